@@ -10,6 +10,7 @@
 #include "dao/mysql_chat_session.hpp"   // mysql数据管理客户端封装
 #include "dao/data_es.hpp"
 #include "dao/data_redis.hpp"   // Members 缓存
+#include "dao/user_info_cache.hpp"   // 成员资料两级缓存
 #include "common/types.pb.h"
 #include "common/error.pb.h"
 #include "common/envelope.pb.h"
@@ -35,7 +36,9 @@ public:
                         const std::string &user_service_name,
                         const std::string &file_service_name,
                         const std::string &message_service_name,
-                        const Members::ptr &members_cache = nullptr)
+                        const Members::ptr &members_cache = nullptr,
+                        const LastMessage::ptr &last_msg = nullptr,
+                        const UserInfoCache<UserInfo>::ptr &user_cache = nullptr)
                         : _es_chat_session(std::make_shared<ESChatSession>(es_client)),
                         _mysql_chat_session(std::make_shared<ChatSessionTable>(mysql_client)),
                         _mysql_chat_session_member(std::make_shared<ChatSessionMemberTable>(mysql_client)),
@@ -43,7 +46,9 @@ public:
                         _user_service_name(user_service_name),
                         _file_service_name(file_service_name),
                         _message_service_name(message_service_name),
-                        _members_cache(members_cache)
+                        _members_cache(members_cache),
+                        _last_msg(last_msg),
+                        _user_cache(user_cache)
     {
         _es_chat_session->create_index();
     }
@@ -66,6 +71,19 @@ public:
         std::string uid = request->user_id();
         //2.  从数据库按顺序查询出用户的会话列表
         std::vector<OrderedChatSessionView> chat_session_list = _mysql_chat_session_member->list_ordered_by_user(uid);
+        if(request->has_min_member_count()) {
+            // 仅按成员数筛选会话 ID：不需要单聊对方与最近消息预览
+            for(const auto &chat_session : chat_session_list) {
+                if(chat_session.member_count < static_cast<int>(request->min_member_count())) continue;
+                auto chat_session_info = response->add_chat_session_info_list();
+                chat_session_info->set_chat_session_id(chat_session.session_id);
+                chat_session_info->set_chat_session_type(static_cast<uint32_t>(chat_session.session_type));
+                chat_session_info->set_member_count(chat_session.member_count);
+            }
+            response->set_request_id(rid);
+            response->set_success(true);
+            return;
+        }
         //3.  找到单聊会话对应的好友ID
         //3. 从数据库查询出用户单聊会话列表
         auto single_friend_list = _mysql_chat_session->singleChatSession(uid);
@@ -73,7 +91,10 @@ public:
         for (const auto &row : single_friend_list) {
             single_friend_map[row.chat_session_id] = row.friend_id;
         }
-        //4.  组织响应
+        //4.  批量取各会话最近一条消息：一次 MGET 读预览缓存，未命中的一次批量 RPC 回源
+        std::unordered_map<std::string, MessageInfo> preview_map;
+        GetLatestMsgPreviews(rid, chat_session_list, preview_map);
+        //5.  组织响应
         for(const auto &chat_session : chat_session_list) {
             auto chat_session_info = response->add_chat_session_info_list();
             if(chat_session.session_type == ChatSessionType::SINGLE) {
@@ -104,11 +125,11 @@ public:
                 );
             }
             //================================================================//
-            //最近一条消息
-            MessageInfo msg;
-            bool ret = GetRecentMsg(rid, chat_session.session_id, msg);
-            if(ret == false) { continue; }
-            chat_session_info->mutable_prev_message()->CopyFrom(msg);
+            //最近一条消息（新建会话没有消息，不设置）
+            auto pit = preview_map.find(chat_session.session_id);
+            if(pit != preview_map.end()) {
+                chat_session_info->mutable_prev_message()->Swap(&pit->second);
+            }
             //================================================================//
         }
         response->set_request_id(rid);
@@ -275,6 +296,7 @@ public:
             user_info->set_description(user_list[member.user_id].description());
             user_info->set_description(user_list[member.user_id].mail());
             user_info->set_description(user_list[member.user_id].avatar());
+            user_info->set_profile_version(user_list[member.user_id].profile_version());
         }
         response->set_request_id(rid);
         response->set_success(true);
@@ -441,6 +463,7 @@ public:
             LOG_ERROR("请求ID - {} 向数据库批量添加会话成员失败", rid);
             return err_response(rid, "向数据库批量添加会话成员失败");
         }
+        // 删 Redis 成员集合并推进成员版本：transmite 进程内成员 L1 据此在 l1_ttl 内感知
         if(_members_cache) _members_cache->invalidate(ssid);
         //4. 填充响应
         response->set_request_id(rid);
@@ -958,11 +981,24 @@ public:
     }
 
 private:
-    /* brief: 对用户管理子服务调用的封装 */
+    /* brief: 批量取成员资料：优先 UserInfoCache，miss 部分回源用户子服务（含头像） */
     bool GetUserInfo(const std::string &rid,
                     const std::unordered_set<std::string> &uid_list,
                     std::unordered_map<std::string, UserInfo> &user_list)
     {
+        std::vector<std::string> uids(uid_list.begin(), uid_list.end());
+        if(!_user_cache) return LoadUserInfo(rid, uids, user_list);
+        return _user_cache->get_many(uids, user_list,
+            [this, &rid](const std::vector<std::string> &miss, std::unordered_map<std::string, UserInfo> &out) {
+                return LoadUserInfo(rid, miss, out);
+            });
+    }
+    /* brief: 对用户管理子服务调用的封装 */
+    bool LoadUserInfo(const std::string &rid,
+                    const std::vector<std::string> &uid_list,
+                    std::unordered_map<std::string, UserInfo> &user_list)
+    {
+        if(uid_list.empty()) return true;
         auto channel = _mm_channels->choose(_user_service_name);
         if(!channel) {
             LOG_ERROR("请求ID - {} 没有可供访问的用户子服务节点: {}", rid, _user_service_name);
@@ -991,38 +1027,60 @@ private:
 
         return true;
     }
-    /* brief: 对消息存储子服务管理的封装 */
-    bool GetRecentMsg(const std::string &rid,
-                    const std::string &chat_session_id,
-                    MessageInfo &msg)
+    /* brief: 批量取会话最近一条消息预览
+     *  - Redis 预览缓存（消息服务落库后写入）一次 MGET
+     *  - 未命中的会话合并成一次 GetLatestMsgPreview RPC，由消息服务批量回源并回填缓存
+     *  - 失败只影响预览展示，不影响会话列表本身
+     */
+    void GetLatestMsgPreviews(const std::string &rid,
+                              const std::vector<OrderedChatSessionView> &chat_session_list,
+                              std::unordered_map<std::string, MessageInfo> &preview_map)
     {
+        std::vector<std::string> ssids;
+        ssids.reserve(chat_session_list.size());
+        for(const auto &cs : chat_session_list) ssids.push_back(cs.session_id);
+        if(ssids.empty()) return;
+
+        std::vector<std::string> missed;
+        if(_last_msg) {
+            auto cached = _last_msg->get_many(ssids);
+            for(size_t i = 0; i < ssids.size(); ++i) {
+                MessageInfo info;
+                if(cached[i] && info.ParseFromString(*cached[i])) {
+                    preview_map.emplace(ssids[i], std::move(info));
+                } else {
+                    missed.push_back(ssids[i]);
+                }
+            }
+        } else {
+            missed = std::move(ssids);
+        }
+        if(missed.empty()) return;
+
         auto channel = _mm_channels->choose(_message_service_name);
         if(!channel) {
-            LOG_ERROR("请求ID - {} 没有可供访问的消息子服务节点: {}", rid, _user_service_name);
-            return false;
+            LOG_ERROR("请求ID - {} 没有可供访问的消息子服务节点: {}", rid, _message_service_name);
+            return;
         }
         MsgStorageService_Stub stub(channel.get());
-        GetRecentMsgReq req;
-        GetRecentMsgRsp rsp;
+        GetLatestMsgPreviewReq req;
+        GetLatestMsgPreviewRsp rsp;
         req.set_request_id(rid);
-        req.set_chat_session_id(chat_session_id);
-        req.set_msg_count(1);
+        for(const auto &ssid : missed) req.add_chat_session_id_list(ssid);
         brpc::Controller cntl;
-        stub.GetRecentMsg(&cntl, &req, &rsp, nullptr);
+        stub.GetLatestMsgPreview(&cntl, &req, &rsp, nullptr);
         if(cntl.Failed() == true) {
             LOG_ERROR("请求ID - {} 消息子服务调用失败: {}", rid, cntl.ErrorText());
-            return false;
+            return;
         }
         if(rsp.success() == false) {
-            LOG_ERROR("请求ID - {} 获取消息信息失败: {}", rid, rsp.errmsg());
-            return false;
+            LOG_ERROR("请求ID - {} 批量获取会话预览失败: {}", rid, rsp.errmsg());
+            return;
         }
-        if(rsp.msg_list_size() > 0) {
-            msg.CopyFrom(rsp.msg_list(0));
-            return true;
+        for(auto &kv : *rsp.mutable_previews()) {
+            preview_map[kv.first].Swap(&kv.second);
         }
-        LOG_DEBUG("请求ID - {} 没有获取到消息", rid);
-        return false;
+        LOG_DEBUG("请求ID - {} 会话预览缓存未命中 {} 个，回源返回 {} 个", rid, missed.size(), rsp.previews_size());
     }
     /* brief: 上传文件到文件存储子服务 */
     bool PutSingleFile(const std::string &rid,
@@ -1060,6 +1118,8 @@ private:
     ChatSessionTable::ptr _mysql_chat_session;
     ChatSessionMemberTable::ptr _mysql_chat_session_member;
     Members::ptr _members_cache;
+    LastMessage::ptr _last_msg;     // 会话最新消息预览（消息服务写，本服务批量读）
+    UserInfoCache<UserInfo>::ptr _user_cache;   // 成员资料缓存（用户服务改资料时失效）
     /* 以下是 RPC 调用客户端相关对象 */
     ServiceManager::ptr _mm_channels;
     std::string _user_service_name;
@@ -1098,12 +1158,14 @@ class ChatSessionServerBuilder
 public:
     /* brief: 构造es客户端对象 */
     void make_es_object(const std::vector<std::string> host_list) { _es_client = ESClientFactory::create(host_list); }
-    /* brief: 构造 Redis 客户端 + Members 缓存（用于成员失效） */
+    /* brief: 构造 Redis 客户端 + Members 缓存（用于成员失效）+ 会话预览缓存 + 用户资料缓存 */
     void make_redis_object(const std::string &host, uint16_t port, int db,
                            bool keep_alive, int pool_size)
     {
         _redis = RedisClientFactory::create(host, port, db, keep_alive, pool_size);
         _members_cache = std::make_shared<Members>(_redis);
+        _last_msg = std::make_shared<LastMessage>(_redis);
+        _user_cache = std::make_shared<UserInfoCache<UserInfo>>(_redis);
     }
     /* brief: 构造mysql客户端对象 */
     void make_mysql_object(const std::string &user,
@@ -1157,7 +1219,7 @@ public:
             abort();
         }
 
-        ChatSessionServiceImpl *chatsession_service = new ChatSessionServiceImpl(_es_client, _mysql_client, _mm_channels, _user_service_name, _file_service_name, _message_service_name, _members_cache);
+        ChatSessionServiceImpl *chatsession_service = new ChatSessionServiceImpl(_es_client, _mysql_client, _mm_channels, _user_service_name, _file_service_name, _message_service_name, _members_cache, _last_msg, _user_cache);
         int ret = _rpc_server->AddService(chatsession_service, brpc::ServiceOwnership::SERVER_OWNS_SERVICE);
         if(ret == -1) {
             LOG_ERROR("添加RPC服务失败!");
@@ -1197,6 +1259,8 @@ private:
     std::shared_ptr<odb::core::database> _mysql_client;
     std::shared_ptr<sw::redis::Redis> _redis;
     Members::ptr _members_cache;
+    LastMessage::ptr _last_msg;
+    UserInfoCache<UserInfo>::ptr _user_cache;
 
     ServiceManager::ptr _mm_channels;
     Discovery::ptr _service_discover;
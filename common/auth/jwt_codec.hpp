@@ -8,20 +8,28 @@
  *   - 多 kid 密钥 map：签发用 current_kid，验签按 token 头部 kid 找密钥
  *   - payload: { sub, did, jti, exp, iat, kid, [typ=refresh] }
  *   - verify 不查 Redis 黑名单（黑名单查询是 JwtStore 的职责）
+ *   - 可选已验签缓存（enable_verify_cache）：key = SHA-256(token)，
+ *     条目寿命 = min(exp - now, max_ttl)，命中跳过 base64/JSON 解码与 HMAC
  *
  * 异常：所有失败路径 throw chatnow::ServiceError，code 来自 chatnow::error::kAuth*。
  *
  * 并发：JwtCodec 构造后 _config 不可变；sign/verify 内部线程安全。
+ *       enable_verify_cache 须在对外服务前调用（启动期一次性配置）。
  */
 
 #include "error/error_codes.hpp"
 #include "error/service_error.hpp"
+#include "utils/lru_cache.hpp"
 #include "utils/trace_id.hpp"
 
 #include "jwt-cpp/jwt.h"
 
+#include <openssl/sha.h>
+
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
@@ -49,6 +57,50 @@ struct JwtClaims {
     bool        is_refresh = false;
 };
 
+/* brief: 已验签 token → claims 的进程内 LRU
+ *  - key 取 token 的 SHA-256 摘要（32 字节），不驻留原 token，碰撞不可构造
+ *  - 条目按 exp 截断寿命；get 命中仍复核 exp，过期视为 miss 交给完整 verify 报错
+ */
+class JwtClaimsCache {
+public:
+    using ptr = std::shared_ptr<JwtClaimsCache>;
+
+    JwtClaimsCache(size_t capacity, int max_ttl_sec)
+        : _max_ttl_sec(max_ttl_sec > 0 ? max_ttl_sec : 1), _lru(capacity) {}
+
+    bool get(const std::string& token, JwtClaims& out) {
+        JwtClaims c;
+        if (!_lru.get(digest(token), c)) return false;
+        if (c.exp_sec <= now_sec()) return false;
+        out = std::move(c);
+        return true;
+    }
+
+    void put(const std::string& token, const JwtClaims& claims) {
+        int64_t ttl = std::min<int64_t>(claims.exp_sec - now_sec(), _max_ttl_sec);
+        if (ttl <= 0) return;
+        _lru.put(digest(token), claims, std::chrono::seconds(ttl));
+    }
+
+    size_t size() const { return _lru.size(); }
+
+    static std::string digest(const std::string& token) {
+        std::string d(SHA256_DIGEST_LENGTH, '\0');
+        SHA256(reinterpret_cast<const unsigned char*>(token.data()), token.size(),
+               reinterpret_cast<unsigned char*>(&d[0]));
+        return d;
+    }
+
+    static int64_t now_sec() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    const int _max_ttl_sec;
+    LruCache<std::string, JwtClaims> _lru;
+};
+
 class JwtCodec {
 public:
     explicit JwtCodec(JwtConfig cfg) : _config(std::move(cfg)) {
@@ -69,6 +121,12 @@ public:
     //   require_refresh 与 typ 不匹配              -> kAuthTokenInvalid
     JwtClaims verify(const std::string& token, bool require_refresh = false);
 
+    /* brief: 开启已验签缓存；capacity == 0 关闭。仅启动期调用 */
+    void enable_verify_cache(size_t capacity, int max_ttl_sec = 300) {
+        _verify_cache = capacity > 0 ? std::make_shared<JwtClaimsCache>(capacity, max_ttl_sec)
+                                     : nullptr;
+    }
+
     int access_ttl_sec()  const { return _config.access_ttl_sec; }
     int refresh_ttl_sec() const { return _config.refresh_ttl_sec; }
 
@@ -77,6 +135,9 @@ public:
 
 private:
     JwtConfig _config;
+    JwtClaimsCache::ptr _verify_cache;
+
+    JwtClaims verify_uncached(const std::string& token, bool require_refresh);
 
     std::string sign_internal(const std::string& user_id,
                               const std::string& device_id,
@@ -146,6 +207,22 @@ inline std::string JwtCodec::sign_refresh(const std::string& user_id,
 }
 
 inline JwtClaims JwtCodec::verify(const std::string& token, bool require_refresh) {
+    if (!_verify_cache) return verify_uncached(token, require_refresh);
+    JwtClaims out;
+    if (_verify_cache->get(token, out)) {
+        if (require_refresh != out.is_refresh) {
+            throw ServiceError(::chatnow::error::kAuthTokenInvalid,
+                               require_refresh ? "expected refresh token"
+                                               : "unexpected refresh token");
+        }
+        return out;
+    }
+    out = verify_uncached(token, require_refresh);
+    _verify_cache->put(token, out);
+    return out;
+}
+
+inline JwtClaims JwtCodec::verify_uncached(const std::string& token, bool require_refresh) {
     using namespace ::chatnow::error;
 
     auto decoded = [&]() {
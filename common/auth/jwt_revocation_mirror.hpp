@@ -0,0 +1,189 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * JwtRevocationMirror —— 吊销集合的进程内镜像（版本号快照同步）
+ * ---------------------------------------------------------------------------
+ * Redis 侧（由 JwtStore::revoke 维护）：
+ *   im:jwt:revoked_set   ZSET  member = jti, score = 吊销记录到期时间（unix 秒）
+ *   im:jwt:revoked_ver   STRING 每次 revoke INCR
+ *
+ * 设计要点：
+ *   1. 后台线程每 interval 一次 GET revoked_ver；版本未变只续期"最近同步成功"时间，
+ *      版本变化才 ZRANGEBYSCORE (now, now + horizon + kClockSkewSec] 拉全量快照整体替换
+ *   2. horizon 取 access token 寿命：能走到 is_revoked 的只有未过期的 access token，
+ *      其吊销记录到期时间 <= 吊销端的 now + access_ttl；上界再放宽 kClockSkewSec，
+ *      吊销端时钟略快于本机时记录仍落在窗口内。长寿命的 refresh 吊销记录不拉取，
+ *      快照大小只与近一个 access 周期内的吊销量相关
+ *   3. 先读版本再拉快照：revoke 端 ZADD 先于 INCR 写入，读到的版本不会比快照新，
+ *      快照之后的吊销必然在下一轮触发重拉
+ *   4. ready() = 同步过至少一次且最近一次成功未超过 stale_after；
+ *      Redis 故障时镜像自动失效，调用方回退到直接查 Redis
+ *   5. 本进程内 revoke 通过 add() 立即生效，不等下一轮同步
+ * ===========================================================================
+ */
+
+#include "infra/logger.hpp"
+
+#include <sw/redis++/redis++.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chatnow::auth {
+
+namespace jwt_key {
+inline constexpr const char* kRevokedSet = "im:jwt:revoked_set";
+inline constexpr const char* kRevokedVer = "im:jwt:revoked_ver";
+}  // namespace jwt_key
+
+class JwtRevocationMirror {
+public:
+    using ptr = std::shared_ptr<JwtRevocationMirror>;
+
+    // 快照上界额外容忍的跨主机时钟偏差（秒）
+    static constexpr int64_t kClockSkewSec = 300;
+
+    JwtRevocationMirror(std::shared_ptr<sw::redis::Redis> c,
+                        std::chrono::milliseconds interval,
+                        int horizon_sec)
+        : _c(std::move(c)),
+          _interval(interval.count() > 0 ? interval : std::chrono::milliseconds(1000)),
+          _stale_after(std::max<int64_t>(_interval.count() * 5, 5000)),
+          _horizon_sec(horizon_sec > 0 ? horizon_sec : 7200) {}
+
+    ~JwtRevocationMirror() { stop(); }
+
+    JwtRevocationMirror(const JwtRevocationMirror&) = delete;
+    JwtRevocationMirror& operator=(const JwtRevocationMirror&) = delete;
+
+    /* brief: 同步一次后启动后台线程；首轮失败不阻塞，ready() 为 false 期间调用方回退 Redis */
+    void start() {
+        if (_thread.joinable()) return;
+        sync_once();
+        _thread = std::thread([this] { _loop(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(_stop_mu);
+            _stop = true;
+        }
+        _stop_cv.notify_all();
+        if (_thread.joinable()) _thread.join();
+    }
+
+    /* brief: 拉取一次；版本未变仅续期。返回本轮是否成功 */
+    bool sync_once() {
+        try {
+            auto v = _c->get(jwt_key::kRevokedVer);
+            int64_t ver = v ? std::stoll(*v) : 0;
+            if (_synced.load(std::memory_order_acquire) && ver == _ver) {
+                _last_ok_ms.store(_now_ms(), std::memory_order_release);
+                return true;
+            }
+            int64_t now = _now_sec();
+            std::vector<std::pair<std::string, double>> items;
+            _c->zrangebyscore(jwt_key::kRevokedSet,
+                              sw::redis::BoundedInterval<double>(
+                                  static_cast<double>(now),
+                                  static_cast<double>(now + _horizon_sec + kClockSkewSec),
+                                  sw::redis::BoundType::LEFT_OPEN),
+                              std::back_inserter(items));
+            std::unordered_map<std::string, int64_t> snap;
+            snap.reserve(items.size());
+            for (auto& it : items) snap.emplace(std::move(it.first), static_cast<int64_t>(it.second));
+            {
+                std::unique_lock<std::shared_mutex> lk(_mu);
+                // 保留本进程刚 add 的、快照里尚未出现的条目，避免被旧快照覆盖
+                for (auto& kv : _local) {
+                    if (kv.second > now) snap.emplace(kv.first, kv.second);
+                }
+                _local.clear();
+                _set.swap(snap);
+            }
+            _ver = ver;
+            _synced.store(true, std::memory_order_release);
+            _last_ok_ms.store(_now_ms(), std::memory_order_release);
+            return true;
+        } catch (const std::exception& e) {
+            LOG_ERROR("JwtRevocationMirror 同步失败: {}", e.what());
+            return false;
+        }
+    }
+
+    bool ready() const {
+        if (!_synced.load(std::memory_order_acquire)) return false;
+        return _now_ms() - _last_ok_ms.load(std::memory_order_acquire) <= _stale_after;
+    }
+
+    bool contains(const std::string& jti) const {
+        std::shared_lock<std::shared_mutex> lk(_mu);
+        auto it = _set.find(jti);
+        return it != _set.end() && it->second > _now_sec();
+    }
+
+    /* brief: 本进程 revoke 后立即写入镜像 */
+    void add(const std::string& jti, int64_t exp_sec) {
+        std::unique_lock<std::shared_mutex> lk(_mu);
+        _set[jti] = exp_sec;
+        _local[jti] = exp_sec;
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lk(_mu);
+        return _set.size();
+    }
+
+private:
+    void _loop() {
+        std::unique_lock<std::mutex> lk(_stop_mu);
+        while (!_stop) {
+            if (_stop_cv.wait_for(lk, _interval, [this] { return _stop; })) break;
+            lk.unlock();
+            sync_once();
+            lk.lock();
+        }
+    }
+
+    static int64_t _now_sec() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    static int64_t _now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::shared_ptr<sw::redis::Redis> _c;
+    const std::chrono::milliseconds _interval;
+    const int64_t _stale_after;                          // ms
+    const int _horizon_sec;
+
+    mutable std::shared_mutex _mu;
+    std::unordered_map<std::string, int64_t> _set;       // jti -> 吊销记录到期时间
+    std::unordered_map<std::string, int64_t> _local;     // 两次快照之间本进程 add 的条目
+
+    int64_t _ver {0};                                    // 仅同步线程读写
+    std::atomic<bool> _synced {false};
+    std::atomic<int64_t> _last_ok_ms {0};
+
+    std::mutex _stop_mu;
+    std::condition_variable _stop_cv;
+    bool _stop {false};
+    std::thread _thread;
+};
+
+}  // namespace chatnow::auth
@@ -6,19 +6,26 @@
  *   im:jwt:revoked:{jti}                  -> "1"          TTL = 剩余寿命
  *   im:jwt:rt:{user_id}:{device_id}       -> refresh_jti  TTL = refresh 寿命
  *   im:jwt:rt_chain:{old_jti}             -> "rotated"    TTL = 24h
+ *   im:jwt:revoked_set / revoked_ver      -> 吊销集合 + 版本号，供进程内镜像同步
+ *                                            （见 jwt_revocation_mirror.hpp）
  *
  * 失败模式：底层 redis 抛异常时函数自身吞掉 + LOG_ERROR + 返回保守值
  *   - is_revoked 失败 → false（不阻断业务，避免雪崩）
  *   - 写失败 → 仅日志，调用方按业务决定
  *
+ * 本地镜像：enable_local_mirror 后 is_revoked 在镜像就绪时只查内存，
+ * 镜像失效（Redis 长时间不可达）自动回退到逐次 GET。
+ *
  * 重放检测：rotate_refresh_or_detect_reuse 用 SET NX 原子保护链节点。
  */
 
+#include "auth/jwt_revocation_mirror.hpp"
 #include "infra/logger.hpp"
 
 #include <sw/redis++/redis++.h>
 
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -38,6 +45,14 @@ public:
     void revoke(const std::string& jti, int ttl_sec);
     bool is_revoked(const std::string& jti);
 
+    /* brief: 开启吊销集合本地镜像（仅鉴权热路径的进程需要，如 gateway）
+     *  horizon_sec 取 access token 寿命；启动期调用一次
+     */
+    void enable_local_mirror(std::chrono::milliseconds interval, int horizon_sec) {
+        _mirror = std::make_shared<JwtRevocationMirror>(_c, interval, horizon_sec);
+        _mirror->start();
+    }
+
     void put_active_refresh(const std::string& user_id,
                             const std::string& device_id,
                             const std::string& refresh_jti,
@@ -65,22 +80,36 @@ public:
 
 private:
     std::shared_ptr<sw::redis::Redis> _c;
+    JwtRevocationMirror::ptr _mirror;
 
     static constexpr int kChainTtlSec = 24 * 3600;
 };
 
 inline void JwtStore::revoke(const std::string& jti, int ttl_sec) {
     if (jti.empty() || ttl_sec <= 0) return;
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t exp = now + ttl_sec;
     try {
-        _c->set(std::string(jwt_key::kRevokedPrefix) + jti, "1",
-                std::chrono::seconds(ttl_sec));
+        // ZADD 先于 INCR：镜像读到新版本时快照必然已包含本条
+        auto pipe = _c->pipeline();
+        pipe.set(std::string(jwt_key::kRevokedPrefix) + jti, "1",
+                 std::chrono::seconds(ttl_sec))
+            .zadd(jwt_key::kRevokedSet, jti, static_cast<double>(exp))
+            .zremrangebyscore(jwt_key::kRevokedSet,
+                              sw::redis::RightBoundedInterval<double>(
+                                  static_cast<double>(now), sw::redis::BoundType::CLOSED))
+            .incr(jwt_key::kRevokedVer);
+        pipe.exec();
     } catch (const std::exception& e) {
         LOG_ERROR("JwtStore.revoke 失败 jti={}: {}", jti, e.what());
     }
+    if (_mirror) _mirror->add(jti, exp);
 }
 
 inline bool JwtStore::is_revoked(const std::string& jti) {
     if (jti.empty()) return false;
+    if (_mirror && _mirror->ready()) return _mirror->contains(jti);
     try {
         auto v = _c->get(std::string(jwt_key::kRevokedPrefix) + jti);
         return v.has_value();
@@ -18,12 +18,19 @@
  */
 
 #include <sw/redis++/redis++.h>
+#include <algorithm>
 #include <chrono>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 #include "infra/logger.hpp"
+#include "utils/token_bucket.hpp"
 
 namespace chatnow
 {
@@ -31,23 +38,37 @@ namespace chatnow
 namespace key
 {
     inline constexpr const char* kSession    = "im:sess:";          // session_id -> user_id
-    inline constexpr const char* kStatus     = "im:status:";        // user_id    -> 1
+    inline constexpr const char* kStatus     = "im:status:";        // user_id    -> 1（已登录）| push_instance_id（已持连，随实例租约失效）
     inline constexpr const char* kVerifyCode = "im:code:";          // code_id    -> 验证码
     inline constexpr const char* kSeqSession = "im:seq:ssid:";      // ssid       -> 会话级 seq
     inline constexpr const char* kSeqUser    = "im:seq:uid:";       // uid        -> 用户级 seq
-    inline constexpr const char* kLastMsg    = "im:last:";          // ssid       -> 最后一条消息预览(JSON)
+    inline constexpr const char* kSeqFence   = "im:seq:fence";      // 全局       -> backfill 抬升 session_seq 时 INCR，作废各实例本地号段
+    inline constexpr const char* kSeqHolder  = "im:seq:holder:";    // ssid       -> 持有号段的 transmite 实例（PX 租约）
+    inline constexpr const char* kLastMsg    = "im:last:";          // ssid       -> "<seq>:<MessageInfo 预览>"
     inline constexpr const char* kDeviceSet  = "im:dev:";           // uid        -> SET<device_id>
     inline constexpr const char* kReadAck    = "im:read:";          // mid        -> SET<uid>
     inline constexpr const char* kMembers    = "im:members:";       // ssid       -> SET<user_id>
-    inline constexpr const char* kRateUser   = "im:rl:user:";       // uid        -> 令牌桶
-    inline constexpr const char* kRateSsid   = "im:rl:ssid:";       // ssid       -> 令牌桶
+    inline constexpr const char* kMembersVer = "im:members:ver:";   // ssid       -> 成员版本（成员变更时 INCR，不过期）
+    inline constexpr const char* kUserInfo    = "im:uinfo:";        // uid        -> "<ver>:<UserInfo 序列化>"
+    inline constexpr const char* kUserInfoVer = "im:uinfo:ver:";    // uid        -> 资料版本（INCR，不过期）
+    inline constexpr const char* kUserBrief   = "im:ubrief:";       // uid        -> "<ver>:<精简资料（无头像）序列化>"
+    inline constexpr const char* kBucketUser = "im:tb:user:";       // uid        -> HASH{t, ts} 令牌桶
+    inline constexpr const char* kBucketSsid = "im:tb:ssid:";       // ssid       -> HASH{t, ts} 令牌桶
+    inline constexpr const char* kDedup      = "im:dedup:";         // uid:client_msg_id -> "pending" | "done:<MessageInfo 序列化>"
     inline constexpr const char* kOnline     = "im:online:";        // uid        -> SET<push_instance_id>
     inline constexpr const char* kPushRoute  = "im:push:route:";    // uid        -> push_instance_id (单设备)
-    inline constexpr const char* kUnacked    = "im:unack:";         // uid        -> Sorted Set<msg_id, ts>
-    inline constexpr const char* kPushOutbox     = "im:push:outbox";       // 全局 Sorted Set<serialized_payload, ts> 投递失败兜底
-    inline constexpr const char* kPushOutboxLock = "im:push:outbox:lock";  // M3 reaper 单实例租约 key
-    inline constexpr const char* kCrossOutbox     = "im:push:cross_outbox";
-    inline constexpr const char* kCrossOutboxLock = "im:push:cross_outbox:lock";
+    inline constexpr const char* kPushLease  = "im:push:lease:";    // push_instance_id -> 1 实例存活租约（路由 / 在线态以此判活）
+    inline constexpr const char* kPushSub    = "im:push:sub:";      // ssid       -> ZSET<push_instance_id, 租约到期秒> 大群订阅
+    inline constexpr const char* kPushSubPending = "im:push:sub_pending";  // ZSET<push_instance_id, 租约到期秒> 有未查清大群的在线用户（订阅全部大群）
+    inline constexpr const char* kPushSubVer = "im:push:sub_ver:";  // ssid       -> 订阅集合已按其逐成员校正过的成员版本
+    inline constexpr const char* kUnackHw    = "im:unack:hw:";      // uid        -> 累计确认的最大 user_seq（故障切换补推起点）
+    inline constexpr const char* kPushOutbox  = "im:push:outbox:stream";        // Stream{p} push_queue 投递失败兜底
+    inline constexpr const char* kCrossOutbox = "im:push:cross_outbox:stream";  // Stream{p, u, peer} 跨实例 PushBatch 失败兜底
+    inline constexpr const char* kESOutbox    = "im:es:outbox:stream";          // Stream{p} es_index_exchange 投递失败兜底
+    inline constexpr const char* kOutboxGroup = "reaper";                       // 各 outbox 的 reaper 消费组
+    inline constexpr const char* kPushOutboxLegacy  = "im:push:outbox";         // 旧版 ZSET outbox，reaper 启动时搬入 stream
+    inline constexpr const char* kCrossOutboxLegacy = "im:push:cross_outbox";
+    inline constexpr const char* kESOutboxLegacy    = "im:es:outbox";
 
     // --- Presence 域（Push 内模块） ---
     inline constexpr const char* kPresence        = "im:presence:";         // {uid} → HASH {state,last_active,custom_status}
@@ -63,8 +84,12 @@ inline constexpr std::chrono::seconds kCodeTtl(60 * 5);             // 验证码
 inline constexpr std::chrono::seconds kLastMsgTtl(24 * 3600);       // 最近消息预览 24 小时
 inline constexpr std::chrono::seconds kReadAckTtl(24 * 3600);       // 已读暂存 24 小时
 inline constexpr std::chrono::seconds kMembersTtl(30 * 60);         // 成员缓存 30 分钟
-inline constexpr std::chrono::seconds kOnlineTtl(60);               // 在线路由 60s（依赖心跳续期）
-inline constexpr std::chrono::seconds kUnackedTtl(7 * 24 * 3600);   // 未 ack 重传缓冲 7 天
+inline constexpr std::chrono::seconds kUserInfoTtl(3600);           // 用户资料 L2 缓存 1 小时
+inline constexpr std::chrono::seconds kOnlineTtl(2 * 3600);         // 在线路由 / 持连在线态 2 小时（仅作回收；存活以实例租约为准）
+inline constexpr std::chrono::seconds kPushLeaseTtl(30);            // Push 实例存活租约 30s（实例定时续约）
+inline constexpr std::chrono::seconds kPushSubTtl(90);              // 大群订阅租约 90s（实例定时续约）
+inline constexpr std::chrono::seconds kUnackedTtl(7 * 24 * 3600);   // 确认高水位 7 天
+inline constexpr std::chrono::seconds kDedupTtl(300);               // 客户端幂等窗口 5 分钟
 
 
 /* brief: Redis 工厂（带连接池） */
@@ -118,11 +143,6 @@ public:
         try { return _c->get(key::kSession + ssid); }
         catch(std::exception &e) { LOG_ERROR("Session.uid 失败 {}: {}", ssid, e.what()); return {}; }
     }
-    /* brief: 续期（每次心跳调用） */
-    void touch(const std::string &ssid, std::chrono::seconds ttl = kSessionTtl) {
-        try { _c->expire(key::kSession + ssid, ttl); }
-        catch(std::exception &e) { LOG_ERROR("Session.touch 失败 {}: {}", ssid, e.what()); }
-    }
 private:
     std::shared_ptr<sw::redis::Redis> _c;
 };
@@ -140,16 +160,39 @@ public:
         try { _c->del(key::kStatus + uid); }
         catch(std::exception &e) { LOG_ERROR("Status.remove 失败 {}: {}", uid, e.what()); }
     }
-    bool exists(const std::string &uid) {
-        try { return _c->get(key::kStatus + uid).has_value(); }
-        catch(std::exception &e) { LOG_ERROR("Status.exists 失败 {}: {}", uid, e.what()); return false; }
+    /* brief: 持连在线态：值记为持连的 push 实例，实例租约失效即视为离线，无需逐连接心跳续期 */
+    void bind(const std::string &uid, const std::string &push_instance,
+              std::chrono::seconds ttl = kOnlineTtl) {
+        try { _c->set(key::kStatus + uid, push_instance, ttl); }
+        catch(std::exception &e) { LOG_ERROR("Status.bind 失败 {}-{}: {}", uid, push_instance, e.what()); }
+    }
+    /* brief: 本实例上最后一条连接断开：仍记为本实例时退回登录态标记（kStatusTtl 后过期），不覆盖其它实例的绑定 */
+    void unbind(const std::string &uid, const std::string &push_instance,
+                std::chrono::seconds ttl = kStatusTtl) {
+        try {
+            std::vector<std::string> keys = {key::kStatus + uid};
+            std::vector<std::string> args = {push_instance, std::to_string(ttl.count())};
+            _c->eval<long long>(kUnbindLua, keys.begin(), keys.end(), args.begin(), args.end());
+        } catch(std::exception &e) { LOG_ERROR("Status.unbind 失败 {}-{}: {}", uid, push_instance, e.what()); }
     }
-    /* brief: 心跳续期 */
-    void touch(const std::string &uid, std::chrono::seconds ttl = kStatusTtl) {
-        try { _c->expire(key::kStatus + uid, ttl); }
-        catch(std::exception &e) { LOG_ERROR("Status.touch 失败 {}: {}", uid, e.what()); }
+    /* brief: 已登录（值为 1）或持连实例租约仍有效 */
+    bool exists(const std::string &uid) {
+        try {
+            std::vector<std::string> keys = {key::kStatus + uid};
+            std::vector<std::string> args = {key::kPushLease};
+            return _c->eval<long long>(kExistsLua, keys.begin(), keys.end(), args.begin(), args.end()) == 1;
+        } catch(std::exception &e) { LOG_ERROR("Status.exists 失败 {}: {}", uid, e.what()); return false; }
     }
 private:
+    static constexpr const char *kExistsLua =
+        "local v = redis.call('GET', KEYS[1]) "
+        "if not v then return 0 end "
+        "if v == '1' then return 1 end "
+        "return redis.call('EXISTS', ARGV[1] .. v)";
+    static constexpr const char *kUnbindLua =
+        "if redis.call('GET', KEYS[1]) == ARGV[1] then "
+        "  redis.call('SET', KEYS[1], '1', 'EX', ARGV[2]) return 1 "
+        "end return 0";
     std::shared_ptr<sw::redis::Redis> _c;
 };
 
@@ -240,12 +283,73 @@ public:
         }
         return res;
     }
-    /* brief: 启动回填 / Redis 数据丢失修复用：把当前 seq 拉到至少 base（Lua 原子操作，消除多实例并发 race） */
+    /* brief: 预占会话级 seq 号段 (end - n, end]（INCRBY 一次往返），同时读回当前 fence
+     *  - holder 非空时带会话持有租约：租约被其它实例持有则不预占、返回 0；
+     *    lease_ms > 0 时顺带（续）取租约，== 0 只校验不取（逐条发号）
+     *  - 失败返回 0；号段仅由会话归属实例在内存中顺序发放（见 SessionSeqAllocator）
+     */
+    unsigned long reserve_session_block(const std::string &ssid, unsigned long n, long long &fence,
+                                        const std::string &holder = "", int lease_ms = 0) {
+        try {
+            std::vector<std::string> keys = {key::kSeqSession + ssid, key::kSeqFence, key::kSeqHolder + ssid};
+            std::vector<std::string> args = {std::to_string(n), holder, std::to_string(lease_ms)};
+            std::vector<long long> res;
+            _c->eval(kReserveLua, keys.begin(), keys.end(), args.begin(), args.end(), std::back_inserter(res));
+            if(res.size() != 2) return 0;
+            if(res[0] == 0) {
+                LOG_DEBUG("SeqGen.reserve_session_block {} 已被其它实例持有", ssid);
+                return 0;
+            }
+            fence = res[1];
+            return static_cast<unsigned long>(res[0]);
+        } catch(std::exception &e) {
+            LOG_ERROR("SeqGen.reserve_session_block 失败 {} n={}: {}", ssid, n, e.what());
+            return 0;
+        }
+    }
+    /* brief: 续期会话持有租约；租约已不属于 holder（过期后被接手）返回 false */
+    bool renew_session_holder(const std::string &ssid, const std::string &holder, int lease_ms) {
+        try {
+            std::vector<std::string> keys = {key::kSeqHolder + ssid};
+            std::vector<std::string> args = {holder, std::to_string(lease_ms)};
+            return _c->eval<long long>(kRenewLua, keys.begin(), keys.end(), args.begin(), args.end()) == 1;
+        } catch(std::exception &e) {
+            LOG_ERROR("SeqGen.renew_session_holder 失败 {}: {}", ssid, e.what());
+            return false;
+        }
+    }
+    /* brief: 归还号段尾部 [next, end]：仅当计数器仍停在 end（之后无人再预占）时回拨到 next - 1；
+     *        next > end 表示无尾部可还。holder 非空时一并释放其持有租约 */
+    bool release_session_block(const std::string &ssid, unsigned long next, unsigned long end,
+                               const std::string &holder = "") {
+        try {
+            std::vector<std::string> keys = {key::kSeqSession + ssid, key::kSeqHolder + ssid};
+            std::vector<std::string> args = {std::to_string(end), std::to_string(next - 1), holder};
+            return _c->eval<long long>(kReleaseLua, keys.begin(), keys.end(), args.begin(), args.end()) == 1;
+        } catch(std::exception &e) {
+            LOG_ERROR("SeqGen.release_session_block 失败 {} [{}, {}]: {}", ssid, next, end, e.what());
+            return false;
+        }
+    }
+    /* brief: 当前 fence；失败返回 -1 */
+    long long session_fence() {
+        try {
+            auto v = _c->get(key::kSeqFence);
+            return v ? std::stoll(*v) : 0;
+        } catch(std::exception &e) {
+            LOG_ERROR("SeqGen.session_fence 失败: {}", e.what());
+            return -1;
+        }
+    }
+    /* brief: 启动回填 / Redis 数据丢失修复用：把当前 seq 拉到至少 base（Lua 原子操作，消除多实例并发 race）
+     *  - 真正抬升时同时 INCR fence：各 transmite 实例内存中的旧号段随之作废，
+     *    避免 Redis 丢数据后旧号段与回填后的新号段重叠
+     */
     void backfill_session(const std::string &ssid, unsigned long base) {
         try {
-            std::vector<std::string> keys = {key::kSeqSession + ssid};
+            std::vector<std::string> keys = {key::kSeqSession + ssid, key::kSeqFence};
             std::vector<std::string> args = {std::to_string(base)};
-            _c->eval<long long>(kBackfillLua, keys.begin(), keys.end(), args.begin(), args.end());
+            _c->eval<long long>(kBackfillFenceLua, keys.begin(), keys.end(), args.begin(), args.end());
         } catch(std::exception &e) {
             LOG_ERROR("SeqGen.backfill_session 失败 {} base={}: {}", ssid, base, e.what());
         }
@@ -267,6 +371,38 @@ private:
         "    return 1 "
         "end "
         "return 0";
+    static constexpr const char *kBackfillFenceLua =
+        "local cur = redis.call('GET', KEYS[1]) "
+        "if not cur or tonumber(cur) < tonumber(ARGV[1]) then "
+        "    redis.call('SET', KEYS[1], ARGV[1]) "
+        "    redis.call('INCR', KEYS[2]) "
+        "    return 1 "
+        "end "
+        "return 0";
+    static constexpr const char *kReserveLua =
+        "if ARGV[2] ~= '' then "
+        "    local h = redis.call('GET', KEYS[3]) "
+        "    if h and h ~= ARGV[2] then return {0, -1} end "
+        "    if tonumber(ARGV[3]) > 0 then redis.call('SET', KEYS[3], ARGV[2], 'PX', ARGV[3]) end "
+        "end "
+        "local e = redis.call('INCRBY', KEYS[1], ARGV[1]) "
+        "local f = tonumber(redis.call('GET', KEYS[2]) or '0') "
+        "return {e, f}";
+    static constexpr const char *kRenewLua =
+        "if redis.call('GET', KEYS[1]) == ARGV[1] then "
+        "    redis.call('PEXPIRE', KEYS[1], ARGV[2]) "
+        "    return 1 "
+        "end "
+        "return 0";
+    static constexpr const char *kReleaseLua =
+        "local r = 0 "
+        "local cur = redis.call('GET', KEYS[1]) "
+        "if tonumber(ARGV[2]) < tonumber(ARGV[1]) and cur and tonumber(cur) == tonumber(ARGV[1]) then "
+        "    redis.call('SET', KEYS[1], ARGV[2]) "
+        "    r = 1 "
+        "end "
+        "if ARGV[3] ~= '' and redis.call('GET', KEYS[2]) == ARGV[3] then redis.call('DEL', KEYS[2]) end "
+        "return r";
     std::shared_ptr<sw::redis::Redis> _c;
 };
 
@@ -280,21 +416,90 @@ public:
     using ptr = std::shared_ptr<LastMessage>;
     LastMessage(const std::shared_ptr<sw::redis::Redis> &c) : _c(c) {}
 
-    /* brief: 写最后一条消息预览（已序列化 JSON 字符串）；TTL 24h */
-    void set(const std::string &ssid, const std::string &preview_json,
+    /* brief: 一条待写入的预览；preview 为已序列化的 MessageInfo（不含文件/头像二进制） */
+    struct Entry {
+        std::string ssid;
+        unsigned long seq;
+        std::string preview;
+    };
+
+    /* brief: 写最后一条消息预览；仅当 seq 不小于已缓存的 seq 才覆盖（重投 / 兜底路径不会让预览回退） */
+    void set(const std::string &ssid, unsigned long seq, const std::string &preview,
              std::chrono::seconds ttl = kLastMsgTtl) {
-        try { _c->set(key::kLastMsg + ssid, preview_json, ttl); }
+        try {
+            std::vector<std::string> keys = {key::kLastMsg + ssid};
+            std::vector<std::string> args = {std::to_string(seq), preview, std::to_string(ttl.count())};
+            _c->eval<long long>(kSetIfNewerLua, keys.begin(), keys.end(), args.begin(), args.end());
+        }
         catch(std::exception &e) { LOG_ERROR("LastMessage.set 失败 {}: {}", ssid, e.what()); }
     }
+    /* brief: 批量写预览（group commit 一批一次 pipeline）；同会话多条只保留 seq 最大的一条 */
+    void set_many(const std::vector<Entry> &entries, std::chrono::seconds ttl = kLastMsgTtl) {
+        if(entries.empty()) return;
+        std::unordered_map<std::string, const Entry*> latest;
+        for(const auto &e : entries) {
+            auto it = latest.find(e.ssid);
+            if(it == latest.end() || it->second->seq < e.seq) latest[e.ssid] = &e;
+        }
+        try {
+            auto pipe = _c->pipeline();
+            const std::string ttl_s = std::to_string(ttl.count());
+            for(const auto &kv : latest) {
+                std::vector<std::string> keys = {key::kLastMsg + kv.first};
+                std::vector<std::string> args = {std::to_string(kv.second->seq), kv.second->preview, ttl_s};
+                pipe.eval(kSetIfNewerLua, keys.begin(), keys.end(), args.begin(), args.end());
+            }
+            pipe.exec();
+        }
+        catch(std::exception &e) { LOG_ERROR("LastMessage.set_many 失败 size={}: {}", latest.size(), e.what()); }
+    }
     sw::redis::OptionalString get(const std::string &ssid) {
-        try { return _c->get(key::kLastMsg + ssid); }
+        try {
+            auto v = _c->get(key::kLastMsg + ssid);
+            if(!v) return {};
+            return _decode(*v);
+        }
         catch(std::exception &e) { LOG_ERROR("LastMessage.get 失败 {}: {}", ssid, e.what()); return {}; }
     }
+    /* brief: 一次 MGET 取多个会话的预览；结果与 ssids 一一对应，未命中为空 */
+    std::vector<sw::redis::OptionalString> get_many(const std::vector<std::string> &ssids) {
+        std::vector<sw::redis::OptionalString> res;
+        if(ssids.empty()) return res;
+        try {
+            std::vector<std::string> keys;
+            keys.reserve(ssids.size());
+            for(const auto &ssid : ssids) keys.push_back(key::kLastMsg + ssid);
+            std::vector<sw::redis::OptionalString> raw;
+            raw.reserve(ssids.size());
+            _c->mget(keys.begin(), keys.end(), std::back_inserter(raw));
+            res.reserve(raw.size());
+            for(auto &v : raw) res.push_back(v ? _decode(*v) : sw::redis::OptionalString{});
+        } catch(std::exception &e) {
+            LOG_ERROR("LastMessage.get_many 失败 size={}: {}", ssids.size(), e.what());
+            res.assign(ssids.size(), sw::redis::OptionalString{});
+        }
+        return res;
+    }
     void remove(const std::string &ssid) {
         try { _c->del(key::kLastMsg + ssid); }
         catch(std::exception &e) { LOG_ERROR("LastMessage.del 失败 {}: {}", ssid, e.what()); }
     }
 private:
+    /* brief: 存储格式 "<seq>:<preview>"；去掉 seq 前缀 */
+    static sw::redis::OptionalString _decode(const std::string &v) {
+        auto pos = v.find(':');
+        if(pos == std::string::npos) return {};
+        return v.substr(pos + 1);
+    }
+    // KEYS[1]=im:last:{ssid}  ARGV[1]=seq ARGV[2]=preview ARGV[3]=ttl_sec
+    static constexpr const char *kSetIfNewerLua =
+        "local cur = redis.call('GET', KEYS[1]) "
+        "if cur then "
+        "    local p = string.find(cur, ':', 1, true) "
+        "    if p and tonumber(string.sub(cur, 1, p - 1)) > tonumber(ARGV[1]) then return 0 end "
+        "end "
+        "redis.call('SET', KEYS[1], ARGV[1] .. ':' .. ARGV[2], 'EX', ARGV[3]) "
+        "return 1";
     std::shared_ptr<sw::redis::Redis> _c;
 };
 
@@ -393,6 +598,32 @@ public:
         catch(std::exception &e) { LOG_ERROR("Members.list 失败 {}: {}", ssid, e.what()); }
         return res;
     }
+    /* brief: 一次往返原子读出 (成员版本, 成员列表)；失败返回 false。集合不存在时 uids 为空，ver 仍有效 */
+    bool load(const std::string &ssid, long long &ver, std::vector<std::string> &uids) {
+        try {
+            std::vector<std::string> keys = {key::kMembers + ssid, key::kMembersVer + ssid};
+            std::vector<std::string> args;
+            std::vector<std::string> res;
+            _c->eval(kLoadLua, keys.begin(), keys.end(), args.begin(), args.end(), std::back_inserter(res));
+            if(res.empty()) return false;
+            ver = std::stoll(res[0]);
+            uids.assign(std::make_move_iterator(res.begin() + 1), std::make_move_iterator(res.end()));
+            return true;
+        } catch(std::exception &e) {
+            LOG_ERROR("Members.load 失败 {}: {}", ssid, e.what());
+            return false;
+        }
+    }
+    /* brief: 成员版本；不存在记 0，失败返回 -1 */
+    long long version(const std::string &ssid) {
+        try {
+            auto v = _c->get(key::kMembersVer + ssid);
+            return v ? std::stoll(*v) : 0;
+        } catch(std::exception &e) {
+            LOG_ERROR("Members.version 失败 {}: {}", ssid, e.what());
+            return -1;
+        }
+    }
     /* brief: 缓存预热 / 重建 */
     void warm(const std::string &ssid, const std::vector<std::string> &uids,
               std::chrono::seconds ttl = kMembersTtl) {
@@ -405,19 +636,139 @@ public:
             LOG_ERROR("Members.warm 失败 {}: {}", ssid, e.what());
         }
     }
-    /* brief: 单成员加入/退出（增量维护） */
+    /* brief: 条件重建：成员版本仍等于回源前读到的 ver 才写入，
+     *  防止"回源读到旧成员 → 期间成员变更并失效 → 旧列表写回"的竞态
+     */
+    bool warm_if_version(const std::string &ssid, const std::vector<std::string> &uids, long long ver,
+                         std::chrono::seconds ttl = kMembersTtl) {
+        if(uids.empty()) return false;
+        try {
+            std::vector<std::string> keys = {key::kMembers + ssid, key::kMembersVer + ssid};
+            std::vector<std::string> args;
+            args.reserve(uids.size() + 2);
+            args.push_back(std::to_string(ver));
+            args.push_back(std::to_string(ttl.count()));
+            args.insert(args.end(), uids.begin(), uids.end());
+            return _c->eval<long long>(kWarmIfVersionLua, keys.begin(), keys.end(), args.begin(), args.end()) == 1;
+        } catch(std::exception &e) {
+            LOG_ERROR("Members.warm_if_version 失败 {}: {}", ssid, e.what());
+            return false;
+        }
+    }
+    /* brief: 单成员加入/退出（增量维护），同时推进成员版本 */
     void add(const std::string &ssid, const std::string &uid) {
-        try { _c->sadd(key::kMembers + ssid, uid); }
-        catch(std::exception &e) { LOG_ERROR("Members.add 失败 {}-{}: {}", ssid, uid, e.what()); }
+        try {
+            auto pipe = _c->pipeline();
+            pipe.sadd(key::kMembers + ssid, uid);
+            pipe.incr(key::kMembersVer + ssid);
+            pipe.exec();
+        } catch(std::exception &e) { LOG_ERROR("Members.add 失败 {}-{}: {}", ssid, uid, e.what()); }
     }
     void remove(const std::string &ssid, const std::string &uid) {
-        try { _c->srem(key::kMembers + ssid, uid); }
-        catch(std::exception &e) { LOG_ERROR("Members.remove 失败 {}-{}: {}", ssid, uid, e.what()); }
+        try {
+            auto pipe = _c->pipeline();
+            pipe.srem(key::kMembers + ssid, uid);
+            pipe.incr(key::kMembersVer + ssid);
+            pipe.exec();
+        } catch(std::exception &e) { LOG_ERROR("Members.remove 失败 {}-{}: {}", ssid, uid, e.what()); }
     }
-    /* brief: 整组失效（解散群 / DDL 变更） */
+    /* brief: 整组失效（成员增删 / 解散群 / DDL 变更）：DEL 集合 + INCR 版本原子执行，
+     *  各 transmite 进程内 L1 据版本变化感知（见 MemberListCache）
+     */
     void invalidate(const std::string &ssid) {
-        try { _c->del(key::kMembers + ssid); }
-        catch(std::exception &e) { LOG_ERROR("Members.invalidate 失败 {}: {}", ssid, e.what()); }
+        try {
+            std::vector<std::string> keys = {key::kMembers + ssid, key::kMembersVer + ssid};
+            std::vector<std::string> args;
+            _c->eval<long long>(kInvalidateLua, keys.begin(), keys.end(), args.begin(), args.end());
+        } catch(std::exception &e) {
+            LOG_ERROR("Members.invalidate 失败 {}: {}", ssid, e.what());
+        }
+    }
+private:
+    // KEYS[1]=im:members:{ssid} KEYS[2]=im:members:ver:{ssid}；返回 {ver, uid...}
+    static constexpr const char *kLoadLua =
+        "local m = redis.call('SMEMBERS', KEYS[1]) "
+        "table.insert(m, 1, redis.call('GET', KEYS[2]) or '0') "
+        "return m";
+    // ARGV[1]=期望版本 ARGV[2]=ttl_sec ARGV[3..]=uid；SADD 分批，避免 unpack 超出 Lua 栈上限
+    static constexpr const char *kWarmIfVersionLua =
+        "if (redis.call('GET', KEYS[2]) or '0') ~= ARGV[1] then return 0 end "
+        "redis.call('DEL', KEYS[1]) "
+        "for i = 3, #ARGV, 1000 do "
+        "    redis.call('SADD', KEYS[1], unpack(ARGV, i, math.min(i + 999, #ARGV))) "
+        "end "
+        "redis.call('EXPIRE', KEYS[1], ARGV[2]) "
+        "return 1";
+    static constexpr const char *kInvalidateLua =
+        "redis.call('DEL', KEYS[1]) "
+        "return redis.call('INCR', KEYS[2])";
+    std::shared_ptr<sw::redis::Redis> _c;
+};
+
+// =============================================================================
+// Push 实例存活租约：每实例一个 key，路由 / 在线态按它判活，取代逐连接心跳 EXPIRE
+// =============================================================================
+
+/* brief: 实例存活与持连用户的续期
+ *  - renew() 由实例定时续约（周期远小于 kPushLeaseTtl）；优雅下线 revoke() 立即失效
+ *  - alive() 一次 MGET 判断一批实例是否存活；OnlineRoute 读路由时据此过滤已宕机实例
+ *  - touch_many() 把一批持连用户的路由 / 在线态 / 登录态 TTL 续期合并为一次 pipeline
+ */
+class PushLease
+{
+public:
+    using ptr = std::shared_ptr<PushLease>;
+    PushLease(const std::shared_ptr<sw::redis::Redis> &c) : _c(c) {}
+
+    bool renew(const std::string &push_instance, std::chrono::seconds ttl = kPushLeaseTtl) {
+        try { return _c->set(key::kPushLease + push_instance, "1", ttl); }
+        catch(std::exception &e) { LOG_ERROR("PushLease.renew 失败 {}: {}", push_instance, e.what()); return false; }
+    }
+    void revoke(const std::string &push_instance) {
+        try { _c->del(key::kPushLease + push_instance); }
+        catch(std::exception &e) { LOG_ERROR("PushLease.revoke 失败 {}: {}", push_instance, e.what()); }
+    }
+    /* brief: 取 instances 中租约有效的实例；查询失败时按全部存活处理（宁可多发一次 RPC，不丢推送） */
+    static std::unordered_set<std::string> alive(sw::redis::Redis &c,
+                                                 const std::unordered_set<std::string> &instances) {
+        std::unordered_set<std::string> res;
+        if(instances.empty()) return res;
+        std::vector<std::string> order(instances.begin(), instances.end());
+        std::vector<std::string> keys;
+        keys.reserve(order.size());
+        for(const auto &i : order) keys.push_back(key::kPushLease + i);
+        try {
+            std::vector<sw::redis::OptionalString> vals;
+            c.mget(keys.begin(), keys.end(), std::back_inserter(vals));
+            for(size_t i = 0; i < order.size() && i < vals.size(); ++i) {
+                if(vals[i]) res.insert(order[i]);
+            }
+        } catch(std::exception &e) {
+            LOG_ERROR("PushLease.alive 失败 size={}: {}", order.size(), e.what());
+            return instances;
+        }
+        return res;
+    }
+    std::unordered_set<std::string> alive(const std::unordered_set<std::string> &instances) {
+        return alive(*_c, instances);
+    }
+    /* brief: 批量续期持连用户 (uid, ssid)：im:online / im:status 续 kOnlineTtl，im:sess 续 kSessionTtl */
+    void touch_many(const std::vector<std::pair<std::string, std::string>> &uid_ssids) {
+        constexpr size_t kChunk = 500;
+        for(size_t off = 0; off < uid_ssids.size(); off += kChunk) {
+            size_t end = std::min(uid_ssids.size(), off + kChunk);
+            try {
+                auto pipe = _c->pipeline();
+                for(size_t i = off; i < end; ++i) {
+                    pipe.expire(key::kOnline + uid_ssids[i].first, kOnlineTtl);
+                    pipe.expire(key::kStatus + uid_ssids[i].first, kOnlineTtl);
+                    pipe.expire(key::kSession + uid_ssids[i].second, kSessionTtl);
+                }
+                pipe.exec();
+            } catch(std::exception &e) {
+                LOG_ERROR("PushLease.touch_many 失败 size={}: {}", end - off, e.what());
+            }
+        }
     }
 private:
     std::shared_ptr<sw::redis::Redis> _c;
@@ -425,6 +776,7 @@ private:
 
 // =============================================================================
 // 在线路由表（多 Push 实例下：uid -> 持有 ws 连接的 push_instance_id 集合）
+// 成员的有效性以实例租约为准：读路由时过滤租约已失效的实例，key 自身 TTL 只用于回收
 // =============================================================================
 
 class OnlineRoute
@@ -444,360 +796,804 @@ public:
             LOG_ERROR("OnlineRoute.bind 失败 {}-{}: {}", uid, push_instance, e.what());
         }
     }
-    /* brief: 心跳续期（每 N 秒由 push 实例对所有持连用户调用） */
-    void touch(const std::string &uid, std::chrono::seconds ttl = kOnlineTtl) {
-        try { _c->expire(key::kOnline + uid, ttl); }
-        catch(std::exception &e) { LOG_ERROR("OnlineRoute.touch 失败 {}: {}", uid, e.what()); }
-    }
     /* brief: 用户在某实例下线 */
     void unbind(const std::string &uid, const std::string &push_instance) {
         try { _c->srem(key::kOnline + uid, push_instance); }
         catch(std::exception &e) { LOG_ERROR("OnlineRoute.unbind 失败 {}-{}: {}", uid, push_instance, e.what()); }
     }
-    /* brief: 取用户当前在哪些 Push 实例上有活跃连接 */
+    /* brief: 取用户当前在哪些 Push 实例上有活跃连接（已过滤租约失效的实例） */
     std::vector<std::string> instances(const std::string &uid) {
         std::vector<std::string> res;
         try { _c->smembers(key::kOnline + uid, std::inserter(res, res.end())); }
         catch(std::exception &e) { LOG_ERROR("OnlineRoute.instances 失败 {}: {}", uid, e.what()); }
+        auto live = PushLease::alive(*_c, std::unordered_set<std::string>(res.begin(), res.end()));
+        res.erase(std::remove_if(res.begin(), res.end(),
+                                 [&live](const std::string &i) { return live.count(i) == 0; }), res.end());
         return res;
     }
-    /* brief: 是否有任意在线设备 */
-    bool online(const std::string &uid) {
-        try { return _c->scard(key::kOnline + uid) > 0; }
-        catch(std::exception &e) { LOG_ERROR("OnlineRoute.online 失败 {}: {}", uid, e.what()); return false; }
+    /* brief: 批量取路由（pipeline 一次往返 + 一次 MGET 判活）；查询失败、不在线或所在实例租约失效的 uid 不出现在结果中
+     *  - 推送扇出对本机未命中的 uid 逐个 SMEMBERS 是 N 次 RTT，大群时阻塞 MQ 消费线程
+     */
+    std::unordered_map<std::string, std::vector<std::string>>
+    instances_many(const std::vector<std::string> &uids) {
+        std::unordered_map<std::string, std::vector<std::string>> res;
+        if(uids.empty()) return res;
+        try {
+            auto pipe = _c->pipeline();
+            for(const auto &uid : uids) pipe.smembers(key::kOnline + uid);
+            auto reply = pipe.exec();
+            for(size_t i = 0; i < uids.size(); ++i) {
+                std::vector<std::string> its;
+                reply.get(i, std::back_inserter(its));
+                if(!its.empty()) res[uids[i]] = std::move(its);
+            }
+        } catch(std::exception &e) {
+            LOG_ERROR("OnlineRoute.instances_many 失败 size={}: {}", uids.size(), e.what());
+            res.clear();
+        }
+        std::unordered_set<std::string> seen;
+        for(const auto &kv : res) seen.insert(kv.second.begin(), kv.second.end());
+        auto live = PushLease::alive(*_c, seen);
+        for(auto it = res.begin(); it != res.end();) {
+            auto &its = it->second;
+            its.erase(std::remove_if(its.begin(), its.end(),
+                                     [&live](const std::string &i) { return live.count(i) == 0; }), its.end());
+            it = its.empty() ? res.erase(it) : std::next(it);
+        }
+        return res;
     }
+    /* brief: 批量下线同一实例上的多个用户（对端不可达时清理路由） */
+    void unbind_many(const std::vector<std::string> &uids, const std::string &push_instance) {
+        if(uids.empty()) return;
+        try {
+            auto pipe = _c->pipeline();
+            for(const auto &uid : uids) pipe.srem(key::kOnline + uid, push_instance);
+            pipe.exec();
+        } catch(std::exception &e) {
+            LOG_ERROR("OnlineRoute.unbind_many 失败 {} size={}: {}", push_instance, uids.size(), e.what());
+        }
+    }
+    /* brief: 是否有任意在线设备（所在实例租约有效） */
+    bool online(const std::string &uid) { return !instances(uid).empty(); }
 private:
     std::shared_ptr<sw::redis::Redis> _c;
 };
 
 // =============================================================================
-// 令牌桶限流（基于 INCR + EXPIRE 简易实现；要求 Redis 7+ 推荐用 redis-cell）
+// 大群订阅索引：会话 → 有该会话在线成员的 Push 实例
 // =============================================================================
 
-class RateLimiter
+/* brief: 读扩散大群按实例广播，取代逐成员查 OnlineRoute
+ *  - 每个 Push 实例登记"本机有在线成员"的大群会话；成员分数为租约到期时间（秒），
+ *    实例崩溃未注销时条目随租约过期，读取只取未过期项
+ *  - 续约即重新 subscribe_many，同时清理已过期条目并顺延 key TTL
+ *  - 有在线用户的大群列表尚未查清（查询中 / 查询失败）的实例登记到 pending 集合，
+ *    视为订阅了全部大群，instances() 一并返回
+ *  - 成员变更后订阅集合可能缺实例（新成员所在实例尚未订阅）：instances() 同时读回
+ *    订阅集合已校正到的成员版本，与消息携带的成员版本不一致时调用方改走逐成员路由，
+ *    对端按收到的会话补登订阅，全部送达后 mark_synced()
+ */
+class SessionSubscribers
 {
 public:
-    using ptr = std::shared_ptr<RateLimiter>;
-    RateLimiter(const std::shared_ptr<sw::redis::Redis> &c) : _c(c) {}
-
-    /**
-     * brief: 滑动窗口 incr-and-check
-     *   - window_sec 内最多允许 max_count 次操作
-     *   - 命中限制返回 false（业务可返回 429 / RATE_LIMITED）
-     */
-    bool allow(const std::string &key_full, int max_count, int window_sec) {
+    using ptr = std::shared_ptr<SessionSubscribers>;
+    SessionSubscribers(const std::shared_ptr<sw::redis::Redis> &c,
+                       std::chrono::seconds lease = kPushSubTtl)
+        : _c(c), _lease(lease) {}
+
+    /* brief: 本实例订阅一批会话（登记 / 续约，一次 pipeline） */
+    void subscribe_many(const std::vector<std::string> &ssids, const std::string &push_instance) {
+        if(ssids.empty()) return;
         try {
-            long long cur = _c->incr(key_full);
-            if(cur == 1) {
-                _c->expire(key_full, std::chrono::seconds(window_sec));
+            long long now = static_cast<long long>(time(nullptr));
+            double expire_at = static_cast<double>(now + _lease.count());
+            using namespace sw::redis;
+            auto pipe = _c->pipeline();
+            for(const auto &ssid : ssids) {
+                std::string k = key::kPushSub + ssid;
+                pipe.zadd(k, push_instance, expire_at)
+                    .zremrangebyscore(k, BoundedInterval<double>(0, static_cast<double>(now),
+                                                                 BoundType::CLOSED))
+                    .expire(k, _lease);
             }
-            return cur <= max_count;
+            pipe.exec();
+        } catch(std::exception &e) {
+            LOG_ERROR("SessionSubscribers.subscribe_many 失败 {} size={}: {}",
+                      push_instance, ssids.size(), e.what());
+        }
+    }
+    /* brief: 本实例取消订阅（该会话在本机已无在线成员） */
+    void unsubscribe_many(const std::vector<std::string> &ssids, const std::string &push_instance) {
+        if(ssids.empty()) return;
+        try {
+            auto pipe = _c->pipeline();
+            for(const auto &ssid : ssids) pipe.zrem(key::kPushSub + ssid, push_instance);
+            pipe.exec();
         } catch(std::exception &e) {
-            LOG_ERROR("RateLimiter.allow {}: {}", key_full, e.what());
-            // 限流器失败时默认放行，避免雪崩
+            LOG_ERROR("SessionSubscribers.unsubscribe_many 失败 {} size={}: {}",
+                      push_instance, ssids.size(), e.what());
+        }
+    }
+    /* brief: 本实例登记 / 续约 pending（有在线用户的大群列表尚未查清） */
+    void subscribe_pending(const std::string &push_instance) {
+        try {
+            long long now = static_cast<long long>(time(nullptr));
+            using namespace sw::redis;
+            auto pipe = _c->pipeline();
+            pipe.zadd(key::kPushSubPending, push_instance, static_cast<double>(now + _lease.count()))
+                .zremrangebyscore(key::kPushSubPending,
+                                  BoundedInterval<double>(0, static_cast<double>(now), BoundType::CLOSED));
+            pipe.exec();
+        } catch(std::exception &e) {
+            LOG_ERROR("SessionSubscribers.subscribe_pending 失败 {}: {}", push_instance, e.what());
+        }
+    }
+    /* brief: 本实例在线用户的大群列表已全部查清，退出 pending */
+    void unsubscribe_pending(const std::string &push_instance) {
+        try { _c->zrem(key::kPushSubPending, push_instance); }
+        catch(std::exception &e) {
+            LOG_ERROR("SessionSubscribers.unsubscribe_pending 失败 {}: {}", push_instance, e.what());
+        }
+    }
+    /* brief: 取订阅了该会话的实例（仅租约未过期，含 pending 实例，一次 pipeline），
+     *        synced_ver 输出订阅集合已校正到的成员版本（未校正过为 -1）；
+     *        Redis 异常返回 false，调用方回退逐成员路由
+     */
+    bool instances(const std::string &ssid, std::vector<std::string> &res, long long &synced_ver) {
+        res.clear();
+        synced_ver = -1;
+        try {
+            long long now = static_cast<long long>(time(nullptr));
+            using namespace sw::redis;
+            LeftBoundedInterval<double> alive(static_cast<double>(now), BoundType::LEFT_OPEN);
+            auto pipe = _c->pipeline();
+            pipe.zrangebyscore(key::kPushSub + ssid, alive)
+                .zrangebyscore(key::kPushSubPending, alive)
+                .get(key::kPushSubVer + ssid);
+            auto reply = pipe.exec();
+            std::vector<std::string> pending;
+            reply.get(0, std::back_inserter(res));
+            reply.get(1, std::back_inserter(pending));
+            for(auto &inst : pending) {
+                if(std::find(res.begin(), res.end(), inst) == res.end()) res.push_back(std::move(inst));
+            }
+            auto ver = reply.get<OptionalString>(2);
+            if(ver) synced_ver = std::stoll(*ver);
             return true;
+        } catch(std::exception &e) {
+            LOG_ERROR("SessionSubscribers.instances 失败 {}: {}", ssid, e.what());
+            res.clear();
+            synced_ver = -1;
+            return false;
         }
     }
-    bool allow_user(const std::string &uid, int max_count, int window_sec) {
-        return allow(key::kRateUser + uid, max_count, window_sec);
+    bool instances(const std::string &ssid, std::vector<std::string> &res) {
+        long long synced_ver;
+        return instances(ssid, res, synced_ver);
     }
-    bool allow_session(const std::string &ssid, int max_count, int window_sec) {
-        return allow(key::kRateSsid + ssid, max_count, window_sec);
+    /* brief: 订阅集合已按成员版本 ver 逐成员校正（各成员所在实例均已补登订阅）；
+     *        随订阅租约过期，过期后下一条消息重新校正一次
+     */
+    void mark_synced(const std::string &ssid, long long ver) {
+        if(ver < 0) return;
+        try { _c->set(key::kPushSubVer + ssid, std::to_string(ver), _lease); }
+        catch(std::exception &e) {
+            LOG_ERROR("SessionSubscribers.mark_synced 失败 {} ver={}: {}", ssid, ver, e.what());
+        }
     }
 private:
     std::shared_ptr<sw::redis::Redis> _c;
+    std::chrono::seconds _lease;
 };
 
 // =============================================================================
-// 推送投递 outbox 兜底（message → push_queue 投递失败时持久化，由后台 reaper 重投）
+// 令牌桶限流（Lua 多桶联合判定，EVALSHA 一次往返；进程内同参数令牌桶预判）
 // =============================================================================
 
-class PushOutbox
+class RateLimiter
 {
 public:
-    using ptr = std::shared_ptr<PushOutbox>;
-    PushOutbox(const std::shared_ptr<sw::redis::Redis> &c) : _c(c) {}
+    using ptr = std::shared_ptr<RateLimiter>;
 
-    /* brief: 投递失败入队（payload 是 InternalMessage 序列化后的 binary） */
-    void enqueue(const std::string &payload, long long score_ts) {
-        try { _c->zadd(key::kPushOutbox, payload, static_cast<double>(score_ts)); }
-        catch(std::exception &e) { LOG_ERROR("PushOutbox.enqueue 失败: {}", e.what()); }
-    }
-    /* brief: reaper 取一批待重投（按时间升序）；返回的项调用方在投递成功后 remove */
-    std::vector<std::string> peek(long limit = 50) {
-        std::vector<std::string> res;
-        try {
-            _c->zrange(key::kPushOutbox, 0, limit - 1, std::back_inserter(res));
-        } catch(std::exception &e) { LOG_ERROR("PushOutbox.peek 失败: {}", e.what()); }
-        return res;
-    }
-    void remove(const std::string &payload) {
-        try { _c->zrem(key::kPushOutbox, payload); }
-        catch(std::exception &e) { LOG_ERROR("PushOutbox.remove 失败: {}", e.what()); }
+    /* brief: rate = 每秒补充令牌数，burst = 桶容量（允许的瞬时突发）；rate <= 0 表示该维度不限 */
+    struct Quota {
+        double rate = 0;
+        double burst = 0;
+        bool enabled() const { return rate > 0 && burst >= 1; }
+    };
+    struct Options {
+        Quota user {10, 100};           // 用户级：平均 10 QPS，突发 100
+        Quota session {50, 500};        // 会话级：平均 50 QPS，突发 500
+        bool local_precheck = true;     // 本地桶见底直接拒绝，不访问 Redis
+    };
+    enum class Verdict { kAllowed, kUserLimited, kSessionLimited };
+
+    RateLimiter(const std::shared_ptr<sw::redis::Redis> &c, const Options &opt = Options())
+        : _c(c), _opt(opt) {}
+
+    /* brief: 发消息限流：用户桶 + 会话桶同时有令牌才放行，且只在放行时扣减 */
+    Verdict allow_message(const std::string &uid, const std::string &ssid) {
+        std::vector<std::string> keys;
+        std::vector<Quota> quotas;
+        std::vector<Verdict> verdicts;
+        if(_opt.user.enabled()) {
+            keys.push_back(key::kBucketUser + uid);
+            quotas.push_back(_opt.user);
+            verdicts.push_back(Verdict::kUserLimited);
+        }
+        if(_opt.session.enabled()) {
+            keys.push_back(key::kBucketSsid + ssid);
+            quotas.push_back(_opt.session);
+            verdicts.push_back(Verdict::kSessionLimited);
+        }
+        if(keys.empty()) return Verdict::kAllowed;
+
+        if(_opt.local_precheck) {
+            if(_opt.user.enabled() && !_local_user.try_take(uid, _opt.user.rate, _opt.user.burst)) {
+                return Verdict::kUserLimited;
+            }
+            if(_opt.session.enabled() && !_local_ssid.try_take(ssid, _opt.session.rate, _opt.session.burst)) {
+                if(_opt.user.enabled()) _local_user.give_back(uid, _opt.user.burst);
+                return Verdict::kSessionLimited;
+            }
+        }
+        size_t hit = allow(keys, quotas);
+        if(hit == 0) return Verdict::kAllowed;
+        // Redis 拒绝时不扣任何桶：本地预判已扣的令牌一并退还
+        if(_opt.local_precheck) {
+            if(_opt.user.enabled()) _local_user.give_back(uid, _opt.user.burst);
+            if(_opt.session.enabled()) _local_ssid.give_back(ssid, _opt.session.burst);
+        }
+        return verdicts[hit - 1];
     }
 
-    /* brief: M3 reaper 单实例租约 — SET NX EX 上锁；已持有则原子续约。
-     *        必须 Lua 原子，否则 acquire 的 GET+EXPIRE 与 release 的 GET+DEL 都有 TOCTOU race，
-     *        race 下两个实例可能同时认为自己持锁，导致 outbox 双发。
-     *        返回是否拿到 / 续到锁。
+    /**
+     * brief: 多桶联合判定（Redis 侧原子执行）
+     *   - 返回 0 表示放行（各桶均扣 1）；否则返回首个见底的桶序号（从 1 起），不扣减任何桶
+     *   - Redis 故障时放行，避免限流器拖垮发送链路
      */
-    bool try_acquire_reaper_lease(const std::string &owner, int ttl_sec) {
-        static const char *kAcquireLua =
-            "if redis.call('SET', KEYS[1], ARGV[1], 'NX', 'EX', ARGV[2]) then return 1 end "
-            "if redis.call('GET', KEYS[1]) == ARGV[1] then "
-            "    redis.call('EXPIRE', KEYS[1], ARGV[2]); return 1 "
-            "end "
-            "return 0";
-        try {
-            std::vector<std::string> keys = {key::kPushOutboxLock};
-            std::vector<std::string> args = {owner, std::to_string(ttl_sec)};
-            auto ret = _c->eval<long long>(kAcquireLua, keys.begin(), keys.end(),
-                                           args.begin(), args.end());
-            return ret == 1;
-        } catch(std::exception &e) {
-            LOG_ERROR("PushOutbox.try_acquire_reaper_lease 失败: {}", e.what());
-            return false;
+    size_t allow(const std::vector<std::string> &keys, const std::vector<Quota> &quotas) {
+        std::vector<std::string> args;
+        args.reserve(quotas.size() * 2);
+        for(const auto &q : quotas) {
+            args.push_back(std::to_string(q.rate));
+            args.push_back(std::to_string(q.burst));
+        }
+        try {
+            try {
+                return static_cast<size_t>(_c->evalsha<long long>(_sha(false), keys.begin(), keys.end(),
+                                                                  args.begin(), args.end()));
+            } catch(const sw::redis::ReplyError &e) {
+                // SCRIPT FLUSH / 主从切换后脚本缓存丢失：重新加载一次
+                if(std::string(e.what()).compare(0, 8, "NOSCRIPT") != 0) throw;
+                return static_cast<size_t>(_c->evalsha<long long>(_sha(true), keys.begin(), keys.end(),
+                                                                  args.begin(), args.end()));
+            }
+        } catch(std::exception &e) {
+            LOG_ERROR("RateLimiter.allow 失败 keys={}: {}", keys.size(), e.what());
+            return 0;
         }
     }
+private:
+    std::string _sha(bool reload) {
+        std::lock_guard<std::mutex> lk(_sha_mu);
+        if(reload || _script_sha.empty()) _script_sha = _c->script_load(kTokenBucketLua);
+        return _script_sha;
+    }
+
+    // KEYS[i] 为 HASH {t: 剩余令牌, ts: 上次更新毫秒}；ARGV[2i-1], ARGV[2i] 为第 i 个桶的 rate / burst
+    // 时间取 Redis TIME：多实例共用同一时钟；replicate_commands 兼容 Redis 5 以前的脚本复制
+    static constexpr const char *kTokenBucketLua =
+        "redis.replicate_commands() "
+        "local t = redis.call('TIME') "
+        "local now = tonumber(t[1]) * 1000 + math.floor(tonumber(t[2]) / 1000) "
+        "local left = {} "
+        "for i = 1, #KEYS do "
+        "    local rate = tonumber(ARGV[2 * i - 1]) "
+        "    local burst = tonumber(ARGV[2 * i]) "
+        "    local v = redis.call('HMGET', KEYS[i], 't', 'ts') "
+        "    local tk = tonumber(v[1]) "
+        "    local ts = tonumber(v[2]) "
+        "    if not tk or not ts then tk = burst ts = now end "
+        "    tk = math.min(burst, tk + math.max(0, now - ts) * rate / 1000) "
+        "    if tk < 1 then return i end "
+        "    left[i] = tk "
+        "end "
+        "for i = 1, #KEYS do "
+        "    local rate = tonumber(ARGV[2 * i - 1]) "
+        "    local burst = tonumber(ARGV[2 * i]) "
+        "    redis.call('HSET', KEYS[i], 't', left[i] - 1, 'ts', now) "
+        "    redis.call('PEXPIRE', KEYS[i], math.ceil(burst * 1000 / rate) + 1000) "
+        "end "
+        "return 0";
+
+    std::shared_ptr<sw::redis::Redis> _c;
+    Options _opt;
+    LocalTokenBuckets _local_user;
+    LocalTokenBuckets _local_ssid;
+    std::mutex _sha_mu;
+    std::string _script_sha;
+};
+
+// =============================================================================
+// 客户端幂等窗口（SET NX 占位；替代每条消息一次 SelectByClientMsg RPC + DB 查询）
+// =============================================================================
 
-    /* brief: M3 reaper 主动释放租约（CAS：仅 owner 与自己一致时 DEL，原子） */
-    void release_reaper_lease(const std::string &owner) {
-        static const char *kReleaseLua =
-            "if redis.call('GET', KEYS[1]) == ARGV[1] then "
-            "    return redis.call('DEL', KEYS[1]) "
-            "end "
-            "return 0";
+class MsgDedup
+{
+public:
+    using ptr = std::shared_ptr<MsgDedup>;
+    enum class State {
+        kAcquired,      // 首次出现，本请求持有占位，成功后 complete / 失败后 release
+        kPending,       // 另一请求正在处理（或其所在实例崩溃，占位等 TTL 过期）
+        kDone,          // 已有结果，value 为首次请求写回的内容
+        kError,         // Redis 不可用，调用方回退到 DB 查询
+    };
+
+    MsgDedup(const std::shared_ptr<sw::redis::Redis> &c, std::chrono::seconds ttl = kDedupTtl)
+        : _c(c), _ttl(ttl) {}
+
+    /* brief: SET NX EX 占位；已存在则一并读回当前值（Lua 一次往返） */
+    State acquire(const std::string &uid, const std::string &client_msg_id, std::string &value) {
         try {
-            std::vector<std::string> keys = {key::kPushOutboxLock};
-            std::vector<std::string> args = {owner};
-            _c->eval<long long>(kReleaseLua, keys.begin(), keys.end(),
-                                args.begin(), args.end());
+            std::vector<std::string> keys = {_key(uid, client_msg_id)};
+            std::vector<std::string> args = {kPendingMark, std::to_string(_ttl.count())};
+            auto cur = _c->eval<sw::redis::OptionalString>(kAcquireLua, keys.begin(), keys.end(),
+                                                           args.begin(), args.end());
+            if(!cur) return State::kAcquired;
+            if(cur->compare(0, kDonePrefixLen, kDonePrefix) != 0) return State::kPending;
+            value = cur->substr(kDonePrefixLen);
+            return State::kDone;
         } catch(std::exception &e) {
-            LOG_ERROR("PushOutbox.release_reaper_lease 失败: {}", e.what());
+            LOG_ERROR("MsgDedup.acquire 失败 {}-{}: {}", uid, client_msg_id, e.what());
+            return State::kError;
+        }
+    }
+    /* brief: 只读查询，语义同 acquire 但不占位（kAcquired 表示窗口内不存在） */
+    State peek(const std::string &uid, const std::string &client_msg_id, std::string &value) {
+        try {
+            auto cur = _c->get(_key(uid, client_msg_id));
+            if(!cur) return State::kAcquired;
+            if(cur->compare(0, kDonePrefixLen, kDonePrefix) != 0) return State::kPending;
+            value = cur->substr(kDonePrefixLen);
+            return State::kDone;
+        } catch(std::exception &e) {
+            LOG_ERROR("MsgDedup.peek 失败 {}-{}: {}", uid, client_msg_id, e.what());
+            return State::kError;
+        }
+    }
+    /* brief: 首次请求成功后写回结果，并从此刻重新计 TTL */
+    void complete(const std::string &uid, const std::string &client_msg_id, const std::string &value) {
+        try { _c->set(_key(uid, client_msg_id), kDonePrefix + value, _ttl); }
+        catch(std::exception &e) { LOG_ERROR("MsgDedup.complete 失败 {}-{}: {}", uid, client_msg_id, e.what()); }
+    }
+    /* brief: 首次请求失败时删除占位（仅当仍为 pending），客户端重试可立即重新处理 */
+    void release(const std::string &uid, const std::string &client_msg_id) {
+        try {
+            std::vector<std::string> keys = {_key(uid, client_msg_id)};
+            std::vector<std::string> args = {kPendingMark};
+            _c->eval<long long>(kReleaseLua, keys.begin(), keys.end(), args.begin(), args.end());
+        } catch(std::exception &e) {
+            LOG_ERROR("MsgDedup.release 失败 {}-{}: {}", uid, client_msg_id, e.what());
         }
     }
 private:
+    static std::string _key(const std::string &uid, const std::string &client_msg_id) {
+        return key::kDedup + uid + ":" + client_msg_id;
+    }
+
+    static constexpr const char *kPendingMark = "pending";
+    static constexpr const char *kDonePrefix = "done:";
+    static constexpr size_t kDonePrefixLen = 5;
+    static constexpr const char *kAcquireLua =
+        "if redis.call('SET', KEYS[1], ARGV[1], 'NX', 'EX', ARGV[2]) then "
+        "    return false "
+        "end "
+        "return redis.call('GET', KEYS[1])";
+    static constexpr const char *kReleaseLua =
+        "if redis.call('GET', KEYS[1]) == ARGV[1] then "
+        "    return redis.call('DEL', KEYS[1]) "
+        "end "
+        "return 0";
     std::shared_ptr<sw::redis::Redis> _c;
+    std::chrono::seconds _ttl;
 };
 
 // =============================================================================
-// 跨实例推送投递 outbox 兜底（PushBatch 跨实例失败时持久化，由 reaper 重试）
+// 投递失败兜底 outbox 公共实现：Redis Stream + 消费组
 // =============================================================================
 
-class CrossInstanceOutbox
+/* brief: outbox 基类
+ *  - enqueue 即 XADD，字段值直接存二进制原文（不做 base64 / 不拼 JSON）
+ *  - 多个 reaper（多实例 / 同实例多线程）以不同 consumer 名加入同一消费组，
+ *    XREADGROUP BLOCK 阻塞等新条目，各自领取、互不重复，积压可并行排空
+ *  - 处理成功才 ack（XACK + XDEL）；失败或 reaper 崩溃的条目留在 PEL，
+ *    空闲超过 min_idle 后任意 reaper 用 XAUTOCLAIM 接管重试，无需选主租约
+ *  - MQ confirm / RPC 回调线程不直接访问 Redis：defer_ack 只登记，reaper 线程每轮 flush_acks 批量提交
+ *  - 旧版 ZSET outbox 由 migrate_legacy 搬入 stream（reaper 启动时调用一次）
+ */
+class StreamOutbox
 {
 public:
-    using ptr = std::shared_ptr<CrossInstanceOutbox>;
-    CrossInstanceOutbox(const std::shared_ptr<sw::redis::Redis> &c) : _c(c) {}
+    using Fields = std::vector<std::pair<std::string, std::string>>;
+    struct Entry {
+        std::string id;
+        Fields fields;
+        /* brief: 取字段值；不存在返回 nullptr */
+        const std::string *get(const std::string &name) const {
+            for(const auto &f : fields) if(f.first == name) return &f.second;
+            return nullptr;
+        }
+    };
 
-    void enqueue(const std::string &payload_b64,
-                 const std::vector<std::string> &failed_uids,
-                 const std::string &peer_instance,
-                 long long score_ts)
-    {
-        std::string member = R"({"k":")" + payload_b64 + R"(","u":[)";
-        for(size_t i = 0; i < failed_uids.size(); ++i) {
-            if(i > 0) member += ",";
-            member += R"(")" + failed_uids[i] + R"(")";
+    StreamOutbox(const std::shared_ptr<sw::redis::Redis> &c, std::string stream,
+                 std::string group = key::kOutboxGroup)
+        : _c(c), _stream(std::move(stream)), _group(std::move(group)) {}
+    virtual ~StreamOutbox() = default;
+
+    /* brief: 建消费组（stream 不存在时一并创建）；已存在视为成功 */
+    bool ensure_group() {
+        try {
+            _c->xgroup_create(_stream, _group, "0", true);
+        } catch(const sw::redis::ReplyError &e) {
+            if(std::string(e.what()).find("BUSYGROUP") != std::string::npos) return true;
+            LOG_ERROR("StreamOutbox.ensure_group 失败 {}: {}", _stream, e.what());
+            return false;
+        } catch(std::exception &e) {
+            LOG_ERROR("StreamOutbox.ensure_group 失败 {}: {}", _stream, e.what());
+            return false;
         }
-        member += R"(],"p":")" + peer_instance + R"("})";
-        enqueue_raw(member, score_ts);
+        return true;
     }
 
-    void enqueue_raw(const std::string &member, long long score_ts) {
-        try { _c->zadd(key::kCrossOutbox, member, static_cast<double>(score_ts)); }
-        catch(std::exception &e) { LOG_ERROR("CrossInstanceOutbox.enqueue 失败: {}", e.what()); }
+    /* brief: 读一批尚未投递给任何 consumer 的新条目；无新条目时至多阻塞 block（须小于连接 socket_timeout） */
+    std::vector<Entry> read(const std::string &consumer, long long count, std::chrono::milliseconds block) {
+        std::vector<Entry> res;
+        try {
+            std::unordered_map<std::string, std::vector<std::pair<std::string, Fields>>> streams;
+            _c->xreadgroup(_group, consumer, _stream, ">", block, count, std::inserter(streams, streams.end()));
+            for(auto &kv : streams) {
+                for(auto &item : kv.second) res.push_back(Entry{std::move(item.first), std::move(item.second)});
+            }
+        } catch(const sw::redis::ReplyError &e) {
+            // NOGROUP：stream 被删除或 Redis 重建，补建消费组后下一轮再读
+            LOG_ERROR("StreamOutbox.read 失败 {}: {}", _stream, e.what());
+            if(std::string(e.what()).find("NOGROUP") != std::string::npos) ensure_group();
+        } catch(std::exception &e) {
+            LOG_ERROR("StreamOutbox.read 失败 {}: {}", _stream, e.what());
+        }
+        return res;
     }
 
-    std::vector<std::string> peek(long limit = 50) {
-        std::vector<std::string> res;
+    /* brief: 接管空闲超过 min_idle 的未确认条目（其它 reaper 崩溃 / 投递失败未 ack）；
+     *        已被删除的悬挂条目直接 ack 清出 PEL */
+    std::vector<Entry> reclaim(const std::string &consumer, std::chrono::milliseconds min_idle, long long count) {
+        std::vector<Entry> res;
+        std::vector<std::string> gone;
         try {
-            _c->zrange(key::kCrossOutbox, 0, limit - 1, std::back_inserter(res));
-        } catch(std::exception &e) { LOG_ERROR("CrossInstanceOutbox.peek 失败: {}", e.what()); }
+            auto r = _c->command("XAUTOCLAIM", _stream, _group, consumer,
+                                 std::to_string(min_idle.count()), "0-0", "COUNT", std::to_string(count));
+            if(!r || r->type != REDIS_REPLY_ARRAY || r->elements < 2) return res;
+            const redisReply *items = r->element[1];
+            for(size_t i = 0; items && items->type == REDIS_REPLY_ARRAY && i < items->elements; ++i) {
+                const redisReply *it = items->element[i];
+                if(it->type != REDIS_REPLY_ARRAY || it->elements < 2) continue;
+                std::string id(it->element[0]->str, it->element[0]->len);
+                const redisReply *kv = it->element[1];
+                if(kv->type != REDIS_REPLY_ARRAY) {     // Redis 6.2 对已删除条目返回 nil
+                    gone.push_back(std::move(id));
+                    continue;
+                }
+                Entry e{std::move(id), {}};
+                for(size_t j = 0; j + 1 < kv->elements; j += 2) {
+                    e.fields.emplace_back(std::string(kv->element[j]->str, kv->element[j]->len),
+                                          std::string(kv->element[j + 1]->str, kv->element[j + 1]->len));
+                }
+                res.push_back(std::move(e));
+            }
+        } catch(std::exception &e) {
+            LOG_ERROR("StreamOutbox.reclaim 失败 {}: {}", _stream, e.what());
+        }
+        if(!gone.empty()) ack(gone);
         return res;
     }
 
-    void remove(const std::string &member) {
-        try { _c->zrem(key::kCrossOutbox, member); }
-        catch(std::exception &e) { LOG_ERROR("CrossInstanceOutbox.remove 失败: {}", e.what()); }
+    /* brief: 处理完成：XACK 出 PEL 并 XDEL 删除条目（一次 pipeline） */
+    void ack(const std::vector<std::string> &ids) {
+        if(ids.empty()) return;
+        try {
+            auto pipe = _c->pipeline();
+            pipe.xack(_stream, _group, ids.begin(), ids.end());
+            pipe.xdel(_stream, ids.begin(), ids.end());
+            pipe.exec();
+        } catch(std::exception &e) {
+            LOG_ERROR("StreamOutbox.ack 失败 {} size={}: {}", _stream, ids.size(), e.what());
+        }
     }
 
-    bool try_acquire_reaper_lease(const std::string &owner, int ttl_sec) {
-        static const char *kAcquireLua =
-            "if redis.call('SET', KEYS[1], ARGV[1], 'NX', 'EX', ARGV[2]) then return 1 end "
-            "if redis.call('GET', KEYS[1]) == ARGV[1] then "
-            "    redis.call('EXPIRE', KEYS[1], ARGV[2]); return 1 "
-            "end "
-            "return 0";
+    /* brief: 登记处理完成的条目，不访问 Redis；可在 MQ confirm / RPC 回调线程调用 */
+    void defer_ack(std::string id) {
+        std::lock_guard<std::mutex> lk(_ack_mu);
+        _acks.push_back(std::move(id));
+    }
+
+    /* brief: 批量提交 defer_ack 登记的条目（一次 pipeline）；由 reaper 线程每轮调用 */
+    void flush_acks() {
+        std::vector<std::string> ids;
+        {
+            std::lock_guard<std::mutex> lk(_ack_mu);
+            ids.swap(_acks);
+        }
+        ack(ids);
+    }
+
+    /* brief: 积压条数（含已领取未确认） */
+    long long backlog() {
+        try { return _c->xlen(_stream); }
+        catch(std::exception &e) { LOG_ERROR("StreamOutbox.backlog 失败 {}: {}", _stream, e.what()); return -1; }
+    }
+
+protected:
+    using Convert = std::function<bool(const std::string &member, Fields &fields)>;
+
+    /* brief: 旧版 ZSET outbox 的成员逐条搬进 stream：Lua 内 ZREM 成功才 XADD，
+     *        多实例同时迁移也不会重复或丢失；convert 失败的成员只删除不搬。返回搬入条数 */
+    size_t migrate_zset(const std::string &zset, const Convert &convert) {
+        static const std::string kMoveLua =
+            "if redis.call('ZREM', KEYS[1], ARGV[1]) == 0 then return 0 end "
+            "if #ARGV < 3 then return 0 end "
+            "redis.call('XADD', KEYS[2], '*', unpack(ARGV, 2)) "
+            "return 1";
+        constexpr long long kBatch = 200;
+        size_t moved = 0, dropped = 0;
         try {
-            std::vector<std::string> keys = {key::kCrossOutboxLock};
-            std::vector<std::string> args = {owner, std::to_string(ttl_sec)};
-            auto ret = _c->eval<long long>(kAcquireLua, keys.begin(), keys.end(),
-                                           args.begin(), args.end());
-            return ret == 1;
+            while(true) {
+                std::vector<std::string> members;
+                _c->zrange(zset, 0, kBatch - 1, std::back_inserter(members));
+                if(members.empty()) break;
+                for(const auto &m : members) {
+                    Fields fields;
+                    std::vector<std::string> keys = {zset, _stream};
+                    std::vector<std::string> args = {m};
+                    if(convert(m, fields)) {
+                        for(auto &f : fields) {
+                            args.push_back(std::move(f.first));
+                            args.push_back(std::move(f.second));
+                        }
+                    } else {
+                        ++dropped;
+                    }
+                    moved += static_cast<size_t>(
+                        _c->eval<long long>(kMoveLua, keys.begin(), keys.end(), args.begin(), args.end()));
+                }
+            }
         } catch(std::exception &e) {
-            LOG_ERROR("CrossInstanceOutbox.try_acquire_reaper_lease 失败: {}", e.what());
-            return false;
+            LOG_ERROR("StreamOutbox 迁移旧版 outbox 失败 {} → {}: {}", zset, _stream, e.what());
+        }
+        if(moved > 0 || dropped > 0) {
+            LOG_INFO("StreamOutbox 旧版 outbox {} 迁移 {} 条，无法解析丢弃 {} 条", zset, moved, dropped);
         }
+        return moved;
     }
 
-    void release_reaper_lease(const std::string &owner) {
-        static const char *kReleaseLua =
-            "if redis.call('GET', KEYS[1]) == ARGV[1] then "
-            "    return redis.call('DEL', KEYS[1]) "
-            "end "
-            "return 0";
+    bool add(const Fields &fields) {
         try {
-            std::vector<std::string> keys = {key::kCrossOutboxLock};
-            std::vector<std::string> args = {owner};
-            _c->eval<long long>(kReleaseLua, keys.begin(), keys.end(),
-                                args.begin(), args.end());
+            _c->xadd(_stream, "*", fields.begin(), fields.end());
+            return true;
         } catch(std::exception &e) {
-            LOG_ERROR("CrossInstanceOutbox.release_reaper_lease 失败: {}", e.what());
+            LOG_ERROR("StreamOutbox.enqueue 失败 {}: {}", _stream, e.what());
+            return false;
         }
     }
 
-private:
     std::shared_ptr<sw::redis::Redis> _c;
+    std::string _stream;
+    std::string _group;
+    std::mutex _ack_mu;
+    std::vector<std::string> _acks;
 };
 
 // =============================================================================
-// ES 索引投递 outbox 兜底（message.onDBMessage → es_index_exchange 投递失败时持久化）
+// 推送投递 outbox 兜底（message → push_queue 投递失败时持久化，由后台 reaper 重投）
 // =============================================================================
 
-class ESOutbox
+class PushOutbox : public StreamOutbox
 {
 public:
-    using ptr = std::shared_ptr<ESOutbox>;
-    ESOutbox(const std::shared_ptr<sw::redis::Redis> &c) : _c(c) {}
+    using ptr = std::shared_ptr<PushOutbox>;
+    PushOutbox(const std::shared_ptr<sw::redis::Redis> &c) : StreamOutbox(c, key::kPushOutbox) {}
 
-    void enqueue(const std::string &payload, long long score_ts) {
-        try { _c->zadd(kEsOutboxKey, payload, static_cast<double>(score_ts)); }
-        catch(std::exception &e) { LOG_ERROR("ESOutbox.enqueue 失败: {}", e.what()); }
-    }
+    /* brief: 投递失败入队（payload 是 InternalMessage 序列化后的 binary） */
+    void enqueue(const std::string &payload) { add({{"p", payload}}); }
 
-    std::vector<std::string> peek(long limit = 50) {
-        std::vector<std::string> res;
-        try {
-            _c->zrange(kEsOutboxKey, 0, limit - 1, std::back_inserter(res));
-        } catch(std::exception &e) { LOG_ERROR("ESOutbox.peek 失败: {}", e.what()); }
-        return res;
+    /* brief: 旧版 ZSET 成员即 payload 原文 */
+    size_t migrate_legacy() {
+        return migrate_zset(key::kPushOutboxLegacy, [](const std::string &m, Fields &f) {
+            f = {{"p", m}};
+            return true;
+        });
     }
+};
 
-    void remove(const std::string &payload) {
-        try { _c->zrem(kEsOutboxKey, payload); }
-        catch(std::exception &e) { LOG_ERROR("ESOutbox.remove 失败: {}", e.what()); }
-    }
+// =============================================================================
+// 跨实例推送投递 outbox 兜底（PushBatch 跨实例失败时持久化，由 reaper 重试）
+// =============================================================================
 
-    bool try_acquire_reaper_lease(const std::string &owner, int ttl_sec) {
-        static const char *kAcquireLua =
-            "if redis.call('SET', KEYS[1], ARGV[1], 'NX', 'EX', ARGV[2]) then return 1 end "
-            "if redis.call('GET', KEYS[1]) == ARGV[1] then "
-            "    redis.call('EXPIRE', KEYS[1], ARGV[2]); return 1 "
-            "end "
-            "return 0";
-        try {
-            std::vector<std::string> keys = {kEsOutboxLockKey};
-            std::vector<std::string> args = {owner, std::to_string(ttl_sec)};
-            return _c->eval<long long>(kAcquireLua, keys.begin(), keys.end(),
-                                        args.begin(), args.end()) == 1;
-        } catch(std::exception &e) {
-            LOG_ERROR("ESOutbox.try_acquire_reaper_lease 失败: {}", e.what());
-            return false;
+class CrossInstanceOutbox : public StreamOutbox
+{
+public:
+    using ptr = std::shared_ptr<CrossInstanceOutbox>;
+    CrossInstanceOutbox(const std::shared_ptr<sw::redis::Redis> &c) : StreamOutbox(c, key::kCrossOutbox) {}
+
+    /* brief: payload 为 InternalMessage 序列化 binary；uid 列表以 '\n' 分隔存一个字段 */
+    void enqueue(const std::string &payload,
+                 const std::vector<std::string> &failed_uids,
+                 const std::string &peer_instance)
+    {
+        std::string uids;
+        for(size_t i = 0; i < failed_uids.size(); ++i) {
+            if(i > 0) uids.push_back('\n');
+            uids += failed_uids[i];
+        }
+        add({{"p", payload}, {"u", uids}, {"peer", peer_instance}});
+    }
+
+    /* brief: 解析条目；缺 payload 返回 false */
+    static bool parse(const Entry &e, std::string &payload,
+                      std::vector<std::string> &uids, std::string &peer_instance) {
+        const std::string *p = e.get("p");
+        if(!p) return false;
+        payload = *p;
+        uids.clear();
+        if(const std::string *u = e.get("u")) {
+            size_t pos = 0;
+            while(pos <= u->size()) {
+                size_t nl = u->find('\n', pos);
+                if(nl == std::string::npos) nl = u->size();
+                if(nl > pos) uids.emplace_back(*u, pos, nl - pos);
+                pos = nl + 1;
+            }
         }
+        const std::string *peer = e.get("peer");
+        peer_instance = peer ? *peer : std::string();
+        return true;
+    }
+
+    /* brief: 旧版 ZSET 成员 {"k":"<base64 payload>","u":["uid",...],"p":"<peer>"} 转为 stream 字段 */
+    size_t migrate_legacy() {
+        return migrate_zset(key::kCrossOutboxLegacy, [](const std::string &m, Fields &f) {
+            auto field = [&m](const char *name, char close, std::string &out) {
+                std::string tag = std::string("\"") + name + "\":" + (close == ']' ? "[" : "\"");
+                size_t b = m.find(tag);
+                if(b == std::string::npos) return false;
+                b += tag.size();
+                size_t e = m.find(close, b);
+                if(e == std::string::npos) return false;
+                out = m.substr(b, e - b);
+                return true;
+            };
+            std::string b64, arr, peer;
+            if(!field("k", '"', b64) || !field("u", ']', arr)) return false;
+            field("p", '"', peer);
+            std::string payload;
+            if(!_base64_decode(b64, payload)) return false;
+            std::string uids;
+            for(size_t q = arr.find('"'); q != std::string::npos; q = arr.find('"', q + 1)) {
+                size_t end = arr.find('"', q + 1);
+                if(end == std::string::npos) break;
+                if(!uids.empty()) uids.push_back('\n');
+                uids.append(arr, q + 1, end - q - 1);
+                q = end;
+            }
+            f = {{"p", std::move(payload)}, {"u", std::move(uids)}, {"peer", std::move(peer)}};
+            return true;
+        });
     }
 
-    void release_reaper_lease(const std::string &owner) {
-        static const char *kReleaseLua =
-            "if redis.call('GET', KEYS[1]) == ARGV[1] then "
-            "    return redis.call('DEL', KEYS[1]) "
-            "end "
-            "return 0";
-        try {
-            std::vector<std::string> keys = {kEsOutboxLockKey};
-            std::vector<std::string> args = {owner};
-            _c->eval<long long>(kReleaseLua, keys.begin(), keys.end(),
-                                args.begin(), args.end());
-        } catch(std::exception &e) {
-            LOG_ERROR("ESOutbox.release_reaper_lease 失败: {}", e.what());
+private:
+    /* brief: 标准 base64（带 '=' 填充）解码，仅迁移旧版成员用 */
+    static bool _base64_decode(const std::string &in, std::string &out) {
+        auto val = [](char c) -> int {
+            if(c >= 'A' && c <= 'Z') return c - 'A';
+            if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if(c >= '0' && c <= '9') return c - '0' + 52;
+            if(c == '+') return 62;
+            if(c == '/') return 63;
+            return -1;
+        };
+        if(in.size() % 4 != 0) return false;
+        out.clear();
+        out.reserve(in.size() / 4 * 3);
+        for(size_t i = 0; i < in.size(); i += 4) {
+            int pad = (in[i + 3] == '=') + (in[i + 2] == '=');
+            unsigned long v = 0;
+            for(size_t j = 0; j < 4; ++j) {
+                int d = (j >= 4 - static_cast<size_t>(pad)) ? 0 : val(in[i + j]);
+                if(d < 0) return false;
+                v = (v << 6) | static_cast<unsigned long>(d);
+            }
+            out.push_back(static_cast<char>((v >> 16) & 0xFF));
+            if(pad < 2) out.push_back(static_cast<char>((v >> 8) & 0xFF));
+            if(pad < 1) out.push_back(static_cast<char>(v & 0xFF));
         }
+        return true;
     }
+};
 
-private:
-    std::shared_ptr<sw::redis::Redis> _c;
-    static constexpr const char *kEsOutboxKey     = "im:es:outbox";
-    static constexpr const char *kEsOutboxLockKey = "im:es:outbox:lock";
+// =============================================================================
+// ES 索引投递 outbox 兜底（message.onDBMessage → es_index_exchange 投递失败时持久化）
+// =============================================================================
+
+class ESOutbox : public StreamOutbox
+{
+public:
+    using ptr = std::shared_ptr<ESOutbox>;
+    ESOutbox(const std::shared_ptr<sw::redis::Redis> &c) : StreamOutbox(c, key::kESOutbox) {}
+
+    void enqueue(const std::string &payload) { add({{"p", payload}}); }
+
+    /* brief: 旧版 ZSET 成员即 payload 原文 */
+    size_t migrate_legacy() {
+        return migrate_zset(key::kESOutboxLegacy, [](const std::string &m, Fields &f) {
+            f = {{"p", m}};
+            return true;
+        });
+    }
 };
 
 // =============================================================================
-// 推送未 ACK 缓冲（B5 用：超时未 ack 的消息进 Sorted Set，按时间戳重传）
+// 推送确认高水位（每用户一个累计确认游标；未确认窗口在持连 Push 实例内存中）
 // =============================================================================
 
+/* brief: 故障切换用：客户端重连到其它实例且未带 last_user_seq 时，从高水位之后补推
+ *  - 只推进不回退（Lua GREATEST）；持连实例定时批量写入，一次往返
+ */
 class UnackedPush
 {
 public:
     using ptr = std::shared_ptr<UnackedPush>;
     UnackedPush(const std::shared_ptr<sw::redis::Redis> &c) : _c(c) {}
 
-    /* brief: 入待重传队列（score = 服务端时间戳秒级） */
-    void push(const std::string &uid, unsigned long user_seq,
-              long long score_ts, std::chrono::seconds ttl = kUnackedTtl) {
-        try {
-            std::string k = key::kUnacked + uid;
-            _c->zadd(k, std::to_string(user_seq), static_cast<double>(score_ts));
-            _c->expire(k, ttl);
-        } catch(std::exception &e) {
-            LOG_ERROR("UnackedPush.push 失败 {}: {}", uid, e.what());
-        }
-    }
-    /* brief: 客户端 ACK 后移除 */
-    void ack(const std::string &uid, unsigned long user_seq) {
-        try { _c->zrem(key::kUnacked + uid, std::to_string(user_seq)); }
-        catch(std::exception &e) { LOG_ERROR("UnackedPush.ack 失败 {}: {}", uid, e.what()); }
-    }
-    /* brief: 取所有"成熟可重传"的 user_seq（按时间升序，仅查询不修改）
-     *  - max_age_sec：仅返回入队时间 ≤ now - max_age_sec 的项（避免立即重传刚入队的）
-     *  - limit：最多返回 limit 条
-     */
-    std::vector<std::string> peek_due(const std::string &uid,
-                                      long limit = 100,
-                                      long max_age_sec = 5) {
-        std::vector<std::string> res;
-        if(limit <= 0) return res;
+    /* brief: 批量推进确认高水位（单条 EVAL，KEYS 与 ARGV 一一对应，末位 ARGV 为 TTL 秒） */
+    void advance_many(const std::vector<std::pair<std::string, uint64_t>> &items,
+                      std::chrono::seconds ttl = kUnackedTtl) {
+        if(items.empty()) return;
+        static const std::string kScript = R"(
+local ttl = tonumber(ARGV[#ARGV])
+for i, k in ipairs(KEYS) do
+    local n = tonumber(ARGV[i])
+    local cur = tonumber(redis.call('GET', k) or '0')
+    if n > cur then redis.call('SET', k, ARGV[i], 'EX', ttl)
+    else redis.call('EXPIRE', k, ttl) end
+end
+return 0
+)";
+        constexpr size_t kChunk = 500;     // 单次脚本不宜过长，避免阻塞 Redis
         try {
-            long long now = static_cast<long long>(time(nullptr));
-            using namespace sw::redis;
-            _c->zrangebyscore(key::kUnacked + uid,
-                              BoundedInterval<double>(0, static_cast<double>(now - max_age_sec),
-                                                       BoundType::CLOSED),
-                              LimitOptions{0, limit},
-                              std::back_inserter(res));
+            for(size_t i = 0; i < items.size(); i += kChunk) {
+                size_t end = std::min(items.size(), i + kChunk);
+                std::vector<std::string> keys, args;
+                keys.reserve(end - i);
+                args.reserve(end - i + 1);
+                for(size_t j = i; j < end; ++j) {
+                    keys.push_back(key::kUnackHw + items[j].first);
+                    args.push_back(std::to_string(items[j].second));
+                }
+                args.push_back(std::to_string(ttl.count()));
+                _c->eval<long long>(kScript, keys.begin(), keys.end(), args.begin(), args.end());
+            }
         } catch(std::exception &e) {
-            LOG_ERROR("UnackedPush.peek_due 失败 {}: {}", uid, e.what());
+            LOG_ERROR("UnackedPush.advance_many 失败 size={}: {}", items.size(), e.what());
         }
-        return res;
     }
-
-    /* brief: 触发重发后把这批 user_seq 的 score 重置为 now（推迟下次重传时机）
-     *  - 用 ZADD XX 仅当存在时才更新；若客户端已 ack，zrem 已经删除，本调用 no-op
-     *  - 配合 peek_due 使用：peek_due → 实际重发 → bump_score 推迟同批的下次重发
-     */
-    void bump_score(const std::string &uid,
-                    const std::vector<std::string> &user_seqs,
-                    std::chrono::seconds ttl = kUnackedTtl) {
-        if(user_seqs.empty()) return;
+    /* brief: 读确认高水位；不存在返回 0，Redis 异常返回 -1 */
+    long long acked(const std::string &uid) {
         try {
-            std::string k = key::kUnacked + uid;
-            long long now = static_cast<long long>(time(nullptr));
-            using namespace sw::redis;
-            std::vector<std::pair<std::string, double>> items;
-            items.reserve(user_seqs.size());
-            for(const auto &s : user_seqs) items.emplace_back(s, static_cast<double>(now));
-            _c->zadd(k, items.begin(), items.end(), UpdateType::EXIST);
-            // 续期 key TTL，避免长期未 ack 项随整 key 7 天到期消失
-            _c->expire(k, ttl);
+            auto v = _c->get(key::kUnackHw + uid);
+            return v ? std::stoll(*v) : 0;
         } catch(std::exception &e) {
-            LOG_ERROR("UnackedPush.bump_score 失败 {}: {}", uid, e.what());
+            LOG_ERROR("UnackedPush.acked 失败 {}: {}", uid, e.what());
+            return -1;
         }
     }
 
@@ -0,0 +1,118 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * MemberListCache —— 群成员列表进程内 L1（按成员版本校验）
+ * ---------------------------------------------------------------------------
+ * 背景：写扩散群每条消息一次 SMEMBERS，200 人群每次发送要从 Redis 搬 200 个 uid
+ *
+ * 设计要点：
+ *   1. L1：LruCache<ssid, Entry{list, ver, checked_at}>，list 为不可变 shared_ptr，
+ *      命中不拷贝；checked_at 距今 < l1_ttl 直接命中，不做任何 I/O（local() 可在 RPC 线程调用）
+ *   2. 超过 l1_ttl 后 GET 一次版本键 im:members:ver:{ssid}：版本未变只刷新 checked_at，
+ *      只传一个整数而非整个成员列表；变了才从 L2 原子读出 (版本, 成员)
+ *   3. 版本由 chatsession 在 AddChatSessionMember / RemoveChatSessionMember / QuitChatSession
+ *      等成员变更后经 Members::invalidate 推进（DEL 集合 + INCR 版本），
+ *      跨进程失效的延迟上限 = l1_ttl
+ *   4. L2 未命中由调用方回源（GetMemberIdList RPC）后 fill()：L2 按回源前读到的版本条件写，
+ *      L1 记同一版本 —— 回源期间发生变更时下次校验必然不一致，不会长期读到旧列表
+ *   5. Redis 异常一律按未命中处理，调用方回源，不影响主流程
+ * ===========================================================================
+ */
+
+#include "dao/data_redis.hpp"
+#include "utils/lru_cache.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace chatnow
+{
+
+class MemberListCache
+{
+public:
+    using ptr  = std::shared_ptr<MemberListCache>;
+    using List = std::shared_ptr<const std::vector<std::string>>;
+
+    MemberListCache(const Members::ptr &members,
+                    size_t l1_capacity = 20000,
+                    std::chrono::milliseconds l1_ttl = std::chrono::seconds(1))
+        : _members(members), _l1(l1_capacity), _l1_ttl(l1_ttl) {}
+
+    /* brief: 仅查 L1 且仍在 l1_ttl 内；不做 I/O。ver 输出该列表对应的成员版本（-1 表示未知） */
+    List local(const std::string &ssid, long long &ver) {
+        ver = -1;
+        Entry e;
+        if(!_l1.get(ssid, e) || Clock::now() - e.checked_at >= _l1_ttl) return nullptr;
+        ver = e.ver;
+        return e.list;
+    }
+    List local(const std::string &ssid) {
+        long long ver;
+        return local(ssid, ver);
+    }
+
+    /* brief: L1 → 版本校验 → L2；未命中返回 nullptr，ver 输出本次读到的版本（回源后 fill 用，-1 表示未知） */
+    List get(const std::string &ssid, long long &ver) {
+        ver = -1;
+        auto now = Clock::now();
+        Entry e;
+        if(_l1.get(ssid, e)) {
+            if(now - e.checked_at < _l1_ttl) {
+                ver = e.ver;
+                return e.list;
+            }
+            long long cur = _members->version(ssid);
+            if(cur >= 0 && cur == e.ver) {
+                e.checked_at = now;
+                _l1.put(ssid, e);
+                ver = cur;
+                return e.list;
+            }
+        }
+        std::vector<std::string> uids;
+        if(!_members->load(ssid, ver, uids)) {
+            ver = -1;
+            return nullptr;
+        }
+        if(uids.empty()) return nullptr;
+        auto list = std::make_shared<const std::vector<std::string>>(std::move(uids));
+        _l1.put(ssid, Entry{list, ver, now});
+        return list;
+    }
+
+    /* brief: 回源结果写回；ver 为回源前 get() 读到的版本 */
+    void fill(const std::string &ssid, const List &list, long long ver) {
+        if(!list || list->empty()) return;
+        if(ver >= 0) _members->warm_if_version(ssid, *list, ver);
+        // 版本未知时记 -1：下次校验必然不一致 → 重新加载
+        _l1.put(ssid, Entry{list, ver, Clock::now()});
+    }
+
+    /* brief: 本进程内立即失效 + 推进全局版本 */
+    void invalidate(const std::string &ssid) {
+        _l1.erase(ssid);
+        _members->invalidate(ssid);
+    }
+
+    size_t l1_size() const { return _l1.size(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Entry {
+        List list;
+        long long ver {-1};
+        Clock::time_point checked_at;
+    };
+
+    Members::ptr _members;
+    LruCache<std::string, Entry> _l1;
+    std::chrono::milliseconds _l1_ttl;
+};
+
+} // namespace chatnow
@@ -11,6 +11,7 @@
 #include <odb/database.hxx>
 #include <odb/mysql/database.hxx>
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <sstream>
@@ -307,7 +308,59 @@ public:
         return _atomic_advance_seq("last_ack_seq", ssid, uid, new_seq);
     }
 
+    struct SeqAdvance {
+        std::string ssid;
+        std::string uid;
+        unsigned long seq;
+    };
+    /* brief: 批量推进送达游标 — 每 kAdvanceChunk 行一条 UPDATE ... JOIN，同一事务提交
+     *  - 同一 (ssid, uid) 先在内存取最大值：JOIN 出现重复行时 MySQL 只更新一次且取值不确定
+     *  - 语义同 update_last_ack_seq：GREATEST 单调推进，重复提交幂等
+     */
+    bool update_last_ack_seq_many(const std::vector<SeqAdvance> &items) {
+        return _atomic_advance_seq_many("last_ack_seq", items);
+    }
+
 private:
+    static constexpr size_t kAdvanceChunk = 500;
+
+    /* brief: 多行原子推进 —
+     *   UPDATE chat_session_member m JOIN (SELECT ? sid, ? uid, ? seq UNION ALL ...) t
+     *      ON m.session_id = t.sid AND m.user_id = t.uid
+     *   SET m.<col> = GREATEST(m.<col>, t.seq)
+     */
+    bool _atomic_advance_seq_many(const char *column, const std::vector<SeqAdvance> &items)
+    {
+        if(items.empty()) return true;
+        std::map<std::pair<std::string, std::string>, unsigned long> merged;
+        for(const auto &it : items) {
+            auto &seq = merged[{it.ssid, it.uid}];
+            seq = std::max(seq, it.seq);
+        }
+        try {
+            odb::transaction trans(_db->begin());
+            auto it = merged.begin();
+            while(it != merged.end()) {
+                std::ostringstream sql;
+                sql << "UPDATE chat_session_member m JOIN (";
+                for(size_t n = 0; n < kAdvanceChunk && it != merged.end(); ++n, ++it) {
+                    if(n > 0) sql << " UNION ALL ";
+                    sql << "SELECT '" << _escape_id(it->first.first) << "' AS sid, '"
+                        << _escape_id(it->first.second) << "' AS uid, "
+                        << it->second << " AS seq";
+                }
+                sql << ") t ON m.session_id = t.sid AND m.user_id = t.uid"
+                    << " SET m." << column << " = GREATEST(m." << column << ", t.seq)";
+                _db->execute(sql.str());
+            }
+            trans.commit();
+            return true;
+        } catch(std::exception &e) {
+            LOG_ERROR("批量推进 {} 失败 size={}: {}", column, merged.size(), e.what());
+            return false;
+        }
+    }
+
     /* brief: 单字段原子推进 — UPDATE chat_session_member SET <col>=GREATEST(<col>, n) WHERE ssid=? AND uid=?
      *  - column 必须是白名单常量字符串（来自代码内部，无外部输入），不需要转义
      *  - ssid / uid 走最小转义（仅 ' 和 \）防御性兜底，避免上游脏数据触发注入
@@ -6,6 +6,7 @@
  * RPC 主路径：
  *   - insert: ApplyUpload / InitMultipart 时新建 pending 行
  *   - select_by_file_id: CompleteUpload / ApplyDownload / GetFileInfo
+ *   - select_committed_by_file_ids: BatchApplyDownload（消息拉取链路一次取整页附件）
  *   - select_by_upload_id: multipart RPC 通过 upload_id 反查
  *   - update_status: pending → committed / deleted / quarantined
  * cleanup 路径：
@@ -70,6 +71,24 @@ public:
         return res;
     }
 
+    /* brief: 批量按 file_id 取 COMMITTED 行（in_range 防注入）；缺失 / 非 committed 的不返回 */
+    std::vector<MediaFile> select_committed_by_file_ids(const std::vector<std::string>& file_ids) {
+        std::vector<MediaFile> v;
+        if (file_ids.empty()) return v;
+        try {
+            odb::transaction trans(_db->begin());
+            using query = odb::query<MediaFile>;
+            auto r = _db->query<MediaFile>(
+                query::file_id.in_range(file_ids.begin(), file_ids.end()) &&
+                (query::status == static_cast<unsigned char>(MediaFileStatus::COMMITTED)));
+            for (auto& f : r) v.push_back(f);
+            trans.commit();
+        } catch (std::exception& e) {
+            LOG_ERROR("media_file 批量查询失败: n={} err={}", file_ids.size(), e.what());
+        }
+        return v;
+    }
+
     /* brief: 按 multipart upload_id 反查 file 行 */
     std::shared_ptr<MediaFile> select_by_upload_id(const std::string& upload_id) {
         std::shared_ptr<MediaFile> res;
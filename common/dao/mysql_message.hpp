@@ -2,6 +2,7 @@
 
 #include "infra/logger.hpp"
 #include "dao/mysql.hpp"
+#include "dao/sql_literal.hpp"
 #include "message.hxx"
 #include "message-odb.hxx"
 #include <odb/mysql/database.hxx>
@@ -27,6 +28,7 @@ namespace chatnow
  *   - 新增 client_msg_id 幂等去重接口：select_by_client_msg
  *   - 新增 mark_revoked / mark_deleted：状态机变更而非物理 erase
  *   - insert / 重要写操作保留"外部事务感知"：服务层有 ODB 事务时复用
+ *   - insert_multi：原生多行 INSERT，供 DB 消费者 group commit 使用
  * ------------------------------------------------------------------
  */
 class MessageTable
@@ -71,6 +73,51 @@ public:
         return true;
     }
 
+    /* brief: 多行 INSERT（group commit 路径）；必须在外部事务内调用
+     *  - 一条语句写多行，省掉逐行 persist 的网络往返；按 kMultiRowLimit / kMultiSqlBytes 切分语句
+     *  - 任一行命中唯一索引整条语句失败并抛出，由调用方回滚后逐条兜底（保留逐条幂等语义）
+     *  - 可空列取值为空（0 / 空串 / not_a_date_time）时写 NULL；content / file_* 与单条路径一致写空串
+     */
+    void insert_multi(const std::vector<Message> &msgs) {
+        if(msgs.empty()) return;
+        static const std::string kHead =
+            "INSERT INTO message (message_id, seq_id, session_id, user_id, message_type, "
+            "create_time, content, client_msg_id, file_id, file_name, file_size, "
+            "reply_to_msg_id, status, revoke_time, revoke_by, edit_time, "
+            "forward_from_uid, forward_at) VALUES ";
+        std::string stmt;
+        size_t rows = 0;
+        auto flush = [&]() {
+            if(rows == 0) return;
+            _db->execute(stmt);
+            stmt.clear();
+            rows = 0;
+        };
+        for(const auto &m : msgs) {
+            stmt += rows == 0 ? kHead : std::string(",");
+            stmt += "(" + std::to_string(m.message_id()) + ","
+                  + std::to_string(m.seq_id()) + ","
+                  + sql::quote(m.session_id()) + ","
+                  + sql::quote(m.user_id()) + ","
+                  + std::to_string(static_cast<unsigned>(m.message_type())) + ","
+                  + sql::datetime(m.create_time()) + ","
+                  + sql::quote(m.content()) + ","
+                  + sql::quote_or_null(m.client_msg_id()) + ","
+                  + sql::quote(m.file_id()) + ","
+                  + sql::quote(m.file_name()) + ","
+                  + std::to_string(m.file_size()) + ","
+                  + (m.reply_to_msg_id() ? std::to_string(m.reply_to_msg_id()) : std::string("NULL")) + ","
+                  + std::to_string(static_cast<unsigned>(m.status())) + ","
+                  + sql::datetime(m.revoke_time()) + ","
+                  + sql::quote_or_null(m.revoke_by()) + ","
+                  + sql::datetime(m.edit_time()) + ","
+                  + sql::quote_or_null(m.forward_from_uid()) + ","
+                  + sql::datetime(m.forward_at()) + ")";
+            if(++rows >= kMultiRowLimit || stmt.size() >= kMultiSqlBytes) flush();
+        }
+        flush();
+    }
+
     /* brief: 客户端断网重发幂等查找
      *  - 走 uk_client_msg(user_id, client_msg_id) 唯一索引
      *  - 命中即视为重复发送，直接复用旧 message 不再写库
@@ -174,6 +221,31 @@ public:
         return res;
     }
 
+    /* brief: 批量取多个会话各自 seq 最大的一条（会话列表预览回源）
+     *  - 单条 SQL：(session_id, seq_id) IN (子查询 GROUP BY session_id)，子查询走 uk_session_seq 松散索引扫描
+     */
+    std::vector<Message> latest_by_sessions(const std::vector<std::string> &ssids) {
+        std::vector<Message> res;
+        if(ssids.empty()) return res;
+        try {
+            std::string in_list;
+            for(const auto &ssid : ssids) {
+                if(!in_list.empty()) in_list += ",";
+                in_list += sql::quote(ssid);
+            }
+            odb::transaction trans(_db->begin());
+            using result = odb::result<Message>;
+            result r(_db->query<Message>(
+                "(session_id, seq_id) IN (SELECT session_id, MAX(seq_id) FROM message "
+                "WHERE session_id IN (" + in_list + ") GROUP BY session_id)"));
+            for(auto &m : r) res.push_back(m);
+            trans.commit();
+        } catch(std::exception &e) {
+            LOG_ERROR("批量取会话最新消息失败 count={}: {}", ssids.size(), e.what());
+        }
+        return res;
+    }
+
     /* brief: 取会话当前最大 seq（DB 层，最终一致；强一致用 Redis） */
     unsigned long max_seq_of_session(const std::string &ssid) {
         unsigned long max_seq = 0;
@@ -295,6 +367,10 @@ public:
     }
 
 private:
+    // 单条多行 INSERT 的上限：行数 / 语句字节数（远低于默认 max_allowed_packet=64MB）
+    static constexpr size_t kMultiRowLimit = 500;
+    static constexpr size_t kMultiSqlBytes = 1 << 20;
+
     std::shared_ptr<odb::core::database> _db;
 };
 
@@ -2,6 +2,7 @@
 
 #include "infra/logger.hpp"
 #include "dao/mysql.hpp"
+#include "dao/sql_literal.hpp"
 #include "user_timeline.hxx"
 #include "user_timeline-odb.hxx"
 #include <odb/database.hxx>
@@ -75,6 +76,34 @@ public:
         return true;
     }
 
+    /* brief: 多行 INSERT（group commit 路径，一批消息的全部扩散行一次写入）
+     *  - 必须在外部事务内调用；按 kMultiRowLimit 行切分语句
+     */
+    void insert_multi(const std::vector<UserTimeline> &timelines) {
+        if(timelines.empty()) return;
+        static const std::string kHead =
+            "INSERT INTO user_timeline (user_id, user_seq, session_id, session_seq, "
+            "message_id, message_time, deliver_status) VALUES ";
+        std::string stmt;
+        size_t rows = 0;
+        for(const auto &tl : timelines) {
+            stmt += rows == 0 ? kHead : std::string(",");
+            stmt += "(" + sql::quote(tl.user_id()) + ","
+                  + std::to_string(tl.user_seq()) + ","
+                  + sql::quote(tl.session_id()) + ","
+                  + std::to_string(tl.session_seq()) + ","
+                  + std::to_string(tl.message_id()) + ","
+                  + sql::datetime(tl.message_time()) + ","
+                  + std::to_string(static_cast<unsigned>(tl.deliver_status())) + ")";
+            if(++rows >= kMultiRowLimit) {
+                _db->execute(stmt);
+                stmt.clear();
+                rows = 0;
+            }
+        }
+        if(rows > 0) _db->execute(stmt);
+    }
+
     /* brief: 全局增量拉取 — 客户端跨会话的统一入口
      *  - 走 idx_user_seq(user_id, user_seq) 索引
      *  - 拉到 user_seq > after_user_seq 的 limit 条；ASC 保证顺序
@@ -325,6 +354,9 @@ private:
         return true;
     }
 
+    // 单条多行 INSERT 的行数上限（每行 < 200B，500 行远低于 max_allowed_packet）
+    static constexpr size_t kMultiRowLimit = 500;
+
     std::shared_ptr<odb::core::database> _db;
 };
 
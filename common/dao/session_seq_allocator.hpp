@@ -0,0 +1,286 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * SessionSeqAllocator —— 会话级 seq 本地号段发放
+ * ---------------------------------------------------------------------------
+ * 前提：gateway 按 chat_session_id 一致性哈希选 transmite，同一会话常态下只由一个
+ *      实例发号，号段可以安全地放在该实例内存里
+ *
+ * 设计要点：
+ *   1. 号段：SeqGen::reserve_session_block 一次 INCRBY n 预占 (end-n, end]，
+ *      之后 n-1 条消息不访问 Redis；每会话一把锁，同会话内严格递增
+ *   2. 自适应大小：号段在 grow_window 内用完则翻倍（上限 max_block），
+ *      否则减半（下限 min_block）。冷会话退化为每条 INCRBY 1，与旧行为一致，
+ *      不持有未用号段；只有热会话才持有较大号段
+ *   3. 避免空洞：号段空闲超过 idle_release 或会话归属已迁走（owned 回调为 false）时，
+ *      把未用尾部 [next, end] 以 CAS 方式还给 Redis（计数器仍停在 end 才回拨），
+ *      接手实例从原位置继续；stop() 时全部归还（滚动发布 = 平滑交接）
+ *   4. fence：backfill_session 真正抬升计数器时 INCR im:seq:fence；预占时同时读回
+ *      fence 记在号段上，tick 周期刷新全局 fence，不一致的号段直接作废（不归还），
+ *      防止 Redis 丢数据回填后旧号段与新号段重叠
+ *   5. 持有租约（holder 非空时）：预占号段同时在 im:seq:holder:{ssid} 取 PX 租约，
+ *      同一会话同一时刻只有一个实例持有号段；过半寿命时在 next() 中续期，续期失败的号段作废。
+ *      next() 发号前校验归属：已迁走则先归还尾部与租约再处理本条，新旧实例不会交错发号；
+ *      非归属实例（如网关因归属实例被摘除而回退）仅在无人持有租约时逐条 INCR，不持号段，否则拒绝
+ *   6. 已知边界：实例崩溃时未归还的尾部成为空洞（仅热会话，长度 <= max_block），
+ *      其会话在租约过期（lease_ms）前拒绝发号
+ * ===========================================================================
+ */
+
+#include "dao/data_redis.hpp"
+#include "infra/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chatnow
+{
+
+class SessionSeqAllocator
+{
+public:
+    using ptr = std::shared_ptr<SessionSeqAllocator>;
+    /* brief: ssid 当前是否归本实例；为空表示恒为 true */
+    using OwnedFn = std::function<bool(const std::string &ssid)>;
+
+    struct Options {
+        size_t min_block = 1;
+        size_t max_block = 64;
+        int grow_window_ms = 1000;      // 号段在该时间内用完则翻倍
+        int idle_release_ms = 3000;     // 号段空闲超过该时间归还尾部
+        int tick_ms = 500;              // fence 刷新 / 归还扫描周期
+        std::string holder;             // 本实例标识；为空不取持有租约（单实例部署）
+        int lease_ms = 6000;            // 持有租约时长，须大于 idle_release_ms + tick_ms
+    };
+
+    static constexpr size_t kShards = 64;
+
+    SessionSeqAllocator(const SeqGen::ptr &seq_gen, const Options &opt, OwnedFn owned = nullptr)
+        : _seq_gen(seq_gen), _opt(opt), _owned(std::move(owned)) {
+        if(_opt.min_block == 0) _opt.min_block = 1;
+        if(_opt.max_block < _opt.min_block) _opt.max_block = _opt.min_block;
+    }
+    ~SessionSeqAllocator() {
+        stop();
+    }
+
+    SessionSeqAllocator(const SessionSeqAllocator &) = delete;
+    SessionSeqAllocator &operator=(const SessionSeqAllocator &) = delete;
+
+    void start() {
+        if(_thread.joinable()) return;
+        _refresh_fence();
+        _thread = std::thread([this] {
+            std::unique_lock<std::mutex> lk(_stop_mu);
+            while(!_stop) {
+                if(_stop_cv.wait_for(lk, std::chrono::milliseconds(_opt.tick_ms), [this] { return _stop; })) break;
+                lk.unlock();
+                tick();
+                lk.lock();
+            }
+        });
+    }
+
+    /* brief: 停止后台线程并归还全部未用尾部（平滑下线） */
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(_stop_mu);
+            _stop = true;
+        }
+        _stop_cv.notify_all();
+        if(_thread.joinable()) _thread.join();
+        release_all();
+    }
+
+    /* brief: 发放下一个 session_seq；失败返回 0（业务侧需视为 fatal） */
+    unsigned long next(const std::string &ssid) {
+        auto b = _block(ssid);
+        std::lock_guard<std::mutex> lk(b->mu);
+        int64_t now = _now_ms();
+        b->last_ms = now;
+        if(_owned && !_owned(ssid)) return _next_unowned(ssid, *b);
+        if(_valid(*b) && b->held && now >= b->lease_until) _renew(ssid, *b, now);
+        if(_valid(*b)) return b->next++;
+
+        // 号段用尽 / 被归还 / fence 作废：按上一段的消耗速度调整大小后重新预占
+        if(b->end != 0 && b->next > b->end && !b->released) {
+            b->size = (now - b->reserved_ms < _opt.grow_window_ms)
+                ? std::min(b->size * 2, _opt.max_block)
+                : std::max(b->size / 2, _opt.min_block);
+        } else {
+            b->size = _opt.min_block;
+        }
+        long long fence = 0;
+        unsigned long end = _seq_gen->reserve_session_block(ssid, b->size, fence, _opt.holder, _opt.lease_ms);
+        if(end == 0) return 0;
+        b->held = !_opt.holder.empty();
+        b->lease_until = now + _opt.lease_ms / 2;
+        _raise_fence(fence);
+        b->fence = fence;
+        b->next = end - b->size + 1;
+        b->end = end;
+        b->reserved_ms = now;
+        b->released = false;
+        return b->next++;
+    }
+
+    /* brief: 一轮维护：刷新 fence；归还空闲 / 已迁走会话的尾部；清理空闲条目 */
+    void tick() {
+        _refresh_fence();
+        int64_t now = _now_ms();
+        for(auto &shard : _shards) {
+            std::vector<std::pair<std::string, BlockPtr>> snapshot;
+            {
+                std::lock_guard<std::mutex> lk(shard.mu);
+                snapshot.assign(shard.map.begin(), shard.map.end());
+            }
+            std::vector<std::string> idle;
+            for(auto &kv : snapshot) {
+                std::lock_guard<std::mutex> lk(kv.second->mu);
+                bool is_idle = now - kv.second->last_ms > _opt.idle_release_ms;
+                if(is_idle || (_owned && !_owned(kv.first))) _release(kv.first, *kv.second);
+                if(is_idle) idle.push_back(kv.first);
+            }
+            snapshot.clear();
+            std::lock_guard<std::mutex> lk(shard.mu);
+            for(const auto &ssid : idle) {
+                auto it = shard.map.find(ssid);
+                // 仅 map 自身持有时才删除：避免与正在 next() 的线程拿到两个不同的 Block
+                if(it != shard.map.end() && it->second.use_count() == 1) shard.map.erase(it);
+            }
+        }
+    }
+
+    /* brief: 归还全部未用尾部 */
+    void release_all() {
+        for(auto &shard : _shards) {
+            std::lock_guard<std::mutex> slk(shard.mu);
+            for(auto &kv : shard.map) {
+                std::lock_guard<std::mutex> lk(kv.second->mu);
+                _release(kv.first, *kv.second);
+            }
+        }
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for(const auto &shard : _shards) {
+            std::lock_guard<std::mutex> lk(shard.mu);
+            n += shard.map.size();
+        }
+        return n;
+    }
+
+    long long fence() const { return _fence.load(std::memory_order_acquire); }
+
+private:
+    struct Block {
+        std::mutex mu;
+        unsigned long next {0};
+        unsigned long end {0};
+        long long fence {-1};
+        size_t size {1};
+        int64_t reserved_ms {0};
+        int64_t last_ms {0};
+        int64_t lease_until {0};        // 过此时刻须续期持有租约
+        bool held {false};              // 是否持有 Redis 侧持有租约
+        bool released {false};
+    };
+    using BlockPtr = std::shared_ptr<Block>;
+    struct Shard {
+        mutable std::mutex mu;
+        std::unordered_map<std::string, BlockPtr> map;
+    };
+
+    BlockPtr _block(const std::string &ssid) {
+        auto &shard = _shards[std::hash<std::string>{}(ssid) % kShards];
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto &b = shard.map[ssid];
+        if(!b) {
+            b = std::make_shared<Block>();
+            b->size = _opt.min_block;
+        }
+        return b;
+    }
+
+    bool _valid(const Block &b) const {
+        return b.end != 0 && b.next <= b.end && b.fence == _fence.load(std::memory_order_acquire);
+    }
+
+    /* brief: 调用方持有 b.mu；归还尾部并释放持有租约。fence 已变的号段直接作废，不回拨（计数器已被回填改写） */
+    void _release(const std::string &ssid, Block &b) {
+        bool tail = _valid(b);
+        if(!tail && !b.held) return;
+        unsigned long from = tail ? b.next : b.end + 1;
+        if(!_seq_gen->release_session_block(ssid, from, b.end, b.held ? _opt.holder : std::string()) && tail) {
+            LOG_DEBUG("SessionSeqAllocator 号段尾部未能归还 {} [{}, {}]（之后已有预占）", ssid, b.next, b.end);
+        }
+        b.next = b.end + 1;
+        b.held = false;
+        b.released = true;
+    }
+
+    /* brief: 调用方持有 b.mu；续期持有租约，租约已丢失（过期后被接手）则作废号段，避免与接手实例交错发号 */
+    void _renew(const std::string &ssid, Block &b, int64_t now) {
+        if(_seq_gen->renew_session_holder(ssid, _opt.holder, _opt.lease_ms)) {
+            b.lease_until = now + _opt.lease_ms / 2;
+            return;
+        }
+        LOG_WARN("SessionSeqAllocator 会话 {} 持有租约已丢失，作废号段 [{}, {}]", ssid, b.next, b.end);
+        b.next = b.end + 1;
+        b.held = false;
+        b.released = true;
+    }
+
+    /* brief: 调用方持有 b.mu；会话已不归本实例：交还号段与租约，仅在无人持有时逐条发号，否则拒绝（返回 0） */
+    unsigned long _next_unowned(const std::string &ssid, Block &b) {
+        _release(ssid, b);
+        if(_opt.holder.empty()) {
+            LOG_WARN("SessionSeqAllocator 会话 {} 不归本实例，拒绝发号", ssid);
+            return 0;
+        }
+        long long fence = 0;
+        return _seq_gen->reserve_session_block(ssid, 1, fence, _opt.holder, 0);
+    }
+
+    void _refresh_fence() {
+        long long f = _seq_gen->session_fence();
+        if(f >= 0) _raise_fence(f);
+    }
+
+    void _raise_fence(long long f) {
+        long long cur = _fence.load(std::memory_order_acquire);
+        while(f > cur && !_fence.compare_exchange_weak(cur, f, std::memory_order_acq_rel)) {}
+    }
+
+    static int64_t _now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    SeqGen::ptr _seq_gen;
+    Options _opt;
+    OwnedFn _owned;
+    std::atomic<long long> _fence {0};
+    Shard _shards[kShards];
+
+    std::mutex _stop_mu;
+    std::condition_variable _stop_cv;
+    bool _stop {false};
+    std::thread _thread;
+};
+
+} // namespace chatnow
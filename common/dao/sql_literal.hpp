@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * SQL 字面量拼装（MySQL 原生多行 INSERT 用）
+ * ---
+ * ODB 的 bulk persist 在 MySQL 后端不可用，多行 INSERT 只能走 database::execute
+ * 拼原生 SQL。这里集中提供字面量转义，DAO 不要各自手搓引号。
+ *
+ * - quote：转义规则与 mysql_real_escape_string 一致（\0 \n \r \\ ' " \x1a），
+ *   依赖服务端默认 sql_mode（未开启 NO_BACKSLASH_ESCAPES）与 utf8mb4 连接字符集
+ * - datetime：ptime → 'YYYY-MM-DD HH:MM:SS.ffffff'；not_a_date_time → NULL
+ */
+
+#include <string>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace chatnow::sql {
+
+/* brief: 字符串 → 带单引号的 SQL 字面量 */
+inline std::string quote(const std::string &v) {
+    std::string out;
+    out.reserve(v.size() + 2);
+    out.push_back('\'');
+    for(char c : v) {
+        switch(c) {
+            case '\0':   out += "\\0";  break;
+            case '\n':   out += "\\n";  break;
+            case '\r':   out += "\\r";  break;
+            case '\\':   out += "\\\\"; break;
+            case '\'':   out += "\\'";  break;
+            case '"':    out += "\\\""; break;
+            case '\x1a': out += "\\Z";  break;
+            default:     out.push_back(c);
+        }
+    }
+    out.push_back('\'');
+    return out;
+}
+
+/* brief: 可空字符串；空串按 NULL 写入（对应 odb::nullable 未赋值） */
+inline std::string quote_or_null(const std::string &v) {
+    return v.empty() ? std::string("NULL") : quote(v);
+}
+
+/* brief: ptime → DATETIME 字面量 */
+inline std::string datetime(const boost::posix_time::ptime &t) {
+    if(t.is_special()) return "NULL";
+    std::string s = boost::posix_time::to_iso_extended_string(t);
+    auto pos = s.find('T');
+    if(pos != std::string::npos) s[pos] = ' ';
+    return "'" + s + "'";
+}
+
+} // namespace chatnow::sql
@@ -0,0 +1,297 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * UserInfoCache —— 用户资料两级缓存（进程内 LRU + Redis）
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. L1：进程内 ByteLruCache<uid, Entry{info, ver, checked_at}>，按序列化字节数限额：
+ *      完整资料含头像字节，条目大小从几十字节到上百 KB，按条目数计无法约束内存；
+ *      checked_at 距今 < l1_ttl 直接命中，超过后用一次 MGET 版本键做校验，
+ *      版本未变只刷新 checked_at，不重新拉取资料 —— 跨进程失效的延迟上限 = l1_ttl
+ *   2. L2：Redis im:uinfo:{uid} = "<ver>:<序列化资料>"，TTL kUserInfoTtl；
+ *      版本键 im:uinfo:ver:{uid} 只在资料变更时 INCR，不过期。
+ *      资料投影不同的调用方（如 transmite 的精简发送者资料）用独立前缀 l2_prefix，共用版本键，
+ *      互不覆盖：完整资料（含头像）与精简资料不会串读
+ *   3. 回源：调用方提供批量 Loader（通常包一次 GetMultiUserInfo RPC）；
+ *      同一 uid 的并发 miss 经 SingleFlight 合并为一次回源；回源失败同样传给 follower，
+ *      follower 返回 false 而不是把瞬时故障当成"用户不存在"
+ *   4. 回写 L2 走 Lua 条件写：只有版本键仍等于回源前读到的版本才写入，
+ *      防止"回源读到旧资料 → 期间资料被改并失效 → 旧资料写回"的竞态
+ *   5. invalidate()：INCR 版本 + DEL 各投影资料 + 清本地 L1；由用户服务在
+ *      SetUserNickname / SetUserAvatar / SetUserDescription / SetUserMailNumber 成功后调用
+ *   6. Info 为各服务生成的 UserInfo pb 类型（需 user_id() / SerializeAsString / ParseFromString），
+ *      common 不直接依赖具体 .pb.h
+ *   7. Redis 异常一律降级为 miss 走 Loader，不影响主流程
+ * ===========================================================================
+ */
+
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dao/data_redis.hpp"
+#include "infra/logger.hpp"
+#include "utils/byte_lru_cache.hpp"
+#include "utils/singleflight.hpp"
+
+namespace chatnow
+{
+
+template <typename Info>
+class UserInfoCache
+{
+public:
+    using ptr     = std::shared_ptr<UserInfoCache<Info>>;
+    using InfoPtr = std::shared_ptr<const Info>;
+    /* brief: 批量回源；返回 false 表示回源失败（RPC 出错），不存在的 uid 不放入 out 即可 */
+    using Loader  = std::function<bool(const std::vector<std::string> &uids,
+                                       std::unordered_map<std::string, Info> &out)>;
+
+    /* brief: l1_capacity_bytes 为 L1 总字节限额（按序列化资料大小累计） */
+    UserInfoCache(const std::shared_ptr<sw::redis::Redis> &c,
+                  size_t l1_capacity_bytes = 64 * 1024 * 1024,
+                  std::chrono::milliseconds l1_ttl = std::chrono::seconds(5),
+                  std::chrono::seconds l2_ttl = kUserInfoTtl,
+                  const std::string &l2_prefix = key::kUserInfo)
+        : _c(c), _l1(l1_capacity_bytes), _l1_ttl(l1_ttl), _l2_ttl(l2_ttl), _l2_prefix(l2_prefix) {}
+
+    /* brief: 单个用户；未找到或回源失败返回 false */
+    bool get(const std::string &uid, Info &out, const Loader &loader) {
+        std::unordered_map<std::string, Info> res;
+        if(!get_many({uid}, res, loader)) return false;
+        auto it = res.find(uid);
+        if(it == res.end()) return false;
+        out = std::move(it->second);
+        return true;
+    }
+
+    /* brief: 批量取资料；返回 false 仅表示回源失败，已命中的部分仍写入 out */
+    bool get_many(const std::vector<std::string> &uids,
+                  std::unordered_map<std::string, Info> &out,
+                  const Loader &loader) {
+        auto now = Clock::now();
+        std::vector<std::string> stale;      // L1 有但需版本校验
+        std::vector<Entry> stale_entries;
+        std::vector<std::string> miss;
+        for(const auto &uid : uids) {
+            if(out.count(uid)) continue;
+            Entry e;
+            if(!_l1.get(uid, e)) { miss.push_back(uid); continue; }
+            if(now - e.checked_at < _l1_ttl) { out[uid] = *e.info; continue; }
+            stale.push_back(uid);
+            stale_entries.push_back(std::move(e));
+        }
+        //1. L1 过期条目：一次 MGET 版本键校验
+        if(!stale.empty()) {
+            auto vers = _versions(stale);
+            for(size_t i = 0; i < stale.size(); ++i) {
+                if(vers.size() == stale.size() && vers[i] == stale_entries[i].ver) {
+                    stale_entries[i].checked_at = now;
+                    out[stale[i]] = *stale_entries[i].info;
+                    _l1_put(stale[i], stale_entries[i]);
+                } else {
+                    miss.push_back(stale[i]);
+                }
+            }
+        }
+        if(miss.empty()) return true;
+        //2. L2：一次 MGET
+        miss = _load_l2(miss, out);
+        if(miss.empty()) return true;
+        //3. 回源：同 uid 并发 miss 合并
+        return _load_source(miss, out, loader);
+    }
+
+    /* brief: 资料变更后失效；其它进程的 L1 在 l1_ttl 内感知 */
+    void invalidate(const std::string &uid) {
+        _l1.erase(uid);
+        try {
+            auto pipe = _c->pipeline();
+            pipe.incr(key::kUserInfoVer + uid);
+            pipe.del(key::kUserInfo + uid);
+            pipe.del(key::kUserBrief + uid);
+            pipe.exec();
+        } catch(std::exception &e) {
+            LOG_ERROR("UserInfoCache.invalidate 失败 {}: {}", uid, e.what());
+        }
+    }
+
+    size_t l1_size() const { return _l1.size(); }
+    size_t l1_bytes() const { return _l1.bytes(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Entry {
+        InfoPtr info;
+        long long ver {0};
+        Clock::time_point checked_at;
+        size_t bytes {0};           // 序列化资料大小
+    };
+    static constexpr size_t kEntryOverhead = 128;   // 键、节点与 Entry 本身的粗略开销
+
+    void _l1_put(const std::string &uid, Entry e) {
+        size_t bytes = e.bytes + uid.size() + kEntryOverhead;
+        _l1.put(uid, std::move(e), bytes);
+    }
+
+    /* brief: MGET 版本键；不存在记 0。失败返回空 vector（调用方按全部失效处理） */
+    std::vector<long long> _versions(const std::vector<std::string> &uids) {
+        std::vector<long long> res;
+        try {
+            std::vector<std::string> keys;
+            keys.reserve(uids.size());
+            for(const auto &uid : uids) keys.push_back(key::kUserInfoVer + uid);
+            std::vector<sw::redis::OptionalString> raw;
+            raw.reserve(uids.size());
+            _c->mget(keys.begin(), keys.end(), std::back_inserter(raw));
+            res.reserve(raw.size());
+            for(auto &v : raw) res.push_back(v ? std::stoll(*v) : 0);
+        } catch(std::exception &e) {
+            LOG_ERROR("UserInfoCache 读版本失败 size={}: {}", uids.size(), e.what());
+            res.clear();
+        }
+        return res;
+    }
+
+    /* brief: 查 L2，命中的写入 out 与 L1；返回仍未命中的 uid */
+    std::vector<std::string> _load_l2(const std::vector<std::string> &uids,
+                                      std::unordered_map<std::string, Info> &out) {
+        std::vector<std::string> remain;
+        std::vector<sw::redis::OptionalString> raw;
+        try {
+            std::vector<std::string> keys;
+            keys.reserve(uids.size());
+            for(const auto &uid : uids) keys.push_back(_l2_prefix + uid);
+            raw.reserve(uids.size());
+            _c->mget(keys.begin(), keys.end(), std::back_inserter(raw));
+        } catch(std::exception &e) {
+            LOG_ERROR("UserInfoCache 读 L2 失败 size={}: {}", uids.size(), e.what());
+            return uids;
+        }
+        auto now = Clock::now();
+        for(size_t i = 0; i < uids.size(); ++i) {
+            Entry e;
+            if(i >= raw.size() || !raw[i] || !_decode(*raw[i], e)) {
+                remain.push_back(uids[i]);
+                continue;
+            }
+            e.checked_at = now;
+            out[uids[i]] = *e.info;
+            _l1_put(uids[i], std::move(e));
+        }
+        return remain;
+    }
+
+    bool _load_source(const std::vector<std::string> &uids,
+                      std::unordered_map<std::string, Info> &out,
+                      const Loader &loader) {
+        std::vector<std::string> led;
+        std::vector<std::pair<std::string, typename Flight::Future>> waits;
+        for(const auto &uid : uids) {
+            auto t = _flight.join(uid);
+            if(t.leader) led.push_back(uid);
+            else waits.emplace_back(uid, t.future);
+        }
+        bool ok = true;
+        if(!led.empty()) {
+            // 回源前先读版本，作为 L2 条件写的基准
+            auto vers = _versions(led);
+            std::unordered_map<std::string, Info> loaded;
+            bool loaded_ok = false;
+            try {
+                loaded_ok = loader(led, loaded);
+            } catch(std::exception &e) {
+                LOG_ERROR("UserInfoCache 回源异常 size={}: {}", led.size(), e.what());
+            }
+            if(!loaded_ok) {
+                ok = false;
+                auto err = std::make_exception_ptr(std::runtime_error("UserInfoCache 回源失败"));
+                for(const auto &uid : led) _flight.fail(uid, err);
+            } else {
+                _store(led, vers, loaded);
+                for(const auto &uid : led) {
+                    auto it = loaded.find(uid);
+                    InfoPtr p = it == loaded.end() ? nullptr : std::make_shared<const Info>(std::move(it->second));
+                    if(p) out[uid] = *p;
+                    _flight.done(uid, p);
+                }
+            }
+        }
+        for(auto &w : waits) {
+            InfoPtr p;
+            try {
+                p = w.second.get();
+            } catch(std::exception &) {
+                ok = false;         // leader 回源失败：不能当作用户不存在
+                continue;
+            }
+            if(p) out[w.first] = *p;
+        }
+        return ok;
+    }
+
+    /* brief: 回源结果写 L1 + L2（L2 条件写，一次 pipeline） */
+    void _store(const std::vector<std::string> &led, const std::vector<long long> &vers,
+                const std::unordered_map<std::string, Info> &loaded) {
+        auto now = Clock::now();
+        bool have_ver = vers.size() == led.size();
+        try {
+            auto pipe = _c->pipeline();
+            const std::string ttl_s = std::to_string(_l2_ttl.count());
+            for(size_t i = 0; i < led.size(); ++i) {
+                auto it = loaded.find(led[i]);
+                if(it == loaded.end()) continue;
+                long long ver = have_ver ? vers[i] : 0;
+                std::string data = it->second.SerializeAsString();
+                size_t bytes = data.size();
+                if(have_ver) {
+                    std::vector<std::string> keys = {key::kUserInfoVer + led[i], _l2_prefix + led[i]};
+                    std::vector<std::string> args = {std::to_string(ver), std::move(data), ttl_s};
+                    pipe.eval(kSetIfVersionLua, keys.begin(), keys.end(), args.begin(), args.end());
+                }
+                // 版本读失败时仍写 L1（ver=0）：下次校验必然不一致 → 重新回源，不会长期读到旧值
+                _l1_put(led[i], Entry{std::make_shared<const Info>(it->second), ver, now, bytes});
+            }
+            if(have_ver) pipe.exec();
+        } catch(std::exception &e) {
+            LOG_ERROR("UserInfoCache 回写 L2 失败 size={}: {}", led.size(), e.what());
+        }
+    }
+
+    /* brief: 存储格式 "<ver>:<序列化资料>" */
+    static bool _decode(const std::string &v, Entry &e) {
+        auto pos = v.find(':');
+        if(pos == std::string::npos) return false;
+        auto info = std::make_shared<Info>();
+        if(!info->ParseFromString(v.substr(pos + 1))) return false;
+        try { e.ver = std::stoll(v.substr(0, pos)); }
+        catch(...) { return false; }
+        e.info = std::move(info);
+        e.bytes = v.size() - pos - 1;
+        return true;
+    }
+
+    // KEYS[1]=im:uinfo:ver:{uid} KEYS[2]=im:uinfo:{uid}  ARGV[1]=期望版本 ARGV[2]=资料 ARGV[3]=ttl_sec
+    static constexpr const char *kSetIfVersionLua =
+        "local v = redis.call('GET', KEYS[1]) or '0' "
+        "if v ~= ARGV[1] then return 0 end "
+        "redis.call('SET', KEYS[2], ARGV[1] .. ':' .. ARGV[2], 'EX', ARGV[3]) "
+        "return 1";
+
+    using Flight = SingleFlight<std::string, InfoPtr>;
+
+    std::shared_ptr<sw::redis::Redis> _c;
+    ByteLruCache<std::string, Entry> _l1;
+    std::chrono::milliseconds _l1_ttl;
+    std::chrono::seconds _l2_ttl;
+    std::string _l2_prefix;
+    Flight _flight;
+};
+
+} // namespace chatnow
@@ -5,18 +5,29 @@
  * brpc 服务信道管理（配合 etcd 服务发现）
  * ---------------------------------------------------------------------------
  * 设计要点：
- *   1. _index 改为 std::atomic 保证 RR 计数无竞争
- *   2. ChannelOptions 增加合理超时（旧版 -1 一直等待，会拖垮调用线程）：
+ *   1. ChannelOptions 带合理超时（旧版 -1 一直等待，会拖垮调用线程）：
  *      - connect_timeout: 1s
  *      - timeout:         3s
- *   3. ServiceManager.choose() 在没有可用节点时返回 nullptr 并打 warn，
+ *   2. ServiceManager.choose() 在没有可用节点时返回 nullptr 并打 warn，
  *      调用方需显式判空
- *   4. 容器使用 unordered_map / unordered_set，保留就近的"添加→使用"读
+ *   3. 读路径无锁：节点集合（含一致性哈希环）与服务表都是不可变快照，
+ *      上下线时在写锁内复制-修改后原子替换；choose 只做一次 atomic_load
+ *   4. 可插拔均衡策略（LbPolicy）：
+ *      - kRoundRobin        轮询（旧行为）
+ *      - kLeastOutstanding  P2C：随机取两个节点，选在途请求少的
+ *      - kEwmaLatency       P2C：比较 ewma 延迟 × (在途 + 1)，慢副本自然少分流量
+ *      choose(key) 按一致性哈希选节点（会话亲和路由），只在归属节点从服务发现下线后才换节点：
+ *      归属节点持有 key 级状态（如会话 seq 持有租约），离群摘除只说明它慢，换到非归属节点
+ *      反而在租约到期前全部失败；owner(key) 给出同一归属 host，供被调方判断 key 是否归自己
+ *   5. 离群摘除：节点 Channel 为 ObservedChannel，每次调用按 cntl.Failed() 与延迟记账；
+ *      连续失败 / 慢调用达阈值的节点在摘除期内不参与选择；
+ *      健康节点不足一半时忽略摘除（避免级联摘光）
  * ===========================================================================
  */
 
 #include <atomic>
 #include <brpc/channel.h>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -24,6 +35,8 @@
 #include <unordered_set>
 #include <vector>
 #include "infra/logger.hpp"
+#include "mq/observed_channel.hpp"
+#include "utils/hash_ring.hpp"
 
 namespace chatnow
 {
@@ -32,6 +45,13 @@ inline constexpr int32_t kConnectTimeoutMs = 1000;   // 连接超时 1s
 inline constexpr int32_t kRpcTimeoutMs     = 3000;   // 单次 RPC 超时 3s
 inline constexpr int32_t kRpcMaxRetry      = 3;
 
+enum class LbPolicy
+{
+    kRoundRobin,
+    kLeastOutstanding,
+    kEwmaLatency,
+};
+
 /* brief: 单服务多实例信道集合（同一服务名下的多个节点） */
 class ServiceChannel
 {
@@ -39,11 +59,19 @@ public:
     using ptr = std::shared_ptr<ServiceChannel>;
     using ChannelPtr = std::shared_ptr<brpc::Channel>;
 
-    explicit ServiceChannel(const std::string &name) : _service_name(name), _index(0) {}
+    struct Node {
+        std::string host;
+        ChannelPtr channel;
+        NodeStats::ptr stats;
+    };
+    using NodePtr = std::shared_ptr<const Node>;
+
+    explicit ServiceChannel(const std::string &name, LbPolicy policy = LbPolicy::kLeastOutstanding)
+        : _service_name(name), _policy(policy), _index(0), _snap(std::make_shared<const Snapshot>()) {}
 
     /* brief: 节点上线，新增 brpc::Channel */
     void append(const std::string &host) {
-        auto channel = std::make_shared<brpc::Channel>();
+        auto channel = std::make_shared<ObservedChannel>(static_cast<int64_t>(kRpcTimeoutMs) * 1000);
         brpc::ChannelOptions options;
         options.connect_timeout_ms = kConnectTimeoutMs;
         options.timeout_ms         = kRpcTimeoutMs;
@@ -53,51 +81,139 @@ public:
             LOG_ERROR("初始化 {}-{} 信道失败", _service_name, host);
             return;
         }
-        std::unique_lock<std::mutex> lock(_mutex);
-        _hosts[host] = channel;
-        _channels.push_back(channel);
+        auto node = std::make_shared<const Node>(Node{host, channel, channel->stats()});
+        std::unique_lock<std::mutex> lock(_write_mutex);
+        auto next = std::make_shared<Snapshot>(*_load());
+        auto it = next->index.find(host);
+        if(it != next->index.end()) {
+            next->nodes[it->second] = node;         // 重复上线：替换旧信道
+        } else {
+            next->index[host] = next->nodes.size();
+            next->nodes.push_back(node);
+            next->ring.add(host);
+        }
+        std::atomic_store(&_snap, std::shared_ptr<const Snapshot>(std::move(next)));
     }
 
-    /* brief: 节点下线，释放 Channel */
+    /* brief: 节点下线，释放 Channel（在途调用持有 shared_ptr，不受影响） */
     void remove(const std::string &host) {
-        std::unique_lock<std::mutex> lock(_mutex);
-        auto it = _hosts.find(host);
-        if(it == _hosts.end()) {
+        std::unique_lock<std::mutex> lock(_write_mutex);
+        auto cur = _load();
+        if(cur->index.find(host) == cur->index.end()) {
             LOG_WARN("{}-{} 节点删除信道时未找到信道信息", _service_name, host);
             return;
         }
-        for(auto vit = _channels.begin(); vit != _channels.end(); ++vit) {
-            if(*vit == it->second) {
-                _channels.erase(vit);
-                break;
-            }
+        auto next = std::make_shared<Snapshot>();
+        for(const auto &n : cur->nodes) {
+            if(n->host == host) continue;
+            next->index[n->host] = next->nodes.size();
+            next->nodes.push_back(n);
         }
-        _hosts.erase(it);
+        next->ring = cur->ring;
+        next->ring.remove(host);
+        std::atomic_store(&_snap, std::shared_ptr<const Snapshot>(std::move(next)));
     }
 
-    /* brief: RR 选择一个 channel；空集合返回 nullptr */
+    /* brief: 按策略选择一个 channel；空集合返回 nullptr */
     ChannelPtr choose() {
-        std::unique_lock<std::mutex> lock(_mutex);
-        if(_channels.empty()) {
+        auto snap = _load();
+        auto node = _pick(*snap);
+        if(!node) {
             LOG_ERROR("当前没有能提供 {} 服务的节点", _service_name);
             return ChannelPtr();
         }
-        auto idx = _index.fetch_add(1, std::memory_order_relaxed) % _channels.size();
-        return _channels[idx];
+        return node->channel;
+    }
+
+    /* brief: 按 key 一致性哈希选择 channel；同一 key 在节点集合不变时恒定落到同一节点
+     *  不受离群摘除影响：环上只有服务发现在线的节点，归属节点下线后环上自然换到下一个节点
+     */
+    ChannelPtr choose(const std::string &key) {
+        auto snap = _load();
+        const std::string &host = snap->ring.locate(key);
+        if(host.empty()) {
+            LOG_ERROR("当前没有能提供 {} 服务的节点", _service_name);
+            return ChannelPtr();
+        }
+        return snap->nodes[snap->index.at(host)]->channel;
+    }
+
+    /* brief: key 当前归属的节点 host；空集合返回空串 */
+    std::string owner(const std::string &key) const {
+        return _load()->ring.locate(key);
     }
 
     /* brief: 当前节点数 — 健康检查/监控用 */
     size_t size() const {
-        std::unique_lock<std::mutex> lock(_mutex);
-        return _channels.size();
+        return _load()->nodes.size();
+    }
+
+    /* brief: 当前节点快照（监控 / 测试用） */
+    std::vector<NodePtr> nodes() const {
+        return _load()->nodes;
     }
 
+    void set_policy(LbPolicy policy) { _policy.store(policy, std::memory_order_relaxed); }
+
 private:
-    mutable std::mutex _mutex;
-    std::atomic<uint32_t> _index;
+    struct Snapshot {
+        std::vector<NodePtr> nodes;
+        std::unordered_map<std::string, size_t> index;      // host -> nodes 下标
+        HashRing ring;
+    };
+
+    std::shared_ptr<const Snapshot> _load() const { return std::atomic_load(&_snap); }
+
+    NodePtr _pick(const Snapshot &snap) {
+        const auto &all = snap.nodes;
+        if(all.empty()) return nullptr;
+        if(all.size() == 1) return all[0];
+
+        // 摘除过滤：健康节点不足一半时忽略摘除
+        std::vector<const NodePtr *> healthy;
+        healthy.reserve(all.size());
+        for(const auto &n : all) {
+            if(!n->stats->ejected()) healthy.push_back(&n);
+        }
+        if(healthy.size() * 2 < all.size()) {
+            healthy.clear();
+            for(const auto &n : all) healthy.push_back(&n);
+        }
+        size_t n = healthy.size();
+        uint32_t seq = _index.fetch_add(1, std::memory_order_relaxed);
+        LbPolicy policy = _policy.load(std::memory_order_relaxed);
+        if(policy == LbPolicy::kRoundRobin || n == 1) return *healthy[seq % n];
+
+        // P2C：两个不同的随机下标
+        uint64_t r = _rand();
+        size_t a = r % n;
+        size_t b = (a + 1 + (r >> 32) % (n - 1)) % n;
+        const auto &na = *healthy[a];
+        const auto &nb = *healthy[b];
+        return _score(*na->stats, policy) <= _score(*nb->stats, policy) ? na : nb;
+    }
+
+    static double _score(const NodeStats &s, LbPolicy policy) {
+        double inflight = static_cast<double>(s.inflight.load(std::memory_order_relaxed));
+        if(policy == LbPolicy::kLeastOutstanding) return inflight;
+        // 新节点 ewma 为 0：给一个与在途数相关的小分值，既能拿到流量又不会被瞬间压垮
+        double ewma = static_cast<double>(s.ewma_us.load(std::memory_order_relaxed));
+        return (ewma + 1.0) * (inflight + 1.0);
+    }
+
+    static uint64_t _rand() {
+        thread_local uint64_t x = 0x9E3779B97F4A7C15ull ^ reinterpret_cast<uintptr_t>(&x);
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    }
+
     std::string _service_name;
-    std::vector<ChannelPtr> _channels;
-    std::unordered_map<std::string, ChannelPtr> _hosts;
+    std::atomic<LbPolicy> _policy;
+    std::atomic<uint32_t> _index;
+    std::mutex _write_mutex;                                // 仅串行化 append / remove
+    std::shared_ptr<const Snapshot> _snap;                  // 经 std::atomic_load / atomic_store 访问
 };
 
 /* brief: 多服务的 Channel 总管 — 配合 etcd Discovery 维护 */
@@ -105,17 +221,35 @@ class ServiceManager
 {
 public:
     using ptr = std::shared_ptr<ServiceManager>;
-    ServiceManager() = default;
+    using ServiceMap = std::unordered_map<std::string, ServiceChannel::ptr>;
+
+    explicit ServiceManager(LbPolicy default_policy = LbPolicy::kLeastOutstanding)
+        : _default_policy(default_policy), _services(std::make_shared<const ServiceMap>()) {}
 
     /* brief: 选中目标服务的某个节点 channel */
     ServiceChannel::ChannelPtr choose(const std::string &service_name) {
-        std::unique_lock<std::mutex> lock(_mutex);
-        auto it = _services.find(service_name);
-        if(it == _services.end()) {
+        auto service = _find(service_name);
+        if(!service) {
             LOG_ERROR("当前没有能提供 {} 服务的节点", service_name);
             return ServiceChannel::ChannelPtr();
         }
-        return it->second->choose();
+        return service->choose();
+    }
+
+    /* brief: 按 key 一致性哈希选中目标服务的节点 channel（会话亲和） */
+    ServiceChannel::ChannelPtr choose(const std::string &service_name, const std::string &key) {
+        auto service = _find(service_name);
+        if(!service) {
+            LOG_ERROR("当前没有能提供 {} 服务的节点", service_name);
+            return ServiceChannel::ChannelPtr();
+        }
+        return service->choose(key);
+    }
+
+    /* brief: key 在目标服务中的归属节点 host；服务未知返回空串 */
+    std::string owner(const std::string &service_name, const std::string &key) {
+        auto service = _find(service_name);
+        return service ? service->owner(key) : std::string();
     }
 
     /* brief: 声明关注哪些服务（不关注的服务上下线事件会被忽略，节省内存） */
@@ -124,6 +258,19 @@ public:
         _follow_services.insert(service_name);
     }
 
+    /* brief: 为指定服务设置均衡策略（未设置的沿用默认策略；可在运行期调整） */
+    void set_policy(const std::string &service_name, LbPolicy policy) {
+        ServiceChannel::ptr service;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _policies[service_name] = policy;
+            auto services = std::atomic_load(&_services);
+            auto it = services->find(service_name);
+            if(it != services->end()) service = it->second;
+        }
+        if(service) service->set_policy(policy);
+    }
+
     /* brief: etcd PUT 事件回调 */
     void onServiceOnline(const std::string &service_instance, const std::string &host) {
         std::string service_name = getServiceName(service_instance);
@@ -134,10 +281,15 @@ public:
                 LOG_DEBUG("{}-{} 服务上线，但当前不关心", service_name, host);
                 return;
             }
-            auto it = _services.find(service_name);
-            if(it == _services.end()) {
-                service = std::make_shared<ServiceChannel>(service_name);
-                _services[service_name] = service;
+            auto services = std::atomic_load(&_services);
+            auto it = services->find(service_name);
+            if(it == services->end()) {
+                auto pit = _policies.find(service_name);
+                service = std::make_shared<ServiceChannel>(
+                    service_name, pit == _policies.end() ? _default_policy : pit->second);
+                auto next = std::make_shared<ServiceMap>(*services);
+                (*next)[service_name] = service;
+                std::atomic_store(&_services, std::shared_ptr<const ServiceMap>(std::move(next)));
             } else {
                 service = it->second;
             }
@@ -149,21 +301,22 @@ public:
     /* brief: etcd DELETE 事件回调 */
     void onServiceOffline(const std::string &service_instance, const std::string &host) {
         std::string service_name = getServiceName(service_instance);
-        ServiceChannel::ptr service;
-        {
-            std::unique_lock<std::mutex> lock(_mutex);
-            auto it = _services.find(service_name);
-            if(it == _services.end()) {
-                LOG_WARN("删除 {} 服务节点时未找到管理对象", service_name);
-                return;
-            }
-            service = it->second;
+        auto service = _find(service_name);
+        if(!service) {
+            LOG_WARN("删除 {} 服务节点时未找到管理对象", service_name);
+            return;
         }
         LOG_DEBUG("{}-{} 服务下线节点", service_name, host);
         service->remove(host);
     }
 
 private:
+    ServiceChannel::ptr _find(const std::string &service_name) const {
+        auto services = std::atomic_load(&_services);
+        auto it = services->find(service_name);
+        return it == services->end() ? nullptr : it->second;
+    }
+
     /* brief: 从注册路径 /service/xxx/instance/<id> 中抽出服务名 /service/xxx/instance */
     std::string getServiceName(const std::string &service_instance) {
         auto pos = service_instance.find_last_of('/');
@@ -171,9 +324,11 @@ private:
         return service_instance.substr(0, pos);
     }
 
-    std::mutex _mutex;
+    std::mutex _mutex;                                      // 串行化写：关注表 / 策略表 / 服务表替换
+    LbPolicy _default_policy;
     std::unordered_set<std::string> _follow_services;
-    std::unordered_map<std::string, ServiceChannel::ptr> _services;
+    std::unordered_map<std::string, LbPolicy> _policies;
+    std::shared_ptr<const ServiceMap> _services;            // 经 std::atomic_load / atomic_store 访问
 };
 
 } // namespace chatnow
@@ -0,0 +1,139 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * ObservedChannel —— 带调用反馈的 brpc::Channel（负载均衡 / 离群摘除的数据源）
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. 继承 brpc::Channel 并覆写 CallMethod：调用方拿到的仍是 shared_ptr<brpc::Channel>，
+ *      各服务 Stub 调用点零改动
+ *   2. 同步调用（done == nullptr）在 CallMethod 返回时已完成，直接记账；
+ *      异步调用把 done 包一层，回调时先记账再执行原 done
+ *   3. NodeStats 全部为原子量，记账无锁：
+ *        - inflight           在途请求数（least-outstanding）
+ *        - ewma_us            延迟 EWMA（失败按超时计），新节点从 0 起步
+ *        - consecutive_bad    连续失败 / 慢调用次数，达阈值摘除；慢调用按该次调用自身的
+ *                             超时（cntl->timeout_ms()）判定：耗时超过超时的 kSlowCallRatio 才算，
+ *                             批量刷写 / 拉历史等本就给了长超时的调用不会被误判
+ *        - ejected_until_ms   摘除截止时间；每次再摘除时长翻倍，上限 kMaxEjectMs
+ * ===========================================================================
+ */
+
+#include <brpc/channel.h>
+#include <brpc/controller.h>
+#include <google/protobuf/stubs/callback.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace chatnow
+{
+
+struct NodeStats
+{
+    using ptr = std::shared_ptr<NodeStats>;
+
+    static constexpr double  kEwmaAlpha        = 0.2;
+    static constexpr double  kSlowCallRatio    = 0.5;           // 耗时超过本次超时的一半视为慢调用
+    static constexpr int32_t kEjectThreshold   = 5;             // 连续 5 次失败 / 慢调用摘除
+    static constexpr int64_t kBaseEjectMs      = 1000;
+    static constexpr int64_t kMaxEjectMs       = 30 * 1000;
+
+    std::atomic<int32_t> inflight {0};
+    std::atomic<int64_t> ewma_us {0};
+    std::atomic<int32_t> consecutive_bad {0};
+    std::atomic<int32_t> eject_count {0};
+    std::atomic<int64_t> ejected_until_ms {0};
+
+    void on_start() { inflight.fetch_add(1, std::memory_order_relaxed); }
+
+    /* brief: timeout_us 为本次调用的超时（失败样本按其计入 ewma，并据此判定慢调用） */
+    void on_done(int64_t latency_us, bool failed, int64_t timeout_us) {
+        inflight.fetch_sub(1, std::memory_order_relaxed);
+        int64_t sample = failed ? std::max(latency_us, timeout_us) : latency_us;
+        int64_t old = ewma_us.load(std::memory_order_relaxed);
+        // 并发更新丢失个别样本可接受，不做 CAS 循环
+        ewma_us.store(old == 0 ? sample : static_cast<int64_t>(old + kEwmaAlpha * (sample - old)),
+                      std::memory_order_relaxed);
+
+        if(!failed && latency_us < static_cast<int64_t>(timeout_us * kSlowCallRatio)) {
+            consecutive_bad.store(0, std::memory_order_relaxed);
+            if(!ejected()) eject_count.store(0, std::memory_order_relaxed);
+            return;
+        }
+        if(consecutive_bad.fetch_add(1, std::memory_order_relaxed) + 1 >= kEjectThreshold) {
+            consecutive_bad.store(0, std::memory_order_relaxed);
+            int32_t n = std::min(eject_count.fetch_add(1, std::memory_order_relaxed), 5);
+            int64_t dur = std::min(kBaseEjectMs << n, kMaxEjectMs);
+            ejected_until_ms.store(now_ms() + dur, std::memory_order_relaxed);
+        }
+    }
+
+    bool ejected() const { return now_ms() < ejected_until_ms.load(std::memory_order_relaxed); }
+
+    static int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+class ObservedChannel : public brpc::Channel
+{
+public:
+    /* brief: default_timeout_us 仅在调用未设超时（timeout_ms <= 0，不限时）时作为记账基准 */
+    explicit ObservedChannel(int64_t default_timeout_us)
+        : _stats(std::make_shared<NodeStats>()), _timeout_us(default_timeout_us) {}
+
+    void CallMethod(const google::protobuf::MethodDescriptor *method,
+                    google::protobuf::RpcController *controller,
+                    const google::protobuf::Message *request,
+                    google::protobuf::Message *response,
+                    google::protobuf::Closure *done) override
+    {
+        auto *cntl = static_cast<brpc::Controller *>(controller);
+        _stats->on_start();
+        if(done == nullptr) {
+            brpc::Channel::CallMethod(method, controller, request, response, nullptr);
+            _stats->on_done(cntl->latency_us(), cntl->Failed(), call_timeout_us(cntl, _timeout_us));
+            return;
+        }
+        brpc::Channel::CallMethod(method, controller, request, response,
+                                  new FeedbackDone(_stats, cntl, done, _timeout_us));
+    }
+
+    const NodeStats::ptr &stats() const { return _stats; }
+
+    /* brief: 本次调用的实际超时（CallMethod 之后 cntl 已合入 ChannelOptions 的默认值） */
+    static int64_t call_timeout_us(const brpc::Controller *cntl, int64_t fallback_us) {
+        int64_t ms = cntl->timeout_ms();
+        return ms > 0 ? ms * 1000 : fallback_us;
+    }
+
+private:
+    class FeedbackDone : public google::protobuf::Closure
+    {
+    public:
+        FeedbackDone(NodeStats::ptr stats, brpc::Controller *cntl,
+                     google::protobuf::Closure *done, int64_t timeout_us)
+            : _stats(std::move(stats)), _cntl(cntl), _done(done), _timeout_us(timeout_us) {}
+        void Run() override {
+            _stats->on_done(_cntl->latency_us(), _cntl->Failed(), call_timeout_us(_cntl, _timeout_us));
+            google::protobuf::Closure *done = _done;
+            delete this;
+            done->Run();
+        }
+    private:
+        NodeStats::ptr _stats;
+        brpc::Controller *_cntl;
+        google::protobuf::Closure *_done;
+        int64_t _timeout_us;
+    };
+
+    NodeStats::ptr _stats;
+    int64_t _timeout_us;
+};
+
+} // namespace chatnow
@@ -13,6 +13,11 @@
  *   4. 新增 qos(prefetch) 限制：默认 prefetch=64，避免慢消费者内存堆积
  *   5. publish_confirm 状态枚举显式注释 Lost vs Nack 的区别
  *   6. 析构关闭 connection 后再销毁 ev_loop，避免事件残留
+ *   7. consume_sharded：回调不在 ev 线程内联执行，而是按 payload 中的分片键
+ *      （如 chat_session_id）投递到 ShardedExecutor —— 同键串行保序、异键多核并行；
+ *      ack / reject 由 worker 通过 post_task 回投 ev 线程执行（AMQP channel 非线程安全）
+ *   8. consume_deferred：回调拿到 SettleCallback 后可异步 ack（如攒批落库后统一 ack），
+ *      settle 可在任意线程调用，只生效一次；配合 shutdown hook 在连接关闭前排空
  * ===========================================================================
  */
 
@@ -21,6 +26,7 @@
 #include <amqpcpp/libev.h>
 #include <openssl/ssl.h>
 #include <openssl/opensslv.h>
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <future>
@@ -29,6 +35,8 @@
 #include <queue>
 #include <thread>
 #include "infra/logger.hpp"
+#include "utils/pb_wire.hpp"
+#include "utils/sharded_executor.hpp"
 
 namespace chatnow
 {
@@ -85,6 +93,25 @@ using MessageCallbackWithHeaders =
     std::function<ConsumeAction(const char*, size_t, bool,
                                 const std::map<std::string, std::string>&)>;
 using PublishConfirmCallback  = std::function<void(PublishStatus, const std::string&)>;
+/* brief: 异步确认句柄；任意线程可调，重复调用只有第一次生效 */
+using SettleCallback          = std::function<void(ConsumeAction)>;
+/* brief: 延迟确认回调；body 仅在回调期间有效，需异步处理时自行拷贝 */
+using DeferredMessageCallback =
+    std::function<void(const char*, size_t, bool,
+                       const std::map<std::string, std::string>&, SettleCallback)>;
+/* brief: 从消息体中提取分片键；返回空串时统一落到 shard 0（仍然保序，只是不并行） */
+using ShardKeyExtractor       = std::function<std::string(const char*, size_t)>;
+
+/* brief: 按 protobuf 字段路径取分片键，例如 InternalMessage.message_info(1).chat_session_id(2) → {1, 2}
+ *  只扫 wire-format tag，不做完整反序列化；payload 非法时返回空串
+ */
+inline ShardKeyExtractor pb_field_shard_key(std::vector<uint32_t> path) {
+    return [path = std::move(path)](const char *body, size_t sz) -> std::string {
+        std::string_view key;
+        if(!pb_wire::find_bytes_path(std::string_view(body, sz), path, key)) return std::string();
+        return std::string(key);
+    };
+}
 
 class MQClient
 {
@@ -109,6 +136,14 @@ public:
     }
 
     ~MQClient() {
+        // 先跑 shutdown hook（停并行消费 worker / 排空攒批队列）：此时 ev 线程仍在，
+        // hook 内产生的 ack/reject 能正常 post 出去；被丢弃的投递连接关闭后由 broker 重投
+        std::vector<std::function<void()>> hooks;
+        {
+            std::lock_guard<std::mutex> lk(_hook_mtx);
+            hooks.swap(_shutdown_hooks);
+        }
+        for(auto &hook : hooks) hook();
         // 优雅关闭：把 close + quit 串成同一个 task，避免 quit watcher 抢在 close 之前
         // 跑完 ev_break，导致 channel 没有干净关掉（broker 看到 abrupt disconnect）。
         post_task([this](){
@@ -213,12 +248,7 @@ public:
                                             uint64_t deliveryTag,
                                             bool redelivered) {
                     try {
-                        ConsumeAction action = callback(message.body(), message.bodySize(), redelivered);
-                        switch(action) {
-                        case ConsumeAction::Ack:         _channel.ack(deliveryTag); break;
-                        case ConsumeAction::NackRequeue: _channel.reject(deliveryTag, true);  break;
-                        case ConsumeAction::NackDiscard: _channel.reject(deliveryTag, false); break;
-                        }
+                        _settle(deliveryTag, callback(message.body(), message.bodySize(), redelivered));
                     } catch(const std::exception &e) {
                         LOG_ERROR("消费回调异常: {}", e.what());
                         _channel.reject(deliveryTag, true);
@@ -252,22 +282,10 @@ public:
                 .onMessage([this, callback](const AMQP::Message &message,
                                             uint64_t deliveryTag,
                                             bool redelivered) {
-                    std::map<std::string, std::string> headers;
-                    const auto &table = message.headers();
-                    for (const auto &kv : table) {
-                        // AMQP::Field 仅在为字符串类型时取出；其他类型转为字符串表示
-                        if (kv.second.isString()) {
-                            headers[kv.first] = std::string(kv.second);
-                        }
-                    }
+                    std::map<std::string, std::string> headers = _string_headers(message);
                     try {
-                        ConsumeAction action = callback(message.body(), message.bodySize(),
-                                                        redelivered, headers);
-                        switch(action) {
-                        case ConsumeAction::Ack:         _channel.ack(deliveryTag); break;
-                        case ConsumeAction::NackRequeue: _channel.reject(deliveryTag, true);  break;
-                        case ConsumeAction::NackDiscard: _channel.reject(deliveryTag, false); break;
-                        }
+                        _settle(deliveryTag, callback(message.body(), message.bodySize(),
+                                                      redelivered, headers));
                     } catch(const std::exception &e) {
                         LOG_ERROR("消费回调异常: {}", e.what());
                         _channel.reject(deliveryTag, true);
@@ -288,6 +306,116 @@ public:
         return future.get();
     }
 
+    /* brief: 并行订阅（带 headers）；回调在 executor 的 worker 线程执行
+     *  - ev 线程只做：拷贝 body/headers → 提取分片键 → 投递到对应 shard
+     *  - 同一分片键的消息落在同一 worker，按 broker 投递顺序串行执行
+     *  - worker 执行完回调后，ack / reject 经 post_task 回到 ev 线程
+     *  - prefetch 需 ≥ worker 数，否则并行度被 broker 侧未 ack 上限卡住
+     */
+    bool consume_sharded(const std::string &queue,
+                         const MessageCallbackWithHeaders &callback,
+                         const ShardKeyExtractor &key_fn,
+                         const ShardedExecutor::ptr &executor,
+                         uint16_t prefetch = kDefaultPrefetch)
+    {
+        if(!executor) {
+            LOG_ERROR("并行订阅 {} 失败：executor 未初始化", queue);
+            return false;
+        }
+        add_shutdown_hook([executor]() { executor->stop(); });
+        std::promise<bool> promise;
+        auto future = promise.get_future();
+
+        post_task([this, queue, callback, key_fn, executor, prefetch, &promise]() {
+            _channel.setQos(prefetch);
+            _channel.consume(queue)
+                .onMessage([this, callback, key_fn, executor](const AMQP::Message &message,
+                                                               uint64_t deliveryTag,
+                                                               bool redelivered) {
+                    std::string key = key_fn ? key_fn(message.body(), message.bodySize())
+                                             : std::string();
+                    auto body = std::make_shared<std::string>(message.body(), message.bodySize());
+                    auto headers = std::make_shared<std::map<std::string, std::string>>(
+                        _string_headers(message));
+                    bool accepted = executor->submit(key,
+                        [this, callback, body, headers, deliveryTag, redelivered]() {
+                            ConsumeAction action = ConsumeAction::NackRequeue;
+                            try {
+                                action = callback(body->data(), body->size(), redelivered, *headers);
+                            } catch(const std::exception &e) {
+                                LOG_ERROR("消费回调异常: {}", e.what());
+                            } catch(...) {
+                                LOG_ERROR("消费回调发生未知异常");
+                            }
+                            post_task([this, deliveryTag, action]() { _settle(deliveryTag, action); });
+                        });
+                    // executor 已停止（进程关停中）：退回 broker 让其它实例消费
+                    if(!accepted) _channel.reject(deliveryTag, true);
+                })
+                .onError([&promise, queue](const char *message) {
+                    LOG_ERROR("订阅消息失败: {} - {}", queue, message ? message : "");
+                    promise.set_value(false);
+                })
+                .onSuccess([&promise, queue, executor]() {
+                    LOG_DEBUG("成功并行订阅队列: {} workers={}", queue, executor->shards());
+                    promise.set_value(true);
+                });
+        });
+        return future.get();
+    }
+
+    /* brief: 延迟确认订阅（带 headers）；回调在 ev 线程执行，ack 时机由调用方通过 settle 决定
+     *  - 典型用法：回调只拷贝 body 入攒批队列，批量事务提交后逐条 settle(Ack)
+     *  - 回调抛异常且尚未 settle → NackRequeue
+     *  - 未 settle 的投递占用 prefetch 额度，prefetch 需 ≥ 期望的批大小
+     */
+    bool consume_deferred(const std::string &queue,
+                          const DeferredMessageCallback &callback,
+                          uint16_t prefetch = kDefaultPrefetch)
+    {
+        std::promise<bool> promise;
+        auto future = promise.get_future();
+
+        post_task([this, queue, callback, prefetch, &promise]() {
+            _channel.setQos(prefetch);
+            _channel.consume(queue)
+                .onMessage([this, callback](const AMQP::Message &message,
+                                            uint64_t deliveryTag,
+                                            bool redelivered) {
+                    auto settled = std::make_shared<std::atomic<bool>>(false);
+                    SettleCallback settle = [this, deliveryTag, settled](ConsumeAction action) {
+                        if(settled->exchange(true)) return;
+                        post_task([this, deliveryTag, action]() { _settle(deliveryTag, action); });
+                    };
+                    std::map<std::string, std::string> headers = _string_headers(message);
+                    try {
+                        callback(message.body(), message.bodySize(), redelivered, headers, settle);
+                    } catch(const std::exception &e) {
+                        LOG_ERROR("消费回调异常: {}", e.what());
+                        if(!settled->exchange(true)) _channel.reject(deliveryTag, true);
+                    } catch(...) {
+                        LOG_ERROR("消费回调发生未知异常");
+                        if(!settled->exchange(true)) _channel.reject(deliveryTag, true);
+                    }
+                })
+                .onError([&promise, queue](const char *message) {
+                    LOG_ERROR("订阅消息失败: {} - {}", queue, message ? message : "");
+                    promise.set_value(false);
+                })
+                .onSuccess([&promise, queue]() {
+                    LOG_DEBUG("成功延迟确认订阅队列: {}", queue);
+                    promise.set_value(true);
+                });
+        });
+        return future.get();
+    }
+
+    /* brief: 注册关闭钩子；析构时在关闭 channel 之前按注册顺序执行（ev 线程仍可 post） */
+    void add_shutdown_hook(std::function<void()> hook) {
+        std::lock_guard<std::mutex> lk(_hook_mtx);
+        _shutdown_hooks.push_back(std::move(hook));
+    }
+
     void wait() { _async_thread.join(); }
 
 private:
@@ -308,6 +436,26 @@ private:
         }
     }
 
+    /* brief: 按回调结果 ack / reject；必须在 ev 线程调用 */
+    void _settle(uint64_t deliveryTag, ConsumeAction action) {
+        switch(action) {
+        case ConsumeAction::Ack:         _channel.ack(deliveryTag); break;
+        case ConsumeAction::NackRequeue: _channel.reject(deliveryTag, true);  break;
+        case ConsumeAction::NackDiscard: _channel.reject(deliveryTag, false); break;
+        }
+    }
+
+    /* brief: AMQP::Field 仅在为字符串类型时取出；其他类型忽略 */
+    static std::map<std::string, std::string> _string_headers(const AMQP::Message &message) {
+        std::map<std::string, std::string> headers;
+        for (const auto &kv : message.headers()) {
+            if (kv.second.isString()) {
+                headers[kv.first] = std::string(kv.second);
+            }
+        }
+        return headers;
+    }
+
     void post_task(std::function<void()> task) {
         {
             std::lock_guard<std::mutex> lk(_task_mtx);
@@ -380,6 +528,8 @@ private:
     AMQP::TcpConnection _connection;
     AMQP::TcpChannel _channel;
     std::unique_ptr<AMQP::Reliable<>> _reliable;
+    std::mutex _hook_mtx;
+    std::vector<std::function<void()>> _shutdown_hooks;   // 析构时先于 channel 关闭执行
     std::thread _async_thread;
 };
 
@@ -429,11 +579,35 @@ public:
             ? _settings.dlx_queue() : _settings.queue;
         _mq->consume(q, _callback_h, prefetch);
     }
+    /* brief: 并行订阅：key_fn 从 payload 取分片键，workers 个 worker 并行消费，同键保序
+     *  - workers == 0 退化为 ev 线程内联消费（旧行为）
+     */
+    void consume_sharded(MessageCallbackWithHeaders &&cb, ShardKeyExtractor key_fn,
+                         size_t workers, uint16_t prefetch = kDefaultPrefetch) {
+        if(workers == 0) {
+            consume(std::move(cb), prefetch);
+            return;
+        }
+        _callback_h = std::move(cb);
+        const std::string &q = (_settings.exchange_type == DELAYED)
+            ? _settings.dlx_queue() : _settings.queue;
+        _executor = std::make_shared<ShardedExecutor>(workers, q);
+        _mq->consume_sharded(q, _callback_h, key_fn, _executor, prefetch);
+    }
+    /* brief: 延迟确认订阅：由回调持有 settle 决定何时 ack（攒批落库等场景） */
+    void consume_deferred(DeferredMessageCallback &&cb, uint16_t prefetch = kDefaultPrefetch) {
+        _callback_d = std::move(cb);
+        const std::string &q = (_settings.exchange_type == DELAYED)
+            ? _settings.dlx_queue() : _settings.queue;
+        _mq->consume_deferred(q, _callback_d, prefetch);
+    }
 private:
     MQClient::ptr _mq;
     declare_settings _settings;
     MessageCallback _callback;
     MessageCallbackWithHeaders _callback_h;
+    DeferredMessageCallback _callback_d;
+    ShardedExecutor::ptr _executor;
 };
 
 class MQFactory
@@ -0,0 +1,147 @@
+// 连接表争用微基准：单把全局 mutex（旧 push Connection）对比分段读写锁 ConnRegistry。
+// 负载模拟 push 实例：推送线程按 uid 查连接 + 取发送锁，心跳线程 touch，建连/断连线程 churn。
+// 用法：conn_registry_bench [连接数=200000] [推送线程=8] [秒=3]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "utils/conn_registry.hpp"
+
+using Conn = std::shared_ptr<int>;
+using Clock = std::chrono::steady_clock;
+
+// 旧实现：uid / conn 两张表共用一把 std::mutex；推送先 connections(uid) 再逐个 send_mutex(conn)
+class GlobalLockRegistry
+{
+public:
+    struct Client {
+        std::string uid;
+        long last_active_ts {0};
+        std::shared_ptr<std::mutex> send_mu {std::make_shared<std::mutex>()};
+    };
+    void insert(const Conn &c, const std::string &uid) {
+        std::lock_guard<std::mutex> lk(_mu);
+        _uid[uid].insert(c);
+        _conn[c] = Client{uid, 0};
+    }
+    std::vector<Conn> connections(const std::string &uid) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _uid.find(uid);
+        if(it == _uid.end()) return {};
+        return std::vector<Conn>(it->second.begin(), it->second.end());
+    }
+    std::shared_ptr<std::mutex> send_mutex(const Conn &c) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _conn.find(c);
+        return it == _conn.end() ? nullptr : it->second.send_mu;
+    }
+    void touch(const Conn &c) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _conn.find(c);
+        if(it != _conn.end()) it->second.last_active_ts++;
+    }
+    void remove(const Conn &c) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _conn.find(c);
+        if(it == _conn.end()) return;
+        auto uc = _uid.find(it->second.uid);
+        if(uc != _uid.end()) {
+            uc->second.erase(c);
+            if(uc->second.empty()) _uid.erase(uc);
+        }
+        _conn.erase(it);
+    }
+private:
+    std::mutex _mu;
+    std::unordered_map<std::string, std::unordered_set<Conn>> _uid;
+    std::unordered_map<Conn, Client> _conn;
+};
+
+struct Result { double push_mops; double touch_mops; };
+
+template <typename PushFn, typename TouchFn, typename ChurnFn>
+Result run(size_t push_threads, int seconds, PushFn push, TouchFn touch, ChurnFn churn) {
+    std::atomic<bool> stop {false};
+    std::atomic<size_t> pushes {0}, touches {0};
+    std::vector<std::thread> ths;
+    for(size_t t = 0; t < push_threads; ++t) {
+        ths.emplace_back([&, t] {
+            std::mt19937 rng(static_cast<unsigned>(t));
+            size_t n = 0;
+            while(!stop.load(std::memory_order_relaxed)) { push(rng); ++n; }
+            pushes += n;
+        });
+    }
+    ths.emplace_back([&] {
+        std::mt19937 rng(991);
+        size_t n = 0;
+        while(!stop.load(std::memory_order_relaxed)) { touch(rng); ++n; }
+        touches += n;
+    });
+    ths.emplace_back([&] {
+        std::mt19937 rng(997);
+        while(!stop.load(std::memory_order_relaxed)) churn(rng);
+    });
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop.store(true);
+    for(auto &th : ths) th.join();
+    return {pushes / 1e6 / seconds, touches / 1e6 / seconds};
+}
+
+int main(int argc, char *argv[]) {
+    size_t conns   = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 8;
+    int seconds    = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    std::vector<std::string> uids(conns);
+    std::vector<Conn> pool(conns);
+    for(size_t i = 0; i < conns; ++i) {
+        uids[i] = "uid-" + std::to_string(i);
+        pool[i] = std::make_shared<int>(static_cast<int>(i));
+    }
+
+    GlobalLockRegistry old_reg;
+    for(size_t i = 0; i < conns; ++i) old_reg.insert(pool[i], uids[i]);
+    auto r_old = run(threads, seconds,
+        [&](std::mt19937 &rng) {
+            for(auto &c : old_reg.connections(uids[rng() % conns])) {
+                auto mu = old_reg.send_mutex(c);
+                if(mu) std::lock_guard<std::mutex> lk(*mu);
+            }
+        },
+        [&](std::mt19937 &rng) { old_reg.touch(pool[rng() % conns]); },
+        [&](std::mt19937 &rng) {
+            size_t i = rng() % conns;
+            old_reg.remove(pool[i]);
+            old_reg.insert(pool[i], uids[i]);
+        });
+
+    chatnow::ConnRegistry<Conn> new_reg;
+    for(size_t i = 0; i < conns; ++i) new_reg.insert(pool[i], uids[i], "s", "d");
+    auto r_new = run(threads, seconds,
+        [&](std::mt19937 &rng) {
+            for(auto &t : new_reg.targets(uids[rng() % conns])) {
+                std::lock_guard<std::mutex> lk(t.slot->send_mu);
+            }
+        },
+        [&](std::mt19937 &rng) { new_reg.touch(pool[rng() % conns]); },
+        [&](std::mt19937 &rng) {
+            size_t i = rng() % conns;
+            new_reg.remove(pool[i]);
+            new_reg.insert(pool[i], uids[i], "s", "d");
+        });
+
+    std::printf("conns=%zu push_threads=%zu (+1 heartbeat, +1 churn)\n", conns, threads);
+    std::printf("  global mutex : push %6.2f Mops/s  touch %6.2f Mops/s\n", r_old.push_mops, r_old.touch_mops);
+    std::printf("  striped      : push %6.2f Mops/s  touch %6.2f Mops/s  (push %.1fx)\n",
+                r_new.push_mops, r_new.touch_mops, r_new.push_mops / r_old.push_mops);
+    return 0;
+}
@@ -0,0 +1,82 @@
+// 网关鉴权单请求成本微基准：
+//   验签  —— JwtCodec::verify 完整 HS256（base64 + JSON + HMAC）对比已验签缓存命中
+//   吊销  —— JwtStore::is_revoked 逐次 Redis GET 对比本地镜像（需要 Redis，连不上则跳过）
+// 用法：jwt_auth_bench [token 数=1000] [轮数=200] [redis_host=127.0.0.1] [redis_port=6379]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "auth/jwt_codec.hpp"
+#include "auth/jwt_store.hpp"
+#include "infra/logger.hpp"
+
+using namespace chatnow::auth;
+using Clock = std::chrono::steady_clock;
+
+static double ns_per(Clock::time_point t0, Clock::time_point t1, size_t n) {
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+}
+
+int main(int argc, char *argv[]) {
+    size_t tokens = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+    std::string host = argc > 3 ? argv[3] : "127.0.0.1";
+    int port = argc > 4 ? std::atoi(argv[4]) : 6379;
+    chatnow::init_logger(false, "", 0);
+
+    JwtConfig cfg;
+    cfg.current_kid = "v1";
+    cfg.keys["v1"] = std::string(32, 'K');
+    JwtCodec plain(cfg), cached(cfg);
+    cached.enable_verify_cache(tokens * 2);
+
+    std::vector<std::string> toks, jtis;
+    for(size_t i = 0; i < tokens; ++i) {
+        jtis.push_back(JwtCodec::random_jti());
+        toks.push_back(plain.sign_access("uid-" + std::to_string(i), "phone", jtis.back()));
+    }
+    for(const auto &t : toks) cached.verify(t);     // 预热：模拟稳态下同一 token 反复访问
+
+    size_t sink = 0, n = tokens * rounds;
+    auto t0 = Clock::now();
+    for(size_t r = 0; r < rounds; ++r)
+        for(const auto &t : toks) sink += plain.verify(t).exp_sec;
+    auto t1 = Clock::now();
+    for(size_t r = 0; r < rounds; ++r)
+        for(const auto &t : toks) sink += cached.verify(t).exp_sec;
+    auto t2 = Clock::now();
+    double v_plain = ns_per(t0, t1, n), v_cached = ns_per(t1, t2, n);
+
+    std::printf("tokens=%zu rounds=%zu\n", tokens, rounds);
+    std::printf("  verify full    : %9.0f ns/req\n", v_plain);
+    std::printf("  verify cached  : %9.0f ns/req  (%.1fx)\n", v_cached, v_plain / v_cached);
+
+    try {
+        sw::redis::ConnectionOptions opt;
+        opt.host = host;
+        opt.port = port;
+        opt.db = 15;
+        auto redis = std::make_shared<sw::redis::Redis>(opt);
+        redis->ping();
+        JwtStore remote(redis), mirrored(redis);
+        for(size_t i = 0; i < tokens; i += 10) remote.revoke(jtis[i], 60);
+        mirrored.enable_local_mirror(std::chrono::milliseconds(1000), 7200);
+
+        // Redis 往返远慢于本地查找，轮数缩减到 1 轮
+        auto t3 = Clock::now();
+        for(const auto &j : jtis) sink += remote.is_revoked(j);
+        auto t4 = Clock::now();
+        for(size_t r = 0; r < rounds; ++r)
+            for(const auto &j : jtis) sink += mirrored.is_revoked(j);
+        auto t5 = Clock::now();
+        double r_remote = ns_per(t3, t4, tokens), r_local = ns_per(t4, t5, n);
+        std::printf("  revoked redis  : %9.0f ns/req\n", r_remote);
+        std::printf("  revoked mirror : %9.0f ns/req  (%.1fx)\n", r_local, r_remote / r_local);
+        std::printf("  per request    : %9.0f ns -> %.0f ns\n", v_plain + r_remote, v_cached + r_local);
+    } catch(const std::exception &e) {
+        std::printf("  revoked        : skipped (redis %s:%d unavailable: %s)\n", host.c_str(), port, e.what());
+    }
+    std::printf("  (sink=%zu)\n", sink);
+    return 0;
+}
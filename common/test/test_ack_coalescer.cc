@@ -0,0 +1,77 @@
+#include "utils/ack_coalescer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace chatnow;
+
+namespace {
+std::map<std::pair<std::string, std::string>, uint64_t> as_map(const std::vector<AckCoalescer::Cursor> &v) {
+    std::map<std::pair<std::string, std::string>, uint64_t> m;
+    for(const auto &c : v) m[{c.uid, c.ssid}] = c.seq;
+    return m;
+}
+}  // namespace
+
+TEST(AckCoalescer, KeepsMaxSeqPerUserSession) {
+    AckCoalescer ac;
+    for(uint64_t s = 1; s <= 100; ++s) ac.add("u1", "s1", s);
+    ac.add("u1", "s1", 50);     // 乱序到达的旧 ACK 不回退
+    ac.add("u1", "s2", 7);
+    ac.add("u2", "s1", 3);
+    EXPECT_EQ(ac.size(), 3u);
+
+    auto m = as_map(ac.drain());
+    EXPECT_EQ(m.size(), 3u);
+    EXPECT_EQ((m[{"u1", "s1"}]), 100u);
+    EXPECT_EQ((m[{"u1", "s2"}]), 7u);
+    EXPECT_EQ((m[{"u2", "s1"}]), 3u);
+    EXPECT_EQ(ac.size(), 0u);
+    EXPECT_TRUE(ac.drain().empty());
+}
+
+TEST(AckCoalescer, DrainRespectsLimit) {
+    AckCoalescer ac;
+    for(int i = 0; i < 1000; ++i) ac.add("u" + std::to_string(i), "s", 1);
+    size_t total = 0;
+    for(;;) {
+        auto batch = ac.drain(64);
+        if(batch.empty()) break;
+        EXPECT_LE(batch.size(), 64u);
+        total += batch.size();
+    }
+    EXPECT_EQ(total, 1000u);
+}
+
+TEST(AckCoalescer, RestoreMergesWithNewerAcks) {
+    AckCoalescer ac;
+    ac.add("u1", "s1", 10);
+    auto failed = ac.drain();
+    ac.add("u1", "s1", 12);     // 刷写期间到达的新 ACK
+    ac.restore(failed);
+    auto m = as_map(ac.drain());
+    EXPECT_EQ((m[{"u1", "s1"}]), 12u);
+
+    ac.add("u1", "s1", 5);
+    ac.restore({{"u1", "s1", 9}});
+    EXPECT_EQ((as_map(ac.drain())[{"u1", "s1"}]), 9u);
+}
+
+TEST(AckCoalescer, ConcurrentAdds) {
+    AckCoalescer ac;
+    std::vector<std::thread> ts;
+    for(int t = 0; t < 4; ++t) {
+        ts.emplace_back([&ac, t]() {
+            for(uint64_t s = 1; s <= 1000; ++s) ac.add("u" + std::to_string(s % 10), "s", s * 4 + t);
+        });
+    }
+    for(auto &t : ts) t.join();
+    auto m = as_map(ac.drain());
+    EXPECT_EQ(m.size(), 10u);
+    EXPECT_EQ((m[{"u0", "s"}]), 1000u * 4 + 3);
+}
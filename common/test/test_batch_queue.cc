@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/batch_queue.hpp"
+
+using chatnow::BatchQueue;
+using namespace std::chrono_literals;
+
+TEST(BatchQueue, FlushesWhenBatchIsFull) {
+    std::mutex mu;
+    std::vector<size_t> sizes;
+    BatchQueue<int> q(1, 4, 10s, [&](std::vector<int> &b) {
+        std::lock_guard<std::mutex> lk(mu);
+        sizes.push_back(b.size());
+    }, "test");
+    for(int i = 0; i < 8; ++i) ASSERT_TRUE(q.submit("k", i));
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while(std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            if(sizes.size() == 2) break;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    std::lock_guard<std::mutex> lk(mu);
+    ASSERT_EQ(sizes.size(), 2u);   // max_delay=10s，只能是攒满触发
+    EXPECT_EQ(sizes[0], 4u);
+    EXPECT_EQ(sizes[1], 4u);
+}
+
+TEST(BatchQueue, FlushesPartialBatchAfterDelay) {
+    std::atomic<size_t> flushed {0};
+    BatchQueue<int> q(1, 100, 20ms, [&](std::vector<int> &b) { flushed += b.size(); }, "test");
+    q.submit("k", 1);
+    q.submit("k", 2);
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while(flushed.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(flushed.load(), 2u);
+}
+
+TEST(BatchQueue, SameKeyKeepsOrderAcrossBatches) {
+    std::mutex mu;
+    std::vector<int> seen;
+    {
+        BatchQueue<int> q(4, 7, 1ms, [&](std::vector<int> &b) {
+            std::lock_guard<std::mutex> lk(mu);
+            seen.insert(seen.end(), b.begin(), b.end());
+        }, "test");
+        for(int i = 0; i < 500; ++i) q.submit("session-1", i);
+    }   // 析构 = stop，排空
+    ASSERT_EQ(seen.size(), 500u);
+    for(int i = 0; i < 500; ++i) EXPECT_EQ(seen[i], i);
+}
+
+TEST(BatchQueue, StopDrainsAndRejectsNew) {
+    std::atomic<size_t> flushed {0};
+    BatchQueue<int> q(2, 1000, 10s, [&](std::vector<int> &b) { flushed += b.size(); }, "test");
+    for(int i = 0; i < 10; ++i) q.submit(std::to_string(i), i);
+    q.stop();
+    EXPECT_EQ(flushed.load(), 10u);   // 不等 max_delay，stop 立即排空
+    EXPECT_EQ(q.pending(), 0u);
+    EXPECT_FALSE(q.submit("k", 1));
+    q.stop();                          // 幂等
+}
@@ -0,0 +1,72 @@
+#include "utils/blocking_fanout.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace chatnow;
+
+TEST(BlockingFanout, RunsTasksConcurrently) {
+    ShardedExecutor pool(4, "fanout-test");
+    std::atomic<int> done {0};
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        BlockingFanout fanout(&pool);
+        for(int i = 0; i < 4; ++i) {
+            fanout.run([&done]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                done.fetch_add(1);
+            });
+        }
+        fanout.wait();
+        EXPECT_EQ(done.load(), 4);
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    // 串行需要 400ms；并发约 100ms
+    EXPECT_LT(ms, 300);
+}
+
+TEST(BlockingFanout, WaitCanBeReusedForNextBatch) {
+    ShardedExecutor pool(2, "fanout-test");
+    BlockingFanout fanout(&pool);
+    int a = 0, b = 0;
+    fanout.run([&a]() { a = 1; });
+    fanout.wait();
+    EXPECT_EQ(a, 1);
+    fanout.run([&a, &b]() { b = a + 1; });
+    fanout.wait();
+    EXPECT_EQ(b, 2);
+}
+
+TEST(BlockingFanout, RunsInlineWithoutPool) {
+    BlockingFanout fanout(nullptr);
+    std::thread::id tid;
+    fanout.run([&tid]() { tid = std::this_thread::get_id(); });
+    fanout.wait();
+    EXPECT_EQ(tid, std::this_thread::get_id());
+}
+
+TEST(BlockingFanout, RunsInlineWhenPoolStopped) {
+    ShardedExecutor pool(2, "fanout-test");
+    pool.stop();
+    BlockingFanout fanout(&pool);
+    bool ran = false;
+    fanout.run([&ran]() { ran = true; });
+    fanout.wait();
+    EXPECT_TRUE(ran);
+}
+
+TEST(BlockingFanout, ThrowingTaskDoesNotHangWaiter) {
+    ShardedExecutor pool(2, "fanout-test");
+    std::atomic<bool> other {false};
+    {
+        BlockingFanout fanout(&pool);
+        fanout.run([]() { throw std::runtime_error("boom"); });
+        fanout.run([&other]() { other = true; });
+    }   // 析构隐式 wait
+    EXPECT_TRUE(other.load());
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "utils/byte_lru_cache.hpp"
+
+using chatnow::ByteLruCache;
+
+TEST(ByteLruCache, EvictsByBytesNotEntries) {
+    ByteLruCache<int64_t, std::string> c(100);
+    c.put(1, "a", 40);
+    c.put(2, "b", 40);
+    std::string v;
+    ASSERT_TRUE(c.get(1, v));       // 1 变为最近访问
+    c.put(3, "c", 40);              // 120 > 100：淘汰 2
+    EXPECT_FALSE(c.get(2, v));
+    EXPECT_TRUE(c.get(1, v));
+    EXPECT_TRUE(c.get(3, v));
+    EXPECT_EQ(c.bytes(), 80u);
+
+    // 许多小条目可以共存
+    ByteLruCache<int64_t, std::string> small(100);
+    for(int64_t i = 0; i < 50; ++i) small.put(i, "x", 2);
+    EXPECT_EQ(small.size(), 50u);
+    small.put(99, "big", 60);       // 挤掉最旧的 30 条
+    EXPECT_EQ(small.size(), 21u);
+    EXPECT_LE(small.bytes(), 100u);
+}
+
+TEST(ByteLruCache, OverwriteAdjustsBytesAndOversizeRejected) {
+    ByteLruCache<int64_t, std::shared_ptr<const std::string>> c(100);
+    c.put(1, std::make_shared<const std::string>("a"), 30);
+    c.put(1, std::make_shared<const std::string>("b"), 50);
+    EXPECT_EQ(c.size(), 1u);
+    EXPECT_EQ(c.bytes(), 50u);
+    std::shared_ptr<const std::string> v;
+    ASSERT_TRUE(c.get(1, v));
+    EXPECT_EQ(*v, "b");
+
+    EXPECT_FALSE(c.put(2, std::make_shared<const std::string>("huge"), 101));
+    EXPECT_FALSE(c.get(2, v));
+    EXPECT_EQ(c.bytes(), 50u);
+
+    EXPECT_TRUE(c.erase(1));
+    EXPECT_FALSE(c.erase(1));
+    EXPECT_EQ(c.bytes(), 0u);
+}
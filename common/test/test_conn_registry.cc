@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "utils/conn_registry.hpp"
+
+using chatnow::ConnRegistry;
+using Conn = std::shared_ptr<int>;
+
+TEST(ConnRegistry, InsertTargetsRemove) {
+    ConnRegistry<Conn> reg;
+    auto c1 = std::make_shared<int>(1), c2 = std::make_shared<int>(2), c3 = std::make_shared<int>(3);
+    reg.insert(c1, "u1", "s1", "phone");
+    reg.insert(c2, "u1", "s2", "pc");
+    reg.insert(c3, "u2", "s3", "phone");
+    EXPECT_EQ(reg.size(), 3u);
+    auto ts = reg.targets("u1");
+    ASSERT_EQ(ts.size(), 2u);
+    EXPECT_NE(ts[0].slot, ts[1].slot);
+    EXPECT_EQ(reg.slot(c2)->device_id, "pc");
+
+    auto removed = reg.remove(c1);
+    ASSERT_TRUE(removed);
+    EXPECT_EQ(removed->uid, "u1");
+    EXPECT_FALSE(reg.remove(c1));
+    ASSERT_EQ(reg.targets("u1").size(), 1u);
+    EXPECT_EQ(reg.targets("u1")[0].conn, c2);
+
+    reg.remove(c2);
+    auto uids = reg.online_uids();
+    EXPECT_EQ(uids, std::vector<std::string>{"u2"});
+}
+
+TEST(ConnRegistry, ReinsertMovesConnToNewUid) {
+    ConnRegistry<Conn> reg;
+    auto c = std::make_shared<int>(1);
+    reg.insert(c, "u1", "s1", "d");
+    reg.insert(c, "u2", "s2", "d");
+    EXPECT_TRUE(reg.targets("u1").empty());
+    ASSERT_EQ(reg.targets("u2").size(), 1u);
+    EXPECT_EQ(reg.size(), 1u);
+}
+
+TEST(ConnRegistry, ReapSkipsFreshConnections) {
+    ConnRegistry<Conn> reg;
+    auto stale = std::make_shared<int>(1), fresh = std::make_shared<int>(2);
+    reg.insert(stale, "u1", "s", "d");
+    reg.insert(fresh, "u2", "s", "d");
+    reg.slot(stale)->last_active.store(ConnRegistry<Conn>::now_sec() - 100);
+    EXPECT_TRUE(reg.touch(fresh));
+    auto reaped = reg.reap(30);
+    ASSERT_EQ(reaped.size(), 1u);
+    EXPECT_EQ(reaped[0].first, "u1");
+    EXPECT_EQ(reaped[0].second, stale);
+    EXPECT_FALSE(reg.slot(stale));
+    EXPECT_TRUE(reg.slot(fresh));
+}
+
+TEST(ConnRegistry, ConcurrentChurnLeavesNoOrphans) {
+    ConnRegistry<Conn> reg;
+    std::atomic<bool> stop {false};
+    std::thread reader([&] {
+        while(!stop.load()) {
+            for(int u = 0; u < 16; ++u) {
+                for(auto &t : reg.targets("u" + std::to_string(u))) {
+                    std::lock_guard<std::mutex> lk(t.slot->send_mu);
+                }
+            }
+        }
+    });
+    std::vector<std::thread> writers;
+    for(int w = 0; w < 4; ++w) {
+        writers.emplace_back([&, w] {
+            for(int i = 0; i < 2000; ++i) {
+                auto c = std::make_shared<int>(i);
+                std::string uid = "u" + std::to_string((w * 7 + i) % 16);
+                reg.insert(c, uid, "s", "d");
+                reg.touch(c);
+                reg.remove(c);
+            }
+        });
+    }
+    for(auto &t : writers) t.join();
+    stop.store(true);
+    reader.join();
+    EXPECT_EQ(reg.size(), 0u);
+    EXPECT_TRUE(reg.online_uids().empty());
+}
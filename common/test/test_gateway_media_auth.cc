@@ -0,0 +1,39 @@
+#include "../../gateway/source/gateway_trace.hpp"
+#include "auth/forward_auth.hpp"
+#include "auth/metadata_keys.hpp"
+
+#include <brpc/controller.h>
+#include <gtest/gtest.h>
+
+using namespace chatnow::auth;
+
+// 拉消息（metadata_only）链路：网关按 JWT 身份写 metadata → message 转发给 media。
+// message 只在转发后的 Controller 带 x-user-id 时才签发附件下载 URL。
+TEST(GatewayMediaAuth, AuthenticatedFetchCarriesIdentityToMedia) {
+    httplib::Request req;
+    brpc::Controller gateway_cntl;      // 网关 → message
+    chatnow::gateway::gateway_setup_trace(req, gateway_cntl, "u1", "d1");
+    chatnow::gateway::LogContextScope scope;
+
+    brpc::Controller media_cntl;        // message → media
+    forward_auth_metadata(&gateway_cntl, &media_cntl);
+    const std::string *uid = media_cntl.http_request().GetHeader(kMetaUserId);
+    ASSERT_NE(uid, nullptr);
+    EXPECT_EQ(*uid, "u1");
+    const std::string *dev = media_cntl.http_request().GetHeader(kMetaDeviceId);
+    ASSERT_NE(dev, nullptr);
+    EXPECT_EQ(*dev, "d1");
+}
+
+TEST(GatewayMediaAuth, AnonymousSetupCarriesNoIdentity) {
+    httplib::Request req;
+    brpc::Controller gateway_cntl;
+    chatnow::gateway::gateway_setup_trace(req, gateway_cntl);
+    chatnow::gateway::LogContextScope scope;
+
+    brpc::Controller media_cntl;
+    forward_auth_metadata(&gateway_cntl, &media_cntl);
+    // 未带身份：message 拒绝签发，附件只返回 file_id
+    EXPECT_EQ(media_cntl.http_request().GetHeader(kMetaUserId), nullptr);
+    EXPECT_NE(media_cntl.http_request().GetHeader(kMetaTraceId), nullptr);
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include "utils/hash_ring.hpp"
+
+using chatnow::HashRing;
+
+TEST(HashRing, EmptyRingReturnsEmpty) {
+    HashRing ring;
+    EXPECT_TRUE(ring.locate("ssid").empty());
+}
+
+TEST(HashRing, StableAndBalanced) {
+    HashRing ring;
+    for(const char *n : {"10.0.0.1:10004", "10.0.0.2:10004", "10.0.0.3:10004", "10.0.0.4:10004"}) ring.add(n);
+    std::map<std::string, int> load;
+    for(int i = 0; i < 40000; ++i) {
+        std::string key = "ssid-" + std::to_string(i);
+        const std::string &n = ring.locate(key);
+        EXPECT_EQ(n, ring.locate(key));
+        load[n]++;
+    }
+    ASSERT_EQ(load.size(), 4u);
+    for(const auto &kv : load) {
+        EXPECT_GT(kv.second, 7000) << kv.first;
+        EXPECT_LT(kv.second, 13000) << kv.first;
+    }
+}
+
+TEST(HashRing, RemoveOnlyMovesKeysOfRemovedNode) {
+    HashRing ring;
+    for(const char *n : {"a", "b", "c", "d"}) ring.add(n);
+    std::map<std::string, std::string> before;
+    for(int i = 0; i < 10000; ++i) {
+        std::string key = "k" + std::to_string(i);
+        before[key] = ring.locate(key);
+    }
+    ring.remove("c");
+    for(const auto &kv : before) {
+        if(kv.second != "c") EXPECT_EQ(ring.locate(kv.first), kv.second);
+        else EXPECT_NE(ring.locate(kv.first), "c");
+    }
+}
+
+TEST(HashRing, HashIsFixed) {
+    // 跨进程 / 跨服务一致：固定输入的哈希值不随实现变化
+    EXPECT_EQ(HashRing::hash("ssid-1"), 14152878648353183856ull);
+    EXPECT_NE(HashRing::hash("a#0"), HashRing::hash("a#1"));
+}
@@ -136,3 +136,43 @@ TEST(JwtCodec, RandomJtiUnique) {
     EXPECT_EQ(a.size(), 32u);
     EXPECT_NE(a, b);
 }
+
+TEST(JwtCodec, VerifyCacheHitKeepsTypCheck) {
+    JwtCodec codec(make_cfg());
+    codec.enable_verify_cache(16);
+    auto tok = codec.sign_refresh("u", "d", "jti_r");
+    EXPECT_EQ(codec.verify(tok, /*require_refresh=*/true).jti, "jti_r");
+    EXPECT_EQ(codec.verify(tok, /*require_refresh=*/true).jti, "jti_r");   // 命中
+    EXPECT_THROW(codec.verify(tok, /*require_refresh=*/false), chatnow::ServiceError);
+}
+
+TEST(JwtCodec, VerifyCacheDoesNotAdmitTampered) {
+    JwtCodec codec(make_cfg());
+    codec.enable_verify_cache(16);
+    auto tok = codec.sign_access("u", "d");
+    codec.verify(tok);
+    auto bad = tok;
+    bad[bad.size() - 2] = (bad[bad.size() - 2] == 'A') ? 'B' : 'A';
+    EXPECT_THROW(codec.verify(bad), chatnow::ServiceError);
+}
+
+TEST(JwtCodec, VerifyCacheBoundedByExp) {
+    JwtConfig cfg = make_cfg();
+    cfg.access_ttl_sec = 1;
+    JwtCodec codec(cfg);
+    codec.enable_verify_cache(16);
+    auto tok = codec.sign_access("u", "d");
+    codec.verify(tok);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+    try {
+        codec.verify(tok);
+        FAIL() << "should throw";
+    } catch (const chatnow::ServiceError& e) {
+        EXPECT_EQ(e.code(), chatnow::error::kAuthTokenExpired);
+    }
+}
+
+TEST(JwtClaimsCache, DigestIsSha256) {
+    EXPECT_EQ(JwtClaimsCache::digest("a").size(), 32u);
+    EXPECT_NE(JwtClaimsCache::digest("a"), JwtClaimsCache::digest("b"));
+}
@@ -0,0 +1,87 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "auth/jwt_store.hpp"
+#include "auth/jwt_revocation_mirror.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+
+#include <chrono>
+#include <thread>
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+}  // namespace
+
+using chatnow::auth::JwtRevocationMirror;
+using chatnow::auth::JwtStore;
+
+TEST(JwtRevocationMirror, SnapshotFollowsVersion) {
+    auto r = make_redis();
+    JwtStore writer(r);
+    JwtRevocationMirror mirror(r, std::chrono::milliseconds(100), 3600);
+    EXPECT_FALSE(mirror.ready());
+    ASSERT_TRUE(mirror.sync_once());
+    EXPECT_TRUE(mirror.ready());
+    EXPECT_FALSE(mirror.contains("jti_a"));
+
+    writer.revoke("jti_a", 60);
+    EXPECT_FALSE(mirror.contains("jti_a"));      // 尚未同步
+    ASSERT_TRUE(mirror.sync_once());
+    EXPECT_TRUE(mirror.contains("jti_a"));
+    EXPECT_EQ(mirror.size(), 1u);
+}
+
+TEST(JwtRevocationMirror, HorizonSkipsLongLivedEntries) {
+    auto r = make_redis();
+    JwtStore writer(r);
+    writer.revoke("access_jti", 60);
+    writer.revoke("refresh_jti", 30 * 86400);
+    JwtRevocationMirror mirror(r, std::chrono::milliseconds(100), 3600);
+    ASSERT_TRUE(mirror.sync_once());
+    EXPECT_TRUE(mirror.contains("access_jti"));
+    EXPECT_FALSE(mirror.contains("refresh_jti"));
+}
+
+TEST(JwtRevocationMirror, ToleratesRevokerClockAhead) {
+    auto r = make_redis();
+    JwtStore writer(r);
+    // 吊销端时钟快 5 秒：记录到期时间略超出 now + horizon
+    writer.revoke("skewed_jti", 3600 + 5);
+    JwtRevocationMirror mirror(r, std::chrono::milliseconds(100), 3600);
+    ASSERT_TRUE(mirror.sync_once());
+    EXPECT_TRUE(mirror.contains("skewed_jti"));
+}
+
+TEST(JwtRevocationMirror, LocalAddSurvivesStaleSnapshot) {
+    auto r = make_redis();
+    JwtRevocationMirror mirror(r, std::chrono::milliseconds(100), 3600);
+    ASSERT_TRUE(mirror.sync_once());
+    auto exp = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() + 60;
+    mirror.add("jti_local", exp);
+    r->incr(chatnow::auth::jwt_key::kRevokedVer);   // 触发重拉，快照中没有 jti_local
+    ASSERT_TRUE(mirror.sync_once());
+    EXPECT_TRUE(mirror.contains("jti_local"));
+}
+
+TEST(JwtStore, MirroredIsRevokedSeesRemoteRevoke) {
+    auto r = make_redis();
+    JwtStore gateway_side(r);
+    gateway_side.enable_local_mirror(std::chrono::milliseconds(50), 3600);
+    JwtStore user_side(r);
+    EXPECT_FALSE(gateway_side.is_revoked("jti_m"));
+    user_side.revoke("jti_m", 60);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_TRUE(gateway_side.is_revoked("jti_m"));
+
+    gateway_side.revoke("jti_n", 60);            // 本进程吊销立即可见
+    EXPECT_TRUE(gateway_side.is_revoked("jti_n"));
+}
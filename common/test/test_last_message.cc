@@ -0,0 +1,51 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "dao/data_redis.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+}  // namespace
+
+using chatnow::LastMessage;
+
+TEST(LastMessage, OlderSeqDoesNotOverwrite) {
+    LastMessage lm(make_redis());
+    lm.set("s1", 5, "p5");
+    lm.set("s1", 3, "p3");          // 重投的旧消息
+    ASSERT_TRUE(lm.get("s1"));
+    EXPECT_EQ(*lm.get("s1"), "p5");
+    lm.set("s1", 6, "p6:with:colons");
+    EXPECT_EQ(*lm.get("s1"), "p6:with:colons");
+}
+
+TEST(LastMessage, GetManyKeepsOrderAndMisses) {
+    LastMessage lm(make_redis());
+    lm.set("a", 1, "pa");
+    lm.set("c", 1, std::string("p\0c", 3));
+    auto res = lm.get_many({"a", "b", "c"});
+    ASSERT_EQ(res.size(), 3u);
+    ASSERT_TRUE(res[0]);
+    EXPECT_EQ(*res[0], "pa");
+    EXPECT_FALSE(res[1]);
+    ASSERT_TRUE(res[2]);
+    EXPECT_EQ(*res[2], std::string("p\0c", 3));   // 二进制安全
+    EXPECT_TRUE(lm.get_many({}).empty());
+}
+
+TEST(LastMessage, SetManyKeepsLatestPerSession) {
+    LastMessage lm(make_redis());
+    lm.set("x", 10, "x10");
+    lm.set_many({{"x", 9, "x9"}, {"y", 2, "y2"}, {"y", 4, "y4"}, {"y", 3, "y3"}});
+    EXPECT_EQ(*lm.get("x"), "x10");
+    EXPECT_EQ(*lm.get("y"), "y4");
+}
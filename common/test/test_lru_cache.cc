@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "utils/lru_cache.hpp"
+
+using chatnow::LruCache;
+
+TEST(LruCache, EvictsLeastRecentlyUsed) {
+    LruCache<std::string, int> c(2);
+    c.put("a", 1);
+    c.put("b", 2);
+    int v = 0;
+    ASSERT_TRUE(c.get("a", v));     // a 变为最近访问
+    c.put("c", 3);                  // 淘汰 b
+    EXPECT_FALSE(c.get("b", v));
+    ASSERT_TRUE(c.get("a", v));
+    EXPECT_EQ(v, 1);
+    ASSERT_TRUE(c.get("c", v));
+    EXPECT_EQ(v, 3);
+    EXPECT_EQ(c.size(), 2u);
+}
+
+TEST(LruCache, PutOverwritesInPlace) {
+    LruCache<std::string, int> c(2);
+    c.put("a", 1);
+    c.put("a", 2);
+    EXPECT_EQ(c.size(), 1u);
+    int v = 0;
+    ASSERT_TRUE(c.get("a", v));
+    EXPECT_EQ(v, 2);
+    EXPECT_TRUE(c.erase("a"));
+    EXPECT_FALSE(c.erase("a"));
+}
+
+TEST(LruCache, TtlExpiresEntries) {
+    LruCache<std::string, int> c(4, std::chrono::milliseconds(20));
+    c.put("a", 1);
+    c.put("b", 2, std::chrono::milliseconds::zero());   // 本条不过期
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    int v = 0;
+    EXPECT_FALSE(c.get("a", v));
+    EXPECT_TRUE(c.get("b", v));
+    EXPECT_EQ(c.size(), 1u);
+}
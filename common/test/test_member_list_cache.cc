@@ -0,0 +1,112 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "dao/member_list_cache.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace chatnow;
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+MemberListCache::List make_list(std::vector<std::string> v) {
+    return std::make_shared<const std::vector<std::string>>(std::move(v));
+}
+}  // namespace
+
+TEST(MemberListCache, MissThenFillThenLocalHit) {
+    auto r = make_redis();
+    MemberListCache cache(std::make_shared<Members>(r), 100, std::chrono::milliseconds(50));
+    long long ver = -1;
+    EXPECT_EQ(cache.get("s1", ver), nullptr);
+    EXPECT_EQ(ver, 0);
+    EXPECT_EQ(cache.local("s1"), nullptr);
+
+    cache.fill("s1", make_list({"u1", "u2", "u3"}), ver);
+    auto hit = cache.local("s1");
+    ASSERT_NE(hit, nullptr);
+    EXPECT_EQ(hit->size(), 3u);
+    // L2 已条件回填
+    EXPECT_EQ(r->scard(std::string(key::kMembers) + "s1"), 3);
+}
+
+TEST(MemberListCache, UnchangedVersionKeepsL1WithoutReload) {
+    auto r = make_redis();
+    MemberListCache cache(std::make_shared<Members>(r), 100, std::chrono::milliseconds(50));
+    long long ver = -1;
+    cache.get("s1", ver);
+    cache.fill("s1", make_list({"u1", "u2"}), ver);
+    // 直接删掉 L2 集合但不推进版本：版本校验通过，仍用 L1，不重新加载成员
+    r->del(std::string(key::kMembers) + "s1");
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    EXPECT_EQ(cache.local("s1"), nullptr);
+    auto hit = cache.get("s1", ver);
+    ASSERT_NE(hit, nullptr);
+    EXPECT_EQ(hit->size(), 2u);
+    EXPECT_NE(cache.local("s1"), nullptr);
+}
+
+TEST(MemberListCache, InvalidateElsewhereIsSeenAfterTtl) {
+    auto r = make_redis();
+    auto members = std::make_shared<Members>(r);
+    MemberListCache cache(members, 100, std::chrono::milliseconds(50));
+    long long ver = -1;
+    cache.get("s1", ver);
+    cache.fill("s1", make_list({"u1", "u2"}), ver);
+
+    // chatsession 侧成员变更
+    members->invalidate("s1");
+    EXPECT_NE(cache.local("s1"), nullptr);      // l1_ttl 内仍命中（延迟上限）
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    EXPECT_EQ(cache.get("s1", ver), nullptr);   // 版本变化 → L2 已删 → 回源
+    EXPECT_EQ(ver, 1);
+
+    cache.fill("s1", make_list({"u1", "u2", "u3"}), ver);
+    long long ver2 = -1;
+    auto hit = cache.get("s1", ver2);
+    ASSERT_NE(hit, nullptr);
+    EXPECT_EQ(hit->size(), 3u);
+}
+
+TEST(MemberListCache, StaleFillDoesNotOverwriteL2) {
+    auto r = make_redis();
+    auto members = std::make_shared<Members>(r);
+    MemberListCache cache(members, 100, std::chrono::milliseconds(50));
+    long long ver = -1;
+    cache.get("s1", ver);
+    // 回源期间成员发生变更
+    members->invalidate("s1");
+    cache.fill("s1", make_list({"old"}), ver);
+    EXPECT_EQ(r->exists(std::string(key::kMembers) + "s1"), 0);
+    // L1 记的是旧版本：过 ttl 后校验失败，不会长期读到旧列表
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    EXPECT_EQ(cache.get("s1", ver), nullptr);
+}
+
+TEST(MemberListCache, LoadReadsVersionAndMembersAtomically) {
+    auto r = make_redis();
+    Members members(r);
+    ASSERT_TRUE(members.warm_if_version("s1", {"a", "b"}, 0));
+    members.invalidate("s1");
+    ASSERT_FALSE(members.warm_if_version("s1", {"a", "b"}, 0));
+    ASSERT_TRUE(members.warm_if_version("s1", {"a", "b", "c"}, 1));
+    long long ver = -1;
+    std::vector<std::string> uids;
+    ASSERT_TRUE(members.load("s1", ver, uids));
+    EXPECT_EQ(ver, 1);
+    EXPECT_EQ(uids.size(), 3u);
+    EXPECT_EQ(members.version("s1"), 1);
+}
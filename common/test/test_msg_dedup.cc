@@ -0,0 +1,89 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "dao/data_redis.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace chatnow;
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+}  // namespace
+
+TEST(MsgDedup, FirstAcquireWinsSecondSeesPending) {
+    auto r = make_redis();
+    MsgDedup d(r);
+    std::string v;
+    EXPECT_EQ(d.acquire("u1", "c1", v), MsgDedup::State::kAcquired);
+    EXPECT_EQ(d.acquire("u1", "c1", v), MsgDedup::State::kPending);
+    // 不同用户 / 不同 client_msg_id 互不影响
+    EXPECT_EQ(d.acquire("u2", "c1", v), MsgDedup::State::kAcquired);
+    EXPECT_EQ(d.acquire("u1", "c2", v), MsgDedup::State::kAcquired);
+    auto ttl = r->ttl(std::string(key::kDedup) + "u1:c1");
+    EXPECT_GT(ttl, 0);
+    EXPECT_LE(ttl, kDedupTtl.count());
+}
+
+TEST(MsgDedup, CompleteReturnsStoredValue) {
+    auto r = make_redis();
+    MsgDedup d(r);
+    std::string v;
+    ASSERT_EQ(d.acquire("u1", "c1", v), MsgDedup::State::kAcquired);
+    std::string payload("\x08\x01\x00\x12pending", 11);     // 二进制值，可含 \0 与 "pending"
+    d.complete("u1", "c1", payload);
+    EXPECT_EQ(d.acquire("u1", "c1", v), MsgDedup::State::kDone);
+    EXPECT_EQ(v, payload);
+    v.clear();
+    EXPECT_EQ(d.peek("u1", "c1", v), MsgDedup::State::kDone);
+    EXPECT_EQ(v, payload);
+}
+
+TEST(MsgDedup, ReleaseOnlyDropsPending) {
+    auto r = make_redis();
+    MsgDedup d(r);
+    std::string v;
+    ASSERT_EQ(d.acquire("u1", "c1", v), MsgDedup::State::kAcquired);
+    d.release("u1", "c1");
+    EXPECT_EQ(d.peek("u1", "c1", v), MsgDedup::State::kAcquired);
+    EXPECT_EQ(d.acquire("u1", "c1", v), MsgDedup::State::kAcquired);
+
+    // 已写回结果后迟到的 release 不能抹掉结果
+    d.complete("u1", "c1", "result");
+    d.release("u1", "c1");
+    EXPECT_EQ(d.peek("u1", "c1", v), MsgDedup::State::kDone);
+    EXPECT_EQ(v, "result");
+}
+
+TEST(MsgDedup, WindowExpires) {
+    auto r = make_redis();
+    MsgDedup d(r, std::chrono::seconds(1));
+    std::string v;
+    ASSERT_EQ(d.acquire("u1", "c1", v), MsgDedup::State::kAcquired);
+    d.complete("u1", "c1", "result");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    // 窗口过期后重新占位成功，之后的重复交给 DB uk_client_msg 兜底
+    EXPECT_EQ(d.acquire("u1", "c1", v), MsgDedup::State::kAcquired);
+}
+
+TEST(MsgDedup, RedisDownReportsError) {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 1;       // 无人监听
+    opt.connect_timeout = std::chrono::milliseconds(100);
+    MsgDedup d(std::make_shared<sw::redis::Redis>(opt));
+    std::string v;
+    EXPECT_EQ(d.acquire("u1", "c1", v), MsgDedup::State::kError);
+    EXPECT_EQ(d.peek("u1", "c1", v), MsgDedup::State::kError);
+}
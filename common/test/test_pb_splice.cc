@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "utils/pb_splice.hpp"
+
+namespace pw = chatnow::pb_wire;
+
+namespace {
+std::string len_field(uint32_t field, const std::string &payload) {
+    std::string out;
+    pw::append_varint(out, (static_cast<uint64_t>(field) << 3) | pw::kWireLen);
+    pw::append_varint(out, payload.size());
+    out += payload;
+    return out;
+}
+std::string varint_field(uint32_t field, uint64_t v) {
+    std::string out;
+    pw::append_varint(out, (static_cast<uint64_t>(field) << 3) | pw::kWireVarint);
+    pw::append_varint(out, v);
+    return out;
+}
+// 结构与 NotifyMessage{type=2, new_message_info=6{message_info=1{...}}} 一致
+std::string notify(const std::string &msg_body, const std::string &trailer = "") {
+    return varint_field(2, 5) + len_field(6, len_field(1, msg_body)) + trailer;
+}
+}  // namespace
+
+TEST(VarintSplicer, AppendsFieldAndFixesLengths) {
+    std::string body = len_field(2, "ssid") + varint_field(6, 42);
+    pw::VarintSplicer sp;
+    ASSERT_TRUE(sp.init(notify(body, len_field(11, "trace")), {6, 1}, 8));
+    EXPECT_EQ(sp.base(), notify(body, len_field(11, "trace")));
+    EXPECT_EQ(sp.encode(300), notify(body + varint_field(8, 300), len_field(11, "trace")));
+    EXPECT_EQ(sp.encode(0), notify(body + varint_field(8, 0), len_field(11, "trace")));
+}
+
+TEST(VarintSplicer, LengthVarintGrowsAcrossLevels) {
+    // 内层 125 字节：追加 2 字节后跨过 127，内外两层长度前缀都变为 2 字节
+    std::string body = len_field(5, std::string(123, 'x'));
+    ASSERT_EQ(body.size(), 125u);
+    pw::VarintSplicer sp;
+    ASSERT_TRUE(sp.init(notify(body), {6, 1}, 8));
+    for(uint64_t seq : {1ull, 127ull, 128ull, 1ull << 40}) {
+        std::string got = sp.encode(seq);
+        EXPECT_EQ(got, notify(body + varint_field(8, seq))) << seq;
+        std::string_view inner;
+        ASSERT_TRUE(pw::find_bytes_path(got, {6, 1}, inner));
+        EXPECT_EQ(inner.size(), body.size() + varint_field(8, seq).size());
+    }
+}
+
+TEST(VarintSplicer, MissingPathFails) {
+    pw::VarintSplicer sp;
+    EXPECT_FALSE(sp.init(varint_field(2, 5), {6, 1}, 8));
+    EXPECT_FALSE(sp.ok());
+    EXPECT_EQ(sp.encode(7), varint_field(2, 5));     // 未就绪时原样返回
+}
+
+TEST(VarintSplicer, EmptyPathAppendsAtTopLevel) {
+    pw::VarintSplicer sp;
+    ASSERT_TRUE(sp.init(varint_field(1, 9), {}, 3));
+    EXPECT_EQ(sp.encode(4), varint_field(1, 9) + varint_field(3, 4));
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "utils/pb_wire.hpp"
+
+namespace pw = chatnow::pb_wire;
+
+namespace {
+// 手工编码：tag(field, type) + payload
+std::string len_field(uint32_t field, const std::string &payload) {
+    std::string out;
+    pw::append_varint(out, (static_cast<uint64_t>(field) << 3) | pw::kWireLen);
+    pw::append_varint(out, payload.size());
+    out += payload;
+    return out;
+}
+std::string varint_field(uint32_t field, uint64_t v) {
+    std::string out;
+    pw::append_varint(out, (static_cast<uint64_t>(field) << 3) | pw::kWireVarint);
+    pw::append_varint(out, v);
+    return out;
+}
+}  // namespace
+
+TEST(PbWire, VarintRoundTrip) {
+    for(uint64_t v : {0ull, 1ull, 127ull, 128ull, 300ull, 1ull << 35, ~0ull}) {
+        std::string buf;
+        pw::append_varint(buf, v);
+        EXPECT_EQ(buf.size(), pw::varint_size(v));
+        size_t pos = 0;
+        uint64_t got = 0;
+        ASSERT_TRUE(pw::read_varint(buf, pos, got));
+        EXPECT_EQ(got, v);
+        EXPECT_EQ(pos, buf.size());
+    }
+    // 截断的 varint
+    std::string bad("\x80\x80", 2);
+    size_t pos = 0;
+    uint64_t got = 0;
+    EXPECT_FALSE(pw::read_varint(bad, pos, got));
+}
+
+TEST(PbWire, FindsTopLevelBytesSkippingOtherTypes) {
+    // field1 varint, field3 fixed64, field2 string
+    std::string msg = varint_field(1, 12345);
+    pw::append_varint(msg, (3u << 3) | pw::kWireFixed64);
+    msg += std::string(8, '\x01');
+    msg += len_field(2, "ssid-42");
+    std::string_view out;
+    ASSERT_TRUE(pw::find_bytes(msg, 2, out));
+    EXPECT_EQ(out, "ssid-42");
+    EXPECT_FALSE(pw::find_bytes(msg, 4, out));
+}
+
+TEST(PbWire, FindsNestedPath) {
+    // InternalMessage{ message_info(1){ message_id(1)=7, chat_session_id(2)="s1" }, member_id_list(2)="u1" }
+    std::string info = varint_field(1, 7) + len_field(2, "s1");
+    std::string msg  = len_field(1, info) + len_field(2, "u1");
+    std::string_view out;
+    ASSERT_TRUE(pw::find_bytes_path(msg, {1, 2}, out));
+    EXPECT_EQ(out, "s1");
+    ASSERT_TRUE(pw::find_bytes_path(msg, {2}, out));
+    EXPECT_EQ(out, "u1");
+    EXPECT_FALSE(pw::find_bytes_path(msg, {1, 3}, out));
+}
+
+TEST(PbWire, RejectsMalformed) {
+    std::string msg = len_field(2, "abcdef");
+    msg.resize(msg.size() - 2);   // 长度声明超出实际
+    std::string_view out;
+    EXPECT_FALSE(pw::find_bytes(msg, 2, out));
+    // group wire type(3) 视为非法
+    std::string group;
+    pw::append_varint(group, (1u << 3) | 3u);
+    EXPECT_FALSE(pw::find_bytes(group, 1, out));
+}
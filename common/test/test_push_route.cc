@@ -0,0 +1,129 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "dao/data_redis.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+}  // namespace
+
+using chatnow::OnlineRoute;
+using chatnow::PushLease;
+using chatnow::Status;
+using chatnow::UnackedPush;
+
+TEST(UnackedPush, AdvanceManyOnlyMovesForwardWithTtl) {
+    auto c = make_redis();
+    UnackedPush up(c);
+    up.advance_many({{"u1", 7}, {"u2", 9}});
+    up.advance_many({{"u1", 5}, {"u2", 12}});    // u1 旧游标不回退
+    EXPECT_EQ(up.acked("u1"), 7);
+    EXPECT_EQ(up.acked("u2"), 12);
+    EXPECT_EQ(up.acked("u3"), 0);
+    EXPECT_GT(c->ttl(std::string(chatnow::key::kUnackHw) + "u1"), 0);
+    up.advance_many({});            // 空批次不访问 Redis
+}
+
+TEST(UnackedPush, AdvanceManyChunksLargeBatches) {
+    auto c = make_redis();
+    UnackedPush up(c);
+    std::vector<std::pair<std::string, uint64_t>> items;
+    for(int i = 0; i < 1200; ++i) items.emplace_back("u" + std::to_string(i), i + 1);
+    up.advance_many(items);
+    EXPECT_EQ(up.acked("u0"), 1);
+    EXPECT_EQ(up.acked("u1199"), 1200);
+}
+
+TEST(OnlineRoute, InstancesManyOmitsOfflineUsers) {
+    auto c = make_redis();
+    OnlineRoute route(c);
+    PushLease lease(c);
+    for(auto i : {"push-1", "push-2", "push-3"}) lease.renew(i);
+    route.bind("a", "push-1");
+    route.bind("a", "push-2");
+    route.bind("c", "push-3");
+    auto res = route.instances_many({"a", "b", "c"});
+    ASSERT_EQ(res.size(), 2u);
+    EXPECT_EQ(res["a"].size(), 2u);
+    EXPECT_EQ(res.count("b"), 0u);
+    ASSERT_EQ(res["c"].size(), 1u);
+    EXPECT_EQ(res["c"][0], "push-3");
+}
+
+TEST(OnlineRoute, UnbindManyOnlyRemovesGivenInstance) {
+    auto c = make_redis();
+    OnlineRoute route(c);
+    PushLease lease(c);
+    for(auto i : {"push-1", "push-2"}) lease.renew(i);
+    route.bind("a", "push-1");
+    route.bind("a", "push-2");
+    route.bind("b", "push-1");
+    route.unbind_many({"a", "b"}, "push-1");
+    auto res = route.instances_many({"a", "b"});
+    ASSERT_EQ(res.count("a"), 1u);
+    EXPECT_EQ(res["a"], std::vector<std::string>{"push-2"});
+    EXPECT_FALSE(route.online("b"));
+}
+
+TEST(OnlineRoute, RoutesToDeadInstancesAreFiltered) {
+    auto c = make_redis();
+    OnlineRoute route(c);
+    PushLease lease(c);
+    lease.renew("push-1");
+    lease.renew("push-2");
+    route.bind("a", "push-1");
+    route.bind("a", "push-2");
+    route.bind("b", "push-2");
+
+    lease.revoke("push-2");         // 实例宕机 / 下线：不逐用户清理路由
+    EXPECT_EQ(route.instances("a"), std::vector<std::string>{"push-1"});
+    auto res = route.instances_many({"a", "b"});
+    EXPECT_EQ(res.count("b"), 0u);
+    EXPECT_EQ(res["a"], std::vector<std::string>{"push-1"});
+    EXPECT_FALSE(route.online("b"));
+}
+
+TEST(PushLease, StatusFollowsInstanceLease) {
+    auto c = make_redis();
+    PushLease lease(c);
+    Status status(c);
+    status.append("u1");                    // 登录态标记
+    EXPECT_TRUE(status.exists("u1"));
+    lease.renew("push-1");
+    status.bind("u1", "push-1");
+    EXPECT_TRUE(status.exists("u1"));
+    status.unbind("u1", "push-2");          // 非本实例绑定：不动
+    EXPECT_EQ(*c->get(std::string(chatnow::key::kStatus) + "u1"), "push-1");
+    lease.revoke("push-1");
+    EXPECT_FALSE(status.exists("u1"));
+    EXPECT_FALSE(status.exists("u2"));
+
+    status.unbind("u1", "push-1");          // 最后一条连接断开：退回登录态标记
+    EXPECT_TRUE(status.exists("u1"));
+    EXPECT_LE(c->ttl(std::string(chatnow::key::kStatus) + "u1"), chatnow::kStatusTtl.count());
+}
+
+TEST(PushLease, TouchManyRefreshesUserKeysInOnePipeline) {
+    auto c = make_redis();
+    PushLease lease(c);
+    OnlineRoute route(c);
+    route.bind("u1", "push-1", std::chrono::seconds(5));
+    c->set(std::string(chatnow::key::kSession) + "s1", "u1", std::chrono::seconds(5));
+    lease.touch_many({{"u1", "s1"}});
+    EXPECT_GT(c->ttl(std::string(chatnow::key::kOnline) + "u1"), 5);
+    EXPECT_GT(c->ttl(std::string(chatnow::key::kSession) + "s1"), 5);
+}
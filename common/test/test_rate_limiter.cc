@@ -0,0 +1,105 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "dao/data_redis.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace chatnow;
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+double tokens(sw::redis::Redis &r, const std::string &k) {
+    auto v = r.hget(k, "t");
+    return v ? std::stod(*v) : -1;
+}
+RateLimiter::Options only_user(double rate, double burst, bool local) {
+    RateLimiter::Options opt;
+    opt.user = {rate, burst};
+    opt.session = {0, 0};
+    opt.local_precheck = local;
+    return opt;
+}
+}  // namespace
+
+TEST(RateLimiter, BurstThenLimited) {
+    auto r = make_redis();
+    RateLimiter rl(r, only_user(1, 5, false));
+    for(int i = 0; i < 5; ++i) EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kUserLimited);
+    // 桶 key 带过期：空闲 burst / rate 秒后必然回满，无需保留
+    auto ttl = r->pttl(std::string(key::kBucketUser) + "u1");
+    EXPECT_GT(ttl, 0);
+    EXPECT_LE(ttl, 6000);
+}
+
+TEST(RateLimiter, RejectedRequestConsumesNoBucket) {
+    auto r = make_redis();
+    RateLimiter::Options opt;
+    opt.user = {1, 3};
+    opt.session = {1, 1};
+    opt.local_precheck = false;
+    RateLimiter rl(r, opt);
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kSessionLimited);
+    // 会话桶拒绝时用户桶不扣减
+    EXPECT_NEAR(tokens(*r, std::string(key::kBucketUser) + "u1"), 2, 0.1);
+    // 换一个会话，用户桶仍可用
+    EXPECT_EQ(rl.allow_message("u1", "s2"), RateLimiter::Verdict::kAllowed);
+}
+
+TEST(RateLimiter, RefillsOverTime) {
+    auto r = make_redis();
+    RateLimiter rl(r, only_user(10, 1, false));
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kUserLimited);
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+}
+
+TEST(RateLimiter, ReloadsScriptAfterFlush) {
+    auto r = make_redis();
+    RateLimiter rl(r, only_user(1, 5, false));
+    const std::string k = std::string(key::kBucketUser) + "u1";
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    r->script_flush();
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    // 真正经过了脚本（而不是 Redis 故障放行）：令牌被扣了两次
+    EXPECT_NEAR(tokens(*r, k), 3, 0.1);
+}
+
+TEST(RateLimiter, LocalPrecheckRejectsWithoutRedis) {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 1;       // 无人监听：Redis 判定一律失败放行
+    opt.connect_timeout = std::chrono::milliseconds(100);
+    RateLimiter rl(std::make_shared<sw::redis::Redis>(opt), only_user(1, 2, true));
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kUserLimited);
+}
+
+TEST(RateLimiter, RedisRejectionReturnsLocalTokens) {
+    auto r = make_redis();
+    RateLimiter rl(r, only_user(0.001, 2, true));
+    RateLimiter other(r, only_user(0.001, 2, false));     // 模拟其它实例耗尽全局桶
+    EXPECT_EQ(other.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    EXPECT_EQ(other.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kUserLimited);
+
+    r->del(key::kBucketUser + std::string("u1"));         // 全局桶重新装满
+    // 被 Redis 拒绝的那次未消耗本地令牌：本地桶仍有 2 个
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+    EXPECT_EQ(rl.allow_message("u1", "s1"), RateLimiter::Verdict::kAllowed);
+}
@@ -0,0 +1,69 @@
+#include "utils/retransmit_window.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace chatnow;
+
+TEST(RetransmitWindow, CumulativeAckDropsPrefix) {
+    RetransmitWindow w;
+    for(uint64_t s = 1; s <= 5; ++s) w.push("u1", s, static_cast<int64_t>(s) * 100);
+    EXPECT_EQ(w.ack("u1", 3), 3u);
+    EXPECT_EQ(w.size("u1"), 2u);
+    // 乱序到达的旧 ACK 不回退游标
+    EXPECT_EQ(w.ack("u1", 2), 0u);
+    EXPECT_EQ(w.acked("u1"), 3u);
+    // 已确认范围内的推送（重复投递）不再入窗口
+    w.push("u1", 3, 300);
+    EXPECT_EQ(w.size("u1"), 2u);
+}
+
+TEST(RetransmitWindow, FireMatchesAttemptAndSkipsAcked) {
+    RetransmitWindow w;
+    w.push("u1", 1, 100);
+    w.push("u1", 2, 200);
+    int64_t mid = 0;
+    ASSERT_TRUE(w.fire("u1", 1, 0, mid));
+    EXPECT_EQ(mid, 100);
+    // 同一次数的旧定时器再次到期：作废
+    EXPECT_FALSE(w.fire("u1", 1, 0, mid));
+    EXPECT_TRUE(w.fire("u1", 1, 1, mid));
+    // 已确认 / 未知用户的定时器到期：作废
+    w.ack("u1", 2);
+    EXPECT_FALSE(w.fire("u1", 2, 0, mid));
+    EXPECT_FALSE(w.fire("u2", 1, 0, mid));
+    // 补推重复入窗口：不算新项，重发次数保留
+    EXPECT_TRUE(w.push("u1", 3, 300));
+    EXPECT_TRUE(w.fire("u1", 3, 0, mid));
+    EXPECT_FALSE(w.push("u1", 3, 301));
+    EXPECT_FALSE(w.fire("u1", 3, 0, mid));
+    ASSERT_TRUE(w.fire("u1", 3, 1, mid));
+    EXPECT_EQ(mid, 301);
+}
+
+TEST(RetransmitWindow, OverflowRecordsEvictedRange) {
+    RetransmitWindow w(3);
+    for(uint64_t s = 1; s <= 5; ++s) w.push("u1", s, 1);
+    EXPECT_EQ(w.size("u1"), 3u);
+    EXPECT_EQ(w.evicted("u1"), 2u);
+    w.clear_evicted("u1", 2);
+    EXPECT_EQ(w.evicted("u1"), 0u);
+}
+
+TEST(RetransmitWindow, DrainAckedReportsEachAdvanceOnce) {
+    RetransmitWindow w;
+    w.ack("u1", 7);
+    w.ack("u1", 9);
+    w.ack("u2", 1);
+    auto acked = w.drain_acked();
+    ASSERT_EQ(acked.size(), 2u);
+    for(const auto &p : acked) EXPECT_EQ(p.second, p.first == "u1" ? 9u : 1u);
+    EXPECT_TRUE(w.drain_acked().empty());
+
+    w.ack("u1", 10);
+    EXPECT_EQ(w.drop("u1"), 10u);      // 下线时返回尚未写出的游标
+    EXPECT_EQ(w.drop("u2"), 0u);       // 已写出过
+    EXPECT_EQ(w.acked("u1"), 0u);
+}
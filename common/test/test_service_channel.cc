@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include "mq/channel.hpp"
+
+using namespace chatnow;
+
+namespace {
+// Init 单地址信道不建连，无需真实服务端
+ServiceChannel::ptr make_service(LbPolicy policy, int n) {
+    auto svc = std::make_shared<ServiceChannel>("/service/test", policy);
+    for(int i = 0; i < n; ++i) svc->append("127.0.0.1:" + std::to_string(20001 + i));
+    return svc;
+}
+std::map<brpc::Channel *, int> spread(ServiceChannel &svc, int rounds) {
+    std::map<brpc::Channel *, int> hits;
+    for(int i = 0; i < rounds; ++i) hits[svc.choose().get()]++;
+    return hits;
+}
+}  // namespace
+
+TEST(ServiceChannel, AppendRemoveSnapshot) {
+    auto svc = make_service(LbPolicy::kRoundRobin, 3);
+    EXPECT_EQ(svc->size(), 3u);
+    auto held = svc->choose();
+    svc->remove("127.0.0.1:20001");
+    svc->remove("127.0.0.1:20001");        // 重复下线：忽略
+    EXPECT_EQ(svc->size(), 2u);
+    EXPECT_TRUE(held);                     // 在途引用不受下线影响
+    for(int i = 0; i < 10; ++i) EXPECT_NE(svc->owner("k" + std::to_string(i)), "127.0.0.1:20001");
+}
+
+TEST(ServiceChannel, RoundRobinIsEven) {
+    auto svc = make_service(LbPolicy::kRoundRobin, 4);
+    auto hits = spread(*svc, 400);
+    ASSERT_EQ(hits.size(), 4u);
+    for(const auto &kv : hits) EXPECT_EQ(kv.second, 100);
+}
+
+TEST(ServiceChannel, LeastOutstandingAvoidsBusyNode) {
+    auto svc = make_service(LbPolicy::kLeastOutstanding, 3);
+    auto nodes = svc->nodes();
+    nodes[0]->stats->inflight.store(100);
+    auto hits = spread(*svc, 3000);
+    EXPECT_EQ(hits[nodes[0]->channel.get()], 0);
+}
+
+TEST(ServiceChannel, EwmaShiftsTrafficFromSlowReplica) {
+    auto svc = make_service(LbPolicy::kEwmaLatency, 3);
+    auto nodes = svc->nodes();
+    for(int i = 0; i < 20; ++i) {
+        nodes[0]->stats->on_start(); nodes[0]->stats->on_done(200000, false, 3000000);   // 200ms
+        nodes[1]->stats->on_start(); nodes[1]->stats->on_done(2000, false, 3000000);     // 2ms
+        nodes[2]->stats->on_start(); nodes[2]->stats->on_done(2000, false, 3000000);
+    }
+    auto hits = spread(*svc, 3000);
+    EXPECT_LT(hits[nodes[0]->channel.get()], 30);
+}
+
+TEST(ServiceChannel, FailuresEjectNodeUntilRecovered) {
+    auto svc = make_service(LbPolicy::kRoundRobin, 3);
+    auto nodes = svc->nodes();
+    for(int i = 0; i < NodeStats::kEjectThreshold; ++i) {
+        nodes[1]->stats->on_start();
+        nodes[1]->stats->on_done(1000, /*failed=*/true, 3000000);
+    }
+    EXPECT_TRUE(nodes[1]->stats->ejected());
+    auto hits = spread(*svc, 300);
+    EXPECT_EQ(hits[nodes[1]->channel.get()], 0);
+    nodes[1]->stats->ejected_until_ms.store(0);
+    hits = spread(*svc, 300);
+    EXPECT_EQ(hits[nodes[1]->channel.get()], 100);
+}
+
+TEST(ServiceChannel, NeverEjectsMajority) {
+    auto svc = make_service(LbPolicy::kRoundRobin, 2);
+    for(const auto &n : svc->nodes()) n->stats->ejected_until_ms.store(NodeStats::now_ms() + 60000);
+    EXPECT_TRUE(svc->choose());
+}
+
+TEST(ServiceChannel, KeyedChooseFailsOverOnlyWhenOwnerLeaves) {
+    auto svc = make_service(LbPolicy::kLeastOutstanding, 3);
+    std::string owner = svc->owner("ssid-1");
+    auto pinned = svc->choose("ssid-1");
+    EXPECT_EQ(pinned, svc->choose("ssid-1"));
+    // 归属节点被摘除（慢但仍在线）：仍选它，会话级状态只在归属节点上
+    for(const auto &n : svc->nodes()) {
+        if(n->host == owner) n->stats->ejected_until_ms.store(NodeStats::now_ms() + 60000);
+    }
+    EXPECT_EQ(svc->choose("ssid-1"), pinned);
+    EXPECT_EQ(svc->owner("ssid-1"), owner);
+    // 从服务发现下线后换到环上下一个节点
+    svc->remove(owner);
+    EXPECT_NE(svc->owner("ssid-1"), owner);
+    EXPECT_NE(svc->choose("ssid-1"), pinned);
+    EXPECT_TRUE(svc->choose("ssid-1"));
+}
+
+TEST(NodeStats, SlowCallThresholdFollowsCallTimeout) {
+    NodeStats long_budget;
+    for(int i = 0; i < NodeStats::kEjectThreshold; ++i) {
+        long_budget.on_start();
+        long_budget.on_done(2000000, false, 10000000);      // 2s / 超时 10s：正常的慢接口
+    }
+    EXPECT_FALSE(long_budget.ejected());
+
+    NodeStats short_budget;
+    for(int i = 0; i < NodeStats::kEjectThreshold; ++i) {
+        short_budget.on_start();
+        short_budget.on_done(2000000, false, 3000000);      // 2s / 超时 3s：接近超时
+    }
+    EXPECT_TRUE(short_budget.ejected());
+}
+
+TEST(ServiceManager, PolicyAppliesToLaterServices) {
+    ServiceManager mgr;
+    mgr.declared("/service/a");
+    mgr.set_policy("/service/a", LbPolicy::kRoundRobin);
+    mgr.onServiceOnline("/service/a/1", "127.0.0.1:20001");
+    mgr.onServiceOnline("/service/a/2", "127.0.0.1:20002");
+    mgr.onServiceOnline("/service/b/1", "127.0.0.1:20003");   // 未关注
+    EXPECT_FALSE(mgr.choose("/service/b"));
+    auto c1 = mgr.choose("/service/a");
+    auto c2 = mgr.choose("/service/a");
+    EXPECT_NE(c1, c2);
+    mgr.onServiceOffline("/service/a/1", "127.0.0.1:20001");
+    EXPECT_EQ(mgr.choose("/service/a"), mgr.choose("/service/a"));
+}
@@ -0,0 +1,85 @@
+#include "utils/session_interest.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace chatnow;
+
+namespace {
+std::vector<std::string> sorted(std::vector<std::string> v) {
+    std::sort(v.begin(), v.end());
+    return v;
+}
+}  // namespace
+
+TEST(SessionInterest, SubscribeOnFirstMemberUnsubscribeOnLast) {
+    SessionInterest si;
+    EXPECT_TRUE(si.attach("u1"));
+    EXPECT_EQ(sorted(si.learn("u1", {"g1", "g2"})), (std::vector<std::string>{"g1", "g2"}));
+    EXPECT_TRUE(si.attach("u2"));
+    // g1 已有本机成员：不需要再次订阅
+    EXPECT_EQ(si.learn("u2", {"g1", "g3"}), (std::vector<std::string>{"g3"}));
+    EXPECT_EQ(si.users("g1"), 2u);
+
+    EXPECT_EQ(sorted(si.detach("u1")), (std::vector<std::string>{"g2"}));
+    EXPECT_EQ(sorted(si.detach("u2")), (std::vector<std::string>{"g1", "g3"}));
+    EXPECT_TRUE(si.sessions().empty());
+}
+
+TEST(SessionInterest, MultipleConnectionsOfOneUser) {
+    SessionInterest si;
+    EXPECT_TRUE(si.attach("u1"));
+    EXPECT_FALSE(si.attach("u1"));
+    si.learn("u1", {"g1"});
+    // 只断开一条连接：仍在线，不退订
+    EXPECT_TRUE(si.detach("u1").empty());
+    EXPECT_EQ(si.users("g1"), 1u);
+    EXPECT_EQ(si.detach("u1"), (std::vector<std::string>{"g1"}));
+}
+
+TEST(SessionInterest, LearnAfterDisconnectIsIgnored) {
+    SessionInterest si;
+    si.attach("u1");
+    si.detach("u1");
+    // 大群列表查询返回时用户已下线
+    EXPECT_TRUE(si.learn("u1", {"g1"}).empty());
+    EXPECT_EQ(si.users("g1"), 0u);
+    EXPECT_TRUE(si.detach("u1").empty());
+}
+
+TEST(SessionInterest, UnlearnedUsersAreListedForRetry) {
+    SessionInterest si;
+    si.attach("u1");
+    si.attach("u2");
+    si.learn("u2", {});
+    EXPECT_EQ(si.unlearned(), (std::vector<std::string>{"u1"}));
+    // 重复 learn 只计一次
+    EXPECT_EQ(si.learn("u1", {"g1"}), (std::vector<std::string>{"g1"}));
+    EXPECT_TRUE(si.learn("u1", {"g1"}).empty());
+    EXPECT_EQ(si.users("g1"), 1u);
+    EXPECT_TRUE(si.unlearned().empty());
+}
+
+TEST(SessionInterest, JoinAddsOneSessionWithoutMarkingLearned) {
+    SessionInterest si;
+    si.attach("u1");
+    EXPECT_EQ(si.pending(), 1u);
+    // 查询期间收到新大群的逐成员投递：补登该会话，仍待查询
+    EXPECT_TRUE(si.join("u1", "g1"));
+    EXPECT_FALSE(si.join("u1", "g1"));
+    EXPECT_EQ(si.pending(), 1u);
+    EXPECT_EQ(si.learn("u1", {"g1", "g2"}), (std::vector<std::string>{"g2"}));
+    EXPECT_EQ(si.pending(), 0u);
+
+    si.attach("u2");
+    EXPECT_FALSE(si.join("u2", "g1"));          // g1 本机已有在线成员
+    EXPECT_EQ(si.users("g1"), 2u);
+    EXPECT_FALSE(si.join("u3", "g1"));          // 不在本机的用户忽略
+    EXPECT_EQ(si.detach("u1"), (std::vector<std::string>{"g2"}));
+    EXPECT_EQ(si.pending(), 1u);
+    EXPECT_EQ(si.detach("u2"), (std::vector<std::string>{"g1"}));
+    EXPECT_EQ(si.pending(), 0u);
+}
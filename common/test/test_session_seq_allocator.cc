@@ -0,0 +1,127 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "dao/session_seq_allocator.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace chatnow;
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+long long counter(sw::redis::Redis &r, const std::string &ssid) {
+    auto v = r.get(std::string(key::kSeqSession) + ssid);
+    return v ? std::stoll(*v) : 0;
+}
+}  // namespace
+
+TEST(SessionSeqAllocator, HotSessionGrowsBlockAndStaysDense) {
+    auto r = make_redis();
+    auto gen = std::make_shared<SeqGen>(r);
+    SessionSeqAllocator::Options opt;
+    opt.max_block = 16;
+    SessionSeqAllocator alloc(gen, opt);
+    for(unsigned long i = 1; i <= 100; ++i) EXPECT_EQ(alloc.next("s1"), i);
+    // 号段已涨到上限：Redis 计数器领先已发放值，但不超过一个号段
+    EXPECT_GE(counter(*r, "s1"), 100);
+    EXPECT_LT(counter(*r, "s1"), 100 + 16);
+    alloc.release_all();
+    EXPECT_EQ(counter(*r, "s1"), 100);      // 尾部已归还
+    EXPECT_EQ(gen->next_session_seq("s1"), 101u);
+}
+
+TEST(SessionSeqAllocator, HandoverContinuesWithoutGap) {
+    auto r = make_redis();
+    auto gen = std::make_shared<SeqGen>(r);
+    SessionSeqAllocator::Options opt;
+    opt.max_block = 32;
+    std::atomic<bool> a_owns {true};
+    SessionSeqAllocator a(gen, opt, [&](const std::string &) { return a_owns.load(); });
+    SessionSeqAllocator b(gen, opt);
+    for(unsigned long i = 1; i <= 50; ++i) ASSERT_EQ(a.next("s2"), i);
+    a_owns = false;
+    a.tick();                                // 归属迁走：归还尾部
+    EXPECT_EQ(b.next("s2"), 51u);
+}
+
+TEST(SessionSeqAllocator, NonOwnerReleasesBeforeServing) {
+    auto r = make_redis();
+    auto gen = std::make_shared<SeqGen>(r);
+    SessionSeqAllocator::Options opt;
+    opt.max_block = 32;
+    opt.holder = "a";
+    std::atomic<bool> a_owns {true};
+    SessionSeqAllocator a(gen, opt, [&](const std::string &) { return a_owns.load(); });
+    opt.holder = "b";
+    SessionSeqAllocator b(gen, opt);
+    for(unsigned long i = 1; i <= 50; ++i) ASSERT_EQ(a.next("s5"), i);
+    EXPECT_EQ(b.next("s5"), 0u);            // a 持有租约：b 拒绝发号，不与 a 交错
+    EXPECT_EQ(a.next("s5"), 51u);
+
+    a_owns = false;                          // 未等 tick：a 在 next() 中发现归属迁走
+    EXPECT_EQ(a.next("s5"), 52u);            // 先交还尾部与租约，再逐条发号
+    EXPECT_EQ(b.next("s5"), 53u);            // b 接手，从 a 之后连续发放
+    EXPECT_EQ(a.next("s5"), 0u);             // b 已持有租约：a 拒绝
+    EXPECT_EQ(b.next("s5"), 54u);
+}
+
+TEST(SessionSeqAllocator, LostLeaseDropsBlock) {
+    auto r = make_redis();
+    auto gen = std::make_shared<SeqGen>(r);
+    SessionSeqAllocator::Options opt;
+    opt.max_block = 64;
+    opt.holder = "a";
+    opt.lease_ms = 200;
+    SessionSeqAllocator a(gen, opt);
+    for(unsigned long i = 1; i <= 40; ++i) ASSERT_EQ(a.next("s6"), i);
+    // 模拟租约过期后被其它实例接手
+    r->set(std::string(key::kSeqHolder) + "s6", "b");
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_EQ(a.next("s6"), 0u);             // 续期失败：号段作废，不再从旧号段发号
+}
+
+TEST(SessionSeqAllocator, FenceInvalidatesLocalBlock) {
+    auto r = make_redis();
+    auto gen = std::make_shared<SeqGen>(r);
+    SessionSeqAllocator::Options opt;
+    opt.max_block = 64;
+    SessionSeqAllocator alloc(gen, opt);
+    for(int i = 0; i < 20; ++i) alloc.next("s3");
+    // 模拟 Redis 丢数据后 message 服务回填：计数器被重置并抬升到 DB 中的 max + 1
+    r->del(std::string(key::kSeqSession) + "s3");
+    gen->backfill_session("s3", 1000);
+    alloc.tick();
+    EXPECT_EQ(alloc.next("s3"), 1001u);
+}
+
+TEST(SessionSeqAllocator, ConcurrentNextIsUnique) {
+    auto r = make_redis();
+    auto gen = std::make_shared<SeqGen>(r);
+    SessionSeqAllocator::Options opt;
+    opt.max_block = 8;
+    SessionSeqAllocator alloc(gen, opt);
+    std::vector<std::vector<unsigned long>> got(4);
+    std::vector<std::thread> ths;
+    for(int t = 0; t < 4; ++t) {
+        ths.emplace_back([&, t] { for(int i = 0; i < 500; ++i) got[t].push_back(alloc.next("s4")); });
+    }
+    for(auto &th : ths) th.join();
+    std::set<unsigned long> all;
+    for(auto &v : got) all.insert(v.begin(), v.end());
+    EXPECT_EQ(all.size(), 2000u);
+    EXPECT_EQ(*all.begin(), 1u);
+    EXPECT_EQ(*all.rbegin(), 2000u);
+}
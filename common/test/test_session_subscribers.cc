@@ -0,0 +1,106 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "dao/data_redis.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace chatnow;
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+}  // namespace
+
+TEST(SessionSubscribers, SubscribeAndUnsubscribe) {
+    auto r = make_redis();
+    SessionSubscribers subs(r);
+    subs.subscribe_many({"g1", "g2"}, "push-a");
+    subs.subscribe_many({"g1"}, "push-b");
+
+    std::vector<std::string> its;
+    ASSERT_TRUE(subs.instances("g1", its));
+    std::sort(its.begin(), its.end());
+    EXPECT_EQ(its, (std::vector<std::string>{"push-a", "push-b"}));
+
+    subs.unsubscribe_many({"g1"}, "push-a");
+    ASSERT_TRUE(subs.instances("g1", its));
+    EXPECT_EQ(its, (std::vector<std::string>{"push-b"}));
+    ASSERT_TRUE(subs.instances("g3", its));
+    EXPECT_TRUE(its.empty());
+    EXPECT_GT(r->ttl(std::string(key::kPushSub) + "g2"), 0);
+}
+
+TEST(SessionSubscribers, ExpiredLeaseIsInvisibleAndPruned) {
+    auto r = make_redis();
+    SessionSubscribers short_lease(r, std::chrono::seconds(1));
+    SessionSubscribers subs(r);
+    short_lease.subscribe_many({"g1"}, "push-dead");
+    std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+
+    std::vector<std::string> its;
+    ASSERT_TRUE(subs.instances("g1", its));
+    EXPECT_TRUE(its.empty());
+    // 其它实例续约时顺带清掉过期条目
+    subs.subscribe_many({"g1"}, "push-live");
+    EXPECT_EQ(r->zcard(std::string(key::kPushSub) + "g1"), 1);
+}
+
+TEST(SessionSubscribers, RedisDownReportsFailure) {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 1;
+    opt.connect_timeout = std::chrono::milliseconds(100);
+    SessionSubscribers subs(std::make_shared<sw::redis::Redis>(opt));
+    std::vector<std::string> its;
+    EXPECT_FALSE(subs.instances("g1", its));
+}
+
+TEST(SessionSubscribers, PendingInstancesSeeEveryGroup) {
+    auto r = make_redis();
+    SessionSubscribers subs(r);
+    subs.subscribe_many({"g1"}, "push-a");
+    subs.subscribe_pending("push-a");
+    subs.subscribe_pending("push-b");
+
+    std::vector<std::string> its;
+    ASSERT_TRUE(subs.instances("g1", its));
+    std::sort(its.begin(), its.end());
+    EXPECT_EQ(its, (std::vector<std::string>{"push-a", "push-b"}));      // 去重
+    ASSERT_TRUE(subs.instances("g2", its));
+    std::sort(its.begin(), its.end());
+    EXPECT_EQ(its, (std::vector<std::string>{"push-a", "push-b"}));
+
+    subs.unsubscribe_pending("push-b");
+    ASSERT_TRUE(subs.instances("g2", its));
+    EXPECT_EQ(its, (std::vector<std::string>{"push-a"}));
+}
+
+TEST(SessionSubscribers, SyncedVersionRoundTrip) {
+    auto r = make_redis();
+    SessionSubscribers subs(r);
+    std::vector<std::string> its;
+    long long ver = 0;
+    ASSERT_TRUE(subs.instances("g1", its, ver));
+    EXPECT_EQ(ver, -1);                         // 从未校正
+
+    subs.mark_synced("g1", 7);
+    ASSERT_TRUE(subs.instances("g1", its, ver));
+    EXPECT_EQ(ver, 7);
+    EXPECT_GT(r->ttl(std::string(key::kPushSubVer) + "g1"), 0);
+    subs.mark_synced("g1", -1);                 // 版本未知不记
+    ASSERT_TRUE(subs.instances("g1", its, ver));
+    EXPECT_EQ(ver, 7);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "utils/sharded_executor.hpp"
+
+using chatnow::ShardedExecutor;
+
+TEST(ShardedExecutor, SameKeyRunsInSubmitOrder) {
+    ShardedExecutor ex(4, "test");
+    std::mutex mu;
+    std::vector<int> seen;
+    std::promise<void> done;
+    const int n = 1000;
+    for(int i = 0; i < n; ++i) {
+        ASSERT_TRUE(ex.submit("session-1", [&, i]() {
+            std::lock_guard<std::mutex> lk(mu);
+            seen.push_back(i);
+            if(i == n - 1) done.set_value();
+        }));
+    }
+    done.get_future().wait();
+    ASSERT_EQ(seen.size(), static_cast<size_t>(n));
+    for(int i = 0; i < n; ++i) EXPECT_EQ(seen[i], i);
+}
+
+TEST(ShardedExecutor, DifferentShardsRunConcurrently) {
+    ShardedExecutor ex(2, "test");
+    // 两个 shard 各自阻塞等对方：只有并行执行才能同时到达
+    std::promise<void> a_in, b_in;
+    auto fa = a_in.get_future().share();
+    auto fb = b_in.get_future().share();
+    std::atomic<int> finished {0};
+    ex.submit_to(0, [&]() { a_in.set_value(); fb.wait(); ++finished; });
+    ex.submit_to(1, [&]() { b_in.set_value(); fa.wait(); ++finished; });
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(finished.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(finished.load(), 2);
+}
+
+TEST(ShardedExecutor, ExceptionDoesNotKillWorker) {
+    ShardedExecutor ex(1, "test");
+    std::promise<void> done;
+    ex.submit("k", []() { throw std::runtime_error("boom"); });
+    ex.submit("k", [&]() { done.set_value(); });
+    EXPECT_EQ(done.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+}
+
+TEST(ShardedExecutor, StopDropsQueuedAndRejectsNew) {
+    ShardedExecutor ex(1, "test");
+    std::promise<void> started, release;
+    auto rel = release.get_future();
+    std::atomic<int> ran {0};
+    ex.submit("k", [&]() { started.set_value(); rel.wait(); ++ran; });
+    started.get_future().wait();
+    for(int i = 0; i < 10; ++i) ex.submit("k", [&]() { ++ran; });
+    EXPECT_EQ(ex.pending(), 10u);
+
+    std::thread stopper([&]() { ex.stop(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    release.set_value();
+    stopper.join();
+
+    EXPECT_EQ(ran.load(), 1);          // 仅正在执行的任务跑完
+    EXPECT_FALSE(ex.submit("k", []() {}));
+    ex.stop();                          // 幂等
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/singleflight.hpp"
+
+using chatnow::SingleFlight;
+
+TEST(SingleFlight, ConcurrentCallsShareOneLoad) {
+    SingleFlight<std::string, int> sf;
+    std::atomic<int> loads {0};
+    std::atomic<bool> go {false};
+    std::vector<std::thread> ts;
+    std::vector<int> results(8, 0);
+    for(int i = 0; i < 8; ++i) {
+        ts.emplace_back([&, i]() {
+            while(!go.load()) std::this_thread::yield();
+            results[i] = sf.run("k", [&]() {
+                ++loads;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                return 42;
+            });
+        });
+    }
+    go = true;
+    for(auto &t : ts) t.join();
+    EXPECT_EQ(loads.load(), 1);
+    for(int r : results) EXPECT_EQ(r, 42);
+    EXPECT_EQ(sf.inflight(), 0u);
+}
+
+TEST(SingleFlight, JoinDoneForBatchLoads) {
+    SingleFlight<std::string, int> sf;
+    auto a = sf.join("a");
+    auto b = sf.join("a");
+    EXPECT_TRUE(a.leader);
+    EXPECT_FALSE(b.leader);
+    sf.done("a", 7);
+    EXPECT_EQ(b.future.get(), 7);
+    EXPECT_TRUE(sf.join("a").leader);   // 结果不缓存，下一轮重新选 leader
+}
+
+TEST(SingleFlight, FailurePropagatesToFollowers) {
+    SingleFlight<std::string, int> sf;
+    auto leader = sf.join("k");
+    auto follower = sf.join("k");
+    sf.fail("k", std::make_exception_ptr(std::runtime_error("boom")));
+    EXPECT_THROW(follower.future.get(), std::runtime_error);
+    EXPECT_TRUE(leader.leader);
+}
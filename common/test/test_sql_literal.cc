@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "dao/sql_literal.hpp"
+
+namespace sql = chatnow::sql;
+
+TEST(SqlLiteral, QuotesAndEscapes) {
+    EXPECT_EQ(sql::quote("abc"), "'abc'");
+    EXPECT_EQ(sql::quote(""), "''");
+    EXPECT_EQ(sql::quote("it's"), "'it\\'s'");
+    EXPECT_EQ(sql::quote("a\\b"), "'a\\\\b'");
+    EXPECT_EQ(sql::quote("\"x\""), "'\\\"x\\\"'");
+    EXPECT_EQ(sql::quote(std::string("a\0b", 3)), "'a\\0b'");
+    EXPECT_EQ(sql::quote("l1\nl2\r"), "'l1\\nl2\\r'");
+    EXPECT_EQ(sql::quote("\x1a"), "'\\Z'");
+    // 多字节 UTF-8 原样透传
+    EXPECT_EQ(sql::quote("你好"), "'你好'");
+    // 注入尝试被整体包成一个字面量
+    EXPECT_EQ(sql::quote("x'); DROP TABLE message; --"), "'x\\'); DROP TABLE message; --'");
+}
+
+TEST(SqlLiteral, QuoteOrNull) {
+    EXPECT_EQ(sql::quote_or_null(""), "NULL");
+    EXPECT_EQ(sql::quote_or_null("u1"), "'u1'");
+}
+
+TEST(SqlLiteral, Datetime) {
+    using namespace boost::posix_time;
+    ptime t(boost::gregorian::date(2026, 5, 14), hours(8) + minutes(3) + seconds(9) + milliseconds(42));
+    EXPECT_EQ(sql::datetime(t), "'2026-05-14 08:03:09.042000'");
+    ptime whole(boost::gregorian::date(2026, 1, 2), hours(0));
+    EXPECT_EQ(sql::datetime(whole), "'2026-01-02 00:00:00'");
+    EXPECT_EQ(sql::datetime(ptime()), "NULL");
+}
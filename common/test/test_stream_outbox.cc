@@ -0,0 +1,131 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "dao/data_redis.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+}  // namespace
+
+using chatnow::CrossInstanceOutbox;
+using chatnow::PushOutbox;
+
+TEST(StreamOutbox, ReadDeliversOnceAndAckRemoves) {
+    auto c = make_redis();
+    PushOutbox box(c);
+    ASSERT_TRUE(box.ensure_group());
+    ASSERT_TRUE(box.ensure_group());            // BUSYGROUP 视为成功
+
+    const std::string bin("a\0b\nc", 5);        // 二进制 payload 原样存取，无需 base64
+    box.enqueue(bin);
+    box.enqueue("second");
+    EXPECT_EQ(box.backlog(), 2);
+
+    auto batch = box.read("r1", 10, std::chrono::milliseconds(100));
+    ASSERT_EQ(batch.size(), 2u);
+    ASSERT_NE(batch[0].get("p"), nullptr);
+    EXPECT_EQ(*batch[0].get("p"), bin);
+    // 已投递给 r1 的条目不会再被其它 consumer 读到
+    EXPECT_TRUE(box.read("r2", 10, std::chrono::milliseconds(100)).empty());
+
+    box.ack({batch[0].id, batch[1].id});
+    EXPECT_EQ(box.backlog(), 0);
+}
+
+TEST(StreamOutbox, ReclaimTakesOverIdlePendingEntries) {
+    auto c = make_redis();
+    PushOutbox box(c);
+    ASSERT_TRUE(box.ensure_group());
+    box.enqueue("x");
+    auto batch = box.read("dead", 10, std::chrono::milliseconds(100));
+    ASSERT_EQ(batch.size(), 1u);                // "dead" 领取后未 ack
+
+    EXPECT_TRUE(box.reclaim("r2", std::chrono::milliseconds(10000), 10).empty());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto claimed = box.reclaim("r2", std::chrono::milliseconds(20), 10);
+    ASSERT_EQ(claimed.size(), 1u);
+    EXPECT_EQ(claimed[0].id, batch[0].id);
+    EXPECT_EQ(*claimed[0].get("p"), "x");
+
+    box.ack({claimed[0].id});
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_TRUE(box.reclaim("r3", std::chrono::milliseconds(20), 10).empty());
+}
+
+TEST(StreamOutbox, CrossInstanceEntryRoundTrip) {
+    auto c = make_redis();
+    CrossInstanceOutbox box(c);
+    ASSERT_TRUE(box.ensure_group());
+    const std::string bin("\x08\x00\xff", 3);
+    box.enqueue(bin, {"u1", "u2"}, "/service/push/instance-2");
+
+    auto batch = box.read("r1", 10, std::chrono::milliseconds(100));
+    ASSERT_EQ(batch.size(), 1u);
+    std::string payload, peer;
+    std::vector<std::string> uids;
+    ASSERT_TRUE(CrossInstanceOutbox::parse(batch[0], payload, uids, peer));
+    EXPECT_EQ(payload, bin);
+    EXPECT_EQ(uids, (std::vector<std::string>{"u1", "u2"}));
+    EXPECT_EQ(peer, "/service/push/instance-2");
+
+    CrossInstanceOutbox::Entry broken{"0-1", {{"u", "u1"}}};
+    EXPECT_FALSE(CrossInstanceOutbox::parse(broken, payload, uids, peer));
+}
+
+TEST(StreamOutbox, DeferredAcksCommitOnFlush) {
+    auto c = make_redis();
+    PushOutbox box(c);
+    ASSERT_TRUE(box.ensure_group());
+    box.enqueue("x");
+    auto batch = box.read("r1", 10, std::chrono::milliseconds(100));
+    ASSERT_EQ(batch.size(), 1u);
+    box.defer_ack(batch[0].id);                 // 只登记，不访问 Redis
+    EXPECT_EQ(box.backlog(), 1);
+    box.flush_acks();
+    EXPECT_EQ(box.backlog(), 0);
+}
+
+TEST(StreamOutbox, MigratesLegacyZsetEntries) {
+    auto c = make_redis();
+    PushOutbox push(c);
+    ASSERT_TRUE(push.ensure_group());
+    const std::string bin("\x08\x00\xff", 3);
+    c->zadd(chatnow::key::kPushOutboxLegacy, bin, 1);
+    c->zadd(chatnow::key::kPushOutboxLegacy, "second", 2);
+    EXPECT_EQ(push.migrate_legacy(), 2u);
+    EXPECT_EQ(c->exists(chatnow::key::kPushOutboxLegacy), 0);
+    auto batch = push.read("r1", 10, std::chrono::milliseconds(100));
+    ASSERT_EQ(batch.size(), 2u);
+    EXPECT_EQ(*batch[0].get("p"), bin);
+    EXPECT_EQ(push.migrate_legacy(), 0u);       // 已搬空：重复调用无副作用
+
+    CrossInstanceOutbox cross(c);
+    ASSERT_TRUE(cross.ensure_group());
+    // 旧版成员：payload base64（"CAD/" 即 \x08\x00\xff）+ uid 数组 + 对端实例
+    c->zadd(chatnow::key::kCrossOutboxLegacy, R"({"k":"CAD/","u":["u1","u2"],"p":"/service/push/instance-2"})", 1);
+    c->zadd(chatnow::key::kCrossOutboxLegacy, "not a legacy member", 2);
+    EXPECT_EQ(cross.migrate_legacy(), 1u);      // 无法解析的成员丢弃
+    EXPECT_EQ(c->exists(chatnow::key::kCrossOutboxLegacy), 0);
+    auto entries = cross.read("r1", 10, std::chrono::milliseconds(100));
+    ASSERT_EQ(entries.size(), 1u);
+    std::string payload, peer;
+    std::vector<std::string> uids;
+    ASSERT_TRUE(CrossInstanceOutbox::parse(entries[0], payload, uids, peer));
+    EXPECT_EQ(payload, bin);
+    EXPECT_EQ(uids, (std::vector<std::string>{"u1", "u2"}));
+    EXPECT_EQ(peer, "/service/push/instance-2");
+}
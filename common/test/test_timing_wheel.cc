@@ -0,0 +1,61 @@
+#include "utils/timing_wheel.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace chatnow;
+
+TEST(TimingWheel, FiresAtDeadlineNotBefore) {
+    TimingWheel<int> w(10, 0);
+    w.schedule(50, 1);
+    w.schedule(55, 2);          // 向上取整到 60
+    w.schedule(0, 3);           // 已过期：下一个 tick 到期
+    std::vector<int> out;
+    EXPECT_EQ(w.advance(10, out), 1u);
+    EXPECT_EQ(out, std::vector<int>{3});
+    out.clear();
+    EXPECT_EQ(w.advance(49, out), 0u);
+    EXPECT_EQ(w.advance(50, out), 1u);
+    EXPECT_EQ(w.advance(60, out), 1u);
+    EXPECT_EQ(out, (std::vector<int>{1, 2}));
+    EXPECT_EQ(w.size(), 0u);
+}
+
+TEST(TimingWheel, CascadesAcrossLevels) {
+    // 覆盖第 0 ~ 3 层及槽下标回绕，逐 tick 推进时每个定时器恰好在到期 tick 触发
+    TimingWheel<int64_t> w(1, 5);
+    std::mt19937_64 rng(42);
+    std::vector<int64_t> deadlines = {6, 63, 64, 65, 4095, 4096, 4097, 4101, 70000, 262150};
+    for(int i = 0; i < 500; ++i) deadlines.push_back(6 + static_cast<int64_t>(rng() % 300000));
+    for(auto d : deadlines) w.schedule(d, d);
+
+    std::vector<int64_t> out;
+    for(int64_t now = 6; now <= 300010; ++now) {
+        out.clear();
+        w.advance(now, out);
+        for(auto d : out) ASSERT_EQ(d, now);
+    }
+    EXPECT_EQ(w.size(), 0u);
+}
+
+TEST(TimingWheel, CatchesUpAfterLargeJump) {
+    TimingWheel<int> w(100, 0);
+    for(int i = 1; i <= 100; ++i) w.schedule(i * 1000, i);
+    std::vector<int> out;
+    EXPECT_EQ(w.advance(50000, out), 50u);
+    std::sort(out.begin(), out.end());
+    EXPECT_EQ(out.front(), 1);
+    EXPECT_EQ(out.back(), 50);
+    // 轮空后直接跳到目标 tick，新定时器按新的当前时间计
+    out.clear();
+    w.advance(1000000, out);
+    EXPECT_EQ(w.size(), 0u);
+    w.schedule(1000100, 7);
+    out.clear();
+    EXPECT_EQ(w.advance(1000100, out), 1u);
+}
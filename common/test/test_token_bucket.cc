@@ -0,0 +1,62 @@
+#include "utils/token_bucket.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace chatnow;
+
+TEST(LocalTokenBuckets, BurstThenRefillAtRate) {
+    LocalTokenBuckets b;
+    for(int i = 0; i < 5; ++i) EXPECT_TRUE(b.try_take("u1", 10, 5, 1000));
+    EXPECT_FALSE(b.try_take("u1", 10, 5, 1000));
+    // 10 令牌/秒：100ms 补 1 个
+    EXPECT_FALSE(b.try_take("u1", 10, 5, 1050));
+    EXPECT_TRUE(b.try_take("u1", 10, 5, 1150));
+    EXPECT_FALSE(b.try_take("u1", 10, 5, 1150));
+    // 长时间空闲最多回满到 burst
+    for(int i = 0; i < 5; ++i) EXPECT_TRUE(b.try_take("u1", 10, 5, 60000));
+    EXPECT_FALSE(b.try_take("u1", 10, 5, 60000));
+}
+
+TEST(LocalTokenBuckets, KeysAreIndependent) {
+    LocalTokenBuckets b;
+    EXPECT_TRUE(b.try_take("a", 1, 1, 0));
+    EXPECT_FALSE(b.try_take("a", 1, 1, 0));
+    EXPECT_TRUE(b.try_take("b", 1, 1, 0));
+}
+
+TEST(LocalTokenBuckets, GiveBackCapsAtBurst) {
+    LocalTokenBuckets b;
+    EXPECT_TRUE(b.try_take("a", 1, 2, 0));
+    EXPECT_TRUE(b.try_take("a", 1, 2, 0));
+    EXPECT_FALSE(b.try_take("a", 1, 2, 0));
+    b.give_back("a", 2);
+    b.give_back("a", 2);
+    b.give_back("a", 2);
+    EXPECT_TRUE(b.try_take("a", 1, 2, 0));
+    EXPECT_TRUE(b.try_take("a", 1, 2, 0));
+    EXPECT_FALSE(b.try_take("a", 1, 2, 0));
+}
+
+TEST(LocalTokenBuckets, SizeIsBoundedAndFullBucketsAreSwept) {
+    LocalTokenBuckets b(/*max_keys_per_shard=*/1);
+    auto drain = [&b](const std::string &prefix, int64_t now_ms) {
+        int limited = 0;
+        for(int i = 0; i < 1000; ++i) {
+            std::string k = prefix + std::to_string(i);
+            bool ok = true;
+            for(int j = 0; j < 11; ++j) ok = b.try_take(k, 1, 10, now_ms);
+            if(!ok) ++limited;
+        }
+        return limited;
+    };
+    // 每分片只跟踪 1 个 key：其余 key 不跟踪、一律放行（交给 Redis）
+    int limited = drain("k", 0);
+    EXPECT_LE(b.size(), LocalTokenBuckets::kShards);
+    EXPECT_EQ(static_cast<size_t>(limited), b.size());
+    // 旧桶回满后与不存在等价，被清理掉，新 key 重新纳入跟踪
+    int limited_later = drain("n", 100000);
+    EXPECT_GT(limited_later, 0);
+    EXPECT_EQ(static_cast<size_t>(limited_later), b.size());
+}
@@ -0,0 +1,39 @@
+#include "utils/touch_scheduler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace chatnow;
+
+TEST(TouchScheduler, QueuesAtMostOncePerInterval) {
+    TouchScheduler ts(1000);
+    ts.seen("s1", "u1", 0);             // 首次只登记
+    EXPECT_TRUE(ts.drain().empty());
+    for(int64_t t = 100; t < 1000; t += 100) ts.seen("s1", "u1", t);
+    EXPECT_TRUE(ts.drain().empty());
+
+    for(int64_t t = 1000; t < 2000; t += 100) ts.seen("s1", "u1", t);
+    auto due = ts.drain();
+    ASSERT_EQ(due.size(), 1u);
+    EXPECT_EQ(due[0], std::make_pair(std::string("s1"), std::string("u1")));
+    EXPECT_TRUE(ts.drain().empty());
+    ts.seen("s1", "u1", 2000);
+    EXPECT_EQ(ts.drain().size(), 1u);
+}
+
+TEST(TouchScheduler, ForgetStopsTracking) {
+    TouchScheduler ts(10);
+    ts.seen("s1", "u1", 0);
+    ts.seen("s2", "u2", 0);
+    EXPECT_EQ(ts.size(), 2u);
+    ts.forget("s1");
+    EXPECT_EQ(ts.size(), 1u);
+    ts.seen("s2", "u2", 20);
+    ts.seen("s1", "u1", 20);            // 重新登记，不排队
+    auto due = ts.drain();
+    ASSERT_EQ(due.size(), 1u);
+    EXPECT_EQ(due[0].first, "s2");
+}
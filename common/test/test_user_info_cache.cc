@@ -0,0 +1,171 @@
+// 需要本地 Redis 127.0.0.1:6379 db=15；CI 容器中已提供。
+#include "dao/user_info_cache.hpp"
+
+#include <gtest/gtest.h>
+#include <sw/redis++/redis++.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+std::shared_ptr<sw::redis::Redis> make_redis() {
+    sw::redis::ConnectionOptions opt;
+    opt.host = "127.0.0.1";
+    opt.port = 6379;
+    opt.db = 15;
+    auto c = std::make_shared<sw::redis::Redis>(opt);
+    c->flushdb();
+    return c;
+}
+
+// 模拟 pb UserInfo：只需 user_id / SerializeAsString / ParseFromString
+struct FakeInfo {
+    std::string uid;
+    std::string nickname;
+    const std::string &user_id() const { return uid; }
+    std::string SerializeAsString() const { return uid + "|" + nickname; }
+    bool ParseFromString(const std::string &s) {
+        auto p = s.find('|');
+        if(p == std::string::npos) return false;
+        uid = s.substr(0, p);
+        nickname = s.substr(p + 1);
+        return true;
+    }
+};
+
+using Cache = chatnow::UserInfoCache<FakeInfo>;
+}  // namespace
+
+TEST(UserInfoCache, LoadsOnceThenServesFromCache) {
+    auto redis = make_redis();
+    Cache cache(redis);
+    int loads = 0;
+    Cache::Loader loader = [&](const std::vector<std::string> &uids,
+                               std::unordered_map<std::string, FakeInfo> &out) {
+        ++loads;
+        for(const auto &u : uids) if(u != "ghost") out[u] = FakeInfo{u, "n-" + u};
+        return true;
+    };
+    std::unordered_map<std::string, FakeInfo> res;
+    ASSERT_TRUE(cache.get_many({"u1", "u2", "ghost"}, res, loader));
+    EXPECT_EQ(res.size(), 2u);
+    EXPECT_EQ(res["u1"].nickname, "n-u1");
+    EXPECT_EQ(loads, 1);
+
+    res.clear();
+    ASSERT_TRUE(cache.get_many({"u1", "u2"}, res, loader));   // L1
+    EXPECT_EQ(loads, 1);
+
+    Cache other(redis);                                       // 另一进程：L1 空，L2 命中
+    FakeInfo info;
+    ASSERT_TRUE(other.get("u2", info, loader));
+    EXPECT_EQ(info.nickname, "n-u2");
+    EXPECT_EQ(loads, 1);
+}
+
+TEST(UserInfoCache, InvalidateIsSeenAfterL1Ttl) {
+    auto redis = make_redis();
+    std::string nick = "old";
+    Cache::Loader loader = [&](const std::vector<std::string> &uids,
+                               std::unordered_map<std::string, FakeInfo> &out) {
+        for(const auto &u : uids) out[u] = FakeInfo{u, nick};
+        return true;
+    };
+    Cache reader(redis, 1 << 20, std::chrono::milliseconds(20));
+    Cache writer(redis, 1 << 20, std::chrono::milliseconds(20));
+    FakeInfo info;
+    ASSERT_TRUE(reader.get("u1", info, loader));
+    EXPECT_EQ(info.nickname, "old");
+
+    nick = "new";
+    writer.invalidate("u1");
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    ASSERT_TRUE(reader.get("u1", info, loader));              // 版本变化 → 重新回源
+    EXPECT_EQ(info.nickname, "new");
+}
+
+TEST(UserInfoCache, StaleWriteBackIsRejected) {
+    auto redis = make_redis();
+    Cache cache(redis);
+    // 回源过程中资料被改并失效：旧资料不能写回 L2
+    Cache::Loader loader = [&](const std::vector<std::string> &uids,
+                               std::unordered_map<std::string, FakeInfo> &out) {
+        cache.invalidate("u1");
+        for(const auto &u : uids) out[u] = FakeInfo{u, "stale"};
+        return true;
+    };
+    FakeInfo info;
+    ASSERT_TRUE(cache.get("u1", info, loader));
+    EXPECT_FALSE(redis->get(std::string(chatnow::key::kUserInfo) + "u1"));
+}
+
+TEST(UserInfoCache, ProjectionsUseSeparateL2Keys) {
+    auto redis = make_redis();
+    Cache full(redis);
+    Cache brief(redis, 1 << 20, std::chrono::seconds(5), chatnow::kUserInfoTtl, chatnow::key::kUserBrief);
+    auto loader_of = [](const std::string &nick) {
+        return Cache::Loader([nick](const std::vector<std::string> &uids,
+                                    std::unordered_map<std::string, FakeInfo> &out) {
+            for(const auto &u : uids) out[u] = FakeInfo{u, nick};
+            return true;
+        });
+    };
+    FakeInfo info;
+    ASSERT_TRUE(brief.get("u1", info, loader_of("brief")));
+    ASSERT_TRUE(full.get("u1", info, loader_of("full")));   // 不会读到精简投影
+    EXPECT_EQ(info.nickname, "full");
+
+    full.invalidate("u1");                                   // 一次失效清掉全部投影
+    EXPECT_FALSE(redis->get(std::string(chatnow::key::kUserInfo) + "u1"));
+    EXPECT_FALSE(redis->get(std::string(chatnow::key::kUserBrief) + "u1"));
+}
+
+TEST(UserInfoCache, LoaderFailureReturnsFalse) {
+    Cache cache(make_redis());
+    Cache::Loader loader = [](const std::vector<std::string> &,
+                              std::unordered_map<std::string, FakeInfo> &) { return false; };
+    FakeInfo info;
+    EXPECT_FALSE(cache.get("u1", info, loader));
+}
+
+TEST(UserInfoCache, LeaderFailureReachesFollowers) {
+    Cache cache(make_redis());
+    std::atomic<int> loads {0};
+    std::atomic<bool> go {false};
+    Cache::Loader loader = [&](const std::vector<std::string> &,
+                               std::unordered_map<std::string, FakeInfo> &) {
+        ++loads;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));     // 让其它调用方排成 follower
+        return false;
+    };
+    std::vector<std::thread> ts;
+    std::atomic<int> succeeded {0};
+    for(int i = 0; i < 8; ++i) {
+        ts.emplace_back([&]() {
+            while(!go.load()) std::this_thread::yield();
+            FakeInfo info;
+            if(cache.get("u1", info, loader)) ++succeeded;
+        });
+    }
+    go = true;
+    for(auto &t : ts) t.join();
+    EXPECT_LT(loads.load(), 8);                  // 并发 miss 已合并
+    EXPECT_EQ(succeeded.load(), 0);              // follower 同样报告失败，而非"用户不存在"
+}
+
+TEST(UserInfoCache, L1IsBoundedByBytes) {
+    auto redis = make_redis();
+    Cache cache(redis, 4096);
+    const std::string avatar(1000, 'a');         // 模拟含头像字节的完整资料
+    Cache::Loader loader = [&](const std::vector<std::string> &uids,
+                               std::unordered_map<std::string, FakeInfo> &out) {
+        for(const auto &u : uids) out[u] = FakeInfo{u, avatar};
+        return true;
+    };
+    std::unordered_map<std::string, FakeInfo> res;
+    ASSERT_TRUE(cache.get_many({"u1", "u2", "u3", "u4", "u5", "u6", "u7", "u8"}, res, loader));
+    EXPECT_EQ(res.size(), 8u);
+    EXPECT_LE(cache.l1_bytes(), 4096u);
+    EXPECT_LT(cache.l1_size(), 8u);
+}
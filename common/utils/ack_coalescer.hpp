@@ -0,0 +1,110 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * AckCoalescer —— 送达游标合并（按 (uid, ssid) 只保留最大 seq）
+ * ---------------------------------------------------------------------------
+ * 背景：客户端每收到一条消息回一次 MSG_PUSH_ACK，逐条上报 last_ack_seq
+ *      就是逐条 RPC + 逐条 UPDATE，而游标只会向前推进，中间值没有意义
+ *
+ * 设计要点：
+ *   1. 按 uid 哈希分 kShards 片，每片一把锁；add() 只做一次 map 查找 + 取 max
+ *   2. drain() 由定时刷写线程调用，一次取走至多 max 条（起始分片轮转，避免饿死）
+ *   3. 刷写失败 restore() 放回：与期间新到的 ACK 取最大值，下一轮重试；
+ *      下游按 GREATEST 单调推进，重复提交是幂等的
+ * ===========================================================================
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace chatnow
+{
+
+class AckCoalescer
+{
+public:
+    static constexpr size_t kShards = 16;
+
+    struct Cursor {
+        std::string uid;
+        std::string ssid;
+        uint64_t seq {0};
+    };
+
+    AckCoalescer() = default;
+    AckCoalescer(const AckCoalescer &) = delete;
+    AckCoalescer &operator=(const AckCoalescer &) = delete;
+
+    /* brief: 记录一次 ACK；同 (uid, ssid) 只保留最大 seq */
+    void add(const std::string &uid, const std::string &ssid, uint64_t seq) {
+        auto &shard = _shard(uid);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto &c = shard.map[_key(uid, ssid)];
+        if(c.seq == 0) {
+            c.uid = uid;
+            c.ssid = ssid;
+        }
+        c.seq = std::max(c.seq, seq);
+    }
+
+    /* brief: 取走至多 max 条待刷写游标（max = 0 表示全部） */
+    std::vector<Cursor> drain(size_t max = 0) {
+        std::vector<Cursor> res;
+        size_t start = _next;
+        for(size_t i = 0; i < kShards; ++i) {
+            auto &shard = _shards[(start + i) % kShards];
+            std::lock_guard<std::mutex> lk(shard.mu);
+            for(auto it = shard.map.begin(); it != shard.map.end();) {
+                if(max != 0 && res.size() >= max) {
+                    _next = (start + i) % kShards;
+                    return res;
+                }
+                res.push_back(std::move(it->second));
+                it = shard.map.erase(it);
+            }
+        }
+        _next = (start + 1) % kShards;
+        return res;
+    }
+
+    /* brief: 刷写失败放回（与期间新到的 ACK 合并取最大） */
+    void restore(const std::vector<Cursor> &cursors) {
+        for(const auto &c : cursors) add(c.uid, c.ssid, c.seq);
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for(const auto &shard : _shards) {
+            std::lock_guard<std::mutex> lk(shard.mu);
+            n += shard.map.size();
+        }
+        return n;
+    }
+
+private:
+    struct Shard {
+        mutable std::mutex mu;
+        std::unordered_map<std::string, Cursor> map;
+    };
+
+    static std::string _key(const std::string &uid, const std::string &ssid) {
+        std::string k;
+        k.reserve(uid.size() + ssid.size() + 1);
+        k.append(uid).push_back('\n');
+        k.append(ssid);
+        return k;
+    }
+    Shard &_shard(const std::string &uid) { return _shards[std::hash<std::string>{}(uid) % kShards]; }
+
+    Shard _shards[kShards];
+    size_t _next {0};   // 仅刷写线程读写
+};
+
+} // namespace chatnow
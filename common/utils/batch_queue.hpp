@@ -0,0 +1,155 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * BatchQueue —— 按 key 分道的攒批队列（group commit）
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. N 条 lane，每条 lane 一个缓冲 + 一个专属 flush 线程；
+ *      item 按 key 哈希落到固定 lane，同 key 的 item 按提交顺序进入同一批或后续批
+ *   2. 触发 flush 的两个条件（先到先触发）：
+ *      - 缓冲达到 max_batch 条
+ *      - 批内第一条入队已满 max_delay
+ *   3. flush 回调在 lane 线程执行，同一 lane 的批严格串行；
+ *      回调内异常被吞掉并打日志 —— 需要逐条兜底的调用方应自行 try/catch
+ *   4. stop()：不再接收新 item，已入队的全部 flush 完再退出（排空语义，
+ *      与 ShardedExecutor 的丢弃语义不同：item 通常持有待 ack 的投递）
+ * ===========================================================================
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "infra/logger.hpp"
+
+namespace chatnow
+{
+
+template <typename T>
+class BatchQueue
+{
+public:
+    using ptr     = std::shared_ptr<BatchQueue<T>>;
+    using FlushFn = std::function<void(std::vector<T>&)>;
+
+    BatchQueue(size_t lanes, size_t max_batch, std::chrono::milliseconds max_delay,
+               FlushFn flush, const std::string &name = "batch")
+        : _name(name), _max_batch(max_batch == 0 ? 1 : max_batch),
+          _max_delay(max_delay), _flush(std::move(flush))
+    {
+        if(lanes == 0) lanes = 1;
+        _lanes.reserve(lanes);
+        for(size_t i = 0; i < lanes; ++i) {
+            _lanes.emplace_back(std::make_unique<Lane>());
+        }
+        for(size_t i = 0; i < lanes; ++i) {
+            Lane *l = _lanes[i].get();
+            l->worker = std::thread([this, l]() { _run(l); });
+        }
+    }
+    ~BatchQueue() { stop(); }
+
+    BatchQueue(const BatchQueue &) = delete;
+    BatchQueue &operator=(const BatchQueue &) = delete;
+
+    size_t lanes() const { return _lanes.size(); }
+    size_t max_batch() const { return _max_batch; }
+
+    /* brief: 按 key 入队；已 stop 返回 false（item 不会被 flush） */
+    bool submit(std::string_view key, T item) {
+        if(_stopped.load(std::memory_order_acquire)) return false;
+        Lane *l = _lanes[std::hash<std::string_view>{}(key) % _lanes.size()].get();
+        bool wake = false;
+        {
+            std::lock_guard<std::mutex> lk(l->mu);
+            if(l->stopping) return false;
+            if(l->buf.empty()) {
+                l->first_at = std::chrono::steady_clock::now();
+                wake = true;                         // 空 → 非空：唤醒以开始计时
+            }
+            l->buf.push_back(std::move(item));
+            if(l->buf.size() >= _max_batch) wake = true;   // 攒满：立即 flush
+        }
+        if(wake) l->cv.notify_one();
+        return true;
+    }
+
+    /* brief: 当前缓冲（未 flush）的 item 总数 */
+    size_t pending() const {
+        size_t n = 0;
+        for(const auto &l : _lanes) {
+            std::lock_guard<std::mutex> lk(l->mu);
+            n += l->buf.size();
+        }
+        return n;
+    }
+
+    /* brief: 停止接收并排空；幂等。返回前所有已入队 item 都已交给 flush 回调 */
+    void stop() {
+        if(_stopped.exchange(true)) return;
+        for(auto &l : _lanes) {
+            std::lock_guard<std::mutex> lk(l->mu);
+            l->stopping = true;
+            l->cv.notify_all();
+        }
+        for(auto &l : _lanes) {
+            if(l->worker.joinable()) l->worker.join();
+        }
+    }
+
+private:
+    struct Lane {
+        mutable std::mutex mu;
+        std::condition_variable cv;
+        std::vector<T> buf;
+        std::chrono::steady_clock::time_point first_at;
+        bool stopping {false};
+        std::thread worker;
+    };
+
+    void _run(Lane *l) {
+        std::unique_lock<std::mutex> lk(l->mu);
+        while(true) {
+            l->cv.wait(lk, [l]() { return l->stopping || !l->buf.empty(); });
+            if(l->buf.empty()) return;                 // stopping 且已排空
+            // 未满且未到期 → 继续攒；stop 时不再等待，直接 flush
+            l->cv.wait_until(lk, l->first_at + _max_delay, [this, l]() {
+                return l->stopping || l->buf.size() >= _max_batch;
+            });
+            std::vector<T> batch;
+            if(l->buf.size() <= _max_batch) {
+                batch.swap(l->buf);
+            } else {
+                batch.reserve(_max_batch);
+                for(size_t i = 0; i < _max_batch; ++i) batch.push_back(std::move(l->buf[i]));
+                l->buf.erase(l->buf.begin(), l->buf.begin() + _max_batch);
+                l->first_at = std::chrono::steady_clock::now();
+            }
+            lk.unlock();
+            try {
+                _flush(batch);
+            } catch(const std::exception &e) {
+                LOG_ERROR("BatchQueue[{}] flush 异常 size={}: {}", _name, batch.size(), e.what());
+            } catch(...) {
+                LOG_ERROR("BatchQueue[{}] flush 发生未知异常 size={}", _name, batch.size());
+            }
+            lk.lock();
+        }
+    }
+
+    std::string _name;
+    size_t _max_batch;
+    std::chrono::milliseconds _max_delay;
+    FlushFn _flush;
+    std::atomic<bool> _stopped {false};
+    std::vector<std::unique_ptr<Lane>> _lanes;
+};
+
+} // namespace chatnow
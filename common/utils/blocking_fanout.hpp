@@ -0,0 +1,83 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * BlockingFanout —— 在 bthread 内并发执行一组阻塞调用（Redis 等同步客户端）
+ * ---------------------------------------------------------------------------
+ * 背景：redis++ 是同步客户端，在 brpc handler 里直接调用会卡住整个 worker pthread，
+ *      且多个互不依赖的查询只能串行
+ *
+ * 设计要点：
+ *   1. 阻塞调用投递到专用线程池（ShardedExecutor），发起方 bthread 在
+ *      bthread::CountdownEvent 上等待：等待基于 butex，只挂起当前 bthread，
+ *      brpc worker 继续调度其他请求
+ *   2. 同一批任务依次落到相邻 shard（起点全局轮转），互不排队，
+ *      总耗时 ≈ 最慢的一个而非之和
+ *   3. pool 为空或已 stop 时就地执行，行为退化为串行调用
+ *   4. 任务异常被吞掉并打日志（与 ShardedExecutor 一致），计数照常递减，不会卡死等待方；
+ *      析构时隐式 wait()，任务引用发起方栈上变量是安全的
+ * ===========================================================================
+ */
+
+#include "utils/sharded_executor.hpp"
+#include "infra/logger.hpp"
+
+#include <bthread/countdown_event.h>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+
+namespace chatnow
+{
+
+class BlockingFanout
+{
+public:
+    explicit BlockingFanout(ShardedExecutor *pool)
+        : _pool(pool), _ev(0), _next(_pool ? _rr().fetch_add(1, std::memory_order_relaxed) : 0) {}
+    ~BlockingFanout() { wait(); }
+
+    BlockingFanout(const BlockingFanout &) = delete;
+    BlockingFanout &operator=(const BlockingFanout &) = delete;
+
+    /* brief: 投递一个阻塞任务 */
+    void run(std::function<void()> fn) {
+        if(_pool) {
+            _ev.add_count(1);
+            auto ev = &_ev;
+            auto task = std::make_shared<std::function<void()>>(std::move(fn));
+            if(_pool->submit_to(_next++, [ev, task]() { _invoke(*task); ev->signal(); })) return;
+            _ev.signal();
+            fn = std::move(*task);
+        }
+        _invoke(fn);
+    }
+
+    /* brief: 等待已投递的任务全部结束；可重复调用，之后可继续 run 下一批 */
+    void wait() { _ev.wait(); }
+
+private:
+    static std::atomic<size_t> &_rr() {
+        static std::atomic<size_t> rr {0};
+        return rr;
+    }
+
+    static void _invoke(const std::function<void()> &fn) {
+        try {
+            fn();
+        } catch(const std::exception &e) {
+            LOG_ERROR("BlockingFanout 任务异常: {}", e.what());
+        } catch(...) {
+            LOG_ERROR("BlockingFanout 任务发生未知异常");
+        }
+    }
+
+    ShardedExecutor *_pool;
+    bthread::CountdownEvent _ev;
+    size_t _next;
+};
+
+} // namespace chatnow
@@ -0,0 +1,122 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * ByteLruCache —— 按字节数限额的线程安全 LRU
+ * ---------------------------------------------------------------------------
+ * 与 LruCache 的区别：容量按调用方申报的字节数计，而不是条目数；
+ * 适合值大小差异悬殊的场景（如推送帧：文本几十字节、富文本 / 卡片消息数 KB）
+ *
+ * 设计要点：
+ *   1. list + unordered_map；get / put 均 O(1)，命中即移到表头
+ *   2. put 时申报本条字节数，累计超出 capacity_bytes 就从表尾淘汰，直到回落到限额内；
+ *      单条超过总限额的直接拒收（否则会把整个缓存冲空）
+ *   3. 单把互斥锁；值类型建议用 shared_ptr<const T>，get 只拷指针
+ * ===========================================================================
+ */
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace chatnow
+{
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ByteLruCache
+{
+public:
+    explicit ByteLruCache(size_t capacity_bytes)
+        : _capacity(capacity_bytes == 0 ? 1 : capacity_bytes) {}
+
+    ByteLruCache(const ByteLruCache &) = delete;
+    ByteLruCache &operator=(const ByteLruCache &) = delete;
+
+    /* brief: 命中返回 true 并拷出值 */
+    bool get(const K &key, V &out) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _index.find(key);
+        if(it == _index.end()) return false;
+        _items.splice(_items.begin(), _items, it->second);
+        out = it->second->value;
+        return true;
+    }
+
+    /* brief: 写入 / 覆盖；bytes 为本条占用的字节数。单条超过总限额时拒收并返回 false */
+    bool put(const K &key, V value, size_t bytes) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _index.find(key);
+        if(bytes > _capacity) {
+            if(it != _index.end()) _erase(it);
+            return false;
+        }
+        if(it != _index.end()) {
+            _bytes -= it->second->bytes;
+            it->second->value = std::move(value);
+            it->second->bytes = bytes;
+            _items.splice(_items.begin(), _items, it->second);
+        } else {
+            _items.push_front(Item{key, std::move(value), bytes});
+            _index.emplace(key, _items.begin());
+        }
+        _bytes += bytes;
+        while(_bytes > _capacity) {
+            _bytes -= _items.back().bytes;
+            _index.erase(_items.back().key);
+            _items.pop_back();
+        }
+        return true;
+    }
+
+    bool erase(const K &key) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _index.find(key);
+        if(it == _index.end()) return false;
+        _erase(it);
+        return true;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lk(_mu);
+        _index.clear();
+        _items.clear();
+        _bytes = 0;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lk(_mu);
+        return _items.size();
+    }
+    /* brief: 当前已占用字节数（按 put 申报值累计） */
+    size_t bytes() const {
+        std::lock_guard<std::mutex> lk(_mu);
+        return _bytes;
+    }
+    size_t capacity_bytes() const { return _capacity; }
+
+private:
+    struct Item {
+        K key;
+        V value;
+        size_t bytes;
+    };
+    using ItemList = std::list<Item>;
+    using Index = std::unordered_map<K, typename ItemList::iterator, Hash>;
+
+    void _erase(typename Index::iterator it) {
+        _bytes -= it->second->bytes;
+        _items.erase(it->second);
+        _index.erase(it);
+    }
+
+    const size_t _capacity;
+    mutable std::mutex _mu;
+    ItemList _items;                                          // 表头 = 最近访问
+    Index _index;
+    size_t _bytes {0};
+};
+
+} // namespace chatnow
@@ -0,0 +1,220 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * ConnRegistry —— 分段锁长连接表（uid ↔ conn 双索引）
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. 两个索引各自按 key 哈希分到 kShards 个段，每段一把 shared_mutex：
+ *        - uid 段：uid → [Target{conn, slot}]        推送按 uid 查
+ *        - conn 段：conn → slot                      WS 回调按 conn 查
+ *      任何时刻最多持有一把段锁，不存在锁顺序问题
+ *   2. Slot 为每连接共享状态：uid / ssid / device_id 只读，
+ *      last_active 为 atomic，发送锁 send_mu 与 slot 同生命周期；
+ *      targets(uid) 一次查找同时拿到连接与其发送锁
+ *   3. touch()（心跳）只取 conn 段的共享锁 + 原子写时间戳，不与推送互斥
+ *   4. 两个索引非原子联动：insert 先 conn 后 uid，remove 先 conn 后 uid；
+ *      中间窗口内推送可能多拿到一个刚摘除的连接，由调用方检查连接状态兜底；
+ *      insert 收尾复查 conn 索引，与并发 remove 交错时补删 uid 索引
+ *   5. reap() 逐段共享锁扫描收集过期项，再逐个 remove（remove 内复查时间戳），
+ *      不会长时间独占整表
+ * ===========================================================================
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chatnow
+{
+
+template <typename ConnPtr>
+class ConnRegistry
+{
+public:
+    struct Slot {
+        std::string uid;
+        std::string ssid;
+        std::string device_id;
+        std::atomic<long> last_active {0};
+        // websocketpp::connection::send 非线程安全：同一 conn 的所有发送方共享此锁
+        std::mutex send_mu;
+    };
+    using SlotPtr = std::shared_ptr<Slot>;
+
+    struct Target {
+        ConnPtr conn;
+        SlotPtr slot;
+    };
+
+    static constexpr size_t kShards = 64;
+
+    void insert(const ConnPtr &conn, const std::string &uid,
+                const std::string &ssid, const std::string &device_id) {
+        auto slot = std::make_shared<Slot>();
+        slot->uid = uid;
+        slot->ssid = ssid;
+        slot->device_id = device_id;
+        slot->last_active.store(now_sec(), std::memory_order_relaxed);
+        SlotPtr replaced;
+        {
+            auto &s = _conn_shard(conn);
+            std::unique_lock<std::shared_mutex> lk(s.mu);
+            auto &cur = s.map[conn];
+            replaced = std::move(cur);
+            cur = slot;
+        }
+        // 同一 conn 重复鉴权：先从旧 uid 下摘除
+        if(replaced) _uid_erase(replaced->uid, conn);
+        {
+            auto &s = _uid_shard(uid);
+            std::unique_lock<std::shared_mutex> lk(s.mu);
+            s.map[uid].push_back(Target{conn, slot});
+        }
+        // 与并发 remove 交错时 conn 索引可能已摘除，此时补删 uid 索引，避免残留
+        if(this->slot(conn) != slot) _uid_erase(uid, conn);
+    }
+
+    /* brief: 取 uid 在本实例的全部连接及其发送锁（一次段查找） */
+    std::vector<Target> targets(const std::string &uid) const {
+        auto &s = _uid_shard(uid);
+        std::shared_lock<std::shared_mutex> lk(s.mu);
+        auto it = s.map.find(uid);
+        if(it == s.map.end()) return {};
+        return it->second;
+    }
+
+    SlotPtr slot(const ConnPtr &conn) const {
+        auto &s = _conn_shard(conn);
+        std::shared_lock<std::shared_mutex> lk(s.mu);
+        auto it = s.map.find(conn);
+        return it == s.map.end() ? nullptr : it->second;
+    }
+
+    /* brief: 心跳续期；仅共享锁 */
+    bool touch(const ConnPtr &conn) {
+        auto &s = _conn_shard(conn);
+        std::shared_lock<std::shared_mutex> lk(s.mu);
+        auto it = s.map.find(conn);
+        if(it == s.map.end()) return false;
+        it->second->last_active.store(now_sec(), std::memory_order_relaxed);
+        return true;
+    }
+
+    /* brief: 摘除连接；返回被摘除的 slot（不存在返回 nullptr） */
+    SlotPtr remove(const ConnPtr &conn) { return _remove_if(conn, -1); }
+
+    std::vector<std::string> online_uids() const {
+        std::vector<std::string> res;
+        for(const auto &s : _uid_shards) {
+            std::shared_lock<std::shared_mutex> lk(s.mu);
+            for(const auto &p : s.map) res.push_back(p.first);
+        }
+        return res;
+    }
+
+    /* brief: 清理 ttl_sec 内无心跳的连接，返回 (uid, conn) */
+    std::vector<std::pair<std::string, ConnPtr>> reap(long ttl_sec) {
+        std::vector<std::pair<std::string, ConnPtr>> reaped;
+        long now = now_sec();
+        for(auto &s : _conn_shards) {
+            std::vector<ConnPtr> expired;
+            {
+                std::shared_lock<std::shared_mutex> lk(s.mu);
+                for(const auto &p : s.map) {
+                    if(now - p.second->last_active.load(std::memory_order_relaxed) > ttl_sec)
+                        expired.push_back(p.first);
+                }
+            }
+            for(const auto &conn : expired) {
+                auto slot = _remove_if(conn, now - ttl_sec);
+                if(slot) reaped.emplace_back(slot->uid, conn);
+            }
+        }
+        return reaped;
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for(const auto &s : _conn_shards) {
+            std::shared_lock<std::shared_mutex> lk(s.mu);
+            n += s.map.size();
+        }
+        return n;
+    }
+
+    static long now_sec() {
+        using namespace std::chrono;
+        return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    struct ConnHash {
+        size_t operator()(const ConnPtr &c) const {
+            // 指针低位恒为 0，乘法散列打散后取高位分段更均匀
+            return static_cast<size_t>(reinterpret_cast<uintptr_t>(c.get()) * 0x9E3779B97F4A7C15ull);
+        }
+    };
+    struct UidShard {
+        mutable std::shared_mutex mu;
+        std::unordered_map<std::string, std::vector<Target>> map;
+    };
+    struct ConnShard {
+        mutable std::shared_mutex mu;
+        std::unordered_map<ConnPtr, SlotPtr, ConnHash> map;
+    };
+
+    UidShard &_uid_shard(const std::string &uid) const {
+        return _uid_shards[std::hash<std::string>{}(uid) % kShards];
+    }
+    ConnShard &_conn_shard(const ConnPtr &conn) const {
+        return _conn_shards[(ConnHash{}(conn) >> 32) % kShards];
+    }
+
+    /* brief: last_active <= deadline 才摘除；deadline < 0 表示无条件 */
+    SlotPtr _remove_if(const ConnPtr &conn, long deadline) {
+        SlotPtr slot;
+        {
+            auto &s = _conn_shard(conn);
+            std::unique_lock<std::shared_mutex> lk(s.mu);
+            auto it = s.map.find(conn);
+            if(it == s.map.end()) return nullptr;
+            if(deadline >= 0 && it->second->last_active.load(std::memory_order_relaxed) > deadline)
+                return nullptr;     // 扫描后又收到心跳
+            slot = std::move(it->second);
+            s.map.erase(it);
+        }
+        _uid_erase(slot->uid, conn);
+        return slot;
+    }
+
+    void _uid_erase(const std::string &uid, const ConnPtr &conn) {
+        auto &s = _uid_shard(uid);
+        std::unique_lock<std::shared_mutex> lk(s.mu);
+        auto it = s.map.find(uid);
+        if(it == s.map.end()) return;
+        auto &vec = it->second;
+        for(size_t i = 0; i < vec.size(); ++i) {
+            if(vec[i].conn == conn) {
+                if(i + 1 != vec.size()) vec[i] = std::move(vec.back());
+                vec.pop_back();
+                break;
+            }
+        }
+        if(vec.empty()) s.map.erase(it);
+    }
+
+    mutable UidShard  _uid_shards[kShards];
+    mutable ConnShard _conn_shards[kShards];
+};
+
+} // namespace chatnow
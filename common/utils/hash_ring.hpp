@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * HashRing —— 带虚拟节点的一致性哈希环
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. 每个节点按 "node#i" 放 kVnodes 个虚拟点，节点增删只迁移约 1/N 的 key
+ *   2. 哈希固定为 FNV-1a 64 + murmur 末端混合：不依赖 std::hash 的实现，
+ *      gateway（选路）与 transmite（判断归属）在不同进程里算出同一结果
+ *   3. 非线程安全，由持有者加锁（ServiceChannel 内与节点表同锁）
+ * ===========================================================================
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace chatnow
+{
+
+class HashRing
+{
+public:
+    static constexpr int kVnodes = 160;
+
+    void add(const std::string &node) {
+        for(int i = 0; i < kVnodes; ++i) _ring[hash(node + "#" + std::to_string(i))] = node;
+    }
+
+    void remove(const std::string &node) {
+        for(int i = 0; i < kVnodes; ++i) {
+            auto it = _ring.find(hash(node + "#" + std::to_string(i)));
+            if(it != _ring.end() && it->second == node) _ring.erase(it);
+        }
+    }
+
+    /* brief: key 顺时针遇到的第一个节点；空环返回空串 */
+    const std::string &locate(const std::string &key) const {
+        static const std::string kEmpty;
+        if(_ring.empty()) return kEmpty;
+        auto it = _ring.lower_bound(hash(key));
+        if(it == _ring.end()) it = _ring.begin();
+        return it->second;
+    }
+
+    bool empty() const { return _ring.empty(); }
+
+    static uint64_t hash(const std::string &s) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for(unsigned char c : s) {
+            h ^= c;
+            h *= 0x100000001b3ull;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    std::map<uint64_t, std::string> _ring;
+};
+
+} // namespace chatnow
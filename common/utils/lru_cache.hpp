@@ -0,0 +1,117 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * LruCache —— 线程安全的进程内 LRU（可选 TTL）
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. list + unordered_map 经典实现；get / put 均 O(1)，命中即移到表头
+ *   2. 容量按条目数计；超出时淘汰表尾（最久未访问）
+ *   3. ttl > 0 时条目写入后 ttl 到期，get 命中过期条目视为 miss 并顺手删除；
+ *      ttl == 0 表示不过期，新鲜度由调用方自行判断（如 UserInfoCache 的版本校验）
+ *   4. 单把互斥锁；值类型建议用 shared_ptr<const T>，避免在锁内深拷贝大对象
+ * ===========================================================================
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace chatnow
+{
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+class LruCache
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LruCache(size_t capacity,
+                      std::chrono::milliseconds ttl = std::chrono::milliseconds::zero())
+        : _capacity(capacity == 0 ? 1 : capacity), _ttl(ttl) {}
+
+    LruCache(const LruCache &) = delete;
+    LruCache &operator=(const LruCache &) = delete;
+
+    /* brief: 命中（且未过期）返回 true 并拷出值 */
+    bool get(const K &key, V &out) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _index.find(key);
+        if(it == _index.end()) return false;
+        if(_expired(*it->second)) {
+            _items.erase(it->second);
+            _index.erase(it);
+            return false;
+        }
+        _items.splice(_items.begin(), _items, it->second);
+        out = it->second->value;
+        return true;
+    }
+
+    /* brief: 写入 / 覆盖，使用构造时的默认 ttl */
+    void put(const K &key, V value) { put(key, std::move(value), _ttl); }
+
+    /* brief: 写入 / 覆盖，指定本条 ttl（0 = 不过期） */
+    void put(const K &key, V value, std::chrono::milliseconds ttl) {
+        Clock::time_point expire_at = ttl.count() > 0 ? Clock::now() + ttl : Clock::time_point::max();
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _index.find(key);
+        if(it != _index.end()) {
+            it->second->value = std::move(value);
+            it->second->expire_at = expire_at;
+            _items.splice(_items.begin(), _items, it->second);
+            return;
+        }
+        _items.push_front(Item{key, std::move(value), expire_at});
+        _index.emplace(key, _items.begin());
+        while(_items.size() > _capacity) {
+            _index.erase(_items.back().key);
+            _items.pop_back();
+        }
+    }
+
+    bool erase(const K &key) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _index.find(key);
+        if(it == _index.end()) return false;
+        _items.erase(it->second);
+        _index.erase(it);
+        return true;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lk(_mu);
+        _index.clear();
+        _items.clear();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lk(_mu);
+        return _items.size();
+    }
+    size_t capacity() const { return _capacity; }
+
+private:
+    struct Item {
+        K key;
+        V value;
+        Clock::time_point expire_at;
+    };
+    using ItemList = std::list<Item>;
+
+    static bool _expired(const Item &item) {
+        return item.expire_at != Clock::time_point::max() && Clock::now() >= item.expire_at;
+    }
+
+    const size_t _capacity;
+    const std::chrono::milliseconds _ttl;
+    mutable std::mutex _mu;
+    ItemList _items;                                          // 表头 = 最近访问
+    std::unordered_map<K, typename ItemList::iterator, Hash> _index;
+};
+
+} // namespace chatnow
@@ -0,0 +1,108 @@
+#pragma once
+
+/**
+ * Protobuf 嵌套 varint 字段拼接（serialize-once）
+ * ---
+ * 群推送时每个收件人的帧只差一个 user_seq：逐人 CopyFrom + set + SerializeAsString
+ * 是 O(成员数 × 消息体) 的深拷贝与编码。这里把模板序列化一次，按收件人在
+ * 最内层子消息末尾追加 "tag + varint"，并重写沿途各层 length 前缀。
+ *
+ * - 依赖 protobuf 解析语义：字段顺序无关，singular 标量字段重复出现时后者覆盖前者
+ * - path 上每一层都必须是 length-delimited（子消息）且在模板中出现；否则 init 失败，
+ *   调用方回退到整包序列化
+ * - 外层 length varint 可能因内层变长而多占 1 字节，逐层向外累积修正
+ * - encode 只读，初始化后可多线程并发调用
+ */
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "utils/pb_wire.hpp"
+
+namespace chatnow::pb_wire {
+
+class VarintSplicer
+{
+public:
+    /* brief: base 为模板序列化结果；path 为外→内的子消息字段号；field 为要追加的 varint 字段号 */
+    bool init(std::string base, const std::vector<uint32_t> &path, uint32_t field) {
+        _base = std::move(base);
+        _levels.clear();
+        _ok = false;
+        if(path.size() > kMaxDepth) return false;
+        std::string_view cur = _base;
+        for(uint32_t f : path) {
+            size_t len_pos = 0;
+            std::string_view inner;
+            if(!find_bytes_at(cur, f, len_pos, inner)) return false;
+            size_t off = static_cast<size_t>(cur.data() - _base.data());
+            Level lv;
+            lv.len_pos = off + len_pos;
+            lv.begin   = static_cast<size_t>(inner.data() - _base.data());
+            lv.end     = lv.begin + inner.size();
+            _levels.push_back(lv);
+            cur = inner;
+        }
+        _tag.clear();
+        append_varint(_tag, (static_cast<uint64_t>(field) << 3) | kWireVarint);
+        _ok = true;
+        return true;
+    }
+
+    bool ok() const { return _ok; }
+    /* brief: 不含追加字段的原始编码（无 user_seq 的收件人直接用） */
+    const std::string &base() const { return _base; }
+
+    /* brief: 生成追加了 field = value 的完整编码 */
+    std::string encode(uint64_t value) const {
+        std::string out;
+        encode_to(value, out);
+        return out;
+    }
+
+    void encode_to(uint64_t value, std::string &out) const {
+        out.clear();
+        if(!_ok) { out = _base; return; }
+        // 由内向外计算各层新长度
+        size_t n = _levels.size();
+        uint64_t grow = _tag.size() + varint_size(value);
+        uint64_t new_len[kMaxDepth];
+        for(size_t i = n; i-- > 0;) {
+            uint64_t old_len = _levels[i].end - _levels[i].begin;
+            new_len[i] = old_len + grow;
+            grow += varint_size(new_len[i]) - varint_size(old_len);
+        }
+        out.reserve(_base.size() + grow);
+        std::string_view b = _base;
+        size_t pos = 0;
+        for(size_t i = 0; i < n; ++i) {
+            out.append(b.substr(pos, _levels[i].len_pos - pos));
+            append_varint(out, new_len[i]);
+            pos = _levels[i].begin;
+        }
+        size_t inner_end = n > 0 ? _levels[n - 1].end : b.size();
+        out.append(b.substr(pos, inner_end - pos));
+        out.append(_tag);
+        append_varint(out, value);
+        for(size_t i = n; i-- > 0;) {
+            size_t stop = i > 0 ? _levels[i - 1].end : b.size();
+            out.append(b.substr(_levels[i].end, stop - _levels[i].end));
+        }
+    }
+
+private:
+    static constexpr size_t kMaxDepth = 8;
+    struct Level {
+        size_t len_pos;     // 该层字段长度 varint 的偏移
+        size_t begin;       // 子消息内容起止
+        size_t end;
+    };
+
+    std::string _base;
+    std::string _tag;
+    std::vector<Level> _levels;
+    bool _ok {false};
+};
+
+}  // namespace chatnow::pb_wire
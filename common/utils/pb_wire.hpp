@@ -0,0 +1,117 @@
+#pragma once
+
+/**
+ * Protobuf wire-format 轻量读取
+ * ---
+ * 只扫描字段 tag，不做完整反序列化：用于在 MQ ev 线程上从 payload 中
+ * 快速取出分片键（如 InternalMessage.message_info.chat_session_id），
+ * 避免为了一个字符串把整条消息 ParseFromArray 两遍。
+ *
+ * - 支持 wire type 0(varint) / 1(fixed64) / 2(length-delimited) / 5(fixed32)
+ * - group(3/4) 已废弃，遇到视为解析失败
+ * - 同一字段出现多次时取第一次出现（分片键都是 singular 字段）
+ */
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace chatnow::pb_wire {
+
+inline constexpr uint32_t kWireVarint  = 0;
+inline constexpr uint32_t kWireFixed64 = 1;
+inline constexpr uint32_t kWireLen     = 2;
+inline constexpr uint32_t kWireFixed32 = 5;
+
+/* brief: 读一个 base-128 varint；成功后 pos 前移 */
+inline bool read_varint(std::string_view data, size_t &pos, uint64_t &value) {
+    value = 0;
+    for(int shift = 0; shift < 64; shift += 7) {
+        if(pos >= data.size()) return false;
+        uint8_t b = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+/* brief: 追加一个 base-128 varint 到 out */
+inline void append_varint(std::string &out, uint64_t value) {
+    while(value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/* brief: varint 编码后的字节数 */
+inline size_t varint_size(uint64_t value) {
+    size_t n = 1;
+    while(value >= 0x80) { value >>= 7; ++n; }
+    return n;
+}
+
+/* brief: 在 data 顶层查找 field 号为 field 的 length-delimited 字段，返回其内容视图；
+ *  len_pos 为该字段长度 varint 在 data 中的起始偏移（原地改写长度时用）
+ */
+inline bool find_bytes_at(std::string_view data, uint32_t field,
+                          size_t &len_pos, std::string_view &out) {
+    size_t pos = 0;
+    while(pos < data.size()) {
+        uint64_t tag = 0;
+        if(!read_varint(data, pos, tag)) return false;
+        uint32_t num  = static_cast<uint32_t>(tag >> 3);
+        uint32_t type = static_cast<uint32_t>(tag & 0x7);
+        switch(type) {
+            case kWireVarint: {
+                uint64_t skip = 0;
+                if(!read_varint(data, pos, skip)) return false;
+                break;
+            }
+            case kWireFixed64:
+                if(data.size() - pos < 8) return false;
+                pos += 8;
+                break;
+            case kWireFixed32:
+                if(data.size() - pos < 4) return false;
+                pos += 4;
+                break;
+            case kWireLen: {
+                uint64_t len = 0;
+                size_t at = pos;
+                if(!read_varint(data, pos, len)) return false;
+                if(len > data.size() - pos) return false;
+                if(num == field) {
+                    len_pos = at;
+                    out = data.substr(pos, static_cast<size_t>(len));
+                    return true;
+                }
+                pos += static_cast<size_t>(len);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+/* brief: 在 data 顶层查找 field 号为 field 的 length-delimited 字段，返回其内容视图 */
+inline bool find_bytes(std::string_view data, uint32_t field, std::string_view &out) {
+    size_t len_pos = 0;
+    return find_bytes_at(data, field, len_pos, out);
+}
+
+/* brief: 沿嵌套路径逐层查找，例如 {1, 2} = 顶层字段 1 内的字段 2 */
+inline bool find_bytes_path(std::string_view data, const std::vector<uint32_t> &path,
+                            std::string_view &out) {
+    std::string_view cur = data;
+    for(uint32_t field : path) {
+        if(!find_bytes(cur, field, cur)) return false;
+    }
+    out = cur;
+    return true;
+}
+
+}  // namespace chatnow::pb_wire
@@ -0,0 +1,174 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * RetransmitWindow —— 持连实例上的按用户未确认推送窗口（累计确认）
+ * ---------------------------------------------------------------------------
+ * 背景：原方案每条推送 ZADD + EXPIRE、每个 ACK 一次 ZREM，重传时再 GetOfflineMsg 回查 DB；
+ *      而能重传的只有持有该用户连接的实例，状态放在这里即可
+ *
+ * 设计要点：
+ *   1. uid → {seq → (message_id, 已重发次数)}；ack(uid, N) 表示 "≤ N 全部收到"，
+ *      一次删除前缀，乱序 / 重复 ACK 只会让游标停在最大值
+ *      窗口只做 (user_seq → message_id) 索引，消息体按 message_id 另存一份（群消息 N 个收件人共用）
+ *   2. 每用户最多 max_per_user 条：超出时淘汰最旧项并记 evicted（被淘汰的最大 seq）；
+ *      evicted > acked 说明窗口已无法覆盖，调用方需从 (acked, evicted] 回查消息服务
+ *   3. 窗口不做扫描：重传截止时间由调用方挂在时间轮上，到期时 fire(uid, seq, attempt)
+ *      校验该项仍未确认且重发次数与定时器一致（已确认 / 已被更新的定时器直接作废）
+ *   4. 累计确认游标变化记 dirty，由调用方定时 drain_acked() 批量写 Redis 高水位（故障切换用）；
+ *      用户在本机全部下线时 drop()，返回尚未写出的游标
+ *   5. 按 uid 哈希分 kShards 片，每片一把锁
+ * ===========================================================================
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chatnow
+{
+
+class RetransmitWindow
+{
+public:
+    static constexpr size_t kShards = 64;
+
+    explicit RetransmitWindow(size_t max_per_user = 256)
+        : _max_per_user(max_per_user == 0 ? 1 : max_per_user) {}
+
+    RetransmitWindow(const RetransmitWindow &) = delete;
+    RetransmitWindow &operator=(const RetransmitWindow &) = delete;
+
+    /* brief: 记录一条已下发待确认的推送；seq ≤ 已确认游标的直接忽略。
+     *        返回是否新入窗口（已在窗口内的只更新 message_id，重发次数不变，调用方无需再挂定时器） */
+    bool push(const std::string &uid, uint64_t seq, int64_t message_id) {
+        auto &shard = _shard(uid);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        User &u = shard.users[uid];
+        if(seq <= u.acked) return false;
+        auto ins = u.items.emplace(seq, Entry{});
+        ins.first->second.message_id = message_id;
+        while(u.items.size() > _max_per_user) {
+            auto first = u.items.begin();
+            if(first->first > u.evicted) u.evicted = first->first;
+            u.items.erase(first);
+        }
+        return ins.second && u.items.count(seq) > 0;
+    }
+
+    /* brief: 累计确认 ≤ seq 的全部推送；返回从窗口移除的条数 */
+    size_t ack(const std::string &uid, uint64_t seq) {
+        auto &shard = _shard(uid);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        User &u = shard.users[uid];
+        if(seq <= u.acked) return 0;
+        u.acked = seq;
+        u.dirty = true;
+        auto end = u.items.upper_bound(seq);
+        size_t n = 0;
+        for(auto it = u.items.begin(); it != end; ++n) it = u.items.erase(it);
+        return n;
+    }
+
+    /* brief: 重传定时器到期：该项仍在窗口且重发次数等于 attempt 时计一次重发并取出 message_id；
+     *        否则（已确认 / 已下线 / 过期的旧定时器）返回 false */
+    bool fire(const std::string &uid, uint64_t seq, uint32_t attempt, int64_t &message_id) {
+        auto &shard = _shard(uid);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto it = shard.users.find(uid);
+        if(it == shard.users.end()) return false;
+        auto e = it->second.items.find(seq);
+        if(e == it->second.items.end() || e->second.attempt != attempt) return false;
+        ++e->second.attempt;
+        message_id = e->second.message_id;
+        return true;
+    }
+
+    /* brief: 已确认游标 */
+    uint64_t acked(const std::string &uid) const {
+        auto &shard = _shard(uid);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto it = shard.users.find(uid);
+        return it == shard.users.end() ? 0 : it->second.acked;
+    }
+
+    /* brief: 被淘汰出窗口的最大 seq；大于 acked 时 (acked, evicted] 需回查消息服务 */
+    uint64_t evicted(const std::string &uid) const {
+        auto &shard = _shard(uid);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto it = shard.users.find(uid);
+        return it == shard.users.end() ? 0 : it->second.evicted;
+    }
+
+    /* brief: 回查补齐后收敛 evicted，避免下次心跳重复回查 */
+    void clear_evicted(const std::string &uid, uint64_t upto) {
+        auto &shard = _shard(uid);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto it = shard.users.find(uid);
+        if(it != shard.users.end() && it->second.evicted <= upto) it->second.evicted = 0;
+    }
+
+    /* brief: 取走自上次以来推进过的确认游标 (uid, acked) */
+    std::vector<std::pair<std::string, uint64_t>> drain_acked() {
+        std::vector<std::pair<std::string, uint64_t>> res;
+        for(auto &shard : _shards) {
+            std::lock_guard<std::mutex> lk(shard.mu);
+            for(auto &p : shard.users) {
+                if(!p.second.dirty) continue;
+                p.second.dirty = false;
+                res.emplace_back(p.first, p.second.acked);
+            }
+        }
+        return res;
+    }
+
+    /* brief: 用户在本机已无连接：丢弃窗口；返回尚未写出的确认游标（无则 0） */
+    uint64_t drop(const std::string &uid) {
+        auto &shard = _shard(uid);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto it = shard.users.find(uid);
+        if(it == shard.users.end()) return 0;
+        uint64_t pending = it->second.dirty ? it->second.acked : 0;
+        shard.users.erase(it);
+        return pending;
+    }
+
+    /* brief: 该用户窗口内待确认条数 */
+    size_t size(const std::string &uid) const {
+        auto &shard = _shard(uid);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto it = shard.users.find(uid);
+        return it == shard.users.end() ? 0 : it->second.items.size();
+    }
+
+private:
+    struct Entry {
+        int64_t message_id {0};
+        uint32_t attempt {0};
+    };
+    struct User {
+        std::map<uint64_t, Entry> items;
+        uint64_t acked {0};
+        uint64_t evicted {0};
+        bool dirty {false};
+    };
+    struct Shard {
+        mutable std::mutex mu;
+        std::unordered_map<std::string, User> users;
+    };
+
+    Shard &_shard(const std::string &uid) const {
+        return _shards[std::hash<std::string>{}(uid) % kShards];
+    }
+
+    const size_t _max_per_user;
+    mutable Shard _shards[kShards];
+};
+
+} // namespace chatnow
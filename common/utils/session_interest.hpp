@@ -0,0 +1,135 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * SessionInterest —— 本实例"哪些大群有在线成员"的进程内索引
+ * ---------------------------------------------------------------------------
+ * 背景：读扩散大群每条消息要为全部成员查一遍 OnlineRoute（5000 人群 = 5000 条 Redis 命令），
+ *      而真正有在线成员的 Push 实例只有少数几个
+ *
+ * 设计要点：
+ *   1. uid → {本机连接数, 所在大群}；ssid → 本机在线成员数。只有会话计数 0→1 / 1→0
+ *      时才需要改 Redis 订阅（SessionSubscribers），返回值即需要订阅 / 退订的会话
+ *   2. 首条连接 attach() 返回 true，由调用方异步查询该用户的大群列表后 learn()；
+ *      查询返回前用户已全部断开则 learn() 忽略结果，不会残留计数
+ *   3. 查询失败的用户 learned=false，unlearned() 列出供定时任务重试
+ *   4. sessions() 给定时续约用：列出本机当前有在线成员的全部大群
+ *   5. 查询之后才加入 / 才达到门限的大群由 join() 逐会话补登（收到该会话的逐成员投递时），
+ *      不改变 learned 标记；pending() 为尚未查清的用户数，非 0 时本实例需视为订阅全部大群
+ * ===========================================================================
+ */
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace chatnow
+{
+
+class SessionInterest
+{
+public:
+    SessionInterest() = default;
+    SessionInterest(const SessionInterest &) = delete;
+    SessionInterest &operator=(const SessionInterest &) = delete;
+
+    /* brief: uid 在本机新增一条连接；首条连接返回 true（调用方去查询该用户所在大群） */
+    bool attach(const std::string &uid) {
+        std::lock_guard<std::mutex> lk(_mu);
+        if(++_users[uid].conns > 1) return false;
+        ++_pending;
+        return true;
+    }
+
+    /* brief: 记录 uid 所在大群；返回本机由无到有的会话（需订阅）。uid 已不在本机时忽略 */
+    std::vector<std::string> learn(const std::string &uid, const std::vector<std::string> &ssids) {
+        std::vector<std::string> added;
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _users.find(uid);
+        if(it == _users.end()) return added;
+        User &u = it->second;
+        if(!u.learned) --_pending;
+        u.learned = true;
+        for(const auto &ssid : ssids) {
+            if(!u.ssids.insert(ssid).second) continue;
+            if(++_sessions[ssid] == 1) added.push_back(ssid);
+        }
+        return added;
+    }
+
+    /* brief: 补记 uid 所在的单个大群；本机由无到有时返回 true（需订阅）。uid 已不在本机时忽略 */
+    bool join(const std::string &uid, const std::string &ssid) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _users.find(uid);
+        if(it == _users.end() || !it->second.ssids.insert(ssid).second) return false;
+        return ++_sessions[ssid] == 1;
+    }
+
+    /* brief: uid 在本机断开一条连接；最后一条断开时返回本机由有到无的会话（需退订） */
+    std::vector<std::string> detach(const std::string &uid) {
+        std::vector<std::string> dropped;
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _users.find(uid);
+        if(it == _users.end() || --it->second.conns > 0) return dropped;
+        if(!it->second.learned) --_pending;
+        for(const auto &ssid : it->second.ssids) {
+            auto sit = _sessions.find(ssid);
+            if(sit == _sessions.end()) continue;
+            if(--sit->second == 0) {
+                _sessions.erase(sit);
+                dropped.push_back(ssid);
+            }
+        }
+        _users.erase(it);
+        return dropped;
+    }
+
+    /* brief: 本机当前有在线成员的全部大群（定时续约用） */
+    std::vector<std::string> sessions() const {
+        std::lock_guard<std::mutex> lk(_mu);
+        std::vector<std::string> res;
+        res.reserve(_sessions.size());
+        for(const auto &p : _sessions) res.push_back(p.first);
+        return res;
+    }
+
+    /* brief: 在线但大群列表尚未查到的用户（查询失败待重试） */
+    std::vector<std::string> unlearned() const {
+        std::lock_guard<std::mutex> lk(_mu);
+        std::vector<std::string> res;
+        for(const auto &p : _users) {
+            if(!p.second.learned) res.push_back(p.first);
+        }
+        return res;
+    }
+
+    /* brief: 在线但大群列表尚未查清的用户数（查询中 + 查询失败） */
+    size_t pending() const {
+        std::lock_guard<std::mutex> lk(_mu);
+        return _pending;
+    }
+
+    /* brief: 该会话在本机的在线成员数 */
+    size_t users(const std::string &ssid) const {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _sessions.find(ssid);
+        return it == _sessions.end() ? 0 : it->second;
+    }
+
+private:
+    struct User {
+        size_t conns {0};
+        bool learned {false};
+        std::unordered_set<std::string> ssids;
+    };
+
+    mutable std::mutex _mu;
+    std::unordered_map<std::string, User> _users;
+    std::unordered_map<std::string, size_t> _sessions;
+    size_t _pending {0};
+};
+
+} // namespace chatnow
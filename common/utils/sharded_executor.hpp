@@ -0,0 +1,145 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * ShardedExecutor —— 按 key 分片的串行化线程池
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. N 个 shard，每个 shard 一条独立 FIFO 队列 + 一个专属 worker 线程
+ *   2. 任务按 key 哈希落到固定 shard：同 key 严格按提交顺序串行执行，
+ *      不同 key 分散到不同 shard 并行执行（典型 key = chat_session_id）
+ *   3. 任务内异常在 worker 内吞掉并打日志，不会杀掉 worker 线程；
+ *      需要感知失败的调用方应在任务内自行 try/catch
+ *   4. stop()：不再接收新任务，正在执行的任务跑完，队列中未执行的任务丢弃。
+ *      用于 MQ 消费场景时，被丢弃的投递未 ack，broker 会在连接关闭后重投
+ * ===========================================================================
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "infra/logger.hpp"
+
+namespace chatnow
+{
+
+class ShardedExecutor
+{
+public:
+    using ptr  = std::shared_ptr<ShardedExecutor>;
+    using Task = std::function<void()>;
+
+    explicit ShardedExecutor(size_t shards, const std::string &name = "sharded")
+        : _name(name)
+    {
+        if(shards == 0) shards = 1;
+        _shards.reserve(shards);
+        for(size_t i = 0; i < shards; ++i) {
+            _shards.emplace_back(std::make_unique<Shard>());
+        }
+        for(size_t i = 0; i < shards; ++i) {
+            Shard *s = _shards[i].get();
+            s->worker = std::thread([this, s]() { _run(s); });
+        }
+    }
+    ~ShardedExecutor() { stop(); }
+
+    ShardedExecutor(const ShardedExecutor &) = delete;
+    ShardedExecutor &operator=(const ShardedExecutor &) = delete;
+
+    size_t shards() const { return _shards.size(); }
+
+    /* brief: key → shard 下标；同一 key 永远落在同一 shard */
+    size_t shard_of(std::string_view key) const {
+        return std::hash<std::string_view>{}(key) % _shards.size();
+    }
+
+    /* brief: 按 key 投递任务；已 stop 返回 false（任务不会执行） */
+    bool submit(std::string_view key, Task task) {
+        return submit_to(shard_of(key), std::move(task));
+    }
+
+    /* brief: 直接投递到指定 shard（下标取模） */
+    bool submit_to(size_t shard, Task task) {
+        if(_stopped.load(std::memory_order_acquire)) return false;
+        Shard *s = _shards[shard % _shards.size()].get();
+        {
+            std::lock_guard<std::mutex> lk(s->mu);
+            if(s->stopping) return false;
+            s->tasks.push_back(std::move(task));
+        }
+        s->cv.notify_one();
+        return true;
+    }
+
+    /* brief: 当前排队（未开始执行）的任务总数 — 监控 / 背压判断用 */
+    size_t pending() const {
+        size_t n = 0;
+        for(const auto &s : _shards) {
+            std::lock_guard<std::mutex> lk(s->mu);
+            n += s->tasks.size();
+        }
+        return n;
+    }
+
+    /* brief: 停止所有 worker；幂等。正在执行的任务跑完，未执行的丢弃 */
+    void stop() {
+        if(_stopped.exchange(true)) return;
+        size_t dropped = 0;
+        for(auto &s : _shards) {
+            std::lock_guard<std::mutex> lk(s->mu);
+            s->stopping = true;
+            dropped += s->tasks.size();
+            s->tasks.clear();
+            s->cv.notify_all();
+        }
+        for(auto &s : _shards) {
+            if(s->worker.joinable()) s->worker.join();
+        }
+        if(dropped > 0) {
+            LOG_WARN("ShardedExecutor[{}] 停止，丢弃 {} 个未执行任务", _name, dropped);
+        }
+    }
+
+private:
+    struct Shard {
+        mutable std::mutex mu;
+        std::condition_variable cv;
+        std::deque<Task> tasks;
+        bool stopping {false};
+        std::thread worker;
+    };
+
+    void _run(Shard *s) {
+        while(true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lk(s->mu);
+                s->cv.wait(lk, [s]() { return s->stopping || !s->tasks.empty(); });
+                if(s->stopping) return;
+                task = std::move(s->tasks.front());
+                s->tasks.pop_front();
+            }
+            try {
+                task();
+            } catch(const std::exception &e) {
+                LOG_ERROR("ShardedExecutor[{}] 任务异常: {}", _name, e.what());
+            } catch(...) {
+                LOG_ERROR("ShardedExecutor[{}] 任务发生未知异常", _name);
+            }
+        }
+    }
+
+    std::string _name;
+    std::atomic<bool> _stopped {false};
+    std::vector<std::unique_ptr<Shard>> _shards;
+};
+
+} // namespace chatnow
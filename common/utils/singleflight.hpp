@@ -0,0 +1,125 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * SingleFlight —— 同 key 并发加载合并
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. 缓存 miss 时同一 key 只放一个调用方（leader）去回源，其余调用方
+ *      （follower）等待并共享 leader 的结果，防止热点 key 失效瞬间的回源风暴
+ *   2. 两种用法：
+ *      - run(key, fn)：单 key 便捷接口，leader 执行 fn，异常同样传播给 follower
+ *      - join / done / fail：批量回源用。调用方对一批 key 逐个 join，
+ *        拿到 leader 身份的 key 合并成一次批量加载，再逐个 done
+ *   3. leader 必须对每个 join 到的 key 调用 done 或 fail，否则 follower 永久等待
+ *   4. 结果不缓存：done 之后同 key 的下一次 join 重新选 leader（缓存由调用方负责）
+ *   5. follower 在 bthread::CountdownEvent 上等待：基于 butex，在 brpc handler（bthread）中
+ *      只挂起当前 bthread，不占住 worker pthread；普通 pthread 中等待同样可用
+ * ===========================================================================
+ */
+
+#include <bthread/countdown_event.h>
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace chatnow
+{
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+class SingleFlight
+{
+public:
+    /* brief: leader 结果的共享句柄；可拷贝，多个 follower 各自 get() */
+    class Future
+    {
+    public:
+        Future() = default;
+        /* brief: 等待 leader 提交；fail 时重新抛出同一异常 */
+        const V &get() const {
+            _s->ev.wait();
+            if(_s->err) std::rethrow_exception(_s->err);
+            return _s->value;
+        }
+    private:
+        friend class SingleFlight;
+        struct State {
+            bthread::CountdownEvent ev {1};
+            V value {};
+            std::exception_ptr err;
+        };
+        explicit Future(std::shared_ptr<State> s) : _s(std::move(s)) {}
+        std::shared_ptr<State> _s;
+    };
+
+    struct Ticket {
+        bool leader;
+        Future future;
+    };
+
+    /* brief: 登记对 key 的加载；leader == true 时调用方负责 done / fail */
+    Ticket join(const K &key) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _calls.find(key);
+        if(it != _calls.end()) return Ticket{false, Future(it->second)};
+        auto state = std::make_shared<State>();
+        _calls.emplace(key, state);
+        return Ticket{true, Future(state)};
+    }
+
+    /* brief: leader 提交结果，唤醒所有 follower */
+    void done(const K &key, V value) {
+        auto state = _take(key);
+        if(!state) return;
+        state->value = std::move(value);
+        state->ev.signal();
+    }
+
+    /* brief: leader 回源失败，follower 在 future.get() 处收到同一异常 */
+    void fail(const K &key, std::exception_ptr err) {
+        auto state = _take(key);
+        if(!state) return;
+        state->err = err;
+        state->ev.signal();
+    }
+
+    /* brief: 单 key 便捷接口 */
+    V run(const K &key, const std::function<V()> &fn) {
+        Ticket t = join(key);
+        if(!t.leader) return t.future.get();
+        try {
+            V v = fn();
+            done(key, v);
+            return v;
+        } catch(...) {
+            fail(key, std::current_exception());
+            throw;
+        }
+    }
+
+    size_t inflight() const {
+        std::lock_guard<std::mutex> lk(_mu);
+        return _calls.size();
+    }
+
+private:
+    using State = typename Future::State;
+
+    std::shared_ptr<State> _take(const K &key) {
+        std::lock_guard<std::mutex> lk(_mu);
+        auto it = _calls.find(key);
+        if(it == _calls.end()) return nullptr;
+        auto state = std::move(it->second);
+        _calls.erase(it);
+        return state;
+    }
+
+    mutable std::mutex _mu;
+    std::unordered_map<K, std::shared_ptr<State>, Hash> _calls;
+};
+
+} // namespace chatnow
@@ -0,0 +1,122 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * TimingWheel —— 分层时间轮（定时器只增不删，到期由调用方校验是否仍有效）
+ * ---------------------------------------------------------------------------
+ * 背景：推送重传原来靠心跳逐用户扫描未确认项，开销随连接数增长；
+ *      改为每条待确认推送挂一个截止时间，只有到期的才会被处理
+ *
+ * 设计要点：
+ *   1. kLevels 层、每层 kSlots 个槽；第 l 层一个槽覆盖 kSlots^l 个 tick，
+ *      可表示 tick_ms * kSlots^kLevels 以内的截止时间（更远的按上限截断）
+ *   2. schedule() O(1)：按 (到期 tick - 当前 tick) 选层，按到期 tick 的对应位选槽
+ *   3. advance(now) 逐 tick 推进：跨越第 l 层槽边界时，从高层到低层把该槽的定时器
+ *      按真实到期 tick 重新挂到低层（cascade），再取出第 0 层当前槽全部到期项
+ *   4. 不支持取消：已失效的定时器照常到期，由调用方按业务状态（如是否已确认）丢弃，
+ *      省去每个定时器的反向索引
+ *   5. 单把互斥锁；轮空时 advance 直接跳到目标 tick
+ * ===========================================================================
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace chatnow
+{
+
+template <typename T>
+class TimingWheel
+{
+public:
+    static constexpr size_t kLevels   = 4;
+    static constexpr size_t kSlotBits = 6;
+    static constexpr size_t kSlots    = size_t(1) << kSlotBits;
+
+    TimingWheel(int64_t tick_ms, int64_t now_ms)
+        : _tick_ms(tick_ms <= 0 ? 1 : tick_ms), _current(now_ms / _tick_ms) {
+        for(auto &level : _wheel) level.resize(kSlots);
+    }
+
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel &operator=(const TimingWheel &) = delete;
+
+    /* brief: 挂一个 deadline_ms 到期的定时器；已过期的在下一个 tick 到期 */
+    void schedule(int64_t deadline_ms, T value) {
+        std::lock_guard<std::mutex> lk(_mu);
+        int64_t expire = (deadline_ms + _tick_ms - 1) / _tick_ms;
+        if(expire <= _current) expire = _current + 1;
+        _insert(Timer{expire, std::move(value)});
+        ++_size;
+    }
+
+    /* brief: 推进到 now_ms，把到期定时器追加到 out；返回本次到期条数 */
+    size_t advance(int64_t now_ms, std::vector<T> &out) {
+        std::lock_guard<std::mutex> lk(_mu);
+        int64_t target = now_ms / _tick_ms;
+        size_t fired = 0;
+        while(_current < target) {
+            if(_size == 0) {
+                _current = target;
+                break;
+            }
+            ++_current;
+            _cascade();
+            auto &slot = _wheel[0][_index(_current, 0)];
+            for(auto &t : slot) out.push_back(std::move(t.value));
+            fired += slot.size();
+            _size -= slot.size();
+            slot.clear();
+        }
+        return fired;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lk(_mu);
+        return _size;
+    }
+    int64_t tick_ms() const { return _tick_ms; }
+
+private:
+    struct Timer {
+        int64_t expire;
+        T value;
+    };
+    using Slot = std::vector<Timer>;
+
+    static size_t _index(int64_t tick, size_t level) {
+        return static_cast<size_t>(tick >> (kSlotBits * level)) & (kSlots - 1);
+    }
+
+    void _insert(Timer t) {
+        constexpr int64_t kHorizon = int64_t(1) << (kSlotBits * kLevels);
+        if(t.expire - _current >= kHorizon) t.expire = _current + kHorizon - 1;
+        int64_t delta = t.expire - _current;
+        size_t level = 0;
+        while(level + 1 < kLevels && delta >= (int64_t(1) << (kSlotBits * (level + 1)))) ++level;
+        _wheel[level][_index(t.expire, level)].push_back(std::move(t));
+    }
+
+    /* brief: _current 跨越高层槽边界时，把对应槽的定时器降到低层；须从高层往低层处理 */
+    void _cascade() {
+        size_t top = 0;
+        while(top + 1 < kLevels &&
+              (_current & ((int64_t(1) << (kSlotBits * (top + 1))) - 1)) == 0) ++top;
+        for(size_t level = top; level >= 1; --level) {
+            Slot moved;
+            moved.swap(_wheel[level][_index(_current, level)]);
+            for(auto &t : moved) _insert(std::move(t));
+        }
+    }
+
+    const int64_t _tick_ms;
+    mutable std::mutex _mu;
+    int64_t _current;                                   // 已处理到的 tick
+    std::vector<Slot> _wheel[kLevels];
+    size_t _size {0};
+};
+
+} // namespace chatnow
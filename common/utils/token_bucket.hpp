@@ -0,0 +1,111 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * LocalTokenBuckets —— 进程内按 key 的令牌桶（限流本地预判）
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. 与 Redis 全局桶同参数：本实例看到的流量是全局流量的子集，本地桶见底时
+ *      全局桶必然也已见底，可直接拒绝而不访问 Redis；本地放行只代表"不明显超限"，
+ *      仍以 Redis 判定为准
+ *   2. 按 key 哈希分 kShards 片，每片一把锁；桶只存 (tokens, ts) 两个数
+ *   3. 已回满的桶与不存在等价：分片条目超过上限时先清掉回满的桶；
+ *      仍超限则不再跟踪新 key（直接放行交给 Redis），内存有上界
+ * ===========================================================================
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace chatnow
+{
+
+class LocalTokenBuckets
+{
+public:
+    static constexpr size_t kShards = 64;
+
+    explicit LocalTokenBuckets(size_t max_keys_per_shard = 4096)
+        : _max_keys(max_keys_per_shard == 0 ? 1 : max_keys_per_shard) {}
+
+    LocalTokenBuckets(const LocalTokenBuckets &) = delete;
+    LocalTokenBuckets &operator=(const LocalTokenBuckets &) = delete;
+
+    /* brief: 取一个令牌；rate 为每秒补充数，burst 为桶容量 */
+    bool try_take(const std::string &key, double rate, double burst) {
+        return try_take(key, rate, burst, _now_ms());
+    }
+    bool try_take(const std::string &key, double rate, double burst, int64_t now_ms) {
+        auto &shard = _shard(key);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto it = shard.map.find(key);
+        if(it == shard.map.end()) {
+            if(shard.map.size() >= _max_keys) _sweep(shard, rate, burst, now_ms);
+            if(shard.map.size() >= _max_keys) return true;
+            it = shard.map.emplace(key, Bucket{burst, now_ms}).first;
+        }
+        Bucket &b = it->second;
+        b.tokens = _refill(b, rate, burst, now_ms);
+        b.ts = now_ms;
+        if(b.tokens < 1) return false;
+        b.tokens -= 1;
+        return true;
+    }
+
+    /* brief: 归还一个令牌（多桶联合判定时，后面的桶拒绝则退还前面已扣的） */
+    void give_back(const std::string &key, double burst) {
+        auto &shard = _shard(key);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto it = shard.map.find(key);
+        if(it != shard.map.end()) it->second.tokens = std::min(burst, it->second.tokens + 1);
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for(const auto &shard : _shards) {
+            std::lock_guard<std::mutex> lk(shard.mu);
+            n += shard.map.size();
+        }
+        return n;
+    }
+
+private:
+    struct Bucket {
+        double tokens;
+        int64_t ts;
+    };
+    struct Shard {
+        mutable std::mutex mu;
+        std::unordered_map<std::string, Bucket> map;
+    };
+
+    Shard &_shard(const std::string &key) { return _shards[std::hash<std::string>{}(key) % kShards]; }
+
+    static double _refill(const Bucket &b, double rate, double burst, int64_t now_ms) {
+        return std::min(burst, b.tokens + std::max<int64_t>(0, now_ms - b.ts) * rate / 1000.0);
+    }
+
+    /* brief: 调用方持有 shard.mu；同一分片内的 key 视为同一组参数（调用方按用途分实例） */
+    static void _sweep(Shard &shard, double rate, double burst, int64_t now_ms) {
+        for(auto it = shard.map.begin(); it != shard.map.end();) {
+            if(_refill(it->second, rate, burst, now_ms) >= burst) it = shard.map.erase(it);
+            else ++it;
+        }
+    }
+
+    static int64_t _now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    const size_t _max_keys;
+    Shard _shards[kShards];
+};
+
+} // namespace chatnow
@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * TouchScheduler —— 按 key 限频的续期登记（心跳只改内存，续期由定时线程批量发出）
+ * ---------------------------------------------------------------------------
+ * 背景：每个心跳对 im:online / im:status / im:sess 各发一次 EXPIRE，
+ *      Redis 负载随连接数线性增长，而 TTL 远长于心跳间隔，绝大多数续期是多余的
+ *
+ * 设计要点：
+ *   1. key → (value, 下次续期时间)；首次 seen() 只登记不排队（鉴权时刚写过 TTL）
+ *   2. 之后 seen() 发现已过下次续期时间才排入待续期列表，并把下次时间推后 interval；
+ *      每个 key 每 interval 至多排队一次，与心跳频率无关
+ *   3. drain() 由定时线程取走待续期列表，一次 pipeline 发出；forget() 在连接关闭时调用
+ *   4. 按 key 哈希分 kShards 片，每片一把锁
+ * ===========================================================================
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chatnow
+{
+
+class TouchScheduler
+{
+public:
+    static constexpr size_t kShards = 16;
+
+    explicit TouchScheduler(int64_t interval_ms) : _interval_ms(interval_ms <= 0 ? 1 : interval_ms) {}
+
+    TouchScheduler(const TouchScheduler &) = delete;
+    TouchScheduler &operator=(const TouchScheduler &) = delete;
+
+    /* brief: key 活跃一次；到了续期时间则排入待续期列表 */
+    void seen(const std::string &key, const std::string &value, int64_t now_ms) {
+        auto &shard = _shard(key);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        auto ins = shard.entries.emplace(key, Entry{value, now_ms + _interval_ms});
+        if(ins.second) return;
+        auto &e = ins.first->second;
+        e.value = value;
+        if(now_ms < e.next_ms) return;
+        e.next_ms = now_ms + _interval_ms;
+        shard.due.emplace_back(key, value);
+    }
+
+    /* brief: key 不再需要续期（连接关闭） */
+    void forget(const std::string &key) {
+        auto &shard = _shard(key);
+        std::lock_guard<std::mutex> lk(shard.mu);
+        shard.entries.erase(key);
+    }
+
+    /* brief: 取走全部待续期的 (key, value) */
+    std::vector<std::pair<std::string, std::string>> drain() {
+        std::vector<std::pair<std::string, std::string>> res;
+        for(auto &shard : _shards) {
+            std::lock_guard<std::mutex> lk(shard.mu);
+            for(auto &p : shard.due) res.push_back(std::move(p));
+            shard.due.clear();
+        }
+        return res;
+    }
+
+    /* brief: 登记中的 key 数 */
+    size_t size() const {
+        size_t n = 0;
+        for(const auto &shard : _shards) {
+            std::lock_guard<std::mutex> lk(shard.mu);
+            n += shard.entries.size();
+        }
+        return n;
+    }
+
+private:
+    struct Entry {
+        std::string value;
+        int64_t next_ms;
+    };
+    struct Shard {
+        mutable std::mutex mu;
+        std::unordered_map<std::string, Entry> entries;
+        std::vector<std::pair<std::string, std::string>> due;
+    };
+
+    Shard &_shard(const std::string &key) { return _shards[std::hash<std::string>{}(key) % kShards]; }
+
+    const int64_t _interval_ms;
+    Shard _shards[kShards];
+};
+
+} // namespace chatnow
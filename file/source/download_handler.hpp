@@ -1,9 +1,11 @@
 #pragma once
 
 /**
- * DownloadHandler —— ApplyDownload + GetFileInfo
+ * DownloadHandler —— ApplyDownload / BatchApplyDownload + GetFileInfo
  * ---
- *   apply()：签 GET presigned URL（committed 行才放）
+ *   apply()      ：签 GET presigned URL（committed 行才放）
+ *   apply_batch()：一次 IN 查询 + 逐个本地签名（presign 不走网络），
+ *                  缺失 / 非 committed 的 file_id 静默跳过，不让整页失败
  *   info() ：仅返回 FileInfo（不签 URL）
  *
  * 访问控制：P4 v1 不引入跨服务鉴权，仅记录访问者；调用方
@@ -12,6 +14,8 @@
 
 #include <memory>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "common/error.pb.h"
 #include "dao/mysql_media_file.hpp"
@@ -50,6 +54,29 @@ public:
                  user_id, file->file_id(), file->file_size());
     }
 
+    void apply_batch(const std::string& user_id,
+                     const ::chatnow::media::BatchApplyDownloadReq& req,
+                     ::chatnow::media::BatchApplyDownloadRsp* rsp) {
+        if (req.file_ids_size() > kMaxBatchDownload) {
+            throw ServiceError(::chatnow::error::kSystemInvalidArgument, "too many file_ids");
+        }
+        std::unordered_set<std::string> seen;
+        std::vector<std::string> ids;
+        ids.reserve(req.file_ids_size());
+        for (const auto& id : req.file_ids()) {
+            if (!id.empty() && seen.insert(id).second) ids.push_back(id);
+        }
+        auto files = _files->select_committed_by_file_ids(ids);
+        for (const auto& f : files) {
+            auto* item = rsp->add_items();
+            item->set_download_url(_s3->presigned_get(f.bucket(), f.object_key(), _presign));
+            item->set_expires_in_sec(_presign);
+            fill_file_info(f, item->mutable_file_info());
+        }
+        LOG_INFO("apply_download_batch user={} asked={} hit={}",
+                 user_id, ids.size(), files.size());
+    }
+
     void info(const std::string& /*user_id*/,
               const ::chatnow::media::GetFileInfoReq& req,
               ::chatnow::media::GetFileInfoRsp* rsp) {
@@ -60,6 +87,9 @@ public:
         fill_file_info(*file, rsp->mutable_file_info());
     }
 
+    // 一页消息（拉取上限 1000）里的附件通常远少于此；超限让调用方分批
+    static constexpr int kMaxBatchDownload = 500;
+
 private:
     std::shared_ptr<S3Client>       _s3;
     std::shared_ptr<MediaFileTable> _files;
@@ -105,6 +105,10 @@ public:
                                  const ::chatnow::media::ApplyDownloadReq*,
                                  ::chatnow::media::ApplyDownloadRsp*,
                                  ::google::protobuf::Closure*) override;
+    void BatchApplyDownload     (::google::protobuf::RpcController*,
+                                 const ::chatnow::media::BatchApplyDownloadReq*,
+                                 ::chatnow::media::BatchApplyDownloadRsp*,
+                                 ::google::protobuf::Closure*) override;
     void GetFileInfo            (::google::protobuf::RpcController*,
                                  const ::chatnow::media::GetFileInfoReq*,
                                  ::chatnow::media::GetFileInfoRsp*,
@@ -216,6 +220,19 @@ inline void MediaServiceImpl::ApplyDownload(
     });
 }
 
+inline void MediaServiceImpl::BatchApplyDownload(
+    ::google::protobuf::RpcController* base_cntl,
+    const ::chatnow::media::BatchApplyDownloadReq* req,
+    ::chatnow::media::BatchApplyDownloadRsp* rsp,
+    ::google::protobuf::Closure* done)
+{
+    brpc::ClosureGuard done_guard(done);
+    auto* cntl = static_cast<brpc::Controller*>(base_cntl);
+    HANDLE_RPC(cntl, req, rsp, {
+        _download->apply_batch(auth.user_id, *req, rsp);
+    });
+}
+
 inline void MediaServiceImpl::GetFileInfo(
     ::google::protobuf::RpcController* base_cntl,
     const ::chatnow::media::GetFileInfoReq* req,
@@ -18,6 +18,12 @@ DEFINE_string(message_service, "/service/message_service", "文件管理子服
 
 DEFINE_string(es_host, "http://127.0.0.1:9200/", "ES搜索引擎服务器URL");
 
+DEFINE_string(redis_host, "127.0.0.1", "Redis 服务器访问地址");
+DEFINE_int32(redis_port, 6379, "Redis 服务器访问端口");
+DEFINE_int32(redis_db, 0, "Redis 选择的库");
+DEFINE_bool(redis_keep_alive, true, "Redis 长连接");
+DEFINE_int32(redis_pool_size, 4, "Redis 连接池大小");
+
 DEFINE_string(mysql_host, "127.0.0.1", "MySQL服务器访问地址");
 DEFINE_string(mysql_user, "root", "MySQL访问服务器用户名");
 DEFINE_string(mysql_pswd, "YHY060403", "MySQL服务器访问密码");
@@ -33,6 +39,7 @@ int main(int argc, char *argv[])
 
     chatnow::FriendServerBuilder fsb;
     fsb.make_es_object({FLAGS_es_host});
+    fsb.make_redis_object(FLAGS_redis_host, FLAGS_redis_port, FLAGS_redis_db, FLAGS_redis_keep_alive, FLAGS_redis_pool_size);
     fsb.make_mysql_object(FLAGS_mysql_user, FLAGS_mysql_pswd, FLAGS_mysql_host, FLAGS_mysql_db, FLAGS_mysql_cset, FLAGS_mysql_port, FLAGS_mysql_pool_count);
     fsb.make_discovery_object(FLAGS_registry_host, FLAGS_base_service, FLAGS_user_service, FLAGS_message_service);
     fsb.make_rpc_object(FLAGS_listen_port, FLAGS_rpc_timeout, FLAGS_rpc_threads);
@@ -12,6 +12,7 @@
 #include "dao/mysql_relation.hpp"   // mysql数据管理客户端封装
 #include "dao/mysql_friend_apply.hpp"   // mysql数据管理客户端封装
 #include "dao/data_redis.hpp"   // redis数据管理客户端封装
+#include "dao/user_info_cache.hpp"   // 用户资料两级缓存
 #include "common/types.pb.h"
 #include "common/error.pb.h"
 #include "common/envelope.pb.h"
@@ -35,7 +36,8 @@ public:
                     const std::shared_ptr<odb::core::database> &mysql_client,
                     const ServiceManager::ptr &channel_manager,
                     const std::string &user_service_name,
-                    const std::string &message_service_name)
+                    const std::string &message_service_name,
+                    const UserInfoCache<UserInfo>::ptr &user_cache = nullptr)
                     : _es_user(std::make_shared<ESUser>(es_client)),
                     _mysql_friend_apply(std::make_shared<FriendApplyTable>(mysql_client)),
                     _mysql_chat_session(std::make_shared<ChatSessionTable>(mysql_client)),
@@ -43,7 +45,8 @@ public:
                     _mysql_relation(std::make_shared<RelationTable>(mysql_client)),
                     _user_service_name(user_service_name),
                     _message_service_name(message_service_name),
-                    _mm_channels(channel_manager) {}
+                    _mm_channels(channel_manager),
+                    _user_cache(user_cache) {}
     ~FriendServiceImpl() = default;
     /* brief: 获取好友列表 */
     virtual void GetFriendList(::google::protobuf::RpcController* controller,
@@ -474,10 +477,23 @@ public:
     //    }
     //}
 private:
+        /* brief: 批量取好友 / 申请人资料：优先 UserInfoCache，miss 部分回源用户子服务（含头像） */
         bool GetUserInfo(const std::string &rid, 
                         const std::unordered_set<std::string> &uid_list,
                         std::unordered_map<std::string, UserInfo> &user_list) 
         {
+            std::vector<std::string> uids(uid_list.begin(), uid_list.end());
+            if(!_user_cache) return LoadUserInfo(rid, uids, user_list);
+            return _user_cache->get_many(uids, user_list,
+                [this, &rid](const std::vector<std::string> &miss, std::unordered_map<std::string, UserInfo> &out) {
+                    return LoadUserInfo(rid, miss, out);
+                });
+        }
+        bool LoadUserInfo(const std::string &rid, 
+                        const std::vector<std::string> &uid_list,
+                        std::unordered_map<std::string, UserInfo> &user_list) 
+        {
+            if(uid_list.empty()) return true;
             auto channel = _mm_channels->choose(_user_service_name);
             if(!channel) {
                 LOG_ERROR("请求ID - {} 没有可供访问的用户子服务节点: {}", rid, _user_service_name);
@@ -545,6 +561,7 @@ private:
     std::string _user_service_name;
     std::string _message_service_name;
     ServiceManager::ptr _mm_channels;
+    UserInfoCache<UserInfo>::ptr _user_cache;   // 资料缓存（用户服务改资料时失效）
 };
 
 class FriendServer
@@ -591,6 +608,13 @@ public:
     {
         _mysql_client = ODBFactory::create(user, password, host, db, cset, port, conn_pool_count);
     }
+    /* brief: 构造 Redis 客户端 + 用户资料缓存 */
+    void make_redis_object(const std::string &host, uint16_t port, int db,
+                           bool keep_alive, int pool_size)
+    {
+        _redis_client = RedisClientFactory::create(host, port, db, keep_alive, pool_size);
+        _user_cache = std::make_shared<UserInfoCache<UserInfo>>(_redis_client);
+    }
     /* brief: 用于构造服务发现&信道管理客户端对象 */
     void make_discovery_object(const std::string &reg_host, 
                             const std::string &base_service_name,
@@ -632,7 +656,7 @@ public:
             abort();
         }
 
-        FriendServiceImpl *friend_service = new FriendServiceImpl(_es_client, _mysql_client, _mm_channels, _user_service_name, _message_service_name);
+        FriendServiceImpl *friend_service = new FriendServiceImpl(_es_client, _mysql_client, _mm_channels, _user_service_name, _message_service_name, _user_cache);
         int ret = _rpc_server->AddService(friend_service, brpc::ServiceOwnership::SERVER_OWNS_SERVICE);
         if(ret == -1) {
             LOG_ERROR("添加RPC服务失败!");
@@ -671,6 +695,7 @@ private:
     std::shared_ptr<elasticlient::Client> _es_client;
     std::shared_ptr<odb::core::database> _mysql_client;
     std::shared_ptr<sw::redis::Redis> _redis_client;
+    UserInfoCache<UserInfo>::ptr _user_cache;
 
     std::string _user_service_name;
     std::string _message_service_name;
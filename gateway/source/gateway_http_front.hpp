@@ -0,0 +1,98 @@
+#pragma once
+
+/**
+ * ===========================================================================
+ * BrpcHttpFront —— 基于 brpc 内置 HTTP 引擎的网关入口
+ * ---------------------------------------------------------------------------
+ * 设计要点：
+ *   1. httplib 为"每连接一个 pthread + 同步下游 RPC"模型：并发上限 = 线程池大小，
+ *      下游慢时线程全部阻塞在 cntl.Join 上，新请求排队
+ *   2. brpc 的 HTTP 处理运行在 bthread 上：handler 内的同步 brpc 调用只挂起当前
+ *      bthread，worker pthread 立刻去跑其它请求，在途请求数不再受线程数限制
+ *   3. 复用既有路由表与 handler（含 jwt_authenticate）：把 brpc 的 HTTP 请求
+ *      转成 httplib::Request，调用原 handler，再把 httplib::Response 回写；
+ *      两种引擎行为一致，可通过 -http_engine 灰度切换
+ *   4. 空请求 / 响应消息 => brpc 视作纯 HTTP 服务，正文走 attachment；
+ *      通过 "/service/* => Dispatch" 映射把全部业务路径收敛到 Dispatch
+ * ===========================================================================
+ */
+
+#include <brpc/server.h>
+#include <brpc/controller.h>
+#include <brpc/closure_guard.h>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "httplib.h"
+#include "infra/logger.hpp"
+#include "gateway/http_gateway.pb.h"
+
+namespace chatnow
+{
+
+class BrpcHttpFront : public ::chatnow::gateway::HttpGatewayService
+{
+public:
+    using Routes = std::vector<std::pair<std::string, httplib::Server::Handler>>;
+
+    explicit BrpcHttpFront(const Routes &routes) : _routes(routes.begin(), routes.end()) {}
+
+    void Dispatch(::google::protobuf::RpcController *controller,
+                  const ::chatnow::gateway::HttpDispatchReq *,
+                  ::chatnow::gateway::HttpDispatchRsp *,
+                  ::google::protobuf::Closure *done) override
+    {
+        brpc::ClosureGuard done_guard(done);
+        auto *cntl = static_cast<brpc::Controller *>(controller);
+        const brpc::HttpHeader &hreq = cntl->http_request();
+
+        if(hreq.method() != brpc::HTTP_METHOD_POST) {
+            cntl->http_response().set_status_code(405);
+            return;
+        }
+        const std::string &path = hreq.uri().path();
+        auto it = _routes.find(path);
+        if(it == _routes.end()) {
+            cntl->http_response().set_status_code(404);
+            return;
+        }
+
+        httplib::Request req;
+        req.method = "POST";
+        req.path = path;
+        req.body = cntl->request_attachment().to_string();
+        for(auto h = hreq.HeaderBegin(); h != hreq.HeaderEnd(); ++h) {
+            req.headers.emplace(h->first, h->second);
+        }
+        if(!hreq.content_type().empty()) {
+            req.headers.emplace("Content-Type", hreq.content_type());
+        }
+        req.remote_addr = butil::ip2str(cntl->remote_side().ip).c_str();
+        req.remote_port = cntl->remote_side().port;
+
+        httplib::Response rsp;
+        try {
+            it->second(req, rsp);
+        } catch(const std::exception &e) {
+            LOG_ERROR("HTTP handler 异常 path={}: {}", path, e.what());
+            cntl->http_response().set_status_code(500);
+            return;
+        }
+
+        brpc::HttpHeader &hrsp = cntl->http_response();
+        hrsp.set_status_code(rsp.status > 0 ? rsp.status : 200);
+        for(const auto &h : rsp.headers) {
+            if(h.first == "Content-Type") hrsp.set_content_type(h.second);
+            else hrsp.SetHeader(h.first, h.second);
+        }
+        cntl->response_attachment().append(rsp.body);
+    }
+
+private:
+    std::unordered_map<std::string, httplib::Server::Handler> _routes;
+};
+
+} // namespace chatnow
@@ -5,6 +5,9 @@ DEFINE_string(log_file, "", "发布模式下，用于指定日志的输出文件
 DEFINE_int32(log_level, 0, "发布模式下，用于指定日志的输出等级");
 
 DEFINE_int32(http_listen_port, 9000, "HTTP服务器监听端口");
+DEFINE_string(http_engine, "httplib", "HTTP 引擎：httplib（线程池同步）| brpc（bthread 承载，下游阻塞不占线程）");
+DEFINE_int32(http_threads, 0, "brpc 引擎 worker 线程数，<=0 取 brpc 默认");
+DEFINE_int32(http_max_concurrency, 0, "brpc 引擎最大在途请求数，<=0 不限");
 // B3: Gateway 不再监听 WebSocket，9001 端口由 push 服务终结。
 //     保留 flag 仅为兼容旧 conf 文件，值不再被使用。
 DEFINE_int32(websocket_listen_port, 9001, "[已废弃] gateway 不再监听 WS（已迁至 push 服务）");
@@ -26,6 +29,8 @@ DEFINE_int32(redis_db, 0, "Redis默认库号");
 DEFINE_bool(redis_keep_alive, true, "Redis长连接保活");
 
 DEFINE_string(auth_config, "/im/conf/auth.json", "JWT 鉴权配置文件路径(JSON)");
+DEFINE_int32(jwt_claims_cache_size, 100000, "已验签 token 缓存条目数，0 关闭");
+DEFINE_int32(jwt_revocation_sync_ms, 1000, "吊销集合本地镜像同步周期(ms)，0 关闭（逐次查 Redis）");
 
 int main(int argc, char *argv[])
 {
@@ -34,7 +39,7 @@ int main(int argc, char *argv[])
 
     chatnow::GatewayServerBuilder gsb;
     gsb.make_redis_object(FLAGS_redis_host, FLAGS_redis_port, FLAGS_redis_db, FLAGS_redis_keep_alive);
-    gsb.make_jwt_object(FLAGS_auth_config);
+    gsb.make_jwt_object(FLAGS_auth_config, FLAGS_jwt_claims_cache_size, FLAGS_jwt_revocation_sync_ms);
     gsb.make_discovery_object(FLAGS_registry_host, FLAGS_base_service, FLAGS_speech_service,
                             FLAGS_file_service, FLAGS_user_service, FLAGS_transmite_service,
                             FLAGS_message_service, FLAGS_friend_service, FLAGS_chatsession_service,
@@ -43,7 +48,7 @@ int main(int argc, char *argv[])
         LOG_WARN("gateway 不再监听 WebSocket，--websocket_listen_port={} 已被忽略（请使用 push_server）",
                  FLAGS_websocket_listen_port);
     }
-    gsb.make_server_object(FLAGS_http_listen_port);
+    gsb.make_server_object(FLAGS_http_listen_port, FLAGS_http_engine, FLAGS_http_threads, FLAGS_http_max_concurrency);
 
     auto server = gsb.build();
     server->start();
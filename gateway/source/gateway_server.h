@@ -17,6 +17,7 @@
 #include "error/service_error.hpp"
 #include "gateway_auth.hpp"
 #include "gateway_trace.hpp"
+#include "gateway_http_front.hpp"
 
 // 注意：B3 — Gateway 已彻底无状态化，WebSocket 终结迁至 push 服务（push_server.h）。
 // 不再 include "connection.hpp"，不再监听 9001 端口，不再维护 uid→conn 映射。
@@ -47,6 +48,7 @@ namespace chatnow
 #define MAIL_REGISTER               "/service/user/mail_register"                     //邮箱号码注册 
 #define MAIL_LOGIN                  "/service/user/mail_login"                        //邮箱号码登录 
 #define GET_USER_INFO               "/service/user/get_user_info"                     //获取个人信息 
+#define GET_USER_PROFILES           "/service/user/get_user_profiles"                 //按 profile_version 校验并拉取用户资料 
 #define SET_AVATAR                  "/service/user/set_avatar"                        //修改头像 
 #define SET_NICKNAME                "/service/user/set_nickname"                      //修改昵称 
 #define SET_DESCRIPTION             "/service/user/set_description"                   //修改签名 
@@ -109,7 +111,10 @@ public:
                 const std::string &message_service_name,
                 const std::string &friend_service_name,
                 const std::string &chatsession_service_name,
-                const std::string &push_service_name = "/service/push_service")
+                const std::string &push_service_name = "/service/push_service",
+                const std::string &http_engine = "httplib",
+                int http_threads = 0,
+                int http_max_concurrency = 0)
         : _jwt_codec(jwt_codec),
         _jwt_store(jwt_store),
         _mm_channels(channels),
@@ -122,75 +127,106 @@ public:
         _friend_service_name(friend_service_name),
         _chatsession_service_name(chatsession_service_name),
         _push_service_name(push_service_name),
-        _http_port(http_port)
+        _http_port(http_port),
+        _http_engine(http_engine),
+        _http_threads(http_threads),
+        _http_max_concurrency(http_max_concurrency)
     {
         // B3: Gateway 不再终结 WebSocket。WS 由 push 服务监听 9001。
         //     此处仅注册 HTTP 路由；推送链路统一走 _pushNotify → PushService。
 
         //2. 搭建http服务器
-        _http_server.Post(GET_MAIL_VERIFY_CODE,         (httplib::Server::Handler)std::bind(&GatewayServer::GetMailVerifyCode,         this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(USERNAME_REGISTER,            (httplib::Server::Handler)std::bind(&GatewayServer::UserRegister,              this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(USERNAME_LOGIN,               (httplib::Server::Handler)std::bind(&GatewayServer::UserLogin,                 this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(USER_LOGOUT,                  (httplib::Server::Handler)std::bind(&GatewayServer::UserLogout,                this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(REFRESH_TOKEN_PATH,           (httplib::Server::Handler)std::bind(&GatewayServer::RefreshToken,              this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(MAIL_REGISTER,                (httplib::Server::Handler)std::bind(&GatewayServer::MailRegister,              this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(MAIL_LOGIN,                   (httplib::Server::Handler)std::bind(&GatewayServer::MailLogin,                 this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_USER_INFO,                (httplib::Server::Handler)std::bind(&GatewayServer::GetUserInfo,               this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SET_AVATAR,                   (httplib::Server::Handler)std::bind(&GatewayServer::SetUserAvatar,             this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SET_NICKNAME,                 (httplib::Server::Handler)std::bind(&GatewayServer::SetUserNickname,           this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SET_DESCRIPTION,              (httplib::Server::Handler)std::bind(&GatewayServer::SetUserDescription,        this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SET_MAIL,                     (httplib::Server::Handler)std::bind(&GatewayServer::SetUserMailNumber,         this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_FRIEND_LIST,              (httplib::Server::Handler)std::bind(&GatewayServer::GetFriendList,             this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(ADD_FRIEND_APPLY,             (httplib::Server::Handler)std::bind(&GatewayServer::FriendAdd,                 this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(ADD_FRIEND_PROCESS,           (httplib::Server::Handler)std::bind(&GatewayServer::FriendAddProcess,          this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(REMOVE_FRIEND,                (httplib::Server::Handler)std::bind(&GatewayServer::FriendRemove,              this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SEARCH_FRIEND,                (httplib::Server::Handler)std::bind(&GatewayServer::FriendSearch,              this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_CHAT_SESSION_LIST,        (httplib::Server::Handler)std::bind(&GatewayServer::GetChatSessionList,        this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(CREATE_CHAT_SESSION,          (httplib::Server::Handler)std::bind(&GatewayServer::ChatSessionCreate,         this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_CHAT_SESSION_MEMBER,      (httplib::Server::Handler)std::bind(&GatewayServer::GetChatSessionMember,      this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_PENDING_FRIEND_EVENTS,    (httplib::Server::Handler)std::bind(&GatewayServer::GetPendingFriendEventList, this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_HISTORY,                  (httplib::Server::Handler)std::bind(&GatewayServer::GetHistoryMsg,             this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_RECENT,                   (httplib::Server::Handler)std::bind(&GatewayServer::GetRecentMsg,              this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SEARCH_HISTORY,               (httplib::Server::Handler)std::bind(&GatewayServer::MsgSearch,                 this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(NEW_MESSAGE,                  (httplib::Server::Handler)std::bind(&GatewayServer::NewMessage,                this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_SINGLE_FILE,              (httplib::Server::Handler)std::bind(&GatewayServer::GetSingleFile,             this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_MULTI_FILE,               (httplib::Server::Handler)std::bind(&GatewayServer::GetMultiFile,              this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(PUT_SINGLE_FILE,              (httplib::Server::Handler)std::bind(&GatewayServer::PutSingleFile,             this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(PUT_MULTI_FILE,               (httplib::Server::Handler)std::bind(&GatewayServer::PutMultiFile,              this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(RECOGNITION,                  (httplib::Server::Handler)std::bind(&GatewayServer::SpeechRecognition,         this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_MAIL_VERIFY_CODE,                    (httplib::Server::Handler)std::bind(&GatewayServer::GetMailVerifyCode,         this, std::placeholders::_1, std::placeholders::_2));
+        _route(USERNAME_REGISTER,                       (httplib::Server::Handler)std::bind(&GatewayServer::UserRegister,              this, std::placeholders::_1, std::placeholders::_2));
+        _route(USERNAME_LOGIN,                          (httplib::Server::Handler)std::bind(&GatewayServer::UserLogin,                 this, std::placeholders::_1, std::placeholders::_2));
+        _route(USER_LOGOUT,                             (httplib::Server::Handler)std::bind(&GatewayServer::UserLogout,                this, std::placeholders::_1, std::placeholders::_2));
+        _route(REFRESH_TOKEN_PATH,                      (httplib::Server::Handler)std::bind(&GatewayServer::RefreshToken,              this, std::placeholders::_1, std::placeholders::_2));
+        _route(MAIL_REGISTER,                           (httplib::Server::Handler)std::bind(&GatewayServer::MailRegister,              this, std::placeholders::_1, std::placeholders::_2));
+        _route(MAIL_LOGIN,                              (httplib::Server::Handler)std::bind(&GatewayServer::MailLogin,                 this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_USER_INFO,                           (httplib::Server::Handler)std::bind(&GatewayServer::GetUserInfo,               this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_USER_PROFILES,                       (httplib::Server::Handler)std::bind(&GatewayServer::GetUserProfiles,           this, std::placeholders::_1, std::placeholders::_2));
+        _route(SET_AVATAR,                              (httplib::Server::Handler)std::bind(&GatewayServer::SetUserAvatar,             this, std::placeholders::_1, std::placeholders::_2));
+        _route(SET_NICKNAME,                            (httplib::Server::Handler)std::bind(&GatewayServer::SetUserNickname,           this, std::placeholders::_1, std::placeholders::_2));
+        _route(SET_DESCRIPTION,                         (httplib::Server::Handler)std::bind(&GatewayServer::SetUserDescription,        this, std::placeholders::_1, std::placeholders::_2));
+        _route(SET_MAIL,                                (httplib::Server::Handler)std::bind(&GatewayServer::SetUserMailNumber,         this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_FRIEND_LIST,                         (httplib::Server::Handler)std::bind(&GatewayServer::GetFriendList,             this, std::placeholders::_1, std::placeholders::_2));
+        _route(ADD_FRIEND_APPLY,                        (httplib::Server::Handler)std::bind(&GatewayServer::FriendAdd,                 this, std::placeholders::_1, std::placeholders::_2));
+        _route(ADD_FRIEND_PROCESS,                      (httplib::Server::Handler)std::bind(&GatewayServer::FriendAddProcess,          this, std::placeholders::_1, std::placeholders::_2));
+        _route(REMOVE_FRIEND,                           (httplib::Server::Handler)std::bind(&GatewayServer::FriendRemove,              this, std::placeholders::_1, std::placeholders::_2));
+        _route(SEARCH_FRIEND,                           (httplib::Server::Handler)std::bind(&GatewayServer::FriendSearch,              this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_CHAT_SESSION_LIST,                   (httplib::Server::Handler)std::bind(&GatewayServer::GetChatSessionList,        this, std::placeholders::_1, std::placeholders::_2));
+        _route(CREATE_CHAT_SESSION,                     (httplib::Server::Handler)std::bind(&GatewayServer::ChatSessionCreate,         this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_CHAT_SESSION_MEMBER,                 (httplib::Server::Handler)std::bind(&GatewayServer::GetChatSessionMember,      this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_PENDING_FRIEND_EVENTS,               (httplib::Server::Handler)std::bind(&GatewayServer::GetPendingFriendEventList, this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_HISTORY,                             (httplib::Server::Handler)std::bind(&GatewayServer::GetHistoryMsg,             this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_RECENT,                              (httplib::Server::Handler)std::bind(&GatewayServer::GetRecentMsg,              this, std::placeholders::_1, std::placeholders::_2));
+        _route(SEARCH_HISTORY,                          (httplib::Server::Handler)std::bind(&GatewayServer::MsgSearch,                 this, std::placeholders::_1, std::placeholders::_2));
+        _route(NEW_MESSAGE,                             (httplib::Server::Handler)std::bind(&GatewayServer::NewMessage,                this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_SINGLE_FILE,                         (httplib::Server::Handler)std::bind(&GatewayServer::GetSingleFile,             this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_MULTI_FILE,                          (httplib::Server::Handler)std::bind(&GatewayServer::GetMultiFile,              this, std::placeholders::_1, std::placeholders::_2));
+        _route(PUT_SINGLE_FILE,                         (httplib::Server::Handler)std::bind(&GatewayServer::PutSingleFile,             this, std::placeholders::_1, std::placeholders::_2));
+        _route(PUT_MULTI_FILE,                          (httplib::Server::Handler)std::bind(&GatewayServer::PutMultiFile,              this, std::placeholders::_1, std::placeholders::_2));
+        _route(RECOGNITION,                             (httplib::Server::Handler)std::bind(&GatewayServer::SpeechRecognition,         this, std::placeholders::_1, std::placeholders::_2));
        
-        _http_server.Post(GET_CHAT_SESSION_DETAIL,      (httplib::Server::Handler)std::bind(&GatewayServer::GetChatSessionDetail,      this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SET_CHAT_SESSION_NAME,        (httplib::Server::Handler)std::bind(&GatewayServer::SetChatSessionName,        this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SET_CHAT_SESSION_AVATAR,      (httplib::Server::Handler)std::bind(&GatewayServer::SetChatSessionAvatar,      this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(ADD_CHAT_SESSION_MEMBER,      (httplib::Server::Handler)std::bind(&GatewayServer::AddChatSessionMember,     this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(REMOVE_CHAT_SESSION_MEMBER,   (httplib::Server::Handler)std::bind(&GatewayServer::RemoveChatSessionMember,   this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(TRANSFER_CHAT_SESSION_OWNER,  (httplib::Server::Handler)std::bind(&GatewayServer::TransferChatSessionOwner,  this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(MODIFY_MEMBER_PERMISSION,     (httplib::Server::Handler)std::bind(&GatewayServer::ModifyMemberPermission,    this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(MODIFY_CHAT_SESSION_STATUS,   (httplib::Server::Handler)std::bind(&GatewayServer::ModifyChatSessionStatus,   this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SEARCH_CHAT_SESSION,          (httplib::Server::Handler)std::bind(&GatewayServer::SearchChatSession,         this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SET_SESSION_MUTED,            (httplib::Server::Handler)std::bind(&GatewayServer::SetSessionMuted,           this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SET_SESSION_PINNED,           (httplib::Server::Handler)std::bind(&GatewayServer::SetSessionPinned,          this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(SET_SESSION_VISIBLE,          (httplib::Server::Handler)std::bind(&GatewayServer::SetSessionVisible,         this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(QUIT_CHAT_SESSION,            (httplib::Server::Handler)std::bind(&GatewayServer::QuitChatSession,           this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(MSG_READ_ACK,                 (httplib::Server::Handler)std::bind(&GatewayServer::MsgReadAck,                this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_MEMBER_ID_LIST,           (httplib::Server::Handler)std::bind(&GatewayServer::GetMemberIdList,           this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_OFFLINE_MSG,              (httplib::Server::Handler)std::bind(&GatewayServer::GetOfflineMsg,             this, std::placeholders::_1, std::placeholders::_2));
-        //_http_server.Post(GET_MSG_BY_IDS,               (httplib::Server::Handler)std::bind(&GatewayServer::GetMsgByIDs,               this, std::placeholders::_1, std::placeholders::_2));
-       // _http_server.Post(DELETE_TIMELINE_MSG,          (httplib::Server::Handler)std::bind(&GatewayServer::DeleteTimelineMsg,         this, std::placeholders::_1, std::placeholders::_2));
-        _http_server.Post(GET_UNREAD_COUNT,             (httplib::Server::Handler)std::bind(&GatewayServer::GetUnreadCount,            this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_CHAT_SESSION_DETAIL,                 (httplib::Server::Handler)std::bind(&GatewayServer::GetChatSessionDetail,      this, std::placeholders::_1, std::placeholders::_2));
+        _route(SET_CHAT_SESSION_NAME,                   (httplib::Server::Handler)std::bind(&GatewayServer::SetChatSessionName,        this, std::placeholders::_1, std::placeholders::_2));
+        _route(SET_CHAT_SESSION_AVATAR,                 (httplib::Server::Handler)std::bind(&GatewayServer::SetChatSessionAvatar,      this, std::placeholders::_1, std::placeholders::_2));
+        _route(ADD_CHAT_SESSION_MEMBER,                 (httplib::Server::Handler)std::bind(&GatewayServer::AddChatSessionMember,     this, std::placeholders::_1, std::placeholders::_2));
+        _route(REMOVE_CHAT_SESSION_MEMBER,              (httplib::Server::Handler)std::bind(&GatewayServer::RemoveChatSessionMember,   this, std::placeholders::_1, std::placeholders::_2));
+        _route(TRANSFER_CHAT_SESSION_OWNER,             (httplib::Server::Handler)std::bind(&GatewayServer::TransferChatSessionOwner,  this, std::placeholders::_1, std::placeholders::_2));
+        _route(MODIFY_MEMBER_PERMISSION,                (httplib::Server::Handler)std::bind(&GatewayServer::ModifyMemberPermission,    this, std::placeholders::_1, std::placeholders::_2));
+        _route(MODIFY_CHAT_SESSION_STATUS,              (httplib::Server::Handler)std::bind(&GatewayServer::ModifyChatSessionStatus,   this, std::placeholders::_1, std::placeholders::_2));
+        _route(SEARCH_CHAT_SESSION,                     (httplib::Server::Handler)std::bind(&GatewayServer::SearchChatSession,         this, std::placeholders::_1, std::placeholders::_2));
+        _route(SET_SESSION_MUTED,                       (httplib::Server::Handler)std::bind(&GatewayServer::SetSessionMuted,           this, std::placeholders::_1, std::placeholders::_2));
+        _route(SET_SESSION_PINNED,                      (httplib::Server::Handler)std::bind(&GatewayServer::SetSessionPinned,          this, std::placeholders::_1, std::placeholders::_2));
+        _route(SET_SESSION_VISIBLE,                     (httplib::Server::Handler)std::bind(&GatewayServer::SetSessionVisible,         this, std::placeholders::_1, std::placeholders::_2));
+        _route(QUIT_CHAT_SESSION,                       (httplib::Server::Handler)std::bind(&GatewayServer::QuitChatSession,           this, std::placeholders::_1, std::placeholders::_2));
+        _route(MSG_READ_ACK,                            (httplib::Server::Handler)std::bind(&GatewayServer::MsgReadAck,                this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_MEMBER_ID_LIST,                      (httplib::Server::Handler)std::bind(&GatewayServer::GetMemberIdList,           this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_OFFLINE_MSG,                         (httplib::Server::Handler)std::bind(&GatewayServer::GetOfflineMsg,             this, std::placeholders::_1, std::placeholders::_2));
+        //_route(GET_MSG_BY_IDS,                          (httplib::Server::Handler)std::bind(&GatewayServer::GetMsgByIDs,               this, std::placeholders::_1, std::placeholders::_2));
+       // _route(DELETE_TIMELINE_MSG,                     (httplib::Server::Handler)std::bind(&GatewayServer::DeleteTimelineMsg,         this, std::placeholders::_1, std::placeholders::_2));
+        _route(GET_UNREAD_COUNT,                        (httplib::Server::Handler)std::bind(&GatewayServer::GetUnreadCount,            this, std::placeholders::_1, std::placeholders::_2));
 
     }
     /* 启动服务器：阻塞主线程在 HTTP 监听上
      * httplib::listen 失败（bind / listen 错误）返回 false；不检查会让进程静默 exit 0
+     * http_engine=brpc 时改由 brpc 内置 HTTP 引擎承载（handler 跑在 bthread 上，
+     * 下游同步 RPC 只挂起 bthread，不占 worker 线程），路由表与 handler 完全复用
      */
     void start() {
-        LOG_INFO("Gateway 启动: http_port={} (WS 已迁至 push 服务)", _http_port);
+        LOG_INFO("Gateway 启动: http_port={} engine={} (WS 已迁至 push 服务)", _http_port, _http_engine);
+        if(_http_engine == "brpc") {
+            _start_brpc();
+            return;
+        }
+        for(const auto &r : _routes) _http_server.Post(r.first, r.second);
         if(!_http_server.listen("0.0.0.0", _http_port)) {
             LOG_ERROR("HTTP 服务器监听失败 port={}", _http_port);
             abort();
         }
     }
 private:
+    void _route(const std::string &path, const httplib::Server::Handler &handler) {
+        _routes.emplace_back(path, handler);
+    }
+    void _start_brpc() {
+        BrpcHttpFront front(_routes);
+        brpc::Server server;
+        if(server.AddService(&front, brpc::SERVER_DOESNT_OWN_SERVICE, "/service/* => Dispatch") != 0) {
+            LOG_ERROR("brpc HTTP 入口注册失败");
+            abort();
+        }
+        brpc::ServerOptions options;
+        if(_http_threads > 0) options.num_threads = _http_threads;
+        if(_http_max_concurrency > 0) options.max_concurrency = _http_max_concurrency;
+        if(server.Start(_http_port, &options) != 0) {
+            LOG_ERROR("brpc HTTP 服务器启动失败 port={}", _http_port);
+            abort();
+        }
+        server.RunUntilAskedToQuit();
+    }
+
     /* brief: 通过 Push 服务下发 NotifyMessage（无状态化推送链路）
      *  - 异步 fire-and-forget；用 SelfDeleteRpcClosure 持有 cntl/req/rsp，
      *    避免栈对象在异步回调到达前已析构（DoNothing 旧实现的 UAF）
@@ -503,6 +539,46 @@ private:
         //4. 得到用户子服务的响应后，将响应进行序列化作为http响应正文
         response.set_content(rsp.SerializeAsString(), "application/x-protbuf");
     }
+    void GetUserProfiles(const httplib::Request &request, httplib::Response &response) {
+        chatnow::gateway::LogContextScope _trace_scope;
+        //1. 取出http请求正文，将正文进行反序列化
+        GetUserProfilesReq req;
+        GetUserProfilesRsp rsp;
+        auto err_response = [&req, &rsp, &response](const std::string &errmsg) -> void {
+            rsp.set_success(false);
+            rsp.set_errmsg(errmsg);
+            response.set_content(rsp.SerializeAsString(), "application/x-protbuf");
+        };
+        bool ret = req.ParseFromString(request.body);
+        if(ret == false) {
+            LOG_ERROR("拉取用户资料请求正文反序列化失败");
+            return err_response("拉取用户资料请求正文反序列化失败");
+        }
+        //2. JWT 鉴权（横切 spec §2.5）
+        chatnow::gateway::AuthInfo _auth;
+        if (!chatnow::gateway::jwt_authenticate(request, response, _jwt_codec, _jwt_store,
+                                                 /*whitelisted=*/false, _auth)) {
+            return;  // 401 已写
+        }
+        req.set_user_id(_auth.user_id);
+        //3. 将请求转发给用户子服务进行业务处理
+        auto channel = _mm_channels->choose(_user_service_name);
+        if(!channel) {
+            LOG_ERROR("请求ID - {} 未找到可提供业务的用户子服务节点", req.request_id());
+            return err_response("未找到可提供业务的用户子服务节点");
+        }
+        UserService_Stub stub(channel.get());
+        brpc::Controller cntl;
+        std::string trace_id = chatnow::gateway::gateway_setup_trace(request, cntl);
+        response.set_header("X-Trace-Id", trace_id);
+        stub.GetUserProfiles(&cntl, &req, &rsp, nullptr);
+        if(cntl.Failed()) {
+            LOG_ERROR("请求ID - {} 用户子服务调用失败: {}", req.request_id(), cntl.ErrorText());
+            return err_response("用户子服务调用失败");
+        }
+        //4. 得到用户子服务的响应后，将响应进行序列化作为http响应正文
+        response.set_content(rsp.SerializeAsString(), "application/x-protbuf");
+    }
     void SetUserAvatar(const httplib::Request &request, httplib::Response &response) {
         chatnow::gateway::LogContextScope _trace_scope;
         //1. 取出http请求正文，将正文进行反序列化
@@ -1160,7 +1236,8 @@ private:
         }
         MsgStorageService_Stub stub(channel.get());
         brpc::Controller cntl;
-        std::string trace_id = chatnow::gateway::gateway_setup_trace(request, cntl);
+        // 附件下载 URL 按转发的鉴权身份签发（metadata_only），必须带上 user_id / device_id
+        std::string trace_id = chatnow::gateway::gateway_setup_trace(request, cntl, _auth.user_id, _auth.device_id);
         response.set_header("X-Trace-Id", trace_id);
         stub.GetHistoryMsg(&cntl, &req, &rsp, nullptr);
         if(cntl.Failed()) {
@@ -1200,7 +1277,8 @@ private:
         }
         MsgStorageService_Stub stub(channel.get());
         brpc::Controller cntl;
-        std::string trace_id = chatnow::gateway::gateway_setup_trace(request, cntl);
+        // 附件下载 URL 按转发的鉴权身份签发（metadata_only），必须带上 user_id / device_id
+        std::string trace_id = chatnow::gateway::gateway_setup_trace(request, cntl, _auth.user_id, _auth.device_id);
         response.set_header("X-Trace-Id", trace_id);
         stub.GetRecentMsg(&cntl, &req, &rsp, nullptr);
         if(cntl.Failed()) {
@@ -1474,7 +1552,8 @@ private:
         }
         req.set_user_id(_auth.user_id);
         //3. 将请求转发给消息转发子服务进行业务处理
-        auto channel = _mm_channels->choose(_transmite_service_name);
+        //   按 chat_session_id 一致性哈希：同会话落到同一 transmite，session_seq 由其本地号段发放
+        auto channel = _mm_channels->choose(_transmite_service_name, req.chat_session_id());
         if(!channel) {
             LOG_ERROR("请求ID - {} 未找到可提供业务的消息转发子服务节点", req.request_id());
             return err_response("未找到可提供业务的消息转发子服务节点");
@@ -2134,7 +2213,8 @@ private:
         }
         MsgStorageService_Stub stub(channel.get());
         brpc::Controller cntl;
-        std::string trace_id = chatnow::gateway::gateway_setup_trace(request, cntl);
+        // 附件下载 URL 按转发的鉴权身份签发（metadata_only），必须带上 user_id / device_id
+        std::string trace_id = chatnow::gateway::gateway_setup_trace(request, cntl, _auth.user_id, _auth.device_id);
         response.set_header("X-Trace-Id", trace_id);
         stub.GetOfflineMsg(&cntl, &req, &rsp, nullptr);
         if(cntl.Failed()) {
@@ -2200,6 +2280,10 @@ private:
     Discovery::ptr _service_discoverer;
 
     int _http_port {0};
+    std::string _http_engine;
+    int _http_threads {0};
+    int _http_max_concurrency {0};
+    BrpcHttpFront::Routes _routes;
     httplib::Server _http_server;
 };
 
@@ -2214,8 +2298,13 @@ public:
     {
         _redis_client = RedisClientFactory::create(host, port, db, keep_alive);
     }
-    /* brief: 加载 JWT 配置并构造 codec / store（必须在 make_redis_object 之后） */
-    void make_jwt_object(const std::string &auth_config_path) {
+    /* brief: 加载 JWT 配置并构造 codec / store（必须在 make_redis_object 之后）
+     *  claims_cache_size > 0：开启已验签 token 缓存（命中跳过 HMAC）
+     *  revocation_sync_ms > 0：开启吊销集合本地镜像（is_revoked 不再逐次访问 Redis）
+     */
+    void make_jwt_object(const std::string &auth_config_path,
+                         size_t claims_cache_size = 0,
+                         int revocation_sync_ms = 0) {
         if (!_redis_client) {
             LOG_ERROR("make_jwt_object 必须在 make_redis_object 之后调用");
             abort();
@@ -2223,6 +2312,13 @@ public:
         auto cfg = ::chatnow::auth::load_jwt_config_from_file(auth_config_path);
         _jwt_codec = std::make_shared<::chatnow::auth::JwtCodec>(std::move(cfg));
         _jwt_store = std::make_shared<::chatnow::auth::JwtStore>(_redis_client);
+        if (claims_cache_size > 0) {
+            _jwt_codec->enable_verify_cache(claims_cache_size);
+        }
+        if (revocation_sync_ms > 0) {
+            _jwt_store->enable_local_mirror(std::chrono::milliseconds(revocation_sync_ms),
+                                            _jwt_codec->access_ttl_sec());
+        }
     }
     /* brief: 用于构造服务发现&信道管理客户端对象 */
     void make_discovery_object(const std::string &reg_host,
@@ -2260,10 +2356,19 @@ public:
 
         _service_discoverer = std::make_shared<Discovery>(reg_host, base_service_name, put_cb, del_cb);
     }
-    /* brief: B3 — Gateway 仅监听 HTTP；WebSocket 由 push 服务终结 */
-    void make_server_object(int http_port)
+    /* brief: B3 — Gateway 仅监听 HTTP；WebSocket 由 push 服务终结
+     *  engine: "httplib"（默认，线程池同步）| "brpc"（bthread 承载，下游阻塞不占线程）
+     *  threads / max_concurrency 仅 brpc 引擎生效，<=0 取 brpc 默认
+     */
+    void make_server_object(int http_port,
+                            const std::string &engine = "httplib",
+                            int threads = 0,
+                            int max_concurrency = 0)
     {
         _http_port = http_port;
+        _http_engine = engine;
+        _http_threads = threads;
+        _http_max_concurrency = max_concurrency;
     }
     GatewayServer::ptr build() {
         if(!_redis_client) {
@@ -2294,11 +2399,17 @@ public:
                                                                 _message_service_name,
                                                                 _friend_service_name,
                                                                 _chatsession_service_name,
-                                                                _push_service_name);
+                                                                _push_service_name,
+                                                                _http_engine,
+                                                                _http_threads,
+                                                                _http_max_concurrency);
         return server;
     }
 private:
     int _http_port;
+    std::string _http_engine {"httplib"};
+    int _http_threads {0};
+    int _http_max_concurrency {0};
 
     std::shared_ptr<sw::redis::Redis> _redis_client;
     std::shared_ptr<::chatnow::auth::JwtCodec> _jwt_codec;
@@ -14,6 +14,7 @@ DEFINE_int32(rpc_timeout, -1, "RPC调用超时时间");
 DEFINE_int32(rpc_threads, 1, "RPC的IO线程数量");
 
 DEFINE_string(file_service, "/service/file_service", "文件管理子服务名称");
+DEFINE_string(media_service, "/service/media_service", "媒体子服务名称（metadata_only 拉取时批量签下载 URL）");
 DEFINE_string(user_service, "/service/user_service", "用户管理子服务名称");
 DEFINE_string(chatsession_service, "/service/chatsession_service", "会话管理子服务名称");
 
@@ -41,6 +42,9 @@ DEFINE_string(mq_push_binding_key, "push", "推送队列绑定键");
 DEFINE_string(mq_es_exchange, "es_index_exchange", "ES 索引事件的交换机名称（DIRECT）");
 DEFINE_string(mq_es_queue, "msg_queue_es_index", "ES 索引事件队列名称（新路径）");
 DEFINE_string(mq_es_binding_key, "msg_queue_es_index", "ES 索引事件绑定键");
+DEFINE_int32(mq_consume_workers, 4, "MQ 消费并行 worker 数（按会话分片保序，0 为 ev 线程内联消费）");
+DEFINE_int32(db_batch_size, 64, "DB 消费 group commit 单批最大消息数（<=1 关闭攒批，逐条事务）");
+DEFINE_int32(db_batch_delay_ms, 5, "DB 消费 group commit 攒批最长等待毫秒数");
 
 DEFINE_string(es_host, "http://127.0.0.1:9200/", "ES搜索引擎服务器URL");
 
@@ -59,13 +63,15 @@ int main(int argc, char *argv[])
     chatnow::MessageServerBuilder msb;
     msb.make_redis_object(FLAGS_redis_host, FLAGS_redis_port, FLAGS_redis_db, FLAGS_redis_keep_alive, FLAGS_redis_pool_size);
     msb.set_reaper_owner(FLAGS_access_host + ":" + std::to_string(::getpid()));
+    msb.set_consume_workers(FLAGS_mq_consume_workers);
+    msb.set_db_batch(FLAGS_db_batch_size > 0 ? FLAGS_db_batch_size : 0, FLAGS_db_batch_delay_ms);
     msb.make_mq_object(FLAGS_mq_user, FLAGS_mq_pswd, FLAGS_mq_host, FLAGS_mq_msg_exchange, FLAGS_mq_msg_queue_db, FLAGS_mq_msg_queue_es, FLAGS_mq_db_binding_key, FLAGS_mq_es_binding_key);
     msb.make_push_publisher(FLAGS_mq_push_exchange, FLAGS_mq_push_queue, FLAGS_mq_push_binding_key);
     msb.make_es_publisher(FLAGS_mq_es_exchange, FLAGS_mq_es_queue, FLAGS_mq_es_binding_key);
     msb.make_es_index_subscriber(FLAGS_mq_es_exchange, FLAGS_mq_es_queue, FLAGS_mq_es_binding_key);
     msb.make_es_object({FLAGS_es_host});
     msb.make_mysql_object(FLAGS_mysql_user, FLAGS_mysql_pswd, FLAGS_mysql_host, FLAGS_mysql_db, FLAGS_mysql_cset, FLAGS_mysql_port, FLAGS_mysql_pool_count);
-    msb.make_discovery_object(FLAGS_registry_host, FLAGS_base_service, FLAGS_file_service, FLAGS_user_service, FLAGS_chatsession_service);
+    msb.make_discovery_object(FLAGS_registry_host, FLAGS_base_service, FLAGS_file_service, FLAGS_user_service, FLAGS_chatsession_service, FLAGS_media_service);
     msb.make_rpc_object(FLAGS_listen_port, FLAGS_rpc_timeout, FLAGS_rpc_threads);
     msb.make_reg_object(FLAGS_registry_host, FLAGS_base_service + FLAGS_instance_name, FLAGS_access_host);
 
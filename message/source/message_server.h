@@ -3,12 +3,14 @@
 #include <brpc/server.h>
 #include "dao/data_es.hpp"
 #include "dao/data_redis.hpp"
+#include "dao/user_info_cache.hpp"
 #include "dao/mysql_message.hpp"
 #include "dao/mysql_user_timeline.hpp"
 #include "dao/mysql_chat_session_member.hpp"
 #include "infra/etcd.hpp"
 #include "infra/logger.hpp"
 #include "utils/utils.hpp"
+#include "utils/batch_queue.hpp"
 #include "mq/channel.hpp"
 #include "mq/trace_headers.hpp"
 #include "mq/rabbitmq.hpp"
@@ -23,8 +25,12 @@
 #include "message/message_service.pb.h"
 #include "message/message_internal.pb.h"
 #include "identity/identity_service.pb.h"
+#include "media/media_service.pb.h"
+#include "auth/forward_auth.hpp"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <limits>
 #include <thread>
 
 namespace chatnow
@@ -47,8 +53,12 @@ public:
                         const Publisher::ptr &push_publisher = nullptr,
                         const PushOutbox::ptr &push_outbox = nullptr,
                         const Publisher::ptr &es_publisher = nullptr,
-                        const ESOutbox::ptr &es_outbox = nullptr)
+                        const ESOutbox::ptr &es_outbox = nullptr,
+                        const LastMessage::ptr &last_msg = nullptr,
+                        const std::string &media_service_name = "",
+                        const UserInfoCache<UserInfo>::ptr &user_cache = nullptr)
                         : _file_service_name(file_service_name),
+                        _media_service_name(media_service_name),
                         _user_service_name(user_service_name),
                         _chatsession_service_name(chatsession_service_name),
                         _mm_channels(channels),
@@ -65,11 +75,14 @@ public:
                         _push_publisher(push_publisher),
                         _push_outbox(push_outbox),
                         _es_publisher(es_publisher),
-                        _es_outbox(es_outbox)
+                        _es_outbox(es_outbox),
+                        _last_msg(last_msg),
+                        _user_cache(user_cache)
     {
         _es_client->createIndex();
     }
     ~MessageServiceImpl() {
+        stop_db_batcher();
         stop_outbox_reaper();
         stop_es_outbox_reaper();
     }
@@ -111,15 +124,12 @@ public:
             response->set_success(true);
             return;
         }
-        //5. 统计所有文件类型消息的文件ID，并从文件子服务进行批量文件下载
-        std::unordered_set<std::string> file_id_list;
-        for(const auto &msg : msg_list) {
-            if(msg.file_id().empty()) continue;
-            LOG_DEBUG("需要下载的文件ID: {}", msg.file_id());
-            file_id_list.insert(msg.file_id());
-        }
+        //5. 准备附件：metadata_only 批量签下载 URL，否则从文件子服务批量下载字节
+        bool metadata_only = request->metadata_only();
         std::unordered_map<std::string, std::string> file_data_list;
-        bool ret = _GetFile(rid, file_id_list, file_data_list);
+        std::unordered_map<std::string, media::DownloadItem> media_list;
+        bool ret = _LoadAttachments(static_cast<brpc::Controller*>(controller), rid,
+                                    msg_list, metadata_only, file_data_list, media_list);
         if(ret == false) {
             LOG_ERROR("请求ID {} - 批量文件数据下载失败", rid);
             return err_response(rid, "批量文件数据下载失败");
@@ -144,31 +154,8 @@ public:
             message_info->set_chat_session_id(msg.session_id());
             message_info->set_timestamp(boost::posix_time::to_time_t(msg.create_time()));
             message_info->mutable_sender()->CopyFrom(user_list[msg.user_id()]);
-            switch(msg.message_type()) {
-                case MessageType::STRING:
-                    message_info->mutable_message()->set_message_type(MessageType::STRING);
-                    message_info->mutable_message()->mutable_string_message()->set_content(msg.content());
-                    break;
-                case MessageType::IMAGE:
-                    message_info->mutable_message()->set_message_type(MessageType::IMAGE);
-                    message_info->mutable_message()->mutable_image_message()->set_file_id(msg.file_id());
-                    message_info->mutable_message()->mutable_image_message()->set_image_content(file_data_list[msg.file_id()]);
-                    break;
-                case MessageType::FILE:
-                    message_info->mutable_message()->set_message_type(MessageType::FILE);
-                    message_info->mutable_message()->mutable_file_message()->set_file_id(msg.file_id());
-                    message_info->mutable_message()->mutable_file_message()->set_file_size(msg.file_size());
-                    message_info->mutable_message()->mutable_file_message()->set_file_name(msg.file_name());
-                    message_info->mutable_message()->mutable_file_message()->set_file_contents(file_data_list[msg.file_id()]);
-                    break;
-                case MessageType::SPEECH:
-                    message_info->mutable_message()->set_message_type(MessageType::FILE);
-                    message_info->mutable_message()->mutable_file_message()->set_file_id(msg.file_id());
-                    message_info->mutable_message()->mutable_file_message()->set_file_contents(file_data_list[msg.file_id()]);
-                    break;
-                default:
-                    LOG_ERROR("消息类型错误");
-                    return;
+            if(!_FillContent(msg, message_info->mutable_message(), metadata_only, file_data_list, media_list)) {
+                return;
             }
         }
         return;
@@ -211,14 +198,12 @@ public:
             return;
         }
 
-        std::unordered_set<std::string> file_id_list;
-        for(const auto &msg : msg_list) {
-            if(msg.file_id().empty()) continue;
-            LOG_DEBUG("需要下载的文件ID: {}", msg.file_id());
-            file_id_list.insert(msg.file_id());
-        }
+        //3. 准备附件：metadata_only 批量签下载 URL，否则从文件子服务批量下载字节
+        bool metadata_only = request->metadata_only();
         std::unordered_map<std::string, std::string> file_data_list;
-        bool ret = _GetFile(rid, file_id_list, file_data_list);
+        std::unordered_map<std::string, media::DownloadItem> media_list;
+        bool ret = _LoadAttachments(static_cast<brpc::Controller*>(controller), rid,
+                                    msg_list, metadata_only, file_data_list, media_list);
         if(ret == false) {
             LOG_ERROR("请求ID {} - 批量文件数据下载失败", rid);
             return err_response(rid, "批量文件数据下载失败");
@@ -245,35 +230,8 @@ public:
             message_info->set_client_msg_id(msg.client_msg_id());
             message_info->set_timestamp(boost::posix_time::to_time_t(msg.create_time()));
             message_info->mutable_sender()->CopyFrom(user_map[msg.user_id()]);
-            switch(msg.message_type()) {
-                case MessageType::STRING:
-                    LOG_DEBUG("消息是字符消息, 组织响应, 内容大小: {}", file_data_list[msg.file_id()].size());
-                    message_info->mutable_message()->set_message_type(MessageType::STRING);
-                    message_info->mutable_message()->mutable_string_message()->set_content(msg.content());
-                    break;
-                case MessageType::IMAGE:
-                    LOG_DEBUG("消息是图像消息, 组织响应, 内容大小: {}", file_data_list[msg.file_id()].size());
-                    message_info->mutable_message()->set_message_type(MessageType::IMAGE);
-                    message_info->mutable_message()->mutable_image_message()->set_file_id(msg.file_id());
-                    message_info->mutable_message()->mutable_image_message()->set_image_content(file_data_list[msg.file_id()]);
-                    break;
-                case MessageType::FILE:
-                    LOG_DEBUG("消息是文件消息, 组织响应, 内容大小: {}", file_data_list[msg.file_id()].size());
-                    message_info->mutable_message()->set_message_type(MessageType::FILE);
-                    message_info->mutable_message()->mutable_file_message()->set_file_id(msg.file_id());
-                    message_info->mutable_message()->mutable_file_message()->set_file_size(msg.file_size());
-                    message_info->mutable_message()->mutable_file_message()->set_file_name(msg.file_name());
-                    message_info->mutable_message()->mutable_file_message()->set_file_contents(file_data_list[msg.file_id()]);
-                    break;
-                case MessageType::SPEECH:
-                    LOG_DEBUG("消息是语音消息, 组织响应, 内容大小: {}", file_data_list[msg.file_id()].size());
-                    message_info->mutable_message()->set_message_type(MessageType::SPEECH);
-                    message_info->mutable_message()->mutable_speech_message()->set_file_id(msg.file_id());
-                    message_info->mutable_message()->mutable_speech_message()->set_file_contents(file_data_list[msg.file_id()]);
-                    break;
-                default:
-                    LOG_ERROR("消息类型错误");
-                    return;                
+            if(!_FillContent(msg, message_info->mutable_message(), metadata_only, file_data_list, media_list)) {
+                return;
             }
         }
         return;
@@ -392,16 +350,13 @@ public:
             return;
         }
 
-        // 6. 批量下载文件数据 (标准流程)
-        std::unordered_set<std::string> file_id_list;
-        for(const auto &msg : msg_list) {
-            if(!msg.file_id().empty()) file_id_list.insert(msg.file_id());
-        }
+        // 6. 准备附件：metadata_only 批量签下载 URL，否则批量下载文件数据
+        bool metadata_only = request->metadata_only();
         std::unordered_map<std::string, std::string> file_data_list;
-        if(!file_id_list.empty()) {
-            if(!_GetFile(rid, file_id_list, file_data_list)) {
-                return err_response(rid, "增量同步: 文件数据获取失败");
-            }
+        std::unordered_map<std::string, media::DownloadItem> media_list;
+        if(!_LoadAttachments(static_cast<brpc::Controller*>(controller), rid,
+                             msg_list, metadata_only, file_data_list, media_list)) {
+            return err_response(rid, "增量同步: 文件数据获取失败");
         }
 
         // 7. 批量获取用户信息 (标准流程)
@@ -436,33 +391,8 @@ public:
                 info->mutable_sender()->CopyFrom(user_map[msg.user_id()]);
             }
 
-            // 填充消息内容 (复用之前的 switch-case 逻辑，建议封装成函数 fill_content)
-            switch(msg.message_type()) {
-                case MessageType::STRING:
-                    info->mutable_message()->set_message_type(MessageType::STRING);
-                    info->mutable_message()->mutable_string_message()->set_content(msg.content());
-                    break;
-                case MessageType::IMAGE:
-                    info->mutable_message()->set_message_type(MessageType::IMAGE);
-                    info->mutable_message()->mutable_image_message()->set_file_id(msg.file_id());
-                    if(file_data_list.count(msg.file_id()))
-                         info->mutable_message()->mutable_image_message()->set_image_content(file_data_list[msg.file_id()]);
-                    break;
-                case MessageType::FILE:
-                    info->mutable_message()->set_message_type(MessageType::FILE);
-                    info->mutable_message()->mutable_file_message()->set_file_id(msg.file_id());
-                    info->mutable_message()->mutable_file_message()->set_file_size(msg.file_size());
-                    info->mutable_message()->mutable_file_message()->set_file_name(msg.file_name());
-                    if(file_data_list.count(msg.file_id()))
-                        info->mutable_message()->mutable_file_message()->set_file_contents(file_data_list[msg.file_id()]);
-                    break;
-                case MessageType::SPEECH:
-                    info->mutable_message()->set_message_type(MessageType::SPEECH);
-                    info->mutable_message()->mutable_speech_message()->set_file_id(msg.file_id());
-                    if(file_data_list.count(msg.file_id()))
-                        info->mutable_message()->mutable_speech_message()->set_file_contents(file_data_list[msg.file_id()]);
-                    break;
-            }
+            // 填充消息内容
+            _FillContent(msg, info->mutable_message(), metadata_only, file_data_list, media_list);
         }
     }
     /* brief: 获取未读消息数量
@@ -573,224 +503,227 @@ public:
         response->set_success(ok);
         if(!ok) response->set_errmsg("update last_ack_seq failed");
     }
+    /* brief: 批量 ACK 收敛（Push 按 (uid, ssid) 合并后定时上报）
+     *  - 非法项跳过；其余一个事务内多行 UPDATE ... JOIN 单调推进
+     *  - DAO 失败 → 返回 false，Push 放回合并缓冲下一轮重试
+     */
+    virtual void BatchUpdateAckSeq(google::protobuf::RpcController* controller,
+                                   const ::chatnow::BatchUpdateAckSeqReq* request,
+                                   ::chatnow::BatchUpdateAckSeqRsp* response,
+                                   ::google::protobuf::Closure* done)
+    {
+        brpc::ClosureGuard rpc_guard(done);
+        response->set_request_id(request->request_id());
+        std::vector<ChatSessionMemberTable::SeqAdvance> items;
+        items.reserve(request->cursors_size());
+        for(const auto &c : request->cursors()) {
+            if(c.user_id().empty() || c.chat_session_id().empty() || c.user_seq() == 0) continue;
+            items.push_back({c.chat_session_id(), c.user_id(), static_cast<unsigned long>(c.user_seq())});
+        }
+        bool ok = _mysql_member_table->update_last_ack_seq_many(items);
+        response->set_success(ok);
+        if(!ok) response->set_errmsg("batch update last_ack_seq failed");
+    }
+    /* brief: 批量取会话最新一条消息预览（会话服务拉列表时调用）
+     *  - 先一次 MGET 读 Redis 预览缓存；未命中的会话一条 SQL 批量回源 + 一次批量取发送者，
+     *    回源结果顺手回填缓存
+     *  - 预览是会话级的最新消息，不考虑单个用户对 Timeline 的删除
+     */
+    virtual void GetLatestMsgPreview(::google::protobuf::RpcController* controller,
+                              const ::chatnow::GetLatestMsgPreviewReq* request,
+                              ::chatnow::GetLatestMsgPreviewRsp* response,
+                              ::google::protobuf::Closure* done)
+    {
+        brpc::ClosureGuard rpc_guard(done);
+        std::string rid = request->request_id();
+        response->set_request_id(rid);
+        std::vector<std::string> ssids(request->chat_session_id_list().begin(),
+                                       request->chat_session_id_list().end());
+        //1. Redis 预览缓存
+        std::vector<std::string> missed;
+        if(_last_msg) {
+            auto cached = _last_msg->get_many(ssids);
+            for(size_t i = 0; i < ssids.size(); ++i) {
+                MessageInfo info;
+                if(cached[i] && info.ParseFromString(*cached[i])) {
+                    (*response->mutable_previews())[ssids[i]] = std::move(info);
+                } else {
+                    missed.push_back(ssids[i]);
+                }
+            }
+        } else {
+            missed = ssids;
+        }
+        if(missed.empty()) {
+            response->set_success(true);
+            return;
+        }
+        //2. 未命中：批量回源 DB
+        std::vector<chatnow::Message> msg_list = _mysql_message_table->latest_by_sessions(missed);
+        std::unordered_set<std::string> user_id_set;
+        for(const auto &msg : msg_list) user_id_set.insert(msg.user_id());
+        std::unordered_map<std::string, UserInfo> user_map;
+        if(!user_id_set.empty() && !_GetUser(rid, user_id_set, user_map)) {
+            // 发送者信息缺失不影响预览主体，仅带 user_id 返回
+            LOG_WARN("请求ID {} - 预览回源批量获取发送者失败，仅返回 user_id", rid);
+        }
+        std::vector<LastMessage::Entry> backfill;
+        backfill.reserve(msg_list.size());
+        for(const auto &msg : msg_list) {
+            MessageInfo info;
+            info.set_message_id(msg.message_id());
+            info.set_chat_session_id(msg.session_id());
+            info.set_seq_id(msg.seq_id());
+            info.set_client_msg_id(msg.client_msg_id());
+            info.set_timestamp(boost::posix_time::to_time_t(msg.create_time()));
+            auto uit = user_map.find(msg.user_id());
+            if(uit != user_map.end()) info.mutable_sender()->CopyFrom(uit->second);
+            else info.mutable_sender()->set_user_id(msg.user_id());
+            auto *content = info.mutable_message();
+            switch(msg.message_type()) {
+                case MessageType::STRING:
+                    content->set_message_type(MessageType::STRING);
+                    content->mutable_string_message()->set_content(msg.content());
+                    break;
+                case MessageType::IMAGE:
+                    content->set_message_type(MessageType::IMAGE);
+                    content->mutable_image_message()->set_file_id(msg.file_id());
+                    break;
+                case MessageType::FILE:
+                    content->set_message_type(MessageType::FILE);
+                    content->mutable_file_message()->set_file_id(msg.file_id());
+                    content->mutable_file_message()->set_file_size(msg.file_size());
+                    content->mutable_file_message()->set_file_name(msg.file_name());
+                    break;
+                case MessageType::SPEECH:
+                    content->set_message_type(MessageType::SPEECH);
+                    content->mutable_speech_message()->set_file_id(msg.file_id());
+                    break;
+                default:
+                    LOG_ERROR("请求ID {} - 预览回源遇到未知消息类型 mid={}", rid, msg.message_id());
+                    continue;
+            }
+            _strip_preview(info);
+            backfill.push_back({msg.session_id(), msg.seq_id(), info.SerializeAsString()});
+            (*response->mutable_previews())[msg.session_id()] = std::move(info);
+        }
+        if(_last_msg) _last_msg->set_many(backfill);
+        LOG_DEBUG("请求ID {} - 预览 {} 个会话，缓存未命中 {} 个，回源命中 {} 个",
+                  rid, ssids.size(), missed.size(), msg_list.size());
+        response->set_success(true);
+    }
     //================================================================================================//
     //=========================================== 消费回调 ============================================//
     //================================================================================================//
+    /* brief: 一条待落库消息；单条路径与攒批路径共用 */
+    struct DBRecord {
+        chatnow::InternalMessage internal_msg;
+        chatnow::Message msg;
+        std::vector<UserTimeline> timeline_list;
+        bool redelivered {false};
+        std::string trace_id;      // 攒批后在 flush 线程恢复 LogContext
+        SettleCallback settle;     // 仅攒批路径：批事务提交后逐条确认
+    };
+    using DBRecordPtr = std::shared_ptr<DBRecord>;
+
     /* brief: DB 消费：写 message 主表 + (写扩散群) user_timeline
      *  - 文件上传由客户端前置完成，本路径仅落 file_id
      *  - 大群（is_large_group=true）启用读扩散，仅写 message 主表
      */
     ConsumeAction onDBMessage(const char *body, size_t sz, bool redelivered) {
         LOG_DEBUG("收到新消息，进行存储处理！redelivered={}", redelivered);
-        //1. 反序列化
-        chatnow::InternalMessage internal_msg;
-        if(!internal_msg.ParseFromArray(body, sz)) {
-            LOG_ERROR("DB-Consumer: 反序列化失败");
-            return ConsumeAction::NackDiscard;
-        }
-
-        const auto &msg_info = internal_msg.message_info();
-        const unsigned long mid = msg_info.message_id();
-        const unsigned long session_seq = msg_info.seq_id();
-        const std::string &client_msg_id = msg_info.client_msg_id();
+        DBRecord rec;
+        if(!_build_db_record(body, sz, redelivered, rec)) return ConsumeAction::NackDiscard;
+        return _persist_one(rec);
+    }
 
-        //2. 提取消息体（文件已由客户端前置上传，仅取 file_id / 文本内容）
-        std::string file_id, file_name, content;
-        int64_t file_size = 0;
-        auto msg_type = msg_info.message().message_type();
-        switch(msg_type) {
-            case MessageType::STRING:
-                content = msg_info.message().string_message().content();
-                break;
-            case MessageType::IMAGE:
-                file_id = msg_info.message().image_message().file_id();
-                break;
-            case MessageType::FILE:
-                file_id = msg_info.message().file_message().file_id();
-                file_name = msg_info.message().file_message().file_name();
-                file_size = msg_info.message().file_message().file_size();
-                break;
-            case MessageType::SPEECH:
-                file_id = msg_info.message().speech_message().file_id();
-                break;
-            default:
-                LOG_ERROR("DB-Consumer: 未知消息类型 mid={}", mid);
-                return ConsumeAction::NackDiscard;
-        }
-        // 文件类型必须带 file_id（客户端前置上传契约）
-        if(msg_type != MessageType::STRING && file_id.empty()) {
-            LOG_ERROR("DB-Consumer: 非文本消息缺少 file_id mid={}", mid);
-            return ConsumeAction::NackDiscard;
+    /* brief: DB 消费（group commit）：解析后按 chat_session_id 入攒批队列，
+     *        批事务提交后再逐条 settle；在 MQ ev 线程调用
+     */
+    void onDBMessageDeferred(const char *body, size_t sz, bool redelivered, SettleCallback settle) {
+        auto rec = std::make_shared<DBRecord>();
+        if(!_build_db_record(body, sz, redelivered, *rec)) {
+            settle(ConsumeAction::NackDiscard);
+            return;
         }
-
-        //3. 组装 Message 对象
-        chatnow::Message msg(mid,
-                            msg_info.chat_session_id(),
-                            msg_info.sender().user_id(),
-                            msg_info.message().message_type(),
-                            boost::posix_time::from_time_t(msg_info.timestamp()),
-                            MessageStatus::NORMAL);
-        msg.seq_id(session_seq);
-        msg.content(content);
-        msg.file_id(file_id);
-        msg.file_name(file_name);
-        msg.file_size(file_size);
-        if(!client_msg_id.empty()) msg.client_msg_id(client_msg_id);
-
-        //4. 写扩散：组装 user_timeline 列表（仅小群；大群跳过实现读扩散）
-        std::vector<UserTimeline> timeline_list;
-        if(!internal_msg.is_large_group()) {
-            // 把 user_seqs 整理为 map 便于 O(1) 查找
-            std::unordered_map<std::string, unsigned long> uid2seq;
-            for(const auto &p : internal_msg.user_seqs()) {
-                uid2seq[p.user_id()] = p.user_seq();
-            }
-            timeline_list.reserve(internal_msg.member_id_list_size());
-            auto msg_pt = boost::posix_time::from_time_t(msg_info.timestamp());
-            for(const auto &member : internal_msg.member_id_list()) {
-                UserTimeline tl;
-                tl.user_id(member);
-                tl.session_id(msg_info.chat_session_id());
-                tl.message_id(mid);
-                tl.message_time(msg_pt);
-                tl.session_seq(session_seq);
-                auto it = uid2seq.find(member);
-                if(it != uid2seq.end()) tl.user_seq(it->second);
-                timeline_list.push_back(std::move(tl));
-            }
+        rec->trace_id = ::chatnow::log::LogContext::current().trace_id;
+        rec->settle = std::move(settle);
+        const std::string ssid = rec->internal_msg.message_info().chat_session_id();
+        if(!_db_batch || !_db_batch->submit(ssid, rec)) {
+            // 攒批队列已停止（进程关停中）：退回 broker
+            rec->settle(ConsumeAction::NackRequeue);
         }
+    }
 
-        //5. 事务落库
-        try {
-            odb::transaction trans(_db->begin());
-            _mysql_message_table->insert(msg);
-            if(!timeline_list.empty()) {
-                _mysql_usertimeline_table->insert(timeline_list);
-            }
-            trans.commit();
-
-            LOG_INFO("DB-Consumer: 消息落库 mid={} seq={} large={} timeline_count={}",
-                     mid, session_seq, internal_msg.is_large_group(), timeline_list.size());
-
-            // 6. DB commit 成功后投递 ES 索引事件（仅文本消息）
-            //    失败 → 落 ESOutbox，由独立 reaper 定期重投
-            if(msg_type == MessageType::STRING && _es_publisher) {
-                ESIndexEvent es_event;
-                es_event.set_message_id(static_cast<int64_t>(mid));
-                es_event.set_chat_session_id(msg_info.chat_session_id());
-                es_event.set_user_id(msg_info.sender().user_id());
-                es_event.set_content(content);
-                es_event.set_timestamp(msg_info.timestamp());
-                es_event.set_seq_id(session_seq);
-                es_event.set_message_type(MessageType::STRING);
-
-                std::string es_payload = es_event.SerializeAsString();
-                long long now_ts = static_cast<long long>(time(nullptr));
-                auto es_outbox = _es_outbox;
-                try {
-                    std::map<std::string, std::string> _hdrs;
-                    ::chatnow::mq::mq_inject_trace_headers(_hdrs);
-                    _es_publisher->publish_confirm(es_payload, _hdrs,
-                        [es_payload, es_outbox, mid, now_ts](PublishStatus st, const std::string &err) {
-                            if(st != PublishStatus::Acked) {
-                                LOG_WARN("ES-Publisher: 投递 es_index_exchange 失败 mid={} err={}, 入 ES outbox", mid, err);
-                                if(es_outbox) es_outbox->enqueue(es_payload, now_ts);
-                            }
-                        });
-                } catch(std::exception &e) {
-                    LOG_WARN("ES-Publisher: 同步异常 mid={} err={}, 入 ES outbox", mid, e.what());
-                    if(_es_outbox) _es_outbox->enqueue(es_payload, now_ts);
-                }
-            }
+    /* brief: 启动 group commit 攒批队列；lanes 条 lane 即最多 lanes 个并发批事务 */
+    void start_db_batcher(size_t lanes, size_t max_batch, int max_delay_ms) {
+        _db_batch = std::make_shared<BatchQueue<DBRecordPtr>>(
+            lanes, max_batch, std::chrono::milliseconds(max_delay_ms),
+            [this](std::vector<DBRecordPtr> &batch) { _flush_db_batch(batch); },
+            "db_commit");
+        LOG_INFO("DB group commit 启动: lanes={} max_batch={} max_delay={}ms",
+                 lanes, max_batch, max_delay_ms);
+    }
 
-            // 7. 落库成功后投递到 push_queue（fire-and-forget；推送服务消费）
-            //    投递失败 → 落 PushOutbox（Redis ZSET），由独立 reaper 定期重投，避免推送丢失
-            if(_push_publisher) {
-                std::string payload = internal_msg.SerializeAsString();
-                auto outbox = _push_outbox;  // 拷一份引用进 lambda
-                long long now_ts = static_cast<long long>(time(nullptr));
-                try {
-                    std::map<std::string, std::string> _hdrs;
-                    ::chatnow::mq::mq_inject_trace_headers(_hdrs);
-                    _push_publisher->publish_confirm(payload, _hdrs,
-                        [mid, payload, outbox, now_ts](PublishStatus status, const std::string &err) {
-                            if(status != PublishStatus::Acked) {
-                                LOG_WARN("Push-Publisher: 投递 push_queue 失败 mid={} err={}, 入 outbox", mid, err);
-                                if(outbox) outbox->enqueue(payload, now_ts);
-                            }
-                        });
-                } catch(std::exception &e) {
-                    LOG_WARN("Push-Publisher: 同步异常 mid={} err={}, 入 outbox", mid, e.what());
-                    if(_push_outbox) _push_outbox->enqueue(payload, now_ts);
-                }
-            }
-            return ConsumeAction::Ack;
-        } catch(const odb::object_already_persistent &e) {
-            // 唯一索引冲突（uk_session_seq / uk_client_msg）→ MQ 重投导致的重复消费，幂等丢弃
-            LOG_WARN("DB-Consumer: 重复消息（唯一索引命中），幂等丢弃 mid={} client_msg_id={} err={}",
-                     mid, client_msg_id, e.what());
-            return ConsumeAction::Ack;
-        } catch(std::exception &e) {
-            // redelivered=true 表示这条消息已经被 broker 重新投递过 → 上一次明确失败
-            // 再次失败则视为永久错误，进 DLX（避免 hot spin）
-            if(redelivered) {
-                LOG_ERROR("DB-Consumer: 二次失败转 DLX mid={} err={}", mid, e.what());
-                return ConsumeAction::NackDiscard;
-            }
-            LOG_ERROR("DB-Consumer: 事务失败（首次），重投 mid={} err={}", mid, e.what());
-            return ConsumeAction::NackRequeue;
-        }
+    /* brief: 停止攒批并排空：已入队消息全部提交并 settle；幂等 */
+    void stop_db_batcher() {
+        if(_db_batch) _db_batch->stop();
     }
 
     /* M3: PushOutbox reaper —
-     *   - 单独线程，每 kReapIntervalSec 唤醒；
-     *   - Redis SET NX EX 单实例租约（kLeaseTtlSec）保证多副本只一个实例真正消费；
-     *   - 从 outbox ZSET 取 kBatchLimit 条失败 payload，重投到 push_publisher；
-     *   - peek-then-zrem 防同批反复重投；publish_confirm 失败回调里重新 enqueue + bump 时间戳。
+     *   - 每个实例一个 reaper 线程，以 owner 为 consumer 名加入消费组，多实例并行排空积压、互不重复；
+     *   - 每轮先 XAUTOCLAIM 接管空闲超过 kClaimIdleMs 的未确认条目（重投失败 / 持有者崩溃），
+     *     没有再 XREADGROUP BLOCK 等新条目；有积压时连续消费，不再固定休眠；
+     *   - publish_confirm 被 broker 确认后才 XACK + XDEL；失败的留在 PEL，空闲到期后再被接管重投；
+     *     confirm 回调跑在 AMQP 事件线程，只 defer_ack 登记，由本线程每轮 flush_acks 批量提交；
+     *   - 线程启动时先把旧版 ZSET outbox 中的遗留条目搬进 stream。
      */
     void start_outbox_reaper(const std::string &owner) {
         if(!_push_outbox || !_push_publisher) {
             LOG_WARN("PushOutbox reaper 未启动：outbox / publisher 未注入");
             return;
         }
-        constexpr int kReapIntervalSec = 5;
-        constexpr int kLeaseTtlSec     = 30;
-        constexpr int kBatchLimit      = 50;
+        constexpr long long kBatchLimit = 200;
+        constexpr std::chrono::milliseconds kBlockMs(1000);
+        constexpr std::chrono::milliseconds kClaimIdleMs(30000);
+        _push_outbox->ensure_group();
         _reaper_running.store(true);
         _reaper_owner = owner;
-        _reaper_thread = std::thread([this]() {
+        _reaper_thread = std::thread([this, kBatchLimit, kBlockMs, kClaimIdleMs]() {
+            _push_outbox->migrate_legacy();
             while(_reaper_running.load()) {
                 try {
-                    if(!_push_outbox->try_acquire_reaper_lease(_reaper_owner, kLeaseTtlSec)) {
-                        std::this_thread::sleep_for(std::chrono::seconds(kReapIntervalSec));
-                        continue;
-                    }
-                    auto batch = _push_outbox->peek(kBatchLimit);
-                    if(batch.empty()) {
-                        std::this_thread::sleep_for(std::chrono::seconds(kReapIntervalSec));
-                        continue;
-                    }
+                    _push_outbox->flush_acks();
+                    auto batch = _push_outbox->reclaim(_reaper_owner, kClaimIdleMs, kBatchLimit);
+                    if(batch.empty()) batch = _push_outbox->read(_reaper_owner, kBatchLimit, kBlockMs);
+                    if(batch.empty()) continue;
                     LOG_INFO("PushOutbox reaper: 取出 {} 条失败投递准备重投", batch.size());
-                    for(const auto &payload : batch) _push_outbox->remove(payload);
                     auto outbox = _push_outbox;
-                    for(const auto &payload : batch) {
-                        std::string p = payload;
-                        _push_publisher->publish_confirm(p,
-                            [outbox, p](PublishStatus status, const std::string &err) {
-                                if(status == PublishStatus::Acked) return;
-                                LOG_WARN("PushOutbox reaper 重投仍失败，回排入 outbox：{}", err);
-                                if(outbox) outbox->enqueue(
-                                    p, static_cast<long long>(time(nullptr)));
+                    for(const auto &e : batch) {
+                        const std::string *p = e.get("p");
+                        if(!p) {
+                            outbox->ack({e.id});
+                            continue;
+                        }
+                        std::string id = e.id;
+                        _push_publisher->publish_confirm(*p,
+                            [outbox, id](PublishStatus status, const std::string &err) {
+                                if(status == PublishStatus::Acked) {
+                                    outbox->defer_ack(id);
+                                    return;
+                                }
+                                LOG_WARN("PushOutbox reaper 重投仍失败，留待接管重试 id={}：{}", id, err);
                             });
                     }
                 } catch(std::exception &e) {
                     LOG_ERROR("PushOutbox reaper 异常: {}", e.what());
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
                 } catch(...) {
                     LOG_ERROR("PushOutbox reaper 未知异常");
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
                 }
-                std::this_thread::sleep_for(std::chrono::seconds(kReapIntervalSec));
             }
-            if(_push_outbox) _push_outbox->release_reaper_lease(_reaper_owner);
+            _push_outbox->flush_acks();
             LOG_INFO("PushOutbox reaper 已停止");
         });
     }
@@ -800,55 +733,57 @@ public:
         if(_reaper_thread.joinable()) _reaper_thread.join();
     }
 
+    /* brief: ES outbox reaper，消费方式同 PushOutbox reaper */
     void start_es_outbox_reaper(const std::string &owner) {
         if(!_es_outbox || !_es_publisher) {
             LOG_WARN("ES outbox reaper 未启动：es_outbox / es_publisher 未注入");
             return;
         }
-        constexpr int kReapIntervalSec = 5;
-        constexpr int kLeaseTtlSec     = 30;
-        constexpr int kBatchLimit      = 50;
+        constexpr long long kBatchLimit = 200;
+        constexpr std::chrono::milliseconds kBlockMs(1000);
+        constexpr std::chrono::milliseconds kClaimIdleMs(30000);
+        _es_outbox->ensure_group();
         _es_reaper_running.store(true);
         _es_reaper_owner = owner;
-        _es_reaper_thread = std::thread([this]() {
+        _es_reaper_thread = std::thread([this, kBatchLimit, kBlockMs, kClaimIdleMs]() {
+            _es_outbox->migrate_legacy();
             while(_es_reaper_running.load()) {
                 try {
-                    if(!_es_outbox->try_acquire_reaper_lease(_es_reaper_owner, kLeaseTtlSec)) {
-                        std::this_thread::sleep_for(std::chrono::seconds(kReapIntervalSec));
-                        continue;
-                    }
-                    auto batch = _es_outbox->peek(kBatchLimit);
-                    if(batch.empty()) {
-                        std::this_thread::sleep_for(std::chrono::seconds(kReapIntervalSec));
-                        continue;
-                    }
+                    _es_outbox->flush_acks();
+                    auto batch = _es_outbox->reclaim(_es_reaper_owner, kClaimIdleMs, kBatchLimit);
+                    if(batch.empty()) batch = _es_outbox->read(_es_reaper_owner, kBatchLimit, kBlockMs);
+                    if(batch.empty()) continue;
                     LOG_INFO("ES outbox reaper: 取出 {} 条待重投", batch.size());
-                    for(const auto &payload : batch) _es_outbox->remove(payload);
                     auto es_outbox = _es_outbox;
-                    for(const auto &payload : batch) {
-                        std::string p = payload;
+                    for(const auto &e : batch) {
+                        const std::string *p = e.get("p");
+                        if(!p) {
+                            es_outbox->ack({e.id});
+                            continue;
+                        }
+                        std::string id = e.id;
                         try {
-                            _es_publisher->publish_confirm(p,
-                                [es_outbox, p](PublishStatus st, const std::string &err) {
-                                    if(st == PublishStatus::Acked) return;
-                                    LOG_WARN("ES outbox reaper 重投仍失败: {}", err);
-                                    if(es_outbox) es_outbox->enqueue(
-                                        p, static_cast<long long>(time(nullptr)));
+                            _es_publisher->publish_confirm(*p,
+                                [es_outbox, id](PublishStatus st, const std::string &err) {
+                                    if(st == PublishStatus::Acked) {
+                                        es_outbox->defer_ack(id);
+                                        return;
+                                    }
+                                    LOG_WARN("ES outbox reaper 重投仍失败，留待接管重试 id={}: {}", id, err);
                                 });
-                        } catch(std::exception &e) {
-                            LOG_WARN("ES outbox reaper publish_confirm 同步异常: {}", e.what());
-                            if(es_outbox) es_outbox->enqueue(
-                                p, static_cast<long long>(time(nullptr)));
+                        } catch(std::exception &ex) {
+                            LOG_WARN("ES outbox reaper publish_confirm 同步异常 id={}: {}", id, ex.what());
                         }
                     }
                 } catch(std::exception &e) {
                     LOG_ERROR("ES outbox reaper 异常: {}", e.what());
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
                 } catch(...) {
                     LOG_ERROR("ES outbox reaper 未知异常");
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
                 }
-                std::this_thread::sleep_for(std::chrono::seconds(kReapIntervalSec));
             }
-            if(_es_outbox) _es_outbox->release_reaper_lease(_es_reaper_owner);
+            _es_outbox->flush_acks();
             LOG_INFO("ES outbox reaper 已停止");
         });
     }
@@ -932,10 +867,271 @@ public:
         return ConsumeAction::Ack;
     }
 private:
+    /* brief: 在当前线程恢复消息的 trace_id，离开作用域清理 */
+    struct _TraceScope {
+        explicit _TraceScope(const std::string &trace_id) {
+            ::chatnow::log::LogContext::set(trace_id, "", "");
+        }
+        ~_TraceScope() { ::chatnow::log::LogContext::clear(); }
+    };
+
+    /* brief: 反序列化 + 组装 Message / UserTimeline；失败（不可恢复）返回 false */
+    bool _build_db_record(const char *body, size_t sz, bool redelivered, DBRecord &rec) {
+        rec.redelivered = redelivered;
+        //1. 反序列化
+        chatnow::InternalMessage &internal_msg = rec.internal_msg;
+        if(!internal_msg.ParseFromArray(body, sz)) {
+            LOG_ERROR("DB-Consumer: 反序列化失败");
+            return false;
+        }
+
+        const auto &msg_info = internal_msg.message_info();
+        const unsigned long mid = msg_info.message_id();
+        const unsigned long session_seq = msg_info.seq_id();
+        const std::string &client_msg_id = msg_info.client_msg_id();
+
+        //2. 提取消息体（文件已由客户端前置上传，仅取 file_id / 文本内容）
+        std::string file_id, file_name, content;
+        int64_t file_size = 0;
+        auto msg_type = msg_info.message().message_type();
+        switch(msg_type) {
+            case MessageType::STRING:
+                content = msg_info.message().string_message().content();
+                break;
+            case MessageType::IMAGE:
+                file_id = msg_info.message().image_message().file_id();
+                break;
+            case MessageType::FILE:
+                file_id = msg_info.message().file_message().file_id();
+                file_name = msg_info.message().file_message().file_name();
+                file_size = msg_info.message().file_message().file_size();
+                break;
+            case MessageType::SPEECH:
+                file_id = msg_info.message().speech_message().file_id();
+                break;
+            default:
+                LOG_ERROR("DB-Consumer: 未知消息类型 mid={}", mid);
+                return false;
+        }
+        // 文件类型必须带 file_id（客户端前置上传契约）
+        if(msg_type != MessageType::STRING && file_id.empty()) {
+            LOG_ERROR("DB-Consumer: 非文本消息缺少 file_id mid={}", mid);
+            return false;
+        }
+
+        //3. 组装 Message 对象
+        chatnow::Message msg(mid,
+                            msg_info.chat_session_id(),
+                            msg_info.sender().user_id(),
+                            msg_info.message().message_type(),
+                            boost::posix_time::from_time_t(msg_info.timestamp()),
+                            MessageStatus::NORMAL);
+        msg.seq_id(session_seq);
+        msg.content(content);
+        msg.file_id(file_id);
+        msg.file_name(file_name);
+        msg.file_size(file_size);
+        if(!client_msg_id.empty()) msg.client_msg_id(client_msg_id);
+        rec.msg = std::move(msg);
+
+        //4. 写扩散：组装 user_timeline 列表（仅小群；大群跳过实现读扩散）
+        if(!internal_msg.is_large_group()) {
+            // 把 user_seqs 整理为 map 便于 O(1) 查找
+            std::unordered_map<std::string, unsigned long> uid2seq;
+            for(const auto &p : internal_msg.user_seqs()) {
+                uid2seq[p.user_id()] = p.user_seq();
+            }
+            rec.timeline_list.reserve(internal_msg.member_id_list_size());
+            auto msg_pt = boost::posix_time::from_time_t(msg_info.timestamp());
+            for(const auto &member : internal_msg.member_id_list()) {
+                UserTimeline tl;
+                tl.user_id(member);
+                tl.session_id(msg_info.chat_session_id());
+                tl.message_id(mid);
+                tl.message_time(msg_pt);
+                tl.session_seq(session_seq);
+                auto it = uid2seq.find(member);
+                if(it != uid2seq.end()) tl.user_seq(it->second);
+                rec.timeline_list.push_back(std::move(tl));
+            }
+        }
+        return true;
+    }
+
+    /* brief: 单条事务落库；重复消息 / 首次失败 / 二次失败的判定都在这里（逐条幂等语义） */
+    ConsumeAction _persist_one(DBRecord &rec) {
+        const auto &msg_info = rec.internal_msg.message_info();
+        const unsigned long mid = msg_info.message_id();
+        try {
+            odb::transaction trans(_db->begin());
+            _mysql_message_table->insert(rec.msg);
+            if(!rec.timeline_list.empty()) {
+                _mysql_usertimeline_table->insert(rec.timeline_list);
+            }
+            trans.commit();
+
+            LOG_INFO("DB-Consumer: 消息落库 mid={} seq={} large={} timeline_count={}",
+                     mid, msg_info.seq_id(), rec.internal_msg.is_large_group(), rec.timeline_list.size());
+            if(_last_msg) _last_msg->set(msg_info.chat_session_id(), msg_info.seq_id(), _preview_of(msg_info));
+            _after_commit(rec);
+            return ConsumeAction::Ack;
+        } catch(const odb::object_already_persistent &e) {
+            // 唯一索引冲突（uk_session_seq / uk_client_msg）→ MQ 重投导致的重复消费，幂等丢弃
+            LOG_WARN("DB-Consumer: 重复消息（唯一索引命中），幂等丢弃 mid={} client_msg_id={} err={}",
+                     mid, msg_info.client_msg_id(), e.what());
+            return ConsumeAction::Ack;
+        } catch(std::exception &e) {
+            // redelivered=true 表示这条消息已经被 broker 重新投递过 → 上一次明确失败
+            // 再次失败则视为永久错误，进 DLX（避免 hot spin）
+            if(rec.redelivered) {
+                LOG_ERROR("DB-Consumer: 二次失败转 DLX mid={} err={}", mid, e.what());
+                return ConsumeAction::NackDiscard;
+            }
+            LOG_ERROR("DB-Consumer: 事务失败（首次），重投 mid={} err={}", mid, e.what());
+            return ConsumeAction::NackRequeue;
+        }
+    }
+
+    /* brief: group commit：一批消息一个事务，message / user_timeline 各走多行 INSERT
+     *  - 提交成功 → 逐条投递 ES / push，再逐条 Ack
+     *  - 批事务失败（含任一条唯一索引冲突）→ 整批回滚，逐条走 _persist_one 兜底，
+     *    重复消息 / 首次失败 / 二次失败的判定与单条路径完全一致
+     */
+    void _flush_db_batch(std::vector<DBRecordPtr> &batch) {
+        if(batch.size() == 1) {
+            auto &rec = *batch.front();
+            _TraceScope scope(rec.trace_id);
+            rec.settle(_persist_one(rec));
+            return;
+        }
+        std::vector<chatnow::Message> msgs;
+        std::vector<UserTimeline> timelines;
+        msgs.reserve(batch.size());
+        for(const auto &rec : batch) {
+            msgs.push_back(rec->msg);
+            timelines.insert(timelines.end(), rec->timeline_list.begin(), rec->timeline_list.end());
+        }
+        try {
+            odb::transaction trans(_db->begin());
+            _mysql_message_table->insert_multi(msgs);
+            _mysql_usertimeline_table->insert_multi(timelines);
+            trans.commit();
+        } catch(std::exception &e) {
+            LOG_WARN("DB-Consumer: 批量事务失败 size={}，逐条兜底: {}", batch.size(), e.what());
+            for(auto &rec : batch) {
+                _TraceScope scope(rec->trace_id);
+                rec->settle(_persist_one(*rec));
+            }
+            return;
+        }
+        LOG_INFO("DB-Consumer: 批量落库 size={} timeline_count={}", batch.size(), timelines.size());
+        // 会话预览：一批一次 pipeline，先于 push 投递写入，客户端收到通知后拉列表即可看到
+        if(_last_msg) {
+            std::vector<LastMessage::Entry> previews;
+            previews.reserve(batch.size());
+            for(const auto &rec : batch) {
+                const auto &info = rec->internal_msg.message_info();
+                previews.push_back({info.chat_session_id(), info.seq_id(), _preview_of(info)});
+            }
+            _last_msg->set_many(previews);
+        }
+        for(auto &rec : batch) {
+            _TraceScope scope(rec->trace_id);
+            _after_commit(*rec);
+            rec->settle(ConsumeAction::Ack);
+        }
+    }
+
+    /* brief: 会话列表预览：去掉文件二进制与发送者头像后序列化 */
+    static void _strip_preview(MessageInfo &preview) {
+        preview.mutable_sender()->clear_avatar();
+        auto *content = preview.mutable_message();
+        if(content->has_image_message())  content->mutable_image_message()->clear_image_content();
+        if(content->has_file_message())   content->mutable_file_message()->clear_file_contents();
+        if(content->has_speech_message()) content->mutable_speech_message()->clear_file_contents();
+    }
+    static std::string _preview_of(const MessageInfo &msg_info) {
+        MessageInfo preview(msg_info);
+        _strip_preview(preview);
+        return preview.SerializeAsString();
+    }
+
+    /* brief: DB commit 成功后的下游投递：ES 索引事件 + push_queue */
+    void _after_commit(const DBRecord &rec) {
+        const auto &internal_msg = rec.internal_msg;
+        const auto &msg_info = internal_msg.message_info();
+        const unsigned long mid = msg_info.message_id();
+
+        // 6. DB commit 成功后投递 ES 索引事件（仅文本消息）
+        //    失败 → 落 ESOutbox，由独立 reaper 定期重投
+        if(msg_info.message().message_type() == MessageType::STRING && _es_publisher) {
+            ESIndexEvent es_event;
+            es_event.set_message_id(static_cast<int64_t>(mid));
+            es_event.set_chat_session_id(msg_info.chat_session_id());
+            es_event.set_user_id(msg_info.sender().user_id());
+            es_event.set_content(msg_info.message().string_message().content());
+            es_event.set_timestamp(msg_info.timestamp());
+            es_event.set_seq_id(msg_info.seq_id());
+            es_event.set_message_type(MessageType::STRING);
+
+            std::string es_payload = es_event.SerializeAsString();
+            auto es_outbox = _es_outbox;
+            try {
+                std::map<std::string, std::string> _hdrs;
+                ::chatnow::mq::mq_inject_trace_headers(_hdrs);
+                _es_publisher->publish_confirm(es_payload, _hdrs,
+                    [es_payload, es_outbox, mid](PublishStatus st, const std::string &err) {
+                        if(st != PublishStatus::Acked) {
+                            LOG_WARN("ES-Publisher: 投递 es_index_exchange 失败 mid={} err={}, 入 ES outbox", mid, err);
+                            if(es_outbox) es_outbox->enqueue(es_payload);
+                        }
+                    });
+            } catch(std::exception &e) {
+                LOG_WARN("ES-Publisher: 同步异常 mid={} err={}, 入 ES outbox", mid, e.what());
+                if(_es_outbox) _es_outbox->enqueue(es_payload);
+            }
+        }
+
+        // 7. 落库成功后投递到 push_queue（fire-and-forget；推送服务消费）
+        //    投递失败 → 落 PushOutbox（Redis Stream），由 reaper 消费组重投，避免推送丢失
+        if(_push_publisher) {
+            std::string payload = internal_msg.SerializeAsString();
+            auto outbox = _push_outbox;  // 拷一份引用进 lambda
+            try {
+                std::map<std::string, std::string> _hdrs;
+                ::chatnow::mq::mq_inject_trace_headers(_hdrs);
+                _push_publisher->publish_confirm(payload, _hdrs,
+                    [mid, payload, outbox](PublishStatus status, const std::string &err) {
+                        if(status != PublishStatus::Acked) {
+                            LOG_WARN("Push-Publisher: 投递 push_queue 失败 mid={} err={}, 入 outbox", mid, err);
+                            if(outbox) outbox->enqueue(payload);
+                        }
+                    });
+            } catch(std::exception &e) {
+                LOG_WARN("Push-Publisher: 同步异常 mid={} err={}, 入 outbox", mid, e.what());
+                if(_push_outbox) _push_outbox->enqueue(payload);
+            }
+        }
+    }
+
+    /* brief: 批量取发送者资料（含头像）：优先 UserInfoCache，miss 部分合并为一次 GetMultiUserInfo */
     bool _GetUser(const std::string &rid,
                 const std::unordered_set<std::string> &user_id_list,
                 std::unordered_map<std::string, UserInfo> &user_list)
     {
+        std::vector<std::string> uids(user_id_list.begin(), user_id_list.end());
+        if(!_user_cache) return _LoadUsers(rid, uids, user_list);
+        return _user_cache->get_many(uids, user_list,
+            [this, &rid](const std::vector<std::string> &miss, std::unordered_map<std::string, UserInfo> &out) {
+                return _LoadUsers(rid, miss, out);
+            });
+    }
+
+    bool _LoadUsers(const std::string &rid,
+                const std::vector<std::string> &uids,
+                std::unordered_map<std::string, UserInfo> &user_list)
+    {
+        if(uids.empty()) return true;
         auto channel = _mm_channels->choose(_user_service_name);
         if(!channel) {
             LOG_ERROR("{} 没有可供访问的用户子服务节点", _user_service_name);
@@ -945,7 +1141,7 @@ private:
         GetMultiUserInfoReq req;
         GetMultiUserInfoRsp rsp;
         req.set_request_id(rid);
-        for(const auto &id : user_id_list) {
+        for(const auto &id : uids) {
             req.add_users_id(id);
         }
         brpc::Controller cntl;
@@ -990,6 +1186,119 @@ private:
         return true;
     }
 
+    /* brief: 按拉取模式准备本页附件
+     *  - metadata_only：向媒体服务批量签下载 URL；签发失败不致命，MediaRef 仍带 file_id / size，
+     *    客户端可单独 ApplyDownload
+     *  - 否则沿用文件子服务 GetMultiFile 内联字节（旧客户端兼容）
+     */
+    bool _LoadAttachments(brpc::Controller *in_cntl, const std::string &rid,
+                          const std::vector<chatnow::Message> &msg_list, bool metadata_only,
+                          std::unordered_map<std::string, std::string> &file_data_list,
+                          std::unordered_map<std::string, media::DownloadItem> &media_list)
+    {
+        std::unordered_set<std::string> file_id_list;
+        for(const auto &msg : msg_list) {
+            if(!msg.file_id().empty()) file_id_list.insert(msg.file_id());
+        }
+        if(file_id_list.empty()) return true;
+        if(!metadata_only) return _GetFile(rid, file_id_list, file_data_list);
+        if(!_ResolveMedia(in_cntl, rid, file_id_list, media_list)) {
+            LOG_WARN("请求ID {} - 附件下载 URL 签发失败，仅返回 file_id", rid);
+        }
+        return true;
+    }
+
+    /* brief: 媒体服务 BatchApplyDownload，按 kMediaBatchLimit 分段；结果按 file_id 索引 */
+    bool _ResolveMedia(brpc::Controller *in_cntl, const std::string &rid,
+                       const std::unordered_set<std::string> &file_id_list,
+                       std::unordered_map<std::string, media::DownloadItem> &media_list)
+    {
+        if(_media_service_name.empty()) return false;
+        auto channel = _mm_channels->choose(_media_service_name);
+        if(!channel) {
+            LOG_ERROR("{} 没有可供访问的媒体子服务节点", _media_service_name);
+            return false;
+        }
+        media::MediaService_Stub stub(channel.get());
+        auto it = file_id_list.begin();
+        while(it != file_id_list.end()) {
+            media::BatchApplyDownloadReq req;
+            media::BatchApplyDownloadRsp rsp;
+            req.set_request_id(rid);
+            for(size_t n = 0; n < kMediaBatchLimit && it != file_id_list.end(); ++n, ++it) {
+                req.add_file_ids(*it);
+            }
+            brpc::Controller cntl;
+            auth::forward_auth_metadata(in_cntl, &cntl);
+            // 下载授权只认网关鉴权后转发的身份；请求体中的 user_id 不可信，不能代为签发
+            if(cntl.http_request().GetHeader(auth::kMetaUserId) == nullptr) {
+                LOG_WARN("请求ID {} - 缺少鉴权 metadata，不签发附件下载 URL", rid);
+                return false;
+            }
+            stub.BatchApplyDownload(&cntl, &req, &rsp, nullptr);
+            if(cntl.Failed() == true || rsp.header().success() == false) {
+                LOG_ERROR("媒体子服务调用失败: {} {}", cntl.ErrorText(), rsp.header().error_message());
+                return false;
+            }
+            for(auto &item : *rsp.mutable_items()) {
+                std::string fid = item.file_info().file_id();
+                media_list.emplace(std::move(fid), std::move(item));
+            }
+        }
+        return true;
+    }
+
+    /* brief: Message 行 → MessageContent；附件按 file_data_list（内联字节）或 media_list（MediaRef）填充 */
+    static bool _FillContent(const chatnow::Message &msg, MessageContent *content, bool metadata_only,
+                             const std::unordered_map<std::string, std::string> &file_data_list,
+                             const std::unordered_map<std::string, media::DownloadItem> &media_list)
+    {
+        const std::string *data = nullptr;
+        if(!metadata_only) {
+            auto it = file_data_list.find(msg.file_id());
+            if(it != file_data_list.end()) data = &it->second;
+        }
+        switch(msg.message_type()) {
+            case MessageType::STRING:
+                content->set_message_type(MessageType::STRING);
+                content->mutable_string_message()->set_content(msg.content());
+                break;
+            case MessageType::IMAGE:
+                content->set_message_type(MessageType::IMAGE);
+                content->mutable_image_message()->set_file_id(msg.file_id());
+                if(data) content->mutable_image_message()->set_image_content(*data);
+                break;
+            case MessageType::FILE:
+                content->set_message_type(MessageType::FILE);
+                content->mutable_file_message()->set_file_id(msg.file_id());
+                content->mutable_file_message()->set_file_size(msg.file_size());
+                content->mutable_file_message()->set_file_name(msg.file_name());
+                if(data) content->mutable_file_message()->set_file_contents(*data);
+                break;
+            case MessageType::SPEECH:
+                content->set_message_type(MessageType::SPEECH);
+                content->mutable_speech_message()->set_file_id(msg.file_id());
+                if(data) content->mutable_speech_message()->set_file_contents(*data);
+                break;
+            default:
+                LOG_ERROR("消息类型错误");
+                return false;
+        }
+        if(metadata_only && !msg.file_id().empty()) {
+            auto ref = content->mutable_media_ref();
+            ref->set_file_id(msg.file_id());
+            ref->set_file_size(msg.file_size());
+            auto it = media_list.find(msg.file_id());
+            if(it != media_list.end()) {
+                ref->set_file_size(it->second.file_info().file_size());
+                ref->set_mime_type(it->second.file_info().mime_type());
+                ref->set_download_url(it->second.download_url());
+                ref->set_expires_in_sec(it->second.expires_in_sec());
+            }
+        }
+        return true;
+    }
+
     bool _PutFile(const std::string &filename, const std::string &body, const int64_t fsize, std::string &file_id) {
         //实现文件数据的上传
         auto channel = _mm_channels->choose(_file_service_name);
@@ -1013,7 +1322,11 @@ private:
         return true;
     }
 private:
+    // 与媒体服务 DownloadHandler::kMaxBatchDownload 对齐
+    static constexpr size_t kMediaBatchLimit = 500;
+
     std::string _file_service_name;
+    std::string _media_service_name;
     std::string _user_service_name;
     std::string _chatsession_service_name;
     std::shared_ptr<odb::core::database> _db;
@@ -1031,6 +1344,8 @@ private:
     PushOutbox::ptr _push_outbox;    // push_queue 投递失败兜底
     Publisher::ptr _es_publisher;  // DB commit 后向 es_index_exchange 投递 ESIndexEvent
     ESOutbox::ptr  _es_outbox;     // ES 索引投递失败兜底
+    LastMessage::ptr _last_msg;    // 会话最新消息预览（commit 后写，会话列表批量读）
+    UserInfoCache<UserInfo>::ptr _user_cache;   // 发送者资料（含头像），命中免 user 服务 RPC
 
     // M3: outbox reaper 状态
     std::atomic<bool> _reaper_running {false};
@@ -1041,6 +1356,9 @@ private:
     std::atomic<bool> _es_reaper_running {false};
     std::thread _es_reaper_thread;
     std::string _es_reaper_owner;
+
+    // group commit 攒批队列；未启动时 DB 消费走单条事务路径
+    BatchQueue<DBRecordPtr>::ptr _db_batch;
 };
 
 class MessageServer
@@ -1065,7 +1383,8 @@ public:
     ~MessageServer() = default;
     /* M3: 按顺序退出，避免 ev 线程访问已 delete 的 MessageServiceImpl
      *  1) RunUntilAskedToQuit 返回（brpc 已开始 Stop）
-     *  2) 先停 reaper 主线程（不再发起 publish_confirm）
+     *  2) 先停 reaper 主线程（不再发起 publish_confirm）；排空 DB 攒批队列
+     *     （ev 线程仍在，批内消息提交后的 ack 能正常发出）
      *  3) 释放 mq_client → MQClient 析构关闭 channel + join ev 线程，未决回调丢弃
      *  4) brpc Join 等 in-flight RPC，brpc::Server 析构再 delete impl
      */
@@ -1075,6 +1394,7 @@ public:
         if(_service_impl) {
             _service_impl->stop_outbox_reaper();
             _service_impl->stop_es_outbox_reaper();
+            _service_impl->stop_db_batcher();
         }
         _mq_client.reset();
         _rpc_server->Join();
@@ -1096,7 +1416,7 @@ class MessageServerBuilder
 public:
     /* brief: 构造es客户端对象 */
     void make_es_object(const std::vector<std::string> host_list) { _es_client = ESClientFactory::create(host_list); }
-    /* brief: 构造 Redis 客户端 + SeqGen + PushOutbox */
+    /* brief: 构造 Redis 客户端 + SeqGen + PushOutbox / ESOutbox + LastMessage 预览缓存 */
     void make_redis_object(const std::string &host, uint16_t port, int db,
                            bool keep_alive, int pool_size)
     {
@@ -1104,6 +1424,8 @@ public:
         _seq_gen = std::make_shared<SeqGen>(_redis);
         _push_outbox = std::make_shared<PushOutbox>(_redis);
         _es_outbox = std::make_shared<ESOutbox>(_redis);
+        _last_msg = std::make_shared<LastMessage>(_redis);
+        _user_cache = std::make_shared<UserInfoCache<UserInfo>>(_redis);
     }
     /* brief: 构造推送队列 Publisher（写 timeline 后向 push_queue 投递） */
     void make_push_publisher(const std::string &exchange,
@@ -1176,14 +1498,18 @@ public:
                             const std::string &base_service_name,
                             const std::string &file_service_name,
                             const std::string &user_service_name,
-                            const std::string &chatsession_service_name)
+                            const std::string &chatsession_service_name,
+                            const std::string &media_service_name = "")
     {
         _file_service_name = file_service_name;
+        _media_service_name = media_service_name;
         _user_service_name = user_service_name;
         _chatsession_service_name = chatsession_service_name;
         _mm_channels = std::make_shared<ServiceManager>();
         _mm_channels->declared(_file_service_name);
         _mm_channels->declared(_user_service_name);
+        // 为空时 metadata_only 拉取不签 URL，只回 file_id / size
+        if(!_media_service_name.empty()) _mm_channels->declared(_media_service_name);
         auto put_cb = std::bind(&ServiceManager::onServiceOnline, _mm_channels.get(), std::placeholders::_1, std::placeholders::_2);
         auto del_cb = std::bind(&ServiceManager::onServiceOffline, _mm_channels.get(), std::placeholders::_1, std::placeholders::_2);
 
@@ -1270,7 +1596,7 @@ public:
             _subscriber_db, _subscriber_es,
             _db_queue_settings, _es_queue_settings,
             _seq_gen, _push_publisher, _push_outbox,
-            _es_publisher, _es_outbox);
+            _es_publisher, _es_outbox, _last_msg, _media_service_name, _user_cache);
         _service_impl = message_service;  // 观察指针，build() 时透传给 MessageServer
         int ret = _rpc_server->AddService(message_service, brpc::ServiceOwnership::SERVER_OWNS_SERVICE);
         if(ret == -1) {
@@ -1305,9 +1631,30 @@ public:
             return callback_es_inner(body, sz, redeliv);
         };
 
-        LOG_INFO("开始向 Broker 订阅消费者队列...");
-        _subscriber_db->consume(std::move(callback_db));
-        _subscriber_es->consume(std::move(callback_es));
+        LOG_INFO("开始向 Broker 订阅消费者队列... workers={} db_batch={}", _consume_workers, _db_batch_size);
+        // 按 chat_session_id 分片并行消费：同会话保序，跨会话多核并行
+        // InternalMessage.message_info(1).chat_session_id(2) / ESIndexEvent.chat_session_id(2)
+        if(_db_batch_size > 1) {
+            // group commit：ev 线程只解析入队，lane 线程攒批提交后统一 ack；
+            // lane 数即并发批事务数，prefetch 放大到能同时攒满所有 lane
+            size_t lanes = std::max<size_t>(_consume_workers, 1);
+            message_service->start_db_batcher(lanes, _db_batch_size, _db_batch_delay_ms);
+            chatnow::DeferredMessageCallback callback_db_deferred =
+                [message_service](const char* body, size_t sz, bool redeliv,
+                                  const std::map<std::string, std::string>& headers,
+                                  chatnow::SettleCallback settle) {
+                std::string _trace_id = ::chatnow::mq::mq_extract_trace_id(headers);
+                ::chatnow::log::LogContext::set(_trace_id, "", "");
+                struct _Scope { ~_Scope() { ::chatnow::log::LogContext::clear(); } } _scope;
+                message_service->onDBMessageDeferred(body, sz, redeliv, std::move(settle));
+            };
+            size_t prefetch = std::min<size_t>(std::max<size_t>(lanes * _db_batch_size * 2, kDefaultPrefetch),
+                                               std::numeric_limits<uint16_t>::max());
+            _subscriber_db->consume_deferred(std::move(callback_db_deferred), static_cast<uint16_t>(prefetch));
+        } else {
+            _subscriber_db->consume_sharded(std::move(callback_db), pb_field_shard_key({1, 2}), _consume_workers);
+        }
+        _subscriber_es->consume_sharded(std::move(callback_es), pb_field_shard_key({1, 2}), _consume_workers);
         if(_subscriber_es_index) {
             auto callback_es_index_inner = std::bind(&MessageServiceImpl::onESIndexMessage, message_service,
                                                      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
@@ -1318,16 +1665,24 @@ public:
                 struct _Scope { ~_Scope() { ::chatnow::log::LogContext::clear(); } } _scope;
                 return callback_es_index_inner(body, sz, redeliv);
             };
-            _subscriber_es_index->consume(std::move(callback_es_index));
+            _subscriber_es_index->consume_sharded(std::move(callback_es_index),
+                                                  pb_field_shard_key({2}), _consume_workers);
         }
         LOG_INFO("队列订阅完成，服务全面启动！");
 
-        // M3: 启动 PushOutbox reaper（多副本只一个实例真正消费，靠 Redis SET NX EX 选主）
+        // M3: 启动 PushOutbox / ES outbox reaper（消费组：多副本并行消费，owner 即 consumer 名）
         std::string owner = _reaper_owner.empty()
             ? std::to_string(::getpid()) : _reaper_owner;
         message_service->start_outbox_reaper(owner);
         message_service->start_es_outbox_reaper(owner);
     }
+    /* brief: 设置 MQ 消费 worker 数；0 = 在 ev 线程内联消费（须在 make_rpc_object 之前调用） */
+    void set_consume_workers(size_t workers) { _consume_workers = workers; }
+    /* brief: 设置 DB 消费 group commit 参数；max_batch <= 1 关闭攒批（须在 make_rpc_object 之前调用） */
+    void set_db_batch(size_t max_batch, int max_delay_ms) {
+        _db_batch_size = max_batch;
+        _db_batch_delay_ms = max_delay_ms;
+    }
     /* brief: 设置 reaper owner 标识（access_host:pid 等），用于多实例租约辨识 */
     void set_reaper_owner(const std::string &owner) { _reaper_owner = owner; }
     /* brief: 启动时从 DB 回填 Redis session_seq / user_seq */
@@ -1382,6 +1737,7 @@ public:
     }
 private:
     std::string _file_service_name;
+    std::string _media_service_name;
     std::string _user_service_name;
     std::string _chatsession_service_name;
     ServiceManager::ptr _mm_channels;
@@ -1398,10 +1754,15 @@ private:
     PushOutbox::ptr _push_outbox;
     Publisher::ptr _es_publisher;
     ESOutbox::ptr  _es_outbox;
+    LastMessage::ptr _last_msg;
+    UserInfoCache<UserInfo>::ptr _user_cache;
     declare_settings _es_pub_settings;
     declare_settings _es_index_settings;
     Subscriber::ptr _subscriber_es_index;
     std::string _reaper_owner;
+    size_t _consume_workers {0};
+    size_t _db_batch_size {0};
+    int _db_batch_delay_ms {5};
     MessageServiceImpl *_service_impl {nullptr};  // brpc 拥有，仅观察指针用
 
     Discovery::ptr _service_discover;   // 服务发现客户端
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "utils/pb_splice.hpp"
+#include "push/notify.pb.h"
+
+namespace chatnow
+{
+
+/**
+ * PushPayloadEncoder
+ * ---------------------------------------------------------------------------
+ * 聊天消息推送帧编码：NotifyMessage 模板序列化一次，按收件人把
+ * new_message_info.message_info.user_seq 拼接到预编码缓冲中。
+ * MQ 消费（onPushMessage）与 PushToUser / PushBatch 共用。
+ *
+ * - 非聊天通知或模板缺少 new_message_info：所有收件人共用 base()
+ * - 拼接初始化失败（理论上不会发生）时回退到 CopyFrom + SerializeAsString
+ */
+class PushPayloadEncoder
+{
+public:
+    explicit PushPayloadEncoder(const NotifyMessage &tmpl)
+        : _chat(tmpl.notify_type() == NotifyType::CHAT_MESSAGE_NOTIFY && tmpl.has_new_message_info())
+    {
+        std::string base = tmpl.SerializeAsString();
+        if(!_chat) {
+            _splicer.init(std::move(base), {}, 0);
+            return;
+        }
+        if(!_splicer.init(std::move(base),
+                          {NotifyMessage::kNewMessageInfoFieldNumber,
+                           NotifyNewMessage::kMessageInfoFieldNumber},
+                          MessageInfo::kUserSeqFieldNumber)) {
+            _fallback = tmpl;
+        }
+    }
+
+    /* brief: 不带 user_seq 的帧（非聊天通知 / 大群读扩散收件人） */
+    const std::string &base() const { return _splicer.base(); }
+
+    /* brief: 带 user_seq 的帧；非聊天通知忽略 user_seq */
+    std::string encode(unsigned long user_seq) const {
+        if(!_chat) return _splicer.base();
+        if(_splicer.ok()) return _splicer.encode(user_seq);
+        NotifyMessage per_user = _fallback;
+        per_user.mutable_new_message_info()->mutable_message_info()->set_user_seq(user_seq);
+        return per_user.SerializeAsString();
+    }
+
+private:
+    bool _chat;
+    pb_wire::VarintSplicer _splicer;
+    NotifyMessage _fallback;
+};
+
+} // namespace chatnow
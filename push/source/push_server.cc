@@ -13,9 +13,12 @@ DEFINE_int32(listen_port, 10008, "Push brpc 监听端口");
 DEFINE_int32(ws_port, 9001, "Push WebSocket 监听端口");
 DEFINE_int32(rpc_timeout, -1, "RPC调用超时时间");
 DEFINE_int32(rpc_threads, 4, "RPC的IO线程数量");
+DEFINE_int32(ws_threads, 4, "WebSocket I/O 线程数（共享 io_service，连接级 strand 串行）");
+DEFINE_int32(ws_workers, 8, "WebSocket 上行处理 worker 数（鉴权 / 心跳等 Redis 调用，按连接分片保序）");
 
 DEFINE_string(message_service, "/service/message_service", "消息存储子服务名称（用于 ACK 收敛）");
 DEFINE_string(push_service, "/service/push_service", "推送子服务名称（自身，便于跨实例转发）");
+DEFINE_string(chatsession_service, "/service/chatsession_service", "会话管理子服务名称（大群订阅登记；置空则大群按逐成员路由）");
 
 DEFINE_string(redis_host, "127.0.0.1", "Redis 服务器访问地址");
 DEFINE_int32(redis_port, 6379, "Redis 端口");
@@ -29,10 +32,15 @@ DEFINE_string(mq_host, "127.0.0.1:5672", "MQ 地址");
 DEFINE_string(mq_push_exchange, "chat_push_exchange", "推送交换机");
 DEFINE_string(mq_push_queue, "msg_push_queue", "推送队列");
 DEFINE_string(mq_push_binding_key, "push", "推送绑定键");
+DEFINE_int32(mq_consume_workers, 4, "推送队列消费并行 worker 数（按会话分片保序，0 为 ev 线程内联消费）");
 
-// M5: 心跳触发未 ack 重传的可调参数
-DEFINE_int32(resend_batch, 50, "心跳触发未 ack 重传的批量上限");
-DEFINE_int32(resend_max_age_sec, 5, "未 ack 项入队后等待多少秒视为可重传");
+// M5: 未 ack 重传的可调参数（时间轮驱动）
+DEFINE_int32(resend_batch, 50, "单次回查补推的消息条数上限");
+DEFINE_int32(resend_max_age_sec, 5, "未 ack 推送首次重传等待秒数，之后按次数指数退避");
+
+DEFINE_int32(ack_flush_interval_ms, 200, "送达 ACK 合并刷写间隔（毫秒）；0 为每个 ACK 立即单独上报");
+DEFINE_int32(ack_flush_batch, 500, "单次 BatchUpdateAckSeq 最多携带的游标数");
+DEFINE_int32(payload_cache_mb, 64, "重传帧缓存上限（MB），按 message_id 每条消息存一份");
 
 int main(int argc, char *argv[])
 {
@@ -44,9 +52,14 @@ int main(int argc, char *argv[])
                           FLAGS_redis_keep_alive, FLAGS_redis_pool_size);
     psb.make_mq_object(FLAGS_mq_user, FLAGS_mq_pswd, FLAGS_mq_host,
                        FLAGS_mq_push_exchange, FLAGS_mq_push_queue, FLAGS_mq_push_binding_key);
-    psb.make_discovery_object(FLAGS_registry_host, FLAGS_base_service, FLAGS_message_service, FLAGS_push_service);
+    psb.make_discovery_object(FLAGS_registry_host, FLAGS_base_service, FLAGS_message_service, FLAGS_push_service,
+                              FLAGS_chatsession_service);
     psb.make_reg_object(FLAGS_registry_host, FLAGS_base_service + FLAGS_instance_name, FLAGS_access_host);
     psb.set_resend_params(FLAGS_resend_batch, FLAGS_resend_max_age_sec);
+    psb.set_ack_flush_params(FLAGS_ack_flush_interval_ms, FLAGS_ack_flush_batch);
+    psb.set_payload_cache_mb(FLAGS_payload_cache_mb);
+    psb.set_consume_workers(FLAGS_mq_consume_workers);
+    psb.set_ws_threads(FLAGS_ws_threads, FLAGS_ws_workers);
     psb.make_rpc_object(FLAGS_listen_port, FLAGS_rpc_timeout, FLAGS_rpc_threads, FLAGS_ws_port);
 
     auto server = psb.build();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "connection.hpp"
+#include "push_payload.hpp"
 #include "infra/etcd.hpp"
 #include "infra/logger.hpp"
 #include "mq/channel.hpp"
@@ -9,10 +10,18 @@
 #include "log/log_context.hpp"
 #include "dao/data_redis.hpp"
 #include "utils/brpc_closure.hpp"
+#include "utils/sharded_executor.hpp"
+#include "utils/session_interest.hpp"
+#include "utils/ack_coalescer.hpp"
+#include "utils/retransmit_window.hpp"
+#include "utils/byte_lru_cache.hpp"
+#include "utils/timing_wheel.hpp"
+#include "utils/touch_scheduler.hpp"
 #include "common/types.pb.h"
 #include "common/error.pb.h"
 #include "common/envelope.pb.h"
 #include "presence/presence_service.pb.h"
+#include "conversation/conversation_service.pb.h"
 #include "push/notify.pb.h"
 #include "push/push_service.pb.h"
 #include "message/message_types.pb.h"
@@ -26,19 +35,54 @@
 namespace chatnow
 {
 
+// 读扩散大群门限：与 transmite 的 LARGE_GROUP_THRESHOLD 保持一致，Push 只为这些会话登记订阅
+inline constexpr uint32_t LARGE_GROUP_THRESHOLD = 200;
+
 /**
  * PushServiceImpl
  * ---------------------------------------------------------------------------
  * 职责：
  *   1. 终结客户端 WebSocket 长连接 + 维护本实例内存中的 uid→conn 映射
  *   2. 把"用户在哪些 push 实例上"写到 Redis（im:online:{uid} → SET<instance>），
- *      让其它 push 实例 / 调用方按 uid 路由到正确实例
+ *      让其它 push 实例 / 调用方按 uid 路由到正确实例；路由有效性以本实例存活租约
+ *      （im:push:lease:{instance}）为准，心跳不再逐连接 EXPIRE，TTL 续期按用户限频后批量发出
  *   3. 提供 brpc PushService 接口给其它服务调用（friend / chatsession / message）
  *   4. 订阅 msg_push_queue：消息落库后由 message 服务投递到此队列，本服务消费后下发
- *   5. 推送 ACK + 重传：未 ack 的 user_seq 进入 Redis Sorted Set，心跳/重连时补送
+ *   5. 推送 ACK + 重传：持连实例内存维护每用户未确认窗口（RetransmitWindow，累计确认），
+ *      每条待确认推送在时间轮上挂重传截止时间（按次数指数退避），到期未确认才重发；
+ *      Redis 只存每用户确认高水位，供重连到其它实例时补推
+ *      窗口只记 user_seq → message_id，推送帧按 message_id 存一份于按字节限额的 _payloads
+ *   6. 大群订阅：本机用户上线时查其所在大群，登记 im:push:sub:{ssid}；读扩散大群消息
+ *      每个订阅实例只收一次 PushBatch，由对端按本机连接表展开，不再逐成员查路由；
+ *      大群列表尚未查清的实例登记 pending（视为订阅全部大群），消息携带的成员版本与订阅集合
+ *      校正过的版本不一致时该条改走逐成员路由，收件实例按会话补登订阅
  */
 class PushServiceImpl : public PushService
 {
+    // 重传时间轮：tick 精度、退避上限与最多重发次数
+    static constexpr int64_t  kRetransmitTickMs       = 100;
+    static constexpr int64_t  kRetransmitMaxBackoffMs = 60 * 1000;
+    static constexpr uint32_t kRetransmitMaxAttempts  = 8;
+    struct RetransmitTimer {
+        std::string uid;
+        uint64_t seq;
+        uint32_t attempt;       // 到期时应处于的重发次数，与窗口不一致即作废
+    };
+    // 大群订阅校正：逐成员投递的各对端 PushBatch 全部成功后才记该成员版本已校正
+    struct SyncProgress {
+        SyncProgress(const SessionSubscribers::ptr &subs, const std::string &ssid, long long ver, size_t peers)
+            : subs(subs), ssid(ssid), ver(ver), left(peers) {}
+        void done(bool ok) {
+            if(!ok) failed.store(true);
+            if(left.fetch_sub(1) == 1 && !failed.load()) subs->mark_synced(ssid, ver);
+        }
+        SessionSubscribers::ptr subs;
+        std::string ssid;
+        long long ver;
+        std::atomic<size_t> left;
+        std::atomic<bool> failed {false};
+    };
+
 public:
     PushServiceImpl(const Connection::ptr &connections,
                     const Session::ptr &redis_session,
@@ -48,7 +92,10 @@ public:
                     const CrossInstanceOutbox::ptr &cross_outbox,
                     const std::string &instance_id,
                     const std::string &message_service_name,
-                    const ServiceManager::ptr &channels)
+                    const ServiceManager::ptr &channels,
+                    const SessionSubscribers::ptr &subscribers = nullptr,
+                    const std::string &chatsession_service_name = "",
+                    const PushLease::ptr &lease = nullptr)
         : _connections(connections),
           _redis_session(redis_session),
           _redis_status(redis_status),
@@ -57,14 +104,32 @@ public:
           _cross_outbox(cross_outbox),
           _instance_id(instance_id),
           _message_service_name(message_service_name),
-          _mm_channels(channels) {}
+          _mm_channels(channels),
+          _subscribers(subscribers),
+          _chatsession_service_name(chatsession_service_name),
+          _lease(lease) {}
 
     /* M5: 重发参数注入（gflags 来源） */
     void set_resend_params(long batch, long max_age_sec) {
         _resend_batch = batch;
         _resend_max_age_sec = max_age_sec;
     }
-    ~PushServiceImpl() { stop_cross_outbox_reaper(); }
+    /* ACK 合并刷写参数：interval_ms = 0 表示每个 ACK 立即单独上报 */
+    void set_ack_flush_params(long interval_ms, long batch) {
+        _ack_flush_interval_ms = interval_ms;
+        _ack_flush_batch = batch <= 0 ? 500 : batch;
+    }
+    /* 重传帧缓存字节上限（须在开始服务前调用） */
+    void set_payload_cache_bytes(size_t bytes) {
+        _payloads = std::make_shared<PayloadCache>(bytes);
+    }
+    ~PushServiceImpl() {
+        stop_cross_outbox_reaper();
+        stop_subscription_refresher();
+        stop_ack_flusher();
+        stop_retransmit_timer();
+        stop_presence_refresher();
+    }
 
     // brpc: 单用户推送（其它服务调用）
     void PushToUser(google::protobuf::RpcController* controller,
@@ -78,25 +143,15 @@ public:
 
         // 若调用方带了 user_seq 且为聊天消息：覆写到 MessageInfo.user_seq，
         // 让客户端能据此正确填 NotifyMsgPushAck（B1）。
-        std::string payload;
-        const NotifyMessage &notify = request->notify();
-        if(request->has_user_seq() &&
-           notify.notify_type() == NotifyType::CHAT_MESSAGE_NOTIFY &&
-           notify.has_new_message_info()) {
-            NotifyMessage per_user = notify;
-            per_user.mutable_new_message_info()->mutable_message_info()
-                ->set_user_seq(request->user_seq());
-            payload = per_user.SerializeAsString();
-        } else {
-            payload = notify.SerializeAsString();
-        }
-
-        int delivered = _local_send(request->user_id(), payload);
-        // 若是聊天消息推送：未 ack 入未送达缓冲，等客户端 ack/心跳触发补送
-        if(request->has_user_seq() && _unacked) {
-            _unacked->push(request->user_id(),
-                           static_cast<unsigned long>(request->user_seq()),
-                           static_cast<long long>(time(nullptr)));
+        auto encoder = std::make_shared<const PushPayloadEncoder>(request->notify());
+        int delivered = request->has_user_seq()
+            ? _local_send(request->user_id(), encoder->encode(static_cast<unsigned long>(request->user_seq())))
+            : _local_send(request->user_id(), encoder->base());
+        // 若是聊天消息推送且已下发：入本机未确认窗口，等客户端 ack / 心跳触发重发
+        if(request->has_user_seq() && delivered > 0) {
+            int64_t mid = _remember(request->notify(), encoder);
+            if(_window.push(request->user_id(), request->user_seq(), mid))
+                _arm(request->user_id(), request->user_seq(), 0, _now_ms());
         }
         response->set_success(true);
         response->set_online_device_count(delivered);
@@ -111,34 +166,32 @@ public:
         std::unordered_map<std::string, unsigned long> uid2seq;
         for(const auto &p : request->user_seqs()) uid2seq[p.user_id()] = p.user_seq();
 
-        const NotifyMessage &base_notify = request->notify();
-        // 仅消息推送类型才需要 per-uid 覆写 user_seq；其它通知（好友 / 会话）走原 payload
-        bool is_chat_msg = (base_notify.notify_type() == NotifyType::CHAT_MESSAGE_NOTIFY) &&
-                          base_notify.has_new_message_info();
-        std::string broadcast_payload;
-        if(!is_chat_msg) broadcast_payload = base_notify.SerializeAsString();
+        // 仅消息推送类型才需要 per-uid 注入 user_seq；其它通知（好友 / 会话）共用 base 帧
+        auto encoder = std::make_shared<const PushPayloadEncoder>(request->notify());
 
         int total = 0;
-        long long now_ts = static_cast<long long>(time(nullptr));
+        int64_t now_ms = _now_ms();
+        int64_t mid = -1;       // 首个入窗口的收件人出现时才登记缓存
+        const std::string &join_ssid = request->subscribe_session_id();
+        bool joined = false;
         for(const auto &uid : request->user_id_list()) {
-            std::string payload;
-            if(is_chat_msg) {
-                NotifyMessage per_user = base_notify;
-                auto it = uid2seq.find(uid);
-                if(it != uid2seq.end()) {
-                    per_user.mutable_new_message_info()->mutable_message_info()->set_user_seq(it->second);
+            auto it = uid2seq.find(uid);
+            if(it == uid2seq.end()) {
+                if(_local_send(uid, encoder->base()) > 0) {
+                    total++;
+                    // 读扩散大群逐成员投递：送达的收件人补登该会话（成员变更 / 刚达到门限后首次出现）
+                    if(!join_ssid.empty() && _subscribers && _interest.join(uid, join_ssid)) joined = true;
                 }
-                payload = per_user.SerializeAsString();
-            } else {
-                payload = broadcast_payload;
+                continue;
             }
-            int n = _local_send(uid, payload);
-            if(n > 0) total++;
-            auto it = uid2seq.find(uid);
-            if(it != uid2seq.end() && _unacked) {
-                _unacked->push(uid, it->second, now_ts);
+            if(_local_send(uid, encoder->encode(it->second)) > 0) {
+                total++;
+                if(mid < 0) mid = _remember(request->notify(), encoder);
+                if(_window.push(uid, it->second, mid)) _arm(uid, it->second, 0, now_ms);
             }
         }
+        // 订阅登记完成后才回包：发送方据全部对端成功判定订阅集合已校正
+        if(joined) _subscribers->subscribe_many({join_ssid}, _instance_id);
         response->set_request_id(request->request_id());
         response->set_success(true);
         response->set_online_count(total);
@@ -171,78 +224,101 @@ public:
         if (!_ctx_trace.empty()) {
             notify_template.set_trace_id(_ctx_trace);
         }
+        // 模板只序列化一次，收件人帧只拼接 user_seq
+        auto encoder = std::make_shared<const PushPayloadEncoder>(notify_template);
         auto build_payload_for = [&](const std::string &uid) -> std::string {
-            NotifyMessage notify = notify_template;
             auto it = uid2seq.find(uid);
-            if(it != uid2seq.end()) {
-                notify.mutable_new_message_info()->mutable_message_info()->set_user_seq(it->second);
-            }
+            if(it != uid2seq.end()) return encoder->encode(it->second);
             // 大群读扩散无 user_seq → 不下发 ACK 链路（客户端按 (session_id, seq_id) 增量补漏）
-            return notify.SerializeAsString();
+            return encoder->base();
         };
 
-        // 1) 写未 ack 缓冲（在尝试推送前先入队，确保对端 ack 前可重传）
-        long long now_ts = static_cast<long long>(time(nullptr));
-        if(_unacked) {
-            for(const auto &uid : internal_msg.member_id_list()) {
-                auto it = uid2seq.find(uid);
-                if(it != uid2seq.end()) _unacked->push(uid, it->second, now_ts);
-            }
-        }
-
-        // 2) 本机直推 → 命中则跳过远端
+        // 1) 本机直推 → 命中则跳过远端；已下发且带 user_seq 的入本机未确认窗口
+        //    （未确认状态只由持连实例维护：远端收件人由对端 PushBatch 入窗口，离线用户重连时补推）
+        int64_t now_ms = _now_ms();
         std::vector<std::string> remote_uids;
         remote_uids.reserve(internal_msg.member_id_list_size());
+        int64_t mid = -1;       // 同一条消息的帧只缓存一份，所有本机收件人共用
+        const bool large = internal_msg.is_large_group() && _subscribers;
+        std::vector<std::string> local_uids;     // 大群本机送达的收件人（订阅校正时补登）
         for(const auto &uid : internal_msg.member_id_list()) {
-            std::string payload = build_payload_for(uid);
-            int n = _local_send(uid, payload);
-            if(n == 0) remote_uids.push_back(uid);
-            else {
-                auto it = uid2seq.find(uid);
-                if(it != uid2seq.end()) {
-                    std::string cache_key = uid + ":" + std::to_string(it->second);
-                    std::lock_guard<std::mutex> lock(_msg_cache_mu);
-                    auto cache_it = _msg_cache.find(cache_key);
-                    if(cache_it != _msg_cache.end()) {
-                        (*cache_it->second)->payload = std::move(payload);
-                    } else {
-                        _msg_evict_list.push_back({cache_key, std::move(payload)});
-                        auto new_it = std::prev(_msg_evict_list.end());
-                        _msg_cache[cache_key] = new_it;
-                        if(_msg_evict_list.size() > _msg_cache_max_entries) {
-                            _msg_cache.erase(_msg_evict_list.front().key);
-                            _msg_evict_list.pop_front();
-                        }
-                    }
-                }
+            int n = _local_send(uid, build_payload_for(uid));
+            if(n == 0) {
+                remote_uids.push_back(uid);
+                continue;
             }
+            if(large) local_uids.push_back(uid);
+            auto it = uid2seq.find(uid);
+            if(it == uid2seq.end()) continue;
+            if(mid < 0) mid = _remember(notify_template, encoder);
+            if(_window.push(uid, it->second, mid)) _arm(uid, it->second, 0, now_ms);
         }
-        if(remote_uids.empty()) return ConsumeAction::Ack;
-
-        // 3) 跨实例：按 push 实例 ID 分组（OnlineRoute 一次查询每个 uid 命中实例集合）
+        // 2) 跨实例：
+        //    - 读扩散大群：取订阅了该会话的实例（含 pending 实例），每个实例发一次全部未命中 uid，
+        //      对端按本机连接表展开
+        //    - 大群订阅集合未按本条消息的成员版本校正过（成员变更 / 刚达到门限 / 校正过期 / 版本未知 /
+        //      订阅查询失败）：本条改走逐 uid 路由，收件实例补登订阅，全部对端成功后记为已校正
+        //    - 其余：按 push 实例 ID 分组（OnlineRoute 一次 pipeline 取全部未命中 uid 的实例集合）
+        const std::string &ssid = msg_info.chat_session_id();
+        const long long members_ver = internal_msg.members_version();
         std::unordered_map<std::string, std::vector<std::string>> peer_to_uids;
-        for(const auto &uid : remote_uids) {
-            auto its = _online_route ? _online_route->instances(uid) : std::vector<std::string>{};
-            for(const auto &peer : its) {
-                if(peer == _instance_id) continue;
-                peer_to_uids[peer].push_back(uid);
-                break;  // 同一 uid 命中一个对端就够
+        std::vector<std::string> subscribed;
+        long long synced_ver = -1;
+        bool broadcast = large && _subscribers->instances(ssid, subscribed, synced_ver) &&
+                         members_ver >= 0 && synced_ver == members_ver;
+        const bool resync = large && !broadcast;
+        if(resync) {
+            bool joined = false;
+            for(const auto &uid : local_uids) joined = _interest.join(uid, ssid) || joined;
+            if(joined) _subscribers->subscribe_many({ssid}, _instance_id);
+        }
+        if(remote_uids.empty()) {
+            if(resync) _subscribers->mark_synced(ssid, members_ver);
+            return ConsumeAction::Ack;
+        }
+
+        if(broadcast) {
+            for(const auto &peer : subscribed) {
+                if(peer != _instance_id) peer_to_uids[peer];    // 广播：uid 列表统一用 remote_uids
+            }
+        } else {
+            auto routes = _online_route ? _online_route->instances_many(remote_uids)
+                                        : std::unordered_map<std::string, std::vector<std::string>>{};
+            for(const auto &uid : remote_uids) {
+                auto route = routes.find(uid);
+                if(route == routes.end()) continue;
+                for(const auto &peer : route->second) {
+                    if(peer == _instance_id) continue;
+                    peer_to_uids[peer].push_back(uid);
+                    break;  // 同一 uid 命中一个对端就够
+                }
             }
         }
 
-        // 4) 每个对端一次 PushBatch（异步 brpc::DoNothing）
+        // 3) 每个对端一次 PushBatch（异步 brpc::DoNothing）
+        //    广播失败不清 OnlineRoute：对端未必持有这些 uid，其订阅租约到期后自然失效
+        auto online = broadcast ? nullptr : _online_route;
+        // 订阅校正：最后一个对端回包时判定，任一对端失败则不记，下一条消息重新校正
+        std::shared_ptr<SyncProgress> sync;
+        if(resync) {
+            if(peer_to_uids.empty()) _subscribers->mark_synced(ssid, members_ver);     // 未命中的收件人均不在线
+            else sync = std::make_shared<SyncProgress>(_subscribers, ssid, members_ver, peer_to_uids.size());
+        }
+        // 失败兜底用的 InternalMessage 原文：各对端共用一份，首次用到时才序列化
+        std::shared_ptr<const std::string> raw;
+        auto raw_msg = [&]() {
+            if(!raw) raw = std::make_shared<const std::string>(internal_msg.SerializeAsString());
+            return raw;
+        };
         for(auto &kv : peer_to_uids) {
             const std::string &peer = kv.first;
-            const auto &uids = kv.second;
+            const auto &uids = broadcast ? remote_uids : kv.second;
             auto channel = _mm_channels->choose(peer);
             if(!channel) {
                 LOG_WARN("Push-Consumer: 对端 {} 不可达，{} 个用户入 CrossInstanceOutbox", peer, uids.size());
-                for(const auto &u : uids)
-                    if(_online_route) _online_route->unbind(u, peer);
-                if(_cross_outbox) {
-                    std::string b64 = _utils_base64_encode(internal_msg.SerializeAsString());
-                    _cross_outbox->enqueue(b64, uids, peer, now_ts);
-                }
+                if(online) online->unbind_many(uids, peer);
+                if(_cross_outbox) _cross_outbox->enqueue(*raw_msg(), uids, peer);
+                if(sync) sync->done(false);
                 continue;
             }
             PushService_Stub stub(channel.get());
@@ -258,20 +334,17 @@ public:
                 p->set_user_id(u);
                 p->set_user_seq(it->second);
             }
+            if(resync) closure->req.set_subscribe_session_id(ssid);
             std::string peer_id = peer;
-            std::string payload_b64 = _utils_base64_encode(internal_msg.SerializeAsString());
-            closure->on_done = [peer_id, uids, outbox = _cross_outbox, online = _online_route,
-                                payload_b64, now_ts]
+            closure->on_done = [peer_id, uids, outbox = _cross_outbox, online, sync, payload = raw_msg()]
                 (brpc::Controller *c, const PushBatchRsp &) {
                 if(c->Failed()) {
                     LOG_WARN("PushBatch 跨实例失败 peer={}: {}，入 CrossInstanceOutbox",
                              peer_id, c->ErrorText());
-                    for(const auto &u : uids)
-                        if(online) online->unbind(u, peer_id);
-                    if(outbox) {
-                        outbox->enqueue(payload_b64, uids, peer_id, now_ts);
-                    }
+                    if(online) online->unbind_many(uids, peer_id);
+                    if(outbox) outbox->enqueue(*payload, uids, peer_id);
                 }
+                if(sync) sync->done(!c->Failed());
             };
             stub.PushBatch(&closure->cntl, &closure->req, &closure->rsp, closure);
         }
@@ -292,7 +365,13 @@ public:
                          ack.user_id(), ack.chat_session_id());
                 return;
             }
-            if(_unacked) _unacked->ack(ack.user_id(), ack.user_seq());
+            // 累计确认：≤ user_seq 的全部出窗口；高水位由刷写线程批量写 Redis
+            _window.ack(ack.user_id(), ack.user_seq());
+            // 合并模式：只记 (uid, ssid) 的最大 seq，由刷写线程定时批量上报
+            if(_ack_flush_interval_ms > 0) {
+                _acks->add(ack.user_id(), ack.chat_session_id(), ack.user_seq());
+                return;
+            }
             // 异步上报 last_ack_seq；失败 → LOG_WARN（DAO 单调推进，下次 ACK 会带更新的 seq 自动 catchup）
             auto channel = _mm_channels->choose(_message_service_name);
             if(!channel) {
@@ -321,217 +400,171 @@ public:
         }
     }
 
-    /* M5: 心跳触发未 ack 重传 —
-     *  - peek_due：拿到一批入队超过 max_age 的成熟 user_seq（不删除）
-     *  - 异步调 message.GetOfflineMsg(uid, last_user_seq, msg_count)；不阻塞 WS asio 单线程
-     *  - 回调里按 message_id->user_seq 映射配对（不依赖列表下标，规避 select_by_ids 跨会话排序）
-     *  - bump_score：把这批 score 推到 now，并续期 7 天 TTL，避免老 unacked 整 key 过期消失
+    /* M5: 心跳 —
+     *  - 心跳带的 last_user_seq 是客户端连续收到的最大 seq，按累计确认收敛窗口
+     *  - 重传由时间轮驱动，心跳不再扫描窗口；只在窗口溢出淘汰过 (acked, evicted] 时回查补齐
      */
     void _on_heartbeat_resend(const ::chatnow::NotifyHeartbeat &hb) {
-        if(!_unacked) return;
-        const std::string uid = hb.user_id();
+        const std::string &uid = hb.user_id();
         if(uid.empty()) return;
-        auto pending = _unacked->peek_due(uid, _resend_batch, _resend_max_age_sec);
-        if(pending.empty()) return;
-        // 解析 user_seq 数值；构 set 给回调过滤；同时算 last_user_seq 起点
-        std::unordered_set<uint64_t> pending_set;
-        pending_set.reserve(pending.size());
-        uint64_t min_seq = std::numeric_limits<uint64_t>::max();
-        for(const auto &s : pending) {
-            try {
-                uint64_t v = std::stoull(s);
-                pending_set.insert(v);
-                if(v < min_seq) min_seq = v;
-            } catch(...) { LOG_WARN("Heartbeat-补送 非法 user_seq={}", s); }
-        }
-        if(pending_set.empty()) return;
-
-        // 先查本地缓存
-        std::vector<uint64_t> cache_hits;
-        std::vector<uint64_t> cache_misses;
-        {
-            std::lock_guard<std::mutex> lock(_msg_cache_mu);
-            for(uint64_t us : pending_set) {
-                std::string key = uid + ":" + std::to_string(us);
-                if(_msg_cache.find(key) != _msg_cache.end()) {
-                    cache_hits.push_back(us);
-                } else {
-                    cache_misses.push_back(us);
-                }
-            }
-        }
-
-        // 缓存命中：直接 _local_send
-        int sent_from_cache = 0;
-        for(uint64_t us : cache_hits) {
-            std::string key = uid + ":" + std::to_string(us);
-            std::string payload;
-            {
-                std::lock_guard<std::mutex> lock(_msg_cache_mu);
-                auto it = _msg_cache.find(key);
-                if(it != _msg_cache.end()) payload = (*it->second)->payload;
-            }
-            if(!payload.empty()) {
-                _local_send(uid, payload);
-                ++sent_from_cache;
-            }
-        }
+        if(hb.last_user_seq() > 0) _window.ack(uid, hb.last_user_seq());
+        uint64_t acked = _window.acked(uid);
+        uint64_t evicted = _window.evicted(uid);
+        if(evicted > acked) _catch_up(uid, acked, evicted);
+    }
 
-        // 全部命中：跳过 RPC
-        if(cache_misses.empty()) {
-            if(_unacked) _unacked->bump_score(uid, pending);
-            LOG_INFO("Heartbeat-补送 uid={} 取出 {} 条 全部命中缓存 (sent={})",
-                     uid, pending.size(), sent_from_cache);
-            return;
+public:
+    /* brief: 鉴权成功后补推（_ws_workers 线程调用）
+     *  - 客户端带 last_user_seq：从该游标之后补推，并视为累计确认
+     *  - 未带：取 Redis 确认高水位（故障切换后新实例窗口为空，靠高水位找回起点）
+     */
+    void resume_after_auth(const std::string &uid, bool has_last_user_seq, uint64_t last_user_seq) {
+        long long from = -1;
+        if(has_last_user_seq) {
+            from = static_cast<long long>(last_user_seq);
+            if(last_user_seq > 0) _window.ack(uid, last_user_seq);
+        } else if(_unacked) {
+            from = _unacked->acked(uid);
         }
+        if(from <= 0) return;   // 无起点：交给客户端按会话增量同步
+        _catch_up(uid, static_cast<uint64_t>(from), 0);
+    }
 
-        // 仅对未命中的走 RPC
-        uint64_t min_miss = *std::min_element(cache_misses.begin(), cache_misses.end());
-        uint64_t last_user_seq = min_miss > 0 ? min_miss - 1 : 0;
-        std::unordered_set<uint64_t> miss_set(cache_misses.begin(), cache_misses.end());
-
-        auto channel = _mm_channels->choose(_message_service_name);
+private:
+    /* brief: 从消息服务回查 user_seq ∈ (from, upto] 的消息补推（upto = 0 表示不设上限，至多 resend_batch 条）
+     *  - 补推成功下发的重新入窗口、帧重新写入 _payloads，后续照常按 ACK / 心跳收敛
+     */
+    void _catch_up(const std::string &uid, uint64_t from, uint64_t upto) {
+        auto channel = _mm_channels ? _mm_channels->choose(_message_service_name) : nullptr;
         if(!channel) {
-            LOG_WARN("Heartbeat-补送：message 服务不可达 uid={}", uid);
+            LOG_WARN("补推：message 服务不可达 uid={}", uid);
             return;
         }
+        long count = _resend_batch;
+        if(upto > from) count = std::min<long>(count, static_cast<long>(upto - from));
         MsgStorageService_Stub stub(channel.get());
         auto *closure = new SelfDeleteRpcClosure<GetOfflineMsgReq, GetOfflineMsgRsp>();
         closure->req.set_request_id(uid);
         closure->req.set_user_id(uid);
-        closure->req.set_last_message_id(static_cast<int64_t>(last_user_seq));
-        closure->req.set_msg_count(static_cast<int32_t>(pending.size()));
+        closure->req.set_last_message_id(static_cast<int64_t>(from));
+        closure->req.set_msg_count(static_cast<int32_t>(count));
 
-        std::string uid_copy = uid;
-        auto unacked = _unacked;
-        auto pending_copy = pending;
-        auto miss_set_copy = std::move(miss_set);
-        int sent_cache = sent_from_cache;
         PushServiceImpl *self = this;
-        closure->on_done = [self, uid_copy, unacked, pending_copy, miss_set_copy, sent_cache](
-            brpc::Controller *c, const GetOfflineMsgRsp &rsp)
-        {
+        std::string uid_copy = uid;
+        closure->on_done = [self, uid_copy, from, upto](brpc::Controller *c, const GetOfflineMsgRsp &rsp) {
             if(c->Failed() || !rsp.success()) {
-                LOG_WARN("Heartbeat-补送 GetOfflineMsg 失败 uid={}: {}",
+                LOG_WARN("补推 GetOfflineMsg 失败 uid={}: {}",
                          uid_copy, c->Failed() ? c->ErrorText() : rsp.errmsg());
                 return;
             }
-            int sent = sent_cache;
-            for(int i = 0; i < rsp.msg_list_size(); ++i) {
-                const auto &mi = rsp.msg_list(i);
+            int sent = 0;
+            int64_t now_ms = _now_ms();
+            for(const auto &mi : rsp.msg_list()) {
                 if(!mi.has_user_seq()) continue;
                 uint64_t us = mi.user_seq();
-                if(miss_set_copy.find(us) == miss_set_copy.end()) continue;
+                if(us <= from || (upto > 0 && us > upto)) continue;
                 ::chatnow::NotifyMessage notify;
                 notify.set_notify_type(NotifyType::CHAT_MESSAGE_NOTIFY);
                 notify.mutable_new_message_info()->mutable_message_info()->CopyFrom(mi);
-                self->_local_send(uid_copy, notify.SerializeAsString());
-                ++sent;
+                auto enc = std::make_shared<const PushPayloadEncoder>(notify);
+                if(self->_local_send(uid_copy, enc->encode(us)) > 0) {
+                    if(self->_window.push(uid_copy, us, self->_remember(notify, enc)))
+                        self->_arm(uid_copy, us, 0, now_ms);
+                    ++sent;
+                }
             }
-            if(unacked) unacked->bump_score(uid_copy, pending_copy);
-            LOG_INFO("Heartbeat-补送 uid={} 取出 {} 条 实际重发 {} 条 (缓存命中 {} 条)",
-                     uid_copy, pending_copy.size(), sent, sent_cache);
+            if(upto > 0) self->_window.clear_evicted(uid_copy, upto);
+            LOG_INFO("补推 uid={} 区间 ({}, {}] 回查 {} 条 实际下发 {} 条",
+                     uid_copy, from, upto, rsp.msg_list_size(), sent);
         };
         stub.GetOfflineMsg(&closure->cntl, &closure->req, &closure->rsp, closure);
     }
 
+    /* brief: 为 (uid, seq) 挂第 attempt 次重传的截止时间：resend_max_age * 2^attempt，封顶 kRetransmitMaxBackoffMs；
+     *        超过 kRetransmitMaxAttempts 次不再挂（留在窗口里等 ACK / 重连补推 / 下线丢弃） */
+    void _arm(const std::string &uid, uint64_t seq, uint32_t attempt, int64_t now_ms) {
+        if(attempt >= kRetransmitMaxAttempts) return;
+        int64_t delay = std::max<int64_t>(_resend_max_age_sec * 1000, kRetransmitTickMs);
+        for(uint32_t i = 0; i < attempt && delay < kRetransmitMaxBackoffMs; ++i) delay <<= 1;
+        _timers.schedule(now_ms + std::min<int64_t>(delay, kRetransmitMaxBackoffMs),
+                         RetransmitTimer{uid, seq, attempt});
+    }
+
+    /* brief: 处理一批到期的重传定时器
+     *  - 已确认 / 已下线 / 已被更新的定时器由 _window.fire 作废，不产生任何 IO
+     *  - 按 message_id 取缓存帧拼入 user_seq 重发；缓存已淘汰的按用户合并成一次回查
+     */
+    void _on_retransmit_due(std::vector<RetransmitTimer> &fired) {
+        std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> misses;   // uid → [from, upto]
+        std::shared_ptr<const PushPayloadEncoder> enc;
+        int64_t now_ms = _now_ms();
+        size_t resent = 0;
+        for(auto &t : fired) {
+            int64_t mid = 0;
+            if(!_window.fire(t.uid, t.seq, t.attempt, mid)) continue;
+            _arm(t.uid, t.seq, t.attempt + 1, now_ms);
+            if(mid > 0 && _payloads->get(mid, enc)) {
+                if(_local_send(t.uid, enc->encode(t.seq)) > 0) ++resent;
+                continue;
+            }
+            auto ins = misses.emplace(t.uid, std::make_pair(t.seq, t.seq));
+            ins.first->second.first = std::min(ins.first->second.first, t.seq);
+            ins.first->second.second = std::max(ins.first->second.second, t.seq);
+        }
+        for(const auto &kv : misses) _catch_up(kv.first, kv.second.first - 1, kv.second.second);
+        if(resent > 0 || !misses.empty()) {
+            LOG_INFO("重传到期 {} 个定时器：缓存重发 {} 条，{} 个用户回查", fired.size(), resent, misses.size());
+        }
+    }
+
+    /* brief: 聊天帧按 message_id 登记到 _payloads，返回该 message_id（非聊天帧 / 无 id 返回 0，重发时走回查） */
+    int64_t _remember(const NotifyMessage &notify, const std::shared_ptr<const PushPayloadEncoder> &encoder) {
+        if(!notify.has_new_message_info()) return 0;
+        int64_t mid = notify.new_message_info().message_info().message_id();
+        if(mid > 0) _payloads->put(mid, encoder, encoder->base().size());
+        return mid;
+    }
+
+    static int64_t _now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    /* brief: CrossInstanceOutbox reaper —
+     *  - 每个实例一个 reaper 线程，以 owner 为 consumer 名加入消费组，多实例并行排空积压
+     *  - 每轮先接管空闲超过 kClaimIdleMs 的未确认条目，没有再 XREADGROUP BLOCK 等新条目
+     *  - 按最新路由重发 PushBatch：全部对端成功（或收件人已不在线）才 XACK，任一失败留在 PEL 待接管；
+     *    RPC 回调只 defer_ack 登记，由本线程每轮 flush_acks 批量提交
+     *  - 线程启动时先把旧版 ZSET outbox 中的遗留条目搬进 stream
+     */
     void start_cross_outbox_reaper(const std::string &owner) {
         if(!_cross_outbox || !_mm_channels) {
             LOG_WARN("CrossInstanceOutbox reaper 未启动：outbox / channels 未注入");
             return;
         }
-        constexpr int kReapIntervalSec = 5;
-        constexpr int kLeaseTtlSec     = 30;
-        constexpr int kBatchLimit      = 50;
+        constexpr long long kBatchLimit = 200;
+        constexpr std::chrono::milliseconds kBlockMs(1000);
+        constexpr std::chrono::milliseconds kClaimIdleMs(30000);
+        _cross_outbox->ensure_group();
         _cross_reaper_running.store(true);
         _cross_reaper_owner = owner;
-        _cross_reaper_thread = std::thread([this, kReapIntervalSec, kLeaseTtlSec, kBatchLimit]() {
+        _cross_reaper_thread = std::thread([this, kBatchLimit, kBlockMs, kClaimIdleMs]() {
+            _cross_outbox->migrate_legacy();
             while(_cross_reaper_running.load()) {
                 try {
-                    if(!_cross_outbox->try_acquire_reaper_lease(_cross_reaper_owner, kLeaseTtlSec)) {
-                        std::this_thread::sleep_for(std::chrono::seconds(kReapIntervalSec));
-                        continue;
-                    }
-                    auto batch = _cross_outbox->peek(kBatchLimit);
-                    if(batch.empty()) {
-                        std::this_thread::sleep_for(std::chrono::seconds(kReapIntervalSec));
-                        continue;
-                    }
+                    _cross_outbox->flush_acks();
+                    auto batch = _cross_outbox->reclaim(_cross_reaper_owner, kClaimIdleMs, kBatchLimit);
+                    if(batch.empty()) batch = _cross_outbox->read(_cross_reaper_owner, kBatchLimit, kBlockMs);
+                    if(batch.empty()) continue;
                     LOG_INFO("CrossInstanceOutbox reaper: 取出 {} 条待重试", batch.size());
-                    for(const auto &member : batch) _cross_outbox->remove(member);
-                    for(const auto &member : batch) {
-                        std::string b64, peer;
-                        std::vector<std::string> uids;
-                        _parse_outbox_member(member, b64, uids, peer);
-                        std::string payload = _utils_base64_decode(b64);
-
-                        InternalMessage internal_msg;
-                        if(!internal_msg.ParseFromString(payload)) {
-                            LOG_ERROR("CrossInstanceOutbox: 反序列化失败，丢弃");
-                            continue;
-                        }
-
-                        std::unordered_map<std::string, std::vector<std::string>> peer_to_uids;
-                        for(const auto &uid : uids) {
-                            auto instances = _online_route ? _online_route->instances(uid)
-                                                           : std::vector<std::string>{};
-                            for(const auto &inst : instances) {
-                                if(inst == _instance_id) continue;
-                                peer_to_uids[inst].push_back(uid);
-                                break;
-                            }
-                        }
-
-                        NotifyMessage notify_template;
-                        notify_template.set_notify_type(NotifyType::CHAT_MESSAGE_NOTIFY);
-                        notify_template.mutable_new_message_info()
-                            ->mutable_message_info()->CopyFrom(internal_msg.message_info());
-
-                        for(auto &kv : peer_to_uids) {
-                            const std::string &p = kv.first;
-                            auto channel = _mm_channels->choose(p);
-                            if(!channel) {
-                                _cross_outbox->enqueue_raw(member,
-                                    static_cast<long long>(time(nullptr)) + 5);
-                                continue;
-                            }
-                            PushService_Stub stub(channel.get());
-                            auto *closure = new SelfDeleteRpcClosure<PushBatchReq, PushBatchRsp>();
-                            closure->req.set_request_id(
-                                internal_msg.message_info().client_msg_id());
-                            for(const auto &u : kv.second)
-                                closure->req.add_user_id_list(u);
-                            closure->req.mutable_notify()->CopyFrom(notify_template);
-                            for(const auto &up : internal_msg.user_seqs()) {
-                                if(std::find(kv.second.begin(), kv.second.end(),
-                                             up.user_id()) != kv.second.end()) {
-                                    auto *seq = closure->req.add_user_seqs();
-                                    seq->set_user_id(up.user_id());
-                                    seq->set_user_seq(up.user_seq());
-                                }
-                            }
-                            std::string peer_id = p;
-                            std::string member_copy = member;
-                            auto outbox_ref = _cross_outbox;
-                            closure->on_done = [peer_id, member_copy, outbox_ref](
-                                brpc::Controller *c, const PushBatchRsp &) {
-                                if(c->Failed()) {
-                                    LOG_WARN("CrossInstanceOutbox reaper 重试失败 peer={}: {}",
-                                             peer_id, c->ErrorText());
-                                    if(outbox_ref) outbox_ref->enqueue_raw(member_copy,
-                                        static_cast<long long>(time(nullptr)) + 5);
-                                }
-                            };
-                            stub.PushBatch(&closure->cntl, &closure->req,
-                                           &closure->rsp, closure);
-                        }
-                    }
+                    for(const auto &e : batch) _retry_cross_entry(e);
                 } catch(std::exception &e) {
                     LOG_ERROR("CrossInstanceOutbox reaper 异常: {}", e.what());
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
                 }
-                std::this_thread::sleep_for(std::chrono::seconds(kReapIntervalSec));
             }
-            if(_cross_outbox) _cross_outbox->release_reaper_lease(_cross_reaper_owner);
+            _cross_outbox->flush_acks();
             LOG_INFO("CrossInstanceOutbox reaper 已停止");
         });
     }
@@ -541,32 +574,311 @@ public:
         if(_cross_reaper_thread.joinable()) _cross_reaper_thread.join();
     }
 
+    /* brief: 用户在本机新增一条连接（鉴权成功后，_ws_workers 线程调用）
+     *  - 首条连接时异步查询其所在大群，本机由无到有的会话登记订阅
+     *  - 查询返回前本实例登记 pending，期间的大群消息照常广播到本机
+     */
+    void on_user_online(const std::string &uid) {
+        if(!_subscribers) return;
+        if(!_interest.attach(uid)) return;
+        if(!_pending_registered.exchange(true)) _subscribers->subscribe_pending(_instance_id);
+        _learn_sessions(uid);
+    }
+    /* brief: 用户在本机断开一条连接；最后一条断开时丢弃未确认窗口、退订本机已无在线成员的大群 */
+    void on_user_offline(const std::string &uid, const std::string &ssid = "") {
+        if(!ssid.empty()) _touches.forget(ssid);
+        // 本机已无该用户连接：丢弃未确认窗口，尚未写出的确认游标立即落 Redis 高水位；在线态退回登录态标记
+        if(_connections->targets(uid).empty()) {
+            uint64_t pending = _window.drop(uid);
+            if(pending > 0 && _unacked) _unacked->advance_many({{uid, pending}});
+            if(_redis_status) _redis_status->unbind(uid, _instance_id);
+        }
+        if(!_subscribers) return;
+        auto dropped = _interest.detach(uid);
+        _subscribers->unsubscribe_many(dropped, _instance_id);
+        _leave_pending();
+    }
+
+    /* brief: 大群订阅续约 + 重试查询失败的用户
+     *  - 续约周期远小于租约（kPushSubTtl），并发订阅 / 退订交错导致的误退订最多持续一个周期
+     */
+    void start_subscription_refresher() {
+        if(!_subscribers) return;
+        constexpr int kRefreshIntervalSec = 30;
+        constexpr size_t kRelearnLimit    = 200;
+        _sub_refresher_running.store(true);
+        _sub_refresher_thread = std::thread([this, kRefreshIntervalSec, kRelearnLimit]() {
+            while(_sub_refresher_running.load()) {
+                for(int i = 0; i < kRefreshIntervalSec && _sub_refresher_running.load(); ++i)
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                if(!_sub_refresher_running.load()) break;
+                try {
+                    _subscribers->subscribe_many(_interest.sessions(), _instance_id);
+                    if(_interest.pending() > 0) {
+                        _pending_registered.store(true);
+                        _subscribers->subscribe_pending(_instance_id);
+                    } else {
+                        _leave_pending();
+                    }
+                    auto unlearned = _interest.unlearned();
+                    if(unlearned.size() > kRelearnLimit) unlearned.resize(kRelearnLimit);
+                    for(const auto &uid : unlearned) _learn_sessions(uid);
+                } catch(std::exception &e) {
+                    LOG_ERROR("大群订阅续约异常: {}", e.what());
+                }
+            }
+            LOG_INFO("大群订阅续约线程已停止");
+        });
+    }
+
+    void stop_subscription_refresher() {
+        _sub_refresher_running.store(false);
+        if(_sub_refresher_thread.joinable()) _sub_refresher_thread.join();
+    }
+
+    /* brief: ACK 刷写线程：
+     *  - 合并模式下每 interval 把合并后的游标按 batch 分批 BatchUpdateAckSeq
+     *  - 同一节拍把窗口累计确认游标批量写 Redis 高水位（未开合并时按 1s 节拍）
+     */
+    void start_ack_flusher() {
+        if(_ack_flush_interval_ms <= 0 && !_unacked) return;
+        long tick_ms = _ack_flush_interval_ms > 0 ? _ack_flush_interval_ms : 1000;
+        _ack_flusher_running.store(true);
+        _ack_flusher_thread = std::thread([this, tick_ms]() {
+            while(_ack_flusher_running.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(tick_ms));
+                if(_ack_flush_interval_ms > 0) _flush_acks(false);
+                if(_unacked) _unacked->advance_many(_window.drain_acked());
+            }
+            // 退出前同步刷完剩余游标（best-effort）
+            if(_ack_flush_interval_ms > 0) _flush_acks(true);
+            if(_unacked) _unacked->advance_many(_window.drain_acked());
+            LOG_INFO("ACK 刷写线程已停止");
+        });
+    }
+
+    void stop_ack_flusher() {
+        _ack_flusher_running.store(false);
+        if(_ack_flusher_thread.joinable()) _ack_flusher_thread.join();
+    }
+
+    /* brief: 已鉴权连接的心跳：只登记到内存，到了续期时间才由刷写线程批量续 TTL */
+    void on_heartbeat_presence(const std::string &uid, const std::string &ssid) {
+        if(ssid.empty()) return;
+        _touches.seen(ssid, uid, _now_ms());
+    }
+
+    /* brief: 实例租约续约 + 持连用户 TTL 批量续期线程
+     *  - 启动时同步续约一次，须在开始接受 WS 连接前调用
+     *  - 每 kPushLeaseTtl / 3 续约；每秒把到期的 (uid, ssid) 续期合并为一次 pipeline
+     *  - 停止时撤销租约，本实例上的路由 / 在线态立即失效
+     */
+    void start_presence_refresher() {
+        if(!_lease) return;
+        _lease->renew(_instance_id);
+        _presence_running.store(true);
+        _presence_thread = std::thread([this]() {
+            const auto renew_every = std::chrono::duration_cast<std::chrono::milliseconds>(kPushLeaseTtl) / 3;
+            auto next_renew = std::chrono::steady_clock::now() + renew_every;
+            while(_presence_running.load()) {
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                try {
+                    if(std::chrono::steady_clock::now() >= next_renew) {
+                        if(!_lease->renew(_instance_id)) LOG_WARN("Push 实例租约续约失败 {}", _instance_id);
+                        next_renew = std::chrono::steady_clock::now() + renew_every;
+                    }
+                    auto due = _touches.drain();
+                    if(due.empty()) continue;
+                    for(auto &p : due) std::swap(p.first, p.second);    // (ssid, uid) → (uid, ssid)
+                    _lease->touch_many(due);
+                } catch(std::exception &e) {
+                    LOG_ERROR("Push 实例租约线程异常: {}", e.what());
+                }
+            }
+            LOG_INFO("Push 实例租约线程已停止");
+        });
+    }
+
+    void stop_presence_refresher() {
+        if(!_presence_running.exchange(false)) return;
+        if(_presence_thread.joinable()) _presence_thread.join();
+        _lease->revoke(_instance_id);
+    }
+
+    /* brief: 重传时间轮驱动线程：每 kRetransmitTickMs 推进一次，只处理到期项 */
+    void start_retransmit_timer() {
+        _retransmit_running.store(true);
+        _retransmit_thread = std::thread([this]() {
+            std::vector<RetransmitTimer> fired;
+            while(_retransmit_running.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(kRetransmitTickMs));
+                fired.clear();
+                if(_timers.advance(_now_ms(), fired) == 0) continue;
+                try {
+                    _on_retransmit_due(fired);
+                } catch(std::exception &e) {
+                    LOG_ERROR("重传定时器处理异常: {}", e.what());
+                }
+            }
+            LOG_INFO("重传时间轮线程已停止");
+        });
+    }
+
+    void stop_retransmit_timer() {
+        _retransmit_running.store(false);
+        if(_retransmit_thread.joinable()) _retransmit_thread.join();
+    }
+
 private:
-    void _parse_outbox_member(const std::string &member,
-                               std::string &b64,
-                               std::vector<std::string> &uids,
-                               std::string &peer) {
-        auto pos_k = member.find("\"k\":\"");
-        auto pos_u = member.find("\"u\":[");
-        auto pos_p = member.find("\"p\":\"");
-        if(pos_k != std::string::npos && pos_u != std::string::npos) {
-            b64 = member.substr(pos_k + 5, pos_u - pos_k - 8);
+    /* brief: 取走合并缓冲并分批上报；失败的批次放回，下一轮与新 ACK 合并后重试 */
+    void _flush_acks(bool sync) {
+        for(;;) {
+            auto batch = _acks->drain(static_cast<size_t>(_ack_flush_batch));
+            if(batch.empty()) return;
+            auto channel = _mm_channels ? _mm_channels->choose(_message_service_name) : nullptr;
+            if(!channel) {
+                LOG_WARN("BatchUpdateAckSeq: message service 不可达，{} 条游标留待下轮", batch.size());
+                _acks->restore(batch);
+                return;
+            }
+            MsgStorageService_Stub stub(channel.get());
+            auto *closure = new SelfDeleteRpcClosure<BatchUpdateAckSeqReq, BatchUpdateAckSeqRsp>();
+            closure->req.mutable_cursors()->Reserve(static_cast<int>(batch.size()));
+            for(const auto &c : batch) {
+                auto *cur = closure->req.add_cursors();
+                cur->set_user_id(c.uid);
+                cur->set_chat_session_id(c.ssid);
+                cur->set_user_seq(c.seq);
+            }
+            // 停机前的最后一轮不再放回：缓冲随进程退出，客户端重连后的 ACK 会带更新的 seq 追平
+            auto acks = sync ? nullptr : _acks;
+            closure->on_done = [acks, batch = std::move(batch)](brpc::Controller *c,
+                                                                 const BatchUpdateAckSeqRsp &r) {
+                if(!c->Failed() && r.success()) return;
+                LOG_WARN("BatchUpdateAckSeq 失败 size={}: {}", batch.size(),
+                         c->Failed() ? c->ErrorText() : r.errmsg());
+                if(acks) acks->restore(batch);
+            };
+            if(sync) {
+                brpc::CallId cid = closure->cntl.call_id();
+                stub.BatchUpdateAckSeq(&closure->cntl, &closure->req, &closure->rsp, closure);
+                brpc::Join(cid);
+            } else {
+                stub.BatchUpdateAckSeq(&closure->cntl, &closure->req, &closure->rsp, closure);
+            }
         }
-        if(pos_p != std::string::npos) {
-            peer = member.substr(pos_p + 5, member.size() - pos_p - 7);
+    }
+
+    /* brief: 异步查询 uid 所在大群（只取成员数达到门限的会话 ID），回调内登记订阅；
+     *        失败时该用户保持 unlearned，由续约线程重试
+     */
+    void _learn_sessions(const std::string &uid) {
+        auto channel = _mm_channels ? _mm_channels->choose(_chatsession_service_name) : nullptr;
+        if(!channel) {
+            LOG_WARN("大群订阅: chatsession_service 节点缺失 uid={}", uid);
+            return;
         }
-        if(pos_u != std::string::npos) {
-            size_t arr_end = member.find(']', pos_u);
-            if(arr_end != std::string::npos) {
-                std::string arr = member.substr(pos_u + 5, arr_end - pos_u - 5);
-                size_t start = 0;
-                while((start = arr.find('"', start)) != std::string::npos) {
-                    size_t end = arr.find('"', start + 1);
-                    if(end == std::string::npos) break;
-                    uids.push_back(arr.substr(start + 1, end - start - 1));
-                    start = end + 1;
-                }
+        ChatSessionService_Stub stub(channel.get());
+        auto *closure = new SelfDeleteRpcClosure<GetChatSessionListReq, GetChatSessionListRsp>();
+        closure->req.set_request_id(uid);
+        closure->req.set_user_id(uid);
+        closure->req.set_min_member_count(LARGE_GROUP_THRESHOLD);
+        PushServiceImpl *self = this;
+        std::string uid_copy = uid;
+        closure->on_done = [self, uid_copy](brpc::Controller *c, const GetChatSessionListRsp &rsp) {
+            if(c->Failed() || !rsp.success()) {
+                LOG_WARN("大群订阅: 查询用户会话失败 uid={}: {}",
+                         uid_copy, c->Failed() ? c->ErrorText() : rsp.errmsg());
+                return;
+            }
+            std::vector<std::string> ssids;
+            ssids.reserve(rsp.chat_session_info_list_size());
+            for(const auto &info : rsp.chat_session_info_list()) ssids.push_back(info.chat_session_id());
+            auto added = self->_interest.learn(uid_copy, ssids);
+            self->_subscribers->subscribe_many(added, self->_instance_id);
+            self->_leave_pending();
+        };
+        stub.GetChatSessionList(&closure->cntl, &closure->req, &closure->rsp, closure);
+    }
+
+    /* brief: 本机在线用户的大群列表已全部查清时退出 pending
+     *  - 退出与新用户上线并发：对方的登记可能先于本次 ZREM 落地而被抹掉，ZREM 后复查一次并补登
+     */
+    void _leave_pending() {
+        if(_interest.pending() > 0 || !_pending_registered.exchange(false)) return;
+        _subscribers->unsubscribe_pending(_instance_id);
+        if(_interest.pending() > 0) {
+            _pending_registered.store(true);
+            _subscribers->subscribe_pending(_instance_id);
+        }
+    }
+
+    /* brief: 重试一条跨实例兜底：按最新路由分组后每个对端一次 PushBatch，全部成功后 ack */
+    void _retry_cross_entry(const StreamOutbox::Entry &e) {
+        std::string payload, peer;
+        std::vector<std::string> uids;
+        InternalMessage internal_msg;
+        if(!CrossInstanceOutbox::parse(e, payload, uids, peer) || !internal_msg.ParseFromString(payload)) {
+            LOG_ERROR("CrossInstanceOutbox: 条目 {} 解析失败，丢弃", e.id);
+            _cross_outbox->ack({e.id});
+            return;
+        }
+
+        std::unordered_map<std::string, std::vector<std::string>> peer_to_uids;
+        auto routes = _online_route ? _online_route->instances_many(uids)
+                                    : std::unordered_map<std::string, std::vector<std::string>>{};
+        for(const auto &uid : uids) {
+            auto route = routes.find(uid);
+            if(route == routes.end()) continue;
+            for(const auto &inst : route->second) {
+                if(inst == _instance_id) continue;
+                peer_to_uids[inst].push_back(uid);
+                break;
+            }
+        }
+        // 收件人均已离线：重连时按确认高水位补推，兜底条目到此完成
+        if(peer_to_uids.empty()) {
+            _cross_outbox->ack({e.id});
+            return;
+        }
+
+        NotifyMessage notify_template;
+        notify_template.set_notify_type(NotifyType::CHAT_MESSAGE_NOTIFY);
+        notify_template.mutable_new_message_info()
+            ->mutable_message_info()->CopyFrom(internal_msg.message_info());
+
+        auto remaining = std::make_shared<std::atomic<size_t>>(peer_to_uids.size());
+        auto failed = std::make_shared<std::atomic<bool>>(false);
+        auto finish = [remaining, failed, outbox = _cross_outbox, id = e.id](bool ok) {
+            if(!ok) failed->store(true);
+            if(remaining->fetch_sub(1) == 1 && !failed->load()) outbox->defer_ack(id);
+        };
+        for(auto &kv : peer_to_uids) {
+            auto channel = _mm_channels->choose(kv.first);
+            if(!channel) {
+                finish(false);
+                continue;
             }
+            PushService_Stub stub(channel.get());
+            auto *closure = new SelfDeleteRpcClosure<PushBatchReq, PushBatchRsp>();
+            closure->req.set_request_id(internal_msg.message_info().client_msg_id());
+            for(const auto &u : kv.second) closure->req.add_user_id_list(u);
+            closure->req.mutable_notify()->CopyFrom(notify_template);
+            std::unordered_set<std::string> targets(kv.second.begin(), kv.second.end());
+            for(const auto &up : internal_msg.user_seqs()) {
+                if(targets.count(up.user_id()) == 0) continue;
+                auto *seq = closure->req.add_user_seqs();
+                seq->set_user_id(up.user_id());
+                seq->set_user_seq(up.user_seq());
+            }
+            std::string peer_id = kv.first;
+            closure->on_done = [peer_id, finish](brpc::Controller *c, const PushBatchRsp &) {
+                if(c->Failed()) {
+                    LOG_WARN("CrossInstanceOutbox reaper 重试失败 peer={}: {}", peer_id, c->ErrorText());
+                }
+                finish(!c->Failed());
+            };
+            stub.PushBatch(&closure->cntl, &closure->req, &closure->rsp, closure);
         }
     }
 
@@ -575,14 +887,13 @@ private:
      *     防止 MQ 消费线程 / brpc IO 线程 / WS asio 线程并发 send 同一 conn 撕帧 / crash。
      */
     int _local_send(const std::string &uid, const std::string &payload) {
-        auto conns = _connections->connections(uid);
+        auto targets = _connections->targets(uid);   // 连接 + 发送锁一次查找
         int sent = 0;
-        for(auto &c : conns) {
+        for(auto &t : targets) {
+            const auto &c = t.conn;
             try {
                 if(!c || c->get_state() != websocketpp::session::state::value::open) continue;
-                auto mu = _connections->send_mutex(c);
-                if(!mu) continue;  // conn 已被 close handler / reaper 清理
-                std::lock_guard<std::mutex> lock(*mu);
+                std::lock_guard<std::mutex> lock(t.slot->send_mu);
                 c->send(payload, websocketpp::frame::opcode::value::binary);
                 ++sent;
             } catch(std::exception &e) {
@@ -592,42 +903,6 @@ private:
         return sent;
     }
 
-    static std::string _utils_base64_encode(const std::string &in) {
-        static const char kTbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-        std::string out;
-        out.reserve(((in.size() + 2) / 3) * 4);
-        for(size_t i = 0; i < in.size(); i += 3) {
-            unsigned long val = (unsigned char)in[i] << 16;
-            if(i + 1 < in.size()) val |= (unsigned char)in[i + 1] << 8;
-            if(i + 2 < in.size()) val |= (unsigned char)in[i + 2];
-            out += kTbl[(val >> 18) & 0x3F];
-            out += kTbl[(val >> 12) & 0x3F];
-            out += (i + 1 < in.size()) ? kTbl[(val >> 6) & 0x3F] : '=';
-            out += (i + 2 < in.size()) ? kTbl[val & 0x3F] : '=';
-        }
-        return out;
-    }
-    static std::string _utils_base64_decode(const std::string &in) {
-        static const unsigned char kDec[128] = {
-            64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,
-            64,64,64,64,64,64,64,64,64,64,64,62,64,64,64,63,52,53,54,55,56,57,58,59,60,61,64,64,64,64,64,64,
-            64, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,64,64,64,64,64,
-            64,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48,49,50,51,64,64,64,64,64
-        };
-        std::string out;
-        out.reserve((in.size() / 4) * 3);
-        for(size_t i = 0; i < in.size(); i += 4) {
-            unsigned long val = 0;
-            for(int j = 0; j < 4; ++j) {
-                if(in[i+j] != '=') val = (val << 6) | kDec[(unsigned char)in[i+j]];
-            }
-            out += (char)((val >> 16) & 0xFF);
-            if(in[i+2] != '=') out += (char)((val >> 8) & 0xFF);
-            if(in[i+3] != '=') out += (char)(val & 0xFF);
-        }
-        return out;
-    }
-
     Connection::ptr _connections;
     Session::ptr _redis_session;
     Status::ptr _redis_status;
@@ -637,22 +912,39 @@ private:
     std::string _instance_id;
     std::string _message_service_name;
     ServiceManager::ptr _mm_channels;
-    // M5: 心跳触发重发的可调参数（gflag 注入；默认值在 conf 缺省时使用）
+    // M5: 重传退避基数 / 回查批量（gflag 注入；默认值在 conf 缺省时使用）
     long _resend_batch        {50};
     long _resend_max_age_sec  {5};
     // CrossInstanceOutbox reaper 状态
     std::atomic<bool> _cross_reaper_running {false};
     std::thread _cross_reaper_thread;
     std::string _cross_reaper_owner;
-    // 本地消息缓存（心跳重传优先命中）
-    struct MsgCacheEntry {
-        std::string key;
-        std::string payload;
-    };
-    std::deque<MsgCacheEntry> _msg_evict_list;
-    std::unordered_map<std::string, decltype(_msg_evict_list)::iterator> _msg_cache;
-    std::mutex _msg_cache_mu;
-    size_t _msg_cache_max_entries = 5000;
+    // 大群订阅：本机索引 + Redis 订阅表 + 续约线程
+    SessionSubscribers::ptr _subscribers;
+    std::string _chatsession_service_name;
+    SessionInterest _interest;
+    std::atomic<bool> _pending_registered {false};     // 本实例是否已登记 pending
+    std::atomic<bool> _sub_refresher_running {false};
+    std::thread _sub_refresher_thread;
+    // ACK 合并刷写
+    std::shared_ptr<AckCoalescer> _acks = std::make_shared<AckCoalescer>();
+    long _ack_flush_interval_ms {0};
+    long _ack_flush_batch       {500};
+    std::atomic<bool> _ack_flusher_running {false};
+    std::thread _ack_flusher_thread;
+    // 本机持连用户的未确认推送窗口（user_seq → message_id）+ 按 message_id 共享的推送帧缓存
+    using PayloadCache = ByteLruCache<int64_t, std::shared_ptr<const PushPayloadEncoder>>;
+    RetransmitWindow _window;
+    std::shared_ptr<PayloadCache> _payloads = std::make_shared<PayloadCache>(64UL << 20);
+    // 重传截止时间（分层时间轮，按次数指数退避）
+    TimingWheel<RetransmitTimer> _timers {kRetransmitTickMs, _now_ms()};
+    std::atomic<bool> _retransmit_running {false};
+    std::thread _retransmit_thread;
+    // 实例存活租约 + 持连用户 TTL 续期（按 ssid 限频，每 kOnlineTtl / 2 至多续一次）
+    PushLease::ptr _lease;
+    TouchScheduler _touches {std::chrono::duration_cast<std::chrono::milliseconds>(kOnlineTtl).count() / 2};
+    std::atomic<bool> _presence_running {false};
+    std::thread _presence_thread;
 };
 
 class PushServer
@@ -664,35 +956,44 @@ public:
                const std::shared_ptr<brpc::Server> &rpc,
                server_t *ws_server,
                const MQClient::ptr &mq_client,
-               const Subscriber::ptr &push_subscriber)
+               const Subscriber::ptr &push_subscriber,
+               size_t ws_threads = 1,
+               const ShardedExecutor::ptr &ws_workers = nullptr)
         : _service_discover(disc), _reg_client(reg), _rpc_server(rpc), _ws_server(ws_server),
-          _mq_client(mq_client), _push_subscriber(push_subscriber) {}
+          _mq_client(mq_client), _push_subscriber(push_subscriber),
+          _ws_thread_count(ws_threads == 0 ? 1 : ws_threads), _ws_workers(ws_workers) {}
     ~PushServer() = default;
 
     /* M1: 关停顺序（消除 UAF）—
      *   1) 主动停 MQ 消费：清空 _push_subscriber 与 _mq_client（MQClient 析构关闭 channel + join 线程）
      *      → onPushMessage 不再调度，PushService 不再被外部触发
-     *   2) 停 WS：服务端 stop，等待 ws_thread join
+     *   2) 停 WS：服务端 stop，等待全部 ws I/O 线程 join，再停 WS worker（丢弃未执行的上行处理）
      *   3) brpc Stop + Join：等待所有进行中的 PushToUser/PushBatch RPC 真正完成
      *      → 此后 brpc::Server 析构 SERVER_OWNS_SERVICE 才能安全 delete PushServiceImpl
      */
     void start() {
         // RPC + WebSocket 同进程跑；任意一边异常退出立即通知另一边停服
-        _ws_thread = std::thread([this]() {
-            try {
-                _ws_server->run();
-                LOG_INFO("Push WS 线程正常退出");
-            } catch(std::exception &e) {
-                LOG_ERROR("Push WS 线程异常退出: {}", e.what());
-            }
-            _rpc_server->Stop(0);
-        });
+        // 多线程共享同一 io_service：连接级回调由 websocketpp strand 串行
+        for(size_t i = 0; i < _ws_thread_count; ++i) {
+            _ws_threads.emplace_back([this]() {
+                try {
+                    _ws_server->run();
+                    LOG_INFO("Push WS 线程正常退出");
+                } catch(std::exception &e) {
+                    LOG_ERROR("Push WS 线程异常退出: {}", e.what());
+                }
+                _rpc_server->Stop(0);
+            });
+        }
         _rpc_server->RunUntilAskedToQuit();
-        // 关停顺序：MQ 消费 → WS → brpc Join → brpc::Server 析构 delete impl
+        // 关停顺序：MQ 消费 → WS → WS worker → brpc Join → brpc::Server 析构 delete impl
         _push_subscriber.reset();
         _mq_client.reset();
         _ws_server->stop();
-        if(_ws_thread.joinable()) _ws_thread.join();
+        for(auto &t : _ws_threads) {
+            if(t.joinable()) t.join();
+        }
+        if(_ws_workers) _ws_workers->stop();
         _rpc_server->Join();
         LOG_INFO("Push 关停完成");
     }
@@ -703,7 +1004,9 @@ private:
     server_t *_ws_server;
     MQClient::ptr _mq_client;
     Subscriber::ptr _push_subscriber;
-    std::thread _ws_thread;
+    size_t _ws_thread_count;
+    ShardedExecutor::ptr _ws_workers;
+    std::vector<std::thread> _ws_threads;
 };
 
 class PushServerBuilder
@@ -718,19 +1021,25 @@ public:
         _online_route  = std::make_shared<OnlineRoute>(_redis);
         _unacked       = std::make_shared<UnackedPush>(_redis);
         _cross_outbox  = std::make_shared<CrossInstanceOutbox>(_redis);
+        _subscribers   = std::make_shared<SessionSubscribers>(_redis);
+        _lease         = std::make_shared<PushLease>(_redis);
     }
 
     void make_discovery_object(const std::string &reg_host,
                                const std::string &base_service_name,
                                const std::string &message_service_name,
-                               const std::string &push_service_name)
+                               const std::string &push_service_name,
+                               const std::string &chatsession_service_name = "")
     {
         _message_service_name = message_service_name;
         _push_service_name    = push_service_name;
+        _chatsession_service_name = chatsession_service_name;
         _mm_channels = std::make_shared<ServiceManager>();
         _mm_channels->declared(message_service_name);
         // 关注 push 自身，便于跨实例转发；service_name 由配置传入避免硬编码
         _mm_channels->declared(push_service_name);
+        // 大群订阅：用户上线时查询其所在大群；未配置则大群仍按逐成员路由
+        if(!chatsession_service_name.empty()) _mm_channels->declared(chatsession_service_name);
         auto put_cb = std::bind(&ServiceManager::onServiceOnline, _mm_channels.get(),
                                 std::placeholders::_1, std::placeholders::_2);
         auto del_cb = std::bind(&ServiceManager::onServiceOffline, _mm_channels.get(),
@@ -768,91 +1077,68 @@ public:
             _mq_client, _push_settings, dummy_cb);
     }
 
-    /* brief: 构造 WebSocket server（监听端口） */
+    /* brief: 构造 WebSocket server（监听端口）
+     *  - io_service 由 PushServer 起 ws_threads 个线程 run()；websocketpp asio 配置开启
+     *    enable_multithreading，同一连接的回调经 strand 串行，不同连接并行
+     *  - I/O 线程只做解帧 + NotifyMessage 反序列化；鉴权 / 心跳 / ACK / 断连等涉及 Redis 的
+     *    阻塞逻辑按连接投递到 _ws_workers，同连接 FIFO 保证"鉴权 → 后续消息 → 断连"顺序
+     */
     void make_ws_object(uint16_t ws_port) {
         _ws_server.set_access_channels(websocketpp::log::alevel::none);
         _ws_server.clear_error_channels(websocketpp::log::elevel::none);
         _ws_server.init_asio();
         _ws_server.set_reuse_addr(true);
+        _ws_workers = std::make_shared<ShardedExecutor>(_ws_worker_count, "push-ws");
         _ws_server.set_open_handler([this](websocketpp::connection_hdl hdl) {
             LOG_DEBUG("WS 连接建立 {}", (size_t)_ws_server.get_con_from_hdl(hdl).get());
         });
         _ws_server.set_close_handler([this](websocketpp::connection_hdl hdl) {
             auto conn = _ws_server.get_con_from_hdl(hdl);
-            std::string uid, ssid, dev;
-            if(_connections && _connections->client(conn, uid, ssid, dev)) {
-                _connections->remove(conn);
-                if(_online_route) _online_route->unbind(uid, _instance_id);
-                LOG_DEBUG("WS 关闭 uid={}", uid);
-            }
+            _ws_workers->submit_to(_conn_shard(conn), [this, conn]() {
+                auto slot = _connections ? _connections->remove(conn) : nullptr;
+                if(slot) {
+                    if(_online_route) _online_route->unbind(slot->uid, _instance_id);
+                    if(_push_service) _push_service->on_user_offline(slot->uid, slot->ssid);
+                    LOG_DEBUG("WS 关闭 uid={}", slot->uid);
+                }
+            });
         });
         _ws_server.set_message_handler([this](websocketpp::connection_hdl hdl, server_t::message_ptr msg) {
             auto conn = _ws_server.get_con_from_hdl(hdl);
             // 反序列化 NotifyMessage（双向通道）
-            NotifyMessage notify;
-            if(!notify.ParseFromString(msg->get_payload())) {
+            auto notify = std::make_shared<NotifyMessage>();
+            if(!notify->ParseFromString(msg->get_payload())) {
                 LOG_WARN("WS payload 反序列化失败，关闭连接");
                 _ws_server.close(hdl, websocketpp::close::status::unsupported_data,
                                  "payload invalid");
                 return;
             }
-
-            // 路径 A：未鉴权连接的首条消息必须是 CLIENT_AUTH
-            std::string uid_known, ssid_known, dev_known;
-            if(!_connections->client(conn, uid_known, ssid_known, dev_known)) {
-                if(notify.notify_type() != NotifyType::CLIENT_AUTH || !notify.has_client_auth()) {
-                    LOG_WARN("WS 首条非 CLIENT_AUTH，关闭连接");
-                    _ws_server.close(hdl, websocketpp::close::status::unsupported_data,
-                                     "auth required");
-                    return;
-                }
-                const auto &auth = notify.client_auth();
-                if(auth.session_id().empty() || auth.device_id().empty()) {
-                    LOG_WARN("WS CLIENT_AUTH 缺 session_id 或 device_id");
-                    _ws_server.close(hdl, websocketpp::close::status::unsupported_data,
-                                     "session_id/device_id required");
-                    return;
-                }
-                auto uid = _redis_session ? _redis_session->uid(auth.session_id())
-                                          : sw::redis::OptionalString{};
-                if(!uid) {
-                    LOG_WARN("WS 鉴权失败 ssid={}", auth.session_id());
-                    _ws_server.close(hdl, websocketpp::close::status::unsupported_data,
-                                     "auth failed");
-                    return;
-                }
-                _connections->insert(conn, *uid, auth.session_id(), auth.device_id());
-                if(_redis_status) _redis_status->append(*uid);
-                if(_online_route) _online_route->bind(*uid, _instance_id);
-                LOG_INFO("WS 鉴权成功 uid={} device={}", *uid, auth.device_id());
-                // 携带 last_user_seq 时立即触发补送
-                if(auth.has_last_user_seq() && _push_service) {
-                    NotifyMessage hb;
-                    hb.set_notify_type(NotifyType::CLIENT_HEARTBEAT);
-                    hb.mutable_heartbeat()->set_user_id(*uid);
-                    hb.mutable_heartbeat()->set_last_user_seq(auth.last_user_seq());
-                    _push_service->onClientNotify(hb);
-                }
-                return;
-            }
-
-            // 路径 B：已鉴权连接的后续消息（ACK / 心跳）
-            _connections->touch(conn);
-            if(_push_service) _push_service->onClientNotify(notify);
-            if(notify.notify_type() == NotifyType::CLIENT_HEARTBEAT) {
-                if(_online_route) _online_route->touch(uid_known);
-                if(_redis_status) _redis_status->touch(uid_known);
-                if(_redis_session) _redis_session->touch(ssid_known);
-            }
+            _ws_workers->submit_to(_conn_shard(conn), [this, hdl, conn, notify]() {
+                _on_ws_notify(hdl, conn, *notify);
+            });
         });
     }
 
-    /* M5: 设置心跳重发参数（应在 make_rpc_object 之前调用） */
+    /* M5: 设置重传参数（应在 make_rpc_object 之前调用） */
     void set_resend_params(int batch, int max_age_sec) {
         _resend_batch = batch;
         _resend_max_age_sec = max_age_sec;
     }
+    /* 设置 ACK 合并刷写间隔与单批上限；interval_ms = 0 关闭合并（应在 make_rpc_object 之前调用） */
+    void set_ack_flush_params(int interval_ms, int batch) {
+        _ack_flush_interval_ms = interval_ms;
+        _ack_flush_batch = batch;
+    }
+    /* 设置重传帧缓存字节上限（MB）（应在 make_rpc_object 之前调用） */
+    void set_payload_cache_mb(int mb) { _payload_cache_mb = mb; }
     void set_reaper_owner(const std::string &owner) { _reaper_owner = owner; }
+    /* 设置 push_queue 消费 worker 数；0 = ev 线程内联消费（应在 make_rpc_object 之前调用） */
+    void set_consume_workers(size_t workers) { _consume_workers = workers; }
+    /* 设置 WS I/O 线程数与上行处理 worker 数（应在 make_rpc_object 之前调用） */
+    void set_ws_threads(size_t io_threads, size_t workers) {
+        _ws_thread_count = io_threads == 0 ? 1 : io_threads;
+        _ws_worker_count = workers == 0 ? 1 : workers;
+    }
 
     void make_rpc_object(uint16_t port, uint32_t timeout, uint8_t num_threads, uint16_t ws_port) {
         if(!_redis) { LOG_ERROR("Push: Redis 未初始化"); abort(); }
@@ -862,8 +1148,12 @@ public:
         _push_service = new PushServiceImpl(
             _connections, _redis_session, _redis_status,
             _online_route, _unacked, _cross_outbox, _instance_id,
-            _message_service_name, _mm_channels);
+            _message_service_name, _mm_channels,
+            _chatsession_service_name.empty() ? nullptr : _subscribers,
+            _chatsession_service_name, _lease);
         _push_service->set_resend_params(_resend_batch, _resend_max_age_sec);
+        _push_service->set_ack_flush_params(_ack_flush_interval_ms, _ack_flush_batch);
+        _push_service->set_payload_cache_bytes(static_cast<size_t>(_payload_cache_mb > 0 ? _payload_cache_mb : 1) << 20);
         int ret = _rpc_server->AddService(_push_service, brpc::ServiceOwnership::SERVER_OWNS_SERVICE);
         if(ret == -1) { LOG_ERROR("Push: AddService 失败"); abort(); }
 
@@ -874,6 +1164,8 @@ public:
             LOG_ERROR("Push: brpc 启动失败");
             abort();
         }
+        // 先续约实例租约：本实例写出的路由 / 在线态以它判活
+        _push_service->start_presence_refresher();
         // 启动 WS server
         make_ws_object(ws_port);
         std::error_code ec;
@@ -892,11 +1184,15 @@ public:
             struct _Scope { ~_Scope() { ::chatnow::log::LogContext::clear(); } } _scope;
             return callback_inner(body, sz, redeliv);
         };
-        _push_subscriber->consume(std::move(callback));
-        // 启动 CrossInstanceOutbox reaper
+        // 按 chat_session_id 分片：同会话推送保序，跨会话并行；InternalMessage.message_info(1).chat_session_id(2)
+        _push_subscriber->consume_sharded(std::move(callback), pb_field_shard_key({1, 2}), _consume_workers);
+        // 启动 CrossInstanceOutbox reaper：owner 即消费组内的 consumer 名，多实例间须唯一
         std::string owner = _reaper_owner.empty()
-            ? std::to_string(::getpid()) : _reaper_owner;
+            ? (_instance_id.empty() ? std::to_string(::getpid()) : _instance_id) : _reaper_owner;
         _push_service->start_cross_outbox_reaper(owner);
+        _push_service->start_subscription_refresher();
+        _push_service->start_ack_flusher();
+        _push_service->start_retransmit_timer();
         LOG_INFO("Push 服务启动: rpc_port={} ws_port={}", port, ws_port);
     }
 
@@ -912,18 +1208,77 @@ public:
                                             std::move(_rpc_server),
                                             &_ws_server,
                                             std::move(_mq_client),
-                                            std::move(_push_subscriber));
+                                            std::move(_push_subscriber),
+                                            _ws_thread_count,
+                                            _ws_workers);
     }
 private:
+    /* brief: 连接 → worker 分片；指针低位恒为 0，先右移再取模 */
+    static size_t _conn_shard(const server_t::connection_ptr &conn) {
+        return static_cast<size_t>(reinterpret_cast<uintptr_t>(conn.get()) >> 6);
+    }
+
+    /* brief: WS 上行消息处理（_ws_workers 线程执行） */
+    void _on_ws_notify(websocketpp::connection_hdl hdl,
+                       const server_t::connection_ptr &conn,
+                       const NotifyMessage &notify) {
+        // 路径 A：未鉴权连接的首条消息必须是 CLIENT_AUTH
+        std::string uid_known, ssid_known, dev_known;
+        if(!_connections->client(conn, uid_known, ssid_known, dev_known)) {
+            if(notify.notify_type() != NotifyType::CLIENT_AUTH || !notify.has_client_auth()) {
+                LOG_WARN("WS 首条非 CLIENT_AUTH，关闭连接");
+                _ws_server.close(hdl, websocketpp::close::status::unsupported_data,
+                                 "auth required");
+                return;
+            }
+            const auto &auth = notify.client_auth();
+            if(auth.session_id().empty() || auth.device_id().empty()) {
+                LOG_WARN("WS CLIENT_AUTH 缺 session_id 或 device_id");
+                _ws_server.close(hdl, websocketpp::close::status::unsupported_data,
+                                 "session_id/device_id required");
+                return;
+            }
+            auto uid = _redis_session ? _redis_session->uid(auth.session_id())
+                                      : sw::redis::OptionalString{};
+            if(!uid) {
+                LOG_WARN("WS 鉴权失败 ssid={}", auth.session_id());
+                _ws_server.close(hdl, websocketpp::close::status::unsupported_data,
+                                 "auth failed");
+                return;
+            }
+            _connections->insert(conn, *uid, auth.session_id(), auth.device_id());
+            if(_redis_status) _redis_status->bind(*uid, _instance_id);
+            if(_online_route) _online_route->bind(*uid, _instance_id);
+            if(_push_service) _push_service->on_user_online(*uid);
+            LOG_INFO("WS 鉴权成功 uid={} device={}", *uid, auth.device_id());
+            // 从 last_user_seq（未带则取 Redis 确认高水位）之后补推
+            if(_push_service) {
+                _push_service->resume_after_auth(*uid, auth.has_last_user_seq(), auth.last_user_seq());
+            }
+            return;
+        }
+
+        // 路径 B：已鉴权连接的后续消息（ACK / 心跳）
+        //   心跳不直接访问 Redis：在线判活靠实例租约，TTL 续期按用户限频后由租约线程批量发出
+        _connections->touch(conn);
+        if(_push_service) _push_service->onClientNotify(notify);
+        if(notify.notify_type() == NotifyType::CLIENT_HEARTBEAT && _push_service) {
+            _push_service->on_heartbeat_presence(uid_known, ssid_known);
+        }
+    }
+
     std::shared_ptr<sw::redis::Redis> _redis;
     Session::ptr _redis_session;
     Status::ptr _redis_status;
     OnlineRoute::ptr _online_route;
     UnackedPush::ptr _unacked;
     CrossInstanceOutbox::ptr _cross_outbox;
+    SessionSubscribers::ptr _subscribers;
+    PushLease::ptr _lease;
 
     std::string _message_service_name;
     std::string _push_service_name;
+    std::string _chatsession_service_name;
     std::string _instance_id;
     ServiceManager::ptr _mm_channels;
     Discovery::ptr _service_discover;
@@ -933,10 +1288,17 @@ private:
     MQClient::ptr _mq_client;
     Subscriber::ptr _push_subscriber;
 
-    // M5: 心跳重发参数
+    // M5: 重传参数
     int _resend_batch       {50};
     int _resend_max_age_sec {5};
+    int _ack_flush_interval_ms {200};
+    int _ack_flush_batch       {500};
+    int _payload_cache_mb      {64};
     std::string _reaper_owner;
+    size_t _consume_workers {0};
+    size_t _ws_thread_count {1};
+    size_t _ws_worker_count {4};
+    ShardedExecutor::ptr _ws_workers;   // 上行处理（含 Redis 阻塞调用），按连接分片保序
 
     Connection::ptr _connections;
     server_t _ws_server;
@@ -20,12 +20,23 @@ DEFINE_int32(rpc_threads, 1, "RPC的IO线程数量");
 DEFINE_string(user_service, "/service/user_service", "用户管理子服务名称");
 DEFINE_string(chatsession_service, "/service/chatsession_service", "会话管理子服务名称");
 DEFINE_string(message_service, "/service/message_service", "消息存储子服务名称（用于幂等查询）");
+DEFINE_string(transmite_service, "/service/transmite_service", "本服务名称（一致性哈希判断会话归属）");
+DEFINE_int32(seq_block_max, 64, "会话级 seq 本地号段上限，<=1 关闭（逐条 Redis INCR）");
 
 DEFINE_string(redis_host, "127.0.0.1", "Redis 服务器访问地址");
 DEFINE_int32(redis_port, 6379, "Redis 服务器访问端口");
 DEFINE_int32(redis_db, 0, "Redis 选择的库");
 DEFINE_bool(redis_keep_alive, true, "Redis 长连接");
 DEFINE_int32(redis_pool_size, 8, "Redis 连接池大小");
+DEFINE_uint64(members_l1_capacity, 20000, "群成员列表进程内缓存容量（会话数）");
+DEFINE_int32(members_l1_ttl_ms, 1000, "群成员列表 L1 免校验时长（毫秒），即成员变更跨进程生效的延迟上限");
+DEFINE_int32(redis_io_threads, 16, "Redis 阻塞调用线程池大小（发消息链路并发查询），0 表示在 RPC 线程内串行执行");
+DEFINE_double(rate_user_qps, 10, "用户级发消息限速（令牌/秒），<=0 不限");
+DEFINE_double(rate_user_burst, 100, "用户级令牌桶容量（允许的突发条数）");
+DEFINE_double(rate_session_qps, 50, "会话级发消息限速（令牌/秒），<=0 不限");
+DEFINE_double(rate_session_burst, 500, "会话级令牌桶容量（允许的突发条数）");
+DEFINE_bool(rate_local_precheck, true, "本地令牌桶预判：明显超限直接拒绝，不访问 Redis");
+DEFINE_int32(dedup_ttl_sec, 300, "client_msg_id 幂等窗口（秒），<=0 关闭（每条消息查库去重）");
 
 DEFINE_string(mysql_host, "127.0.0.1", "MySQL服务器访问地址");
 DEFINE_string(mysql_user, "root", "MySQL访问服务器用户名");
@@ -52,11 +63,16 @@ int main(int argc, char *argv[])
 
     chatnow::TransmiteServerBuilder tsb;
     // 注意：先初始化 Redis（worker_id 自动分配依赖 Redis），再初始化 ID 生成器
-    tsb.make_redis_object(FLAGS_redis_host, FLAGS_redis_port, FLAGS_redis_db, FLAGS_redis_keep_alive, FLAGS_redis_pool_size);
+    tsb.make_redis_object(FLAGS_redis_host, FLAGS_redis_port, FLAGS_redis_db, FLAGS_redis_keep_alive, FLAGS_redis_pool_size, FLAGS_dedup_ttl_sec);
+    tsb.make_member_cache_object(FLAGS_members_l1_capacity, FLAGS_members_l1_ttl_ms);
+    tsb.make_redis_pool_object(FLAGS_redis_io_threads);
+    tsb.make_rate_limiter_object(FLAGS_rate_user_qps, FLAGS_rate_user_burst,
+                                 FLAGS_rate_session_qps, FLAGS_rate_session_burst, FLAGS_rate_local_precheck);
     tsb.set_instance_owner(FLAGS_access_host);
     tsb.make_id_generator_object(FLAGS_instance_num, FLAGS_epoch_ms, FLAGS_wait_on_clock_backwards);
     tsb.make_mq_object(FLAGS_mq_user, FLAGS_mq_pswd, FLAGS_mq_host, FLAGS_mq_msg_exchange, FLAGS_mq_msg_queue, FLAGS_mq_msg_binding_key);
-    tsb.make_discovery_object(FLAGS_registry_host, FLAGS_base_service, FLAGS_user_service, FLAGS_chatsession_service, FLAGS_message_service);
+    tsb.make_discovery_object(FLAGS_registry_host, FLAGS_base_service, FLAGS_user_service, FLAGS_chatsession_service, FLAGS_message_service, FLAGS_transmite_service);
+    tsb.make_seq_allocator_object(FLAGS_seq_block_max, FLAGS_access_host);
     tsb.make_rpc_object(FLAGS_listen_port, FLAGS_rpc_timeout, FLAGS_rpc_threads);
     tsb.make_reg_object(FLAGS_registry_host, FLAGS_base_service + FLAGS_instance_name, FLAGS_access_host);
 
@@ -8,6 +8,11 @@
 #include "utils/utils.hpp"
 #include "infra/snowflake.hpp"
 #include "dao/data_redis.hpp"
+#include "dao/user_info_cache.hpp"
+#include "dao/member_list_cache.hpp"
+#include "dao/session_seq_allocator.hpp"
+#include "utils/blocking_fanout.hpp"
+#include "utils/sharded_executor.hpp"
 #include "utils/worker_id.hpp"
 #include "common/types.pb.h"
 #include "common/error.pb.h"
@@ -18,9 +23,13 @@
 #include "message/message_service.pb.h"
 #include "transmite/transmite_service.pb.h"
 #include <brpc/server.h>
+#include <bthread/bthread.h>
 #include <butil/logging.h>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <functional>
+#include <memory>
 #include <thread>
 
 namespace chatnow
@@ -41,8 +50,12 @@ public:
                         const Publisher::ptr &publisher,
                         const std::shared_ptr<SnowflakeId> &id_generator,
                         const SeqGen::ptr &seq_gen,
-                        const Members::ptr &members_cache,
-                        const RateLimiter::ptr &rate_limiter)
+                        const MemberListCache::ptr &members_cache,
+                        const RateLimiter::ptr &rate_limiter,
+                        const UserInfoCache<UserInfo>::ptr &user_cache = nullptr,
+                        const SessionSeqAllocator::ptr &seq_allocator = nullptr,
+                        const MsgDedup::ptr &dedup = nullptr,
+                        const ShardedExecutor::ptr &redis_pool = nullptr)
                         : _user_service_name(user_service_name),
                         _chatsession_service_name(chatsession_service_name),
                         _message_service_name(message_service_name),
@@ -53,7 +66,11 @@ public:
                         _id_generator(id_generator),
                         _seq_gen(seq_gen),
                         _members_cache(members_cache),
-                        _rate_limiter(rate_limiter) {}
+                        _rate_limiter(rate_limiter),
+                        _user_cache(user_cache),
+                        _seq_allocator(seq_allocator),
+                        _dedup(dedup),
+                        _redis_pool(redis_pool) {}
     ~TransmiteServiceImpl() = default;
 
     void GetTransmitTarget(google::protobuf::RpcController *controller,
@@ -62,7 +79,14 @@ public:
                         ::google::protobuf::Closure *done)
     {
         brpc::ClosureGuard rpc_guard(done);
-        auto err_response = [response](const std::string &rid, const std::string &err_msg) -> void {
+        // 本请求持有幂等占位（SET NX 成功）时，任何失败返回前都要释放，客户端重试才能重新处理
+        bool dedup_held = false;
+        auto err_response = [this, request, response, &dedup_held](const std::string &rid, const std::string &err_msg) -> void {
+            if(dedup_held) {
+                auto dedup = _dedup;
+                std::string uid = request->user_id(), cmid = request->client_msg_id();
+                _Detach([dedup, uid, cmid]() { dedup->release(uid, cmid); });
+            }
             response->set_request_id(rid);
             response->set_success(false);
             response->set_errmsg(err_msg);
@@ -97,105 +121,146 @@ public:
             default: break;
         }
 
-        // ============ 步骤 1: 客户端幂等去重 ============
-        // 命中 client_msg_id 索引则直接返回旧消息，绕过雪花/seq/MQ
-        if(!client_msg_id.empty()) {
-            auto msg_channel = _mm_channels->choose(_message_service_name);
-            if(msg_channel) {
-                MsgStorageService_Stub stub(msg_channel.get());
-                SelectByClientMsgReq dup_req;
-                SelectByClientMsgRsp dup_rsp;
-                brpc::Controller dup_cntl;
-                dup_req.set_request_id(rid);
-                dup_req.set_user_id(uid);
-                dup_req.set_client_msg_id(client_msg_id);
-                stub.SelectByClientMsg(&dup_cntl, &dup_req, &dup_rsp, nullptr);
-                if(!dup_cntl.Failed() && dup_rsp.success() && dup_rsp.exists()) {
-                    LOG_INFO("请求ID: {} - 命中幂等 client_msg_id={} 直接返回旧消息", rid, client_msg_id);
-                    response->set_request_id(rid);
-                    response->set_success(true);
-                    response->mutable_message()->CopyFrom(dup_rsp.message());
-                    // 幂等返回不带 target_id_list（避免重复推送）
-                    return;
-                }
-            } else {
-                LOG_WARN("请求ID: {} - message_service 不可用，跳过幂等检查", rid);
+        // ============ 步骤 1: 并发查询（幂等窗口 / 限流 / 发送者资料 / 成员列表） ============
+        // 四项互不依赖：Redis 阻塞调用一并投到 Redis 线程池并发执行，当前 bthread 挂起等待（不占 brpc worker）；
+        // 未启用 UserInfoCache 时 GetUserInfo 走异步 RPC 同时发出。总耗时 ≈ 最慢的一项。
+        // 成员列表常态命中进程内 L1（不做任何 I/O，不进线程池）
+        MsgDedup::State dedup_st = MsgDedup::State::kError;
+        std::string dedup_prev;
+        RateLimiter::Verdict rl_verdict = RateLimiter::Verdict::kAllowed;
+        UserInfo sender;
+        bool sender_ok = false;
+        long long members_ver = -1;
+        MemberListCache::List members = _members_cache ? _members_cache->local(chat_ssid, members_ver) : nullptr;
+
+        GetUserInfoRsp user_rsp;
+        brpc::Controller user_cntl;
+        bool user_rpc = false;
+        if(!_user_cache) {
+            auto user_channel = _mm_channels->choose(_user_service_name);
+            if(!user_channel) {
+                LOG_ERROR("请求ID: {} - user_service 节点缺失", rid);
+                return err_response(rid, "依赖服务节点缺失");
             }
+            UserService_Stub user_stub(user_channel.get());
+            GetUserInfoReq user_req;
+            user_req.set_request_id(rid);
+            user_req.set_user_id(uid);
+            user_req.set_brief(true);   // 发送者只需 user_id / nickname / profile_version，不拉头像
+            user_stub.GetUserInfo(&user_cntl, &user_req, &user_rsp, brpc::DoNothing());
+            user_rpc = true;
         }
-
-        // ============ 步骤 1.5: 限流（用户级 + 会话级） ============
-        // 实现：基于 INCR + EXPIRE 的固定窗口计数器（简化版）。
-        //   - 阈值语义为"每窗口内最多 N 次"（窗口=60s）
-        //   - 已知缺陷：相邻窗口边界可能放行 ≈2N，对反爬场景不严格；
-        //     生产环境推荐 redis-cell（CL.THROTTLE）或 Lua 令牌桶替换 RateLimiter::allow
-        if(_rate_limiter) {
-            // 用户级：60s 内 600 次（≈10 QPS 平均；爆发可在窗口内集中）
-            if(!_rate_limiter->allow_user(uid, /*max_count=*/600, /*window_sec=*/60)) {
-                LOG_WARN("请求ID: {} - 用户级限流命中 uid={}", rid, uid);
-                return err_response(rid, "rate_limited");
+        // 提前返回前必须等异步 RPC 结束：user_cntl / user_rsp 在本栈上
+        auto join_user = [&]() { if(user_rpc) { brpc::Join(user_cntl.call_id()); user_rpc = false; } };
+        {
+            BlockingFanout fanout(_redis_pool.get());
+            if(_dedup && !client_msg_id.empty()) {
+                fanout.run([&]() { dedup_st = _dedup->acquire(uid, client_msg_id, dedup_prev); });
             }
-            // 会话级：60s 内 3000 次（≈50 QPS）
-            if(!_rate_limiter->allow_session(chat_ssid, /*max_count=*/3000, /*window_sec=*/60)) {
-                LOG_WARN("请求ID: {} - 会话级限流命中 ssid={}", rid, chat_ssid);
-                return err_response(rid, "rate_limited");
+            if(_rate_limiter) {
+                fanout.run([&]() { rl_verdict = _rate_limiter->allow_message(uid, chat_ssid); });
+            }
+            if(_user_cache) {
+                fanout.run([&]() {
+                    auto loader = [this, &rid](const std::vector<std::string> &uids,
+                                               std::unordered_map<std::string, UserInfo> &out) {
+                        return _LoadUsers(rid, uids, out);
+                    };
+                    sender_ok = _user_cache->get(uid, sender, loader);
+                });
+            }
+            if(_members_cache && !members) {
+                fanout.run([&]() { members = _members_cache->get(chat_ssid, members_ver); });
             }
         }
 
-        // ============ 步骤 2: 并行 RPC 拿用户信息 + 群成员列表（成员优先走缓存） ============
-        auto user_channel = _mm_channels->choose(_user_service_name);
-        if(!user_channel) {
-            LOG_ERROR("请求ID: {} - user_service 节点缺失", rid);
-            return err_response(rid, "依赖服务节点缺失");
-        }
+        // 首次请求仍在处理：在本 bthread 上等待重查，不占 Redis 线程池
+        if(dedup_st == MsgDedup::State::kPending) dedup_st = _AwaitDedup(uid, client_msg_id, dedup_prev);
 
-        // 成员列表：先查 Redis 缓存，未命中再 RPC + 回填
-        std::vector<std::string> member_id_list;
-        bool members_from_cache = false;
-        if(_members_cache) {
-            member_id_list = _members_cache->list(chat_ssid);
-            if(!member_id_list.empty()) members_from_cache = true;
+        // 幂等判定：命中则直接返回旧消息，绕过雪花/seq/MQ。
+        // Redis 不可用时回退 SelectByClientMsg 查库；窗口过期后的重复由 DB uk_client_msg 兜底
+        if(!client_msg_id.empty()) {
+            switch(dedup_st) {
+                case MsgDedup::State::kAcquired:
+                    dedup_held = true;
+                    break;
+                case MsgDedup::State::kDone: {
+                    MessageInfo old_msg;
+                    if(old_msg.ParseFromString(dedup_prev)) {
+                        join_user();
+                        LOG_INFO("请求ID: {} - 命中幂等窗口 client_msg_id={} 直接返回旧消息", rid, client_msg_id);
+                        response->set_request_id(rid);
+                        response->set_success(true);
+                        response->mutable_message()->CopyFrom(old_msg);
+                        // 幂等返回不带 target_id_list（避免重复推送）
+                        return;
+                    }
+                    LOG_ERROR("请求ID: {} - 幂等窗口结果解析失败 client_msg_id={}，按新消息处理", rid, client_msg_id);
+                    break;
+                }
+                case MsgDedup::State::kPending:
+                    // 首次请求仍未完成（或其实例已崩溃）：不再等待，交给 DB 唯一索引兜底
+                    LOG_WARN("请求ID: {} - 幂等占位等待超时 client_msg_id={}，继续处理", rid, client_msg_id);
+                    break;
+                case MsgDedup::State::kError:
+                    if(_SelectByClientMsg(rid, uid, client_msg_id, response)) {
+                        join_user();
+                        return;
+                    }
+                    break;
+            }
         }
 
-        UserService_Stub user_stub(user_channel.get());
-        GetUserInfoReq user_req;
-        GetUserInfoRsp user_rsp;
-        brpc::Controller user_cntl;
-        user_req.set_request_id(rid);
-        user_req.set_user_id(uid);
-
-        // 用户信息 RPC 异步发起
-        user_stub.GetUserInfo(&user_cntl, &user_req, &user_rsp, brpc::DoNothing());
+        // 限流：令牌桶，用户桶 + 会话桶在一次 EVALSHA 内联合判定（本地同参数令牌桶先预判）
+        if(rl_verdict != RateLimiter::Verdict::kAllowed) {
+            join_user();
+            if(rl_verdict == RateLimiter::Verdict::kUserLimited) {
+                LOG_WARN("请求ID: {} - 用户级限流命中 uid={}", rid, uid);
+            } else {
+                LOG_WARN("请求ID: {} - 会话级限流命中 ssid={}", rid, chat_ssid);
+            }
+            return err_response(rid, "rate_limited");
+        }
 
-        // 成员列表未命中缓存：RPC 拉取
-        GetMemberIdListRsp session_rsp;
-        brpc::Controller session_cntl;
-        if(!members_from_cache) {
+        // ============ 步骤 2: 成员列表缓存未命中时 RPC 拉取 + 异步回填；收齐发送者资料 ============
+        if(!members) {
             auto session_channel = _mm_channels->choose(_chatsession_service_name);
             if(!session_channel) {
-                brpc::Join(user_cntl.call_id());
+                join_user();
                 LOG_ERROR("请求ID: {} - chatsession_service 节点缺失", rid);
                 return err_response(rid, "依赖服务节点缺失");
             }
             ChatSessionService_Stub session_stub(session_channel.get());
             GetMemberIdListReq session_req;
+            GetMemberIdListRsp session_rsp;
+            brpc::Controller session_cntl;
             session_req.set_request_id(rid);
             session_req.set_chat_session_id(chat_ssid);
-            session_stub.GetMemberIdList(&session_cntl, &session_req, &session_rsp, brpc::DoNothing());
-            brpc::Join(session_cntl.call_id());
+            session_stub.GetMemberIdList(&session_cntl, &session_req, &session_rsp, nullptr);
             if(session_cntl.Failed() || !session_rsp.success()) {
-                brpc::Join(user_cntl.call_id());
+                join_user();
                 LOG_ERROR("请求ID: {} - 获取群成员失败: {}", rid, session_cntl.ErrorText());
                 return err_response(rid, "获取群成员失败");
             }
-            for(const auto &m : session_rsp.member_id_list()) member_id_list.push_back(m);
-            // 回填缓存
-            if(_members_cache) _members_cache->warm(chat_ssid, member_id_list);
+            auto ids = std::make_shared<std::vector<std::string>>(session_rsp.member_id_list().begin(),
+                                                                  session_rsp.member_id_list().end());
+            members = ids;
+            // 回填缓存不阻塞发送链路（按回源前读到的版本条件写，期间成员变更则放弃）
+            if(_members_cache && !ids->empty()) {
+                auto cache = _members_cache;
+                _Detach([cache, chat_ssid, members, members_ver]() { cache->fill(chat_ssid, members, members_ver); });
+            }
         }
+        const std::vector<std::string> &member_id_list = *members;
 
-        brpc::Join(user_cntl.call_id());
-
-        if(user_cntl.Failed() || !user_rsp.success()) {
-            LOG_ERROR("请求ID: {} - 获取用户信息失败: {}", rid, user_cntl.ErrorText());
+        if(!_user_cache) {
+            join_user();
+            sender_ok = !user_cntl.Failed() && user_rsp.success();
+            if(sender_ok) sender = user_rsp.user_info();
+            else LOG_ERROR("请求ID: {} - 获取用户信息失败: {}", rid, user_cntl.ErrorText());
+        }
+        if(!sender_ok) {
+            LOG_ERROR("请求ID: {} - 获取用户信息失败 uid={}", rid, uid);
             return err_response(rid, "获取用户信息失败");
         }
         if(member_id_list.empty()) {
@@ -203,12 +268,31 @@ public:
             return err_response(rid, "会话成员为空");
         }
 
-        // ============ 步骤 3: 申请 message_id (Snowflake) + session_seq (Redis INCR) ============
-        unsigned long session_seq = _seq_gen->next_session_seq(chat_ssid);
+        // ============ 步骤 3: 申请 session_seq + user_seq（两者并发） ============
+        // 放在所有校验之后：失败路径不消耗 seq，不制造空洞。
+        // session_seq 会话亲和路由下由本地号段发放（多数消息不访问 Redis）；未启用时逐条 Redis INCR。
+        // 写扩散群批量申请 user_seq（pipeline 一次往返）；大群跳过
+        bool is_large = member_id_list.size() >= LARGE_GROUP_THRESHOLD;
+        unsigned long session_seq = 0;
+        std::vector<unsigned long> user_seqs;
+        {
+            BlockingFanout fanout(_redis_pool.get());
+            fanout.run([&]() {
+                session_seq = _seq_allocator ? _seq_allocator->next(chat_ssid)
+                                             : _seq_gen->next_session_seq(chat_ssid);
+            });
+            if(!is_large) {
+                fanout.run([&]() { user_seqs = _seq_gen->next_user_seq_batch(member_id_list); });
+            }
+        }
         if(session_seq == 0) {
             LOG_ERROR("请求ID: {} - 申请 session_seq 失败 ssid={}", rid, chat_ssid);
             return err_response(rid, "序号生成失败");
         }
+        if(!is_large && user_seqs.size() != member_id_list.size()) {
+            LOG_ERROR("请求ID: {} - 批量申请 user_seq 失败", rid);
+            return err_response(rid, "用户序号生成失败");
+        }
 
         // ============ 步骤 4: 组装 InternalMessage ============
         InternalMessage internal_msg;
@@ -218,25 +302,24 @@ public:
         msg_info->set_chat_session_id(chat_ssid);
         msg_info->set_timestamp(time(nullptr));
         msg_info->mutable_message()->CopyFrom(request->message());
-        msg_info->mutable_sender()->CopyFrom(user_rsp.user_info());
+        // 精简发送者引用：消息经 MQ / 落库 / 推送 / WS 全链路流转，不携带头像等资料字段
+        msg_info->mutable_sender()->set_user_id(sender.user_id());
+        msg_info->mutable_sender()->set_nickname(sender.nickname());
+        msg_info->mutable_sender()->set_profile_version(sender.profile_version());
         msg_info->set_seq_id(session_seq);
         msg_info->set_client_msg_id(client_msg_id);
 
         // 成员列表
-        size_t member_count = member_id_list.size();
-        bool is_large = member_count >= LARGE_GROUP_THRESHOLD;
         internal_msg.set_is_large_group(is_large);
+        internal_msg.set_members_version(members_ver);
+        internal_msg.mutable_member_id_list()->Reserve(static_cast<int>(member_id_list.size()));
         for (const auto& member_id : member_id_list) {
             internal_msg.add_member_id_list(member_id);
         }
 
-        // 写扩散群：批量申请 user_seq（pipeline 一次往返）；大群跳过
+        // 写扩散群：逐成员带上 user_seq
         if(!is_large) {
-            auto user_seqs = _seq_gen->next_user_seq_batch(member_id_list);
-            if(user_seqs.size() != member_id_list.size()) {
-                LOG_ERROR("请求ID: {} - 批量申请 user_seq 失败", rid);
-                return err_response(rid, "用户序号生成失败");
-            }
+            internal_msg.mutable_user_seqs()->Reserve(static_cast<int>(member_id_list.size()));
             for(size_t i = 0; i < member_id_list.size(); ++i) {
                 auto *pair = internal_msg.add_user_seqs();
                 pair->set_user_id(member_id_list[i]);
@@ -249,10 +332,15 @@ public:
         response->set_message_id(msg_info->message_id());
         response->set_seq_id(session_seq);
         response->mutable_message()->CopyFrom(*msg_info);
+        response->mutable_target_id_list()->Reserve(static_cast<int>(member_id_list.size()));
         for(const auto& member_id : member_id_list) {
             response->add_target_id_list(member_id);
         }
 
+        // 幂等结果：投递成功后写回窗口，之后的重试直接拿到这条消息
+        std::string dedup_value;
+        if(dedup_held) dedup_value = msg_info->SerializeAsString();
+
         // 解除 rpc_guard 对 done 的管理权，等 MQ 投递完再 Run
         google::protobuf::Closure* async_done = rpc_guard.release();
 
@@ -266,9 +354,11 @@ public:
             ::chatnow::mq::mq_inject_trace_headers(_mq_headers);
             _publisher->publish_confirm(internal_msg.SerializeAsString(),
                 _mq_headers,
-                [async_done, response, rid, done_called](PublishStatus status, const std::string& msg) {
+                [this, async_done, response, rid, uid, client_msg_id, dedup_held,
+                 dedup_value = std::move(dedup_value), done_called](PublishStatus status, const std::string& msg) {
                 if(done_called->exchange(true)) return;  // 防止重复 Run
-                if(status == PublishStatus::Acked) {
+                bool acked = status == PublishStatus::Acked;
+                if(acked) {
                     LOG_DEBUG("请求ID: {} - 消息成功投递到 Broker", rid);
                     response->set_success(true);
                 } else {
@@ -278,11 +368,27 @@ public:
                     response->clear_target_id_list();
                     response->set_errmsg("消息投递失败,请重试");
                 }
-                async_done->Run();
+                if(!dedup_held) {
+                    async_done->Run();
+                    return;
+                }
+                // 回调跑在 AMQP 事件线程：幂等窗口写回 / 释放是同步 Redis 往返，移出事件线程后再应答；
+                // 先写回再应答：客户端收到应答后的重试必然命中结果
+                auto dedup = _dedup;
+                _Offload([dedup, async_done, uid, client_msg_id, acked, dedup_value]() {
+                    if(acked) dedup->complete(uid, client_msg_id, dedup_value);
+                    else dedup->release(uid, client_msg_id);
+                    async_done->Run();
+                });
             });
         } catch(std::exception &e) {
             LOG_ERROR("请求ID: {} - publish_confirm 同步异常: {}", rid, e.what());
             if(!done_called->exchange(true)) {
+                if(dedup_held) {
+                    auto dedup = _dedup;
+                    std::string cmid = client_msg_id;
+                    _Detach([dedup, uid, cmid]() { dedup->release(uid, cmid); });
+                }
                 response->set_success(false);
                 response->clear_message();
                 response->clear_target_id_list();
@@ -292,6 +398,98 @@ public:
         }
     }
 private:
+    /* brief: 不需要等结果的阻塞调用（缓存回填 / 释放占位）丢到 Redis 线程池；未配置线程池时就地执行 */
+    void _Detach(std::function<void()> fn)
+    {
+        if(_redis_pool && _redis_pool->submit_to(_detach_rr.fetch_add(1, std::memory_order_relaxed), fn)) return;
+        fn();
+    }
+
+    /* brief: 不允许就地执行的阻塞调用（如 AMQP 事件线程回调中的 Redis 往返）：
+     *        优先投递 Redis 线程池，未配置或已停止时起后台 bthread */
+    void _Offload(std::function<void()> fn)
+    {
+        if(_redis_pool && _redis_pool->submit_to(_detach_rr.fetch_add(1, std::memory_order_relaxed), fn)) return;
+        auto *task = new std::function<void()>(std::move(fn));
+        bthread_t tid;
+        auto entry = [](void *arg) -> void* {
+            std::unique_ptr<std::function<void()>> t(static_cast<std::function<void()>*>(arg));
+            (*t)();
+            return nullptr;
+        };
+        if(bthread_start_background(&tid, nullptr, entry, task) != 0) entry(task);
+    }
+
+    /* brief: 幂等占位 pending 时每 100ms 重查一次，最多 5 次，等首次请求出结果
+     *  - 休眠在 handler 所在 bthread 上（只挂起本 bthread）；每次重查单独投递 Redis 线程池，
+     *    不在池线程里睡眠，避免重复请求长时间占住池线程、拖慢排在后面的 Redis 调用
+     */
+    MsgDedup::State _AwaitDedup(const std::string &uid, const std::string &client_msg_id, std::string &prev)
+    {
+        MsgDedup::State st = MsgDedup::State::kPending;
+        for(int i = 0; i < kDedupPollTimes && st == MsgDedup::State::kPending; ++i) {
+            bthread_usleep(kDedupPollIntervalUs);
+            BlockingFanout fanout(_redis_pool.get());
+            fanout.run([&]() {
+                st = _dedup->peek(uid, client_msg_id, prev);
+                // 首次请求失败已释放占位：重新抢占，由本请求处理
+                if(st == MsgDedup::State::kAcquired) st = _dedup->acquire(uid, client_msg_id, prev);
+            });
+        }
+        return st;
+    }
+
+    /* brief: 幂等窗口不可用时的回退：查 message 服务（DB uk_client_msg）；命中返回 true 并填好响应 */
+    bool _SelectByClientMsg(const std::string &rid, const std::string &uid,
+                            const std::string &client_msg_id, ::chatnow::GetTransmitTargetRsp *response)
+    {
+        auto msg_channel = _mm_channels->choose(_message_service_name);
+        if(!msg_channel) {
+            LOG_WARN("请求ID: {} - message_service 不可用，跳过幂等检查", rid);
+            return false;
+        }
+        MsgStorageService_Stub stub(msg_channel.get());
+        SelectByClientMsgReq dup_req;
+        SelectByClientMsgRsp dup_rsp;
+        brpc::Controller dup_cntl;
+        dup_req.set_request_id(rid);
+        dup_req.set_user_id(uid);
+        dup_req.set_client_msg_id(client_msg_id);
+        stub.SelectByClientMsg(&dup_cntl, &dup_req, &dup_rsp, nullptr);
+        if(dup_cntl.Failed() || !dup_rsp.success() || !dup_rsp.exists()) return false;
+        LOG_INFO("请求ID: {} - 命中幂等 client_msg_id={} 直接返回旧消息", rid, client_msg_id);
+        response->set_request_id(rid);
+        response->set_success(true);
+        response->mutable_message()->CopyFrom(dup_rsp.message());
+        // 幂等返回不带 target_id_list（避免重复推送）
+        return true;
+    }
+
+    /* brief: UserInfoCache 回源：GetMultiUserInfo(brief)，不下载头像 */
+    bool _LoadUsers(const std::string &rid, const std::vector<std::string> &uids,
+                    std::unordered_map<std::string, UserInfo> &out)
+    {
+        auto channel = _mm_channels->choose(_user_service_name);
+        if(!channel) {
+            LOG_ERROR("请求ID: {} - user_service 节点缺失", rid);
+            return false;
+        }
+        UserService_Stub stub(channel.get());
+        GetMultiUserInfoReq req;
+        GetMultiUserInfoRsp rsp;
+        req.set_request_id(rid);
+        req.set_brief(true);
+        for(const auto &id : uids) req.add_users_id(id);
+        brpc::Controller cntl;
+        stub.GetMultiUserInfo(&cntl, &req, &rsp, nullptr);
+        if(cntl.Failed() || !rsp.success()) {
+            LOG_ERROR("请求ID: {} - 批量获取用户信息失败: {} {}", rid, cntl.ErrorText(), rsp.errmsg());
+            return false;
+        }
+        for(const auto &kv : rsp.users_info()) out[kv.first] = kv.second;
+        return true;
+    }
+
     std::string _user_service_name;
     std::string _chatsession_service_name;
     std::string _message_service_name;
@@ -303,8 +501,16 @@ private:
     Publisher::ptr _publisher;
     std::shared_ptr<SnowflakeId> _id_generator;
     SeqGen::ptr _seq_gen;
-    Members::ptr _members_cache;
+    MemberListCache::ptr _members_cache;
     RateLimiter::ptr _rate_limiter;
+    UserInfoCache<UserInfo>::ptr _user_cache;
+    SessionSeqAllocator::ptr _seq_allocator;
+    MsgDedup::ptr _dedup;
+    ShardedExecutor::ptr _redis_pool;       // Redis 阻塞调用专用线程池，handler 所在 bthread 只挂起不占 worker
+    std::atomic<size_t> _detach_rr {0};
+
+    static constexpr int kDedupPollTimes = 5;
+    static constexpr int kDedupPollIntervalUs = 100 * 1000;
 };
 
 class TransmiteServer
@@ -385,20 +591,26 @@ public:
     }
     /* brief: 设置实例标识（host:pid），用于 worker_id 租约识别 */
     void set_instance_owner(const std::string &owner) { _instance_owner = owner; }
-    /* brief: 用于构造服务发现&信道管理客户端对象（含 message_service 用于幂等查询） */
+    /* brief: 用于构造服务发现&信道管理客户端对象（含 message_service 用于幂等查询）
+     *  transmite_service_name 非空时同时关注自身服务的实例集合，
+     *  用与 gateway 相同的一致性哈希环判断会话归属（本地号段交接用）
+     */
     void make_discovery_object(const std::string &reg_host,
                             const std::string &base_service_name,
                             const std::string &user_service_name,
                             const std::string &chatsession_service_name,
-                            const std::string &message_service_name)
+                            const std::string &message_service_name,
+                            const std::string &transmite_service_name = "")
     {
         _user_service_name = user_service_name;
         _chatsession_service_name = chatsession_service_name;
         _message_service_name = message_service_name;
+        _transmite_service_name = transmite_service_name;
         _mm_channels = std::make_shared<ServiceManager>();
         _mm_channels->declared(_user_service_name);
         _mm_channels->declared(_chatsession_service_name);
         _mm_channels->declared(_message_service_name);
+        if(!_transmite_service_name.empty()) _mm_channels->declared(_transmite_service_name);
         auto put_cb = std::bind(&ServiceManager::onServiceOnline, _mm_channels.get(), std::placeholders::_1, std::placeholders::_2);
         auto del_cb = std::bind(&ServiceManager::onServiceOffline, _mm_channels.get(), std::placeholders::_1, std::placeholders::_2);
 
@@ -449,14 +661,79 @@ public:
         _publisher = std::make_shared<Publisher>(_mq_client, settings);
         LOG_INFO("Transmite MQ 已就绪: exchange={} (FANOUT, publisher-only)", exchange_name);
     }
-    /* brief: 构造 Redis 客户端 + SeqGen + Members + RateLimiter */
+    /* brief: 构造 Redis 客户端 + SeqGen + 成员列表缓存 + UserInfoCache + 幂等窗口
+     *  dedup_ttl_sec <= 0 不启用幂等窗口，每条消息回退 SelectByClientMsg 查库
+     */
     void make_redis_object(const std::string &host, uint16_t port, int db,
-                          bool keep_alive, int pool_size)
+                          bool keep_alive, int pool_size, int dedup_ttl_sec = 300)
     {
         _redis = RedisClientFactory::create(host, port, db, keep_alive, pool_size);
         _seq_gen = std::make_shared<SeqGen>(_redis);
-        _members_cache = std::make_shared<Members>(_redis);
-        _rate_limiter = std::make_shared<RateLimiter>(_redis);
+        _members_cache = std::make_shared<MemberListCache>(std::make_shared<Members>(_redis));
+        // 发送者引用只需精简资料（brief 回源，无头像）：L2 用独立前缀，不与其它服务的完整资料互相覆盖
+        _user_cache = std::make_shared<UserInfoCache<UserInfo>>(_redis, 4 * 1024 * 1024, std::chrono::seconds(5),
+                                                                kUserInfoTtl, key::kUserBrief);
+        if(dedup_ttl_sec > 0) _dedup = std::make_shared<MsgDedup>(_redis, std::chrono::seconds(dedup_ttl_sec));
+    }
+    /* brief: 调整成员列表 L1（须在 make_redis_object 之后）；l1_ttl_ms 为跨进程失效的延迟上限 */
+    void make_member_cache_object(size_t l1_capacity, int l1_ttl_ms) {
+        if(!_redis) {
+            LOG_ERROR("make_member_cache_object 必须在 make_redis_object 之后调用");
+            abort();
+        }
+        _members_cache = std::make_shared<MemberListCache>(std::make_shared<Members>(_redis), l1_capacity,
+                                                           std::chrono::milliseconds(std::max(l1_ttl_ms, 0)));
+    }
+    /* brief: 构造 Redis 阻塞调用线程池：GetTransmitTarget 内的 Redis 查询并发投递到这里，
+     *  handler 所在 bthread 只挂起等待，不占用 brpc worker；threads == 0 时就地串行执行
+     */
+    void make_redis_pool_object(size_t threads) {
+        if(threads == 0) return;
+        _redis_pool = std::make_shared<ShardedExecutor>(threads, "transmite-redis");
+    }
+    /* brief: 构造发消息限流器（须在 make_redis_object 之后）；两个维度的 qps 都 <= 0 时不启用 */
+    void make_rate_limiter_object(double user_qps, double user_burst,
+                                  double session_qps, double session_burst, bool local_precheck)
+    {
+        if(!_redis) {
+            LOG_ERROR("make_rate_limiter_object 必须在 make_redis_object 之后调用");
+            abort();
+        }
+        RateLimiter::Options opt;
+        opt.user = {user_qps, user_burst};
+        opt.session = {session_qps, session_burst};
+        opt.local_precheck = local_precheck;
+        if(!opt.user.enabled() && !opt.session.enabled()) {
+            LOG_WARN("发消息限流未启用");
+            return;
+        }
+        _rate_limiter = std::make_shared<RateLimiter>(_redis, opt);
+    }
+    /* brief: 构造会话级 seq 本地号段分配器（须在 make_redis_object / make_discovery_object 之后）
+     *  max_block <= 1 不启用，退回逐条 INCR；self_host 为本实例注册到 etcd 的 access_host
+     */
+    void make_seq_allocator_object(size_t max_block, const std::string &self_host) {
+        if(max_block <= 1) return;
+        if(!_seq_gen) {
+            LOG_ERROR("make_seq_allocator_object 必须在 make_redis_object 之后调用");
+            abort();
+        }
+        SessionSeqAllocator::OwnedFn owned;
+        if(_mm_channels && !_transmite_service_name.empty()) {
+            auto channels = _mm_channels;
+            auto service = _transmite_service_name;
+            owned = [channels, service, self_host](const std::string &ssid) {
+                std::string owner = channels->owner(service, ssid);
+                return owner.empty() || owner == self_host;     // 环尚未就绪时视为归属自己
+            };
+        } else {
+            LOG_WARN("未关注 transmite 自身实例集合，本地号段仅按空闲归还");
+        }
+        SessionSeqAllocator::Options opt;
+        opt.max_block = max_block;
+        opt.holder = self_host;
+        _seq_allocator = std::make_shared<SessionSeqAllocator>(_seq_gen, opt, std::move(owned));
+        _seq_allocator->start();
     }
     /* brief: 构造RPC服务器对象，并添加服务 */
     void make_rpc_object(uint16_t port, uint32_t timeout, uint8_t num_threads) {
@@ -487,7 +764,11 @@ public:
                                                                         _id_generator,
                                                                         _seq_gen,
                                                                         _members_cache,
-                                                                        _rate_limiter);
+                                                                        _rate_limiter,
+                                                                        _user_cache,
+                                                                        _seq_allocator,
+                                                                        _dedup,
+                                                                        _redis_pool);
         int ret = _rpc_server->AddService(transmite_service, brpc::ServiceOwnership::SERVER_OWNS_SERVICE);
         if(ret == -1) {
             LOG_ERROR("添加RPC服务失败!");
@@ -526,6 +807,7 @@ private:
     std::string _user_service_name;
     std::string _chatsession_service_name;
     std::string _message_service_name;
+    std::string _transmite_service_name;
     ServiceManager::ptr _mm_channels;
 
     std::string _exchange_name;
@@ -536,8 +818,12 @@ private:
 
     std::shared_ptr<sw::redis::Redis> _redis;
     SeqGen::ptr _seq_gen;
-    Members::ptr _members_cache;
+    MemberListCache::ptr _members_cache;
     RateLimiter::ptr _rate_limiter;
+    UserInfoCache<UserInfo>::ptr _user_cache;
+    SessionSeqAllocator::ptr _seq_allocator;
+    MsgDedup::ptr _dedup;
+    ShardedExecutor::ptr _redis_pool;
     std::string _instance_owner;
     WorkerIdAllocator::ptr _worker_allocator;
 
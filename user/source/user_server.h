@@ -8,6 +8,7 @@
 #include "dao/data_es.hpp"      // es数据管理客户端封装
 #include "dao/mysql_user.hpp"   // mysql数据管理客户端封装
 #include "dao/data_redis.hpp"   // redis数据管理客户端封装
+#include "dao/user_info_cache.hpp"   // 用户资料两级缓存（此处仅负责失效）
 #include "common/types.pb.h"
 #include "common/error.pb.h"
 #include "common/envelope.pb.h"
@@ -244,6 +245,7 @@ public:
                     _redis_session(std::make_shared<Session>(redis_client)),
                     _redis_status(std::make_shared<Status>(redis_client)),
                     _redis_codes(std::make_shared<Codes>(redis_client)),
+                    _user_cache(std::make_shared<UserInfoCache<UserInfo>>(redis_client)),
                     _mail_client(std::make_shared<MailClient>(mail_client->settings())),
                     _file_service_name(file_service_name),
                     _mm_channels(channel_manager) 
@@ -548,6 +550,13 @@ public:
         UserInfo *user_info = response->mutable_user_info();
         user_info->set_user_id(user->user_id());
         user_info->set_nickname(user->nickname());
+        user_info->set_profile_version(pt_to_ms(user->update_time()));
+        if(request->brief()) {
+            // 消息链路的发送者引用：不拉头像，客户端按 profile_version 走本地资料缓存
+            response->set_request_id(request->request_id());
+            response->set_success(true);
+            return;
+        }
         user_info->set_description(user->description());
         user_info->set_mail(user->mail());
         if(!user->avatar_id().empty()) {
@@ -601,14 +610,29 @@ public:
             LOG_ERROR("请求ID: {} - 查找到的用户信息数量与请求不一致: {} - {}", request->request_id(), request->users_id_size(), users.size());
             return err_response(request->request_id(), "查找到的用户信息数量与请求不一致");
         }
-        //3. 批量从文件管理子服务下载
-        //3.1 从信道管理对象中，获取到连接了文件管理子服务的channel
+        //3. brief 模式（资料缓存回源）：不下载头像
+        if(request->brief()) {
+            auto user_map = response->mutable_users_info();
+            for(auto &user : users) {
+                UserInfo &user_info = (*user_map)[user.user_id()];
+                user_info.set_user_id(user.user_id());
+                user_info.set_nickname(user.nickname());
+                user_info.set_description(user.description());
+                user_info.set_mail(user.mail());
+                user_info.set_profile_version(pt_to_ms(user.update_time()));
+            }
+            response->set_request_id(request->request_id());
+            response->set_success(true);
+            return;
+        }
+        //4. 批量从文件管理子服务下载
+        //4.1 从信道管理对象中，获取到连接了文件管理子服务的channel
         auto channel = _mm_channels->choose(_file_service_name);
         if(!channel) {
             LOG_ERROR("请求ID: {} - 未找到文件子服务: {}", request->request_id(), _file_service_name);
             return err_response(request->request_id(), "用户不存在");    
         }
-        //3.2 进行RPC调用
+        //4.2 进行RPC调用
         FileService_Stub stub(channel.get());
         GetMultiFileReq req;
         GetMultiFileRsp rsp;
@@ -633,11 +657,84 @@ public:
             user_info.set_description(user.description());
             user_info.set_mail(user.mail());
             user_info.set_avatar((*file_map)[user.avatar_id()].file_content());
+            user_info.set_profile_version(pt_to_ms(user.update_time()));
             (*user_map)[user_info.user_id()] = user_info;
         }
         response->set_request_id(request->request_id());
         response->set_success(true);
     }
+    // 与媒体批量下载上限一致：超限让客户端分批校验，避免单次请求放大为无界的批量查库 / 下载
+    static constexpr int kMaxProfileBatch = 500;
+    /* brief: 客户端资料缓存校验 —— 只回 profile_version 与本地不一致的用户完整资料，
+     *        头像只为这些用户下载；不存在的用户直接忽略（不像 GetMultiUserInfo 那样整体失败）
+     */
+    virtual void GetUserProfiles(::google::protobuf::RpcController* controller,
+                        const ::chatnow::GetUserProfilesReq* request,
+                        ::chatnow::GetUserProfilesRsp* response,
+                        ::google::protobuf::Closure* done)
+    {
+        brpc::ClosureGuard rpc_guard(done);
+        auto err_response = [this, response](const std::string &rid, const std::string &err_msg) -> void {
+            response->set_request_id(rid);
+            response->set_success(false);
+            response->set_errmsg(err_msg);
+            return;
+        };
+        std::string rid = request->request_id();
+        if(request->known_versions_size() > kMaxProfileBatch) {
+            LOG_ERROR("请求ID: {} - 资料校验用户数超限: {}", rid, request->known_versions_size());
+            return err_response(rid, "单次校验用户数过多");
+        }
+        //1. 查库，挑出版本变化的用户
+        std::vector<std::string> uid_list;
+        uid_list.reserve(request->known_versions_size());
+        for(const auto &kv : request->known_versions()) uid_list.push_back(kv.first);
+        auto users = _mysql_user->select_multi_users(uid_list);
+        std::vector<const User*> changed;
+        for(const auto &user : users) {
+            auto it = request->known_versions().find(user.user_id());
+            if(it != request->known_versions().end() && it->second == pt_to_ms(user.update_time())) continue;
+            changed.push_back(&user);
+        }
+        response->set_request_id(rid);
+        response->set_success(true);
+        if(changed.empty()) return;
+        //2. 只为变化的用户批量下载头像
+        GetMultiFileRsp file_rsp;
+        GetMultiFileReq file_req;
+        file_req.set_request_id(rid);
+        for(const User *user : changed) {
+            if(!user->avatar_id().empty()) file_req.add_file_id_list(user->avatar_id());
+        }
+        if(file_req.file_id_list_size() > 0) {
+            auto channel = _mm_channels->choose(_file_service_name);
+            if(!channel) {
+                LOG_ERROR("请求ID: {} - 未找到文件子服务: {}", rid, _file_service_name);
+                return err_response(rid, "未找到文件子服务");
+            }
+            FileService_Stub stub(channel.get());
+            brpc::Controller cntl;
+            stub.GetMultiFile(&cntl, &file_req, &file_rsp, nullptr);
+            if(cntl.Failed() == true || file_rsp.success() == false) {
+                LOG_ERROR("请求ID: {} - 文件子服务调用失败: {}", rid, cntl.ErrorText());
+                return err_response(rid, "文件子服务调用失败");
+            }
+        }
+        //3. 组织响应
+        auto user_map = response->mutable_users_info();
+        const auto &file_map = file_rsp.file_data();
+        for(const User *user : changed) {
+            UserInfo &user_info = (*user_map)[user->user_id()];
+            user_info.set_user_id(user->user_id());
+            user_info.set_nickname(user->nickname());
+            user_info.set_description(user->description());
+            // 邮箱只返回给本人（user_id 由网关按 JWT 身份覆盖写入），与单用户资料接口一致
+            if(user->user_id() == request->user_id()) user_info.set_mail(user->mail());
+            user_info.set_profile_version(pt_to_ms(user->update_time()));
+            auto fit = file_map.find(user->avatar_id());
+            if(fit != file_map.end()) user_info.set_avatar(fit->second.file_content());
+        }
+    }
     /* brief: 设置用户头像 */
     virtual void SetUserAvatar(::google::protobuf::RpcController* controller,
                         const ::chatnow::SetUserAvatarReq* request,
@@ -691,6 +788,7 @@ public:
             return err_response(request->request_id(), "更新数据库用户头像ID失败");              
         }
         //5. 更新 ES 服务器中用户信息
+        _user_cache->invalidate(user->user_id());   // 资料已变更：各服务的 UserInfoCache 随版本失效
         ret = _es_user->append_data(user->user_id(), user->mail(), user->nickname(), user->description(), user->avatar_id());
         if(ret == false) {
             LOG_ERROR("请求ID: {} - 更新 ES搜索引擎 用户头像ID失败: {}", request->request_id(), avatar_id);
@@ -737,6 +835,7 @@ public:
             return err_response(request->request_id(), "更新数据库用户昵称失败");                
         }
         //5. 更新 ES 服务中，用户信息
+        _user_cache->invalidate(user->user_id());
         ret = _es_user->append_data(user->user_id(), user->mail(), user->nickname(), user->description(), user->avatar_id());
         if(ret == false) {
             LOG_ERROR("请求ID: {} - 更新 ES搜索引擎 用户昵称失败: {}", request->request_id(), user->nickname());
@@ -777,6 +876,7 @@ public:
             return err_response(request->request_id(), "更新数据库用户签名失败");                
         }
         //4. 更新 ES 服务中，用户信息
+        _user_cache->invalidate(user->user_id());
         ret = _es_user->append_data(user->user_id(), user->mail(), user->nickname(), user->description(), user->avatar_id());
         if(ret == false) {
             LOG_ERROR("请求ID: {} - 更新 ES搜索引擎 用户签名失败: {}", request->request_id(), user->description());
@@ -825,6 +925,7 @@ public:
             return err_response(request->request_id(), "更新数据库用户邮箱失败");                
         }
         //5. 更新 ES 服务中，用户信息
+        _user_cache->invalidate(user->user_id());
         ret = _es_user->append_data(user->user_id(), user->mail(), user->nickname(), user->description(), user->avatar_id());
         if(ret == false) {
             LOG_ERROR("请求ID: {} - 更新 ES搜索引擎 用户邮箱失败: {}", request->request_id(), user->mail());
@@ -840,6 +941,7 @@ private:
     Session::ptr _redis_session;
     Status::ptr _redis_status;
     Codes::ptr _redis_codes;
+    UserInfoCache<UserInfo>::ptr _user_cache;
     MailClient::ptr _mail_client;
     /* 以下是 RPC 调用客户端相关对象 */
     std::string _file_service_name;